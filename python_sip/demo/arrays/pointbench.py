@@ -0,0 +1,59 @@
+#!/bin/env python
+
+# Per-frame cost of updating a large points node from Python:
+# a list of arVector3 (converted element by element) versus a numpy
+# array (passed through the buffer protocol without conversion).
+# Runs against a local arGraphicsDatabase, so needs no szgserver.
+#
+# Usage: python pointbench.py [points [frames]]
+
+import sys
+import time
+import math
+import numpy
+from szg import *
+
+numPoints = 100000
+numFrames = 20
+if len(sys.argv) > 1:
+  numPoints = int(sys.argv[1])
+if len(sys.argv) > 2:
+  numFrames = int(sys.argv[2])
+
+db = arGraphicsDatabase()
+dgSetGraphicsDatabase(db)
+pointsID = dgPoints('points', 'root', [arVector3(0,0,0)])
+colorsID = dgColor4('colors', 'points', [arVector4(1,1,1,1)])
+dgDrawable('cloud', 'colors', 0, numPoints)  # 0 is DG_POINTS
+
+angles = numpy.linspace(0, 2*math.pi, numPoints).astype(numpy.float32)
+positions = numpy.zeros((numPoints,3), numpy.float32)
+colors = numpy.ones((numPoints,4), numpy.float32)
+
+def animate(t):
+  positions[:,0] = numpy.cos(angles*3 + t)
+  positions[:,1] = numpy.sin(angles*5 + t)
+  positions[:,2] = numpy.sin(angles + t)
+  colors[:,0] = .5 + .5*positions[:,2]
+
+def updateLists(t):
+  animate(t)
+  dgPoints(pointsID, [arVector3(p[0],p[1],p[2]) for p in positions])
+  dgColor4(colorsID, [arVector4(c[0],c[1],c[2],c[3]) for c in colors])
+
+def updateArrays(t):
+  animate(t)
+  dgPoints(pointsID, positions)
+  dgColor4(colorsID, colors)
+
+def bench(name, update):
+  start = time.time()
+  for frame in range(numFrames):
+    update(frame * .02)
+  msec = (time.time() - start) * 1000. / numFrames
+  print '%s: %d points, %.1f msec/frame' % (name, numPoints, msec)
+  return msec
+
+lists = bench('lists ', updateLists)
+arrays = bench('arrays', updateArrays)
+print 'speedup: %.1fx' % (lists / arrays)
@@ -18,6 +18,8 @@ void arBarrierServer::_barrierDataFunction(arStructuredData* data,
     arGuard _(_queueActivationLock, "arBarrierServer::_barrierDataFunction _handshakeData");
     const int bondedSocketID = data->getDataInt(BONDED_ID);
     _activationSocketIDs.push_back(pair<int, int>(theSocket->getID(), bondedSocketID));
+    _telemetry.addClient(theSocket->getID(),
+      _dataServer.getSocketAddress(theSocket->getID()));
     // If the signal object has been set and no one is connected yet,
     // send a signal here as well.
     if (getNumberConnectedActive()==0 && _pumpPrimingFlag) {
@@ -39,7 +41,18 @@ void arBarrierServer::_barrierDataFunction(arStructuredData* data,
     _rcvTime = theData[1];
     _procTime = theData[2];
     _frameNum = theData[3];
+    const int socketID = theSocket->getID();
     arGuard _(_waitingLock, "arBarrierServer::_barrierDataFunction _clientTuningData");
+    if (_excusedIDs.erase(socketID) > 0) {
+      // This belongs to a frame released without it.  The client
+      // already holds that (sticky) release, so it won't wait for it:
+      // don't count it towards the current frame.
+      return;
+    }
+    _telemetry.recordArrival(socketID, _drawTime, _rcvTime, _procTime, _frameNum);
+    if (_totalWaiting == 0)
+      _roundStart = ar_time();
+    _arrivedIDs.insert(socketID);
     _totalWaiting++;
     _waitingCondVar.signal();
   }
@@ -64,19 +77,77 @@ void ar_releaseFunction(void* server) {
   ((arBarrierServer*)server)->_releaseFunction();
 }
 
+// Caller holds _waitingLock.  Returns -1 for "no deadline".
+int arBarrierServer::_msecUntilDeadline() const {
+  if (_deadlineUsec <= 0 && _targetUsec <= 0)
+    return -1;
+  // Never release without the local loop:  it produces the frames.
+  if (_totalWaiting == 0 || (_localConnection && !_localArrived))
+    return -1;
+
+  const ar_timeval now = ar_time();
+  double usecLeft = -1.;
+  if (_deadlineUsec > 0)
+    usecLeft = _deadlineUsec - ar_difftime(now, _roundStart);
+  if (_targetUsec > 0 && !_lastRelease.zero()) {
+    const double usecTarget = _targetUsec - ar_difftime(now, _lastRelease);
+    if (usecLeft < 0. || usecTarget < usecLeft)
+      usecLeft = usecTarget;
+  }
+  if (usecLeft <= 0.)
+    return 0;
+  return int(usecLeft / 1000.) + 1;
+}
+
+// Caller holds _waitingLock.
+void arBarrierServer::_excuseLaggards() {
+  list<arSocket*>* active = _dataServer.getActiveSockets();
+  for (list<arSocket*>::const_iterator i = active->begin(); i != active->end(); ++i) {
+    const int id = (*i)->getID();
+    if (_arrivedIDs.find(id) == _arrivedIDs.end()) {
+      _excusedIDs.insert(id);
+      _telemetry.recordLate(id);
+    }
+  }
+  delete active;
+}
+
 void arBarrierServer::_releaseFunction() {
   while (_runThreads) {
     _waitingLock.lock("arBarrierServer::_releaseFunction");
+    bool early = false;
     while (true) {
       int total = getNumberConnectedActive();
       if (_localConnection)
         ++total;
-      if (_totalWaiting >= total && total > 0) {
-        _totalWaiting = 0;
+      if (_totalWaiting >= total && total > 0)
+        break;
+      const int msecWait = _msecUntilDeadline();
+      if (msecWait == 0) {
+        early = true;
         break;
       }
-      _waitingCondVar.wait(_waitingLock);
+      _waitingCondVar.wait(_waitingLock, msecWait);
+    }
+    if (early)
+      _excuseLaggards();
+    _totalWaiting = 0;
+    _arrivedIDs.clear();
+    _localArrived = false;
+    _telemetry.recordRelease(early);
+
+    if (_minReleaseUsec > 0 && !_lastRelease.zero()) {
+      // Frame rate cap.  Everyone's waiting for this release, so nobody
+      // needs _waitingLock meanwhile except late clients and new connections.
+      const double usecEarly = _minReleaseUsec - ar_difftime(ar_time(), _lastRelease);
+      if (usecEarly > 0.) {
+        _telemetry.recordCapped();
+        _waitingLock.unlock();
+        ar_usleep(int(usecEarly));
+        _waitingLock.lock("arBarrierServer::_releaseFunction capped");
+      }
     }
+    _lastRelease = ar_time();
     // send release packet
     const int tuningData = _serverSendSize;
     if (!_serverTuningData->dataIn(
@@ -103,12 +174,17 @@ void arBarrierServer::_releaseFunction() {
   }
 }
 
-void ar_barrierDisconnectFunction(void* server, arSocket*) {
-  ((arBarrierServer*)server)->_barrierDisconnectFunction();
+void ar_barrierDisconnectFunction(void* server, arSocket* theSocket) {
+  ((arBarrierServer*)server)->_barrierDisconnectFunction(theSocket);
 }
 
-void arBarrierServer::_barrierDisconnectFunction() {
+void arBarrierServer::_barrierDisconnectFunction(arSocket* theSocket) {
   _waitingLock.lock("arBarrierServer::_barrierDisconnectFunction wait");
+  if (theSocket) {
+    _telemetry.removeClient(theSocket->getID());
+    _arrivedIDs.erase(theSocket->getID());
+    _excusedIDs.erase(theSocket->getID());
+  }
   _waitingCondVar.signal();
   _waitingLock.unlock();
 
@@ -122,6 +198,10 @@ arBarrierServer::arBarrierServer():
   _client(NULL),
   _serviceName("NULL"),
   _totalWaiting(0),
+  _localArrived(false),
+  _deadlineUsec(0),
+  _minReleaseUsec(0),
+  _targetUsec(0),
   _waitingCondVar("arBarrierServer-wait"),
   _started(false),
   _runThreads(false),
@@ -176,9 +256,33 @@ bool arBarrierServer::init(const string& serviceName, const string& channel, arS
   _serviceName = serviceName;
   _channel = channel;
   _client = &client;
+
+  // Frame pacing, from the master's host.
+  setDeadline(client.getAttributeInt("SZG_BARRIER", "deadline_usec"));
+  float fps = 0.;
+  setMaxFrameRate(client.getAttributeFloats("SZG_BARRIER", "max_fps", &fps, 1) ? fps : 0.);
+  fps = 0.;
+  setTargetFrameRate(client.getAttributeFloats("SZG_BARRIER", "target_fps", &fps, 1) ? fps : 0.);
   return true;
 }
 
+void arBarrierServer::setDeadline(int usec) {
+  arGuard _(_waitingLock, "arBarrierServer::setDeadline");
+  _deadlineUsec = usec > 0 ? usec : 0;
+  _waitingCondVar.signal();
+}
+
+void arBarrierServer::setMaxFrameRate(float fps) {
+  arGuard _(_waitingLock, "arBarrierServer::setMaxFrameRate");
+  _minReleaseUsec = fps > 0. ? int(1e6 / fps) : 0;
+}
+
+void arBarrierServer::setTargetFrameRate(float fps) {
+  arGuard _(_waitingLock, "arBarrierServer::setTargetFrameRate");
+  _targetUsec = fps > 0. ? int(1e6 / fps) : 0;
+  _waitingCondVar.signal();
+}
+
 bool arBarrierServer::start() {
   if (!_client) {
     cerr << "arBarrierServer error: init not called.\n";
@@ -357,7 +461,11 @@ void arBarrierServer::localSync() {
 
   if (getNumberConnectedActive() == 0)
     ar_usleep(10000);
+  _telemetry.recordArrival(arBarrierTelemetry::AR_LOCAL_ID);
   _waitingLock.lock("arBarrierServer::localSync");
+    if (_totalWaiting == 0)
+      _roundStart = ar_time();
+    _localArrived = true;
     _totalWaiting++;
     _waitingCondVar.signal();
   _waitingLock.unlock();
@@ -9,8 +9,10 @@
 #include "arDataUtilities.h"
 #include "arDataServer.h"
 #include "arSZGClient.h"
+#include "arBarrierTelemetry.h"
 #include "arBarrierCalling.h"
 
+#include <set>
 using namespace std;
 
 // Server for arBarrierClient objects.
@@ -32,8 +34,19 @@ class SZG_CALL arBarrierServer {
   int getDrawTime() const { return _drawTime; }
   int getRcvTime()  const { return _rcvTime;  }
   int getProcTime() const { return _procTime; }
+  // Per-client history of the above, plus time spent waiting at the barrier.
+  arBarrierTelemetry& getTelemetry() { return _telemetry; }
   bool setServerSendSize(int);
 
+  // Frame pacing.  Zero (the default) disables each policy.
+  // Release without laggards this long after the first client arrives.
+  // A laggard skips its next wait, resynchronizing on the following frame.
+  void setDeadline(int usec);
+  // Never release more often than this.
+  void setMaxFrameRate(float fps);
+  // Release without laggards, if need be, to keep this frame rate.
+  void setTargetFrameRate(float fps);
+
   void setSignalObject(arSignalObject* signalObject);
   void setSignalObjectRelease(arSignalObject*);
 
@@ -56,6 +69,14 @@ class SZG_CALL arBarrierServer {
   string         _serviceName;
 
   int            _totalWaiting; // too complicated for arIntAtom
+  set<int>       _arrivedIDs;   // remote clients counted in _totalWaiting
+  set<int>       _excusedIDs;   // released early without them
+  bool           _localArrived;
+  ar_timeval     _roundStart;   // first arrival since the last release
+  ar_timeval     _lastRelease;
+  int            _deadlineUsec;
+  int            _minReleaseUsec;
+  int            _targetUsec;
   arConditionVar _waitingCondVar;
   arLock _waitingLock; // with _waitingCondVar, guards _totalWaiting and _waitingCondVar (?)
 
@@ -74,6 +95,7 @@ class SZG_CALL arBarrierServer {
   int _procTime;        // time to process the data
   int _frameNum;        // ID of the frame last processed
   int _serverSendSize;  // amount of data the server sent
+  arBarrierTelemetry _telemetry;
 
   // stuff that's only pertinent to the TCP connection
   // both checking the line and dealing with passive connection mode
@@ -106,7 +128,9 @@ class SZG_CALL arBarrierServer {
   string _channel; // network route
   void _barrierDataFunction(arStructuredData*, arSocket*);
   void _releaseFunction();
-  void _barrierDisconnectFunction();
+  int _msecUntilDeadline() const;
+  void _excuseLaggards();
+  void _barrierDisconnectFunction(arSocket*);
 };
 
 #endif
@@ -0,0 +1,271 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arBarrierTelemetry.h"
+#include "arLogStream.h"
+#include "arSTLalgo.h"
+
+#include <stdio.h>
+
+static const char* const channelNames[AR_TIMING_NUM_CHANNELS] =
+  { "draw", "recv", "proc", "wait" };
+
+arTimingHistogram::arTimingHistogram(int windowSize) :
+  _window(windowSize > 0 ? windowSize : 1, 0),
+  _next(0),
+  _filled(0),
+  _lifetimeCount(0) {
+  for (int i=0; i<NUM_BUCKETS; ++i)
+    _buckets[i] = 0;
+}
+
+void arTimingHistogram::add(int usec) {
+  if (usec < 0)
+    usec = 0; // Clock skew or garbage.
+  _window[_next] = usec;
+  _next = (_next + 1) % _window.size();
+  if (_filled < int(_window.size()))
+    ++_filled;
+
+  int i = 0;
+  while (i < NUM_BUCKETS-1 && (usec >> (i+1)) > 0)
+    ++i;
+  ++_buckets[i];
+  ++_lifetimeCount;
+}
+
+void arTimingHistogram::reset() {
+  _next = 0;
+  _filled = 0;
+  _lifetimeCount = 0;
+  for (int i=0; i<NUM_BUCKETS; ++i)
+    _buckets[i] = 0;
+}
+
+double arTimingHistogram::mean() const {
+  if (_filled == 0)
+    return 0.;
+  double sum = 0.;
+  for (int i=0; i<_filled; ++i)
+    sum += _window[i];
+  return sum / _filled;
+}
+
+int arTimingHistogram::percentile(float p) const {
+  if (_filled == 0)
+    return 0;
+  vector<int> v(_window.begin(), _window.begin() + _filled);
+  const int n = p <= 0. ? 0 : p >= 1. ? _filled-1 : int(p * (_filled-1) + .5);
+  nth_element(v.begin(), v.begin() + n, v.end());
+  return v[n];
+}
+
+int arTimingHistogram::maximum() const {
+  return _filled == 0 ? 0 :
+    *max_element(_window.begin(), _window.begin() + _filled);
+}
+
+arBarrierTelemetry::arBarrierTelemetry(int windowSize) :
+  _windowSize(windowSize),
+  _releases(0),
+  _earlyReleases(0),
+  _capped(0),
+  _lock("BARRIER_TELEMETRY") {
+}
+
+// Caller holds _lock.
+arBarrierTelemetry::Client& arBarrierTelemetry::_find(int id) {
+  ClientMap::iterator i(_clients.find(id));
+  if (i != _clients.end())
+    return i->second;
+  Client& c = _clients[id];
+  c.label = id == AR_LOCAL_ID ? "local" : ar_intToString(id);
+  c.frameNum = 0;
+  c.late = 0;
+  c.arrived = false;
+  c.channels.assign(AR_TIMING_NUM_CHANNELS, arTimingHistogram(_windowSize));
+  return c;
+}
+
+void arBarrierTelemetry::addClient(int id, const string& label) {
+  arGuard _(_lock, "arBarrierTelemetry::addClient");
+  Client& c = _find(id);
+  c.label = label;
+  c.late = 0;
+  c.arrived = false;
+  for (int i=0; i<AR_TIMING_NUM_CHANNELS; ++i)
+    c.channels[i].reset();
+}
+
+void arBarrierTelemetry::removeClient(int id) {
+  arGuard _(_lock, "arBarrierTelemetry::removeClient");
+  _clients.erase(id);
+}
+
+void arBarrierTelemetry::recordArrival(int id, int drawTime, int rcvTime,
+                                       int procTime, int frameNum) {
+  arGuard _(_lock, "arBarrierTelemetry::recordArrival");
+  Client& c = _find(id);
+  c.channels[AR_TIMING_DRAW].add(drawTime);
+  c.channels[AR_TIMING_RECEIVE].add(rcvTime);
+  c.channels[AR_TIMING_PROCESS].add(procTime);
+  c.frameNum = frameNum;
+  c.arrived = true;
+  c.arrival = ar_time();
+}
+
+void arBarrierTelemetry::recordArrival(int id) {
+  arGuard _(_lock, "arBarrierTelemetry::recordArrival local");
+  Client& c = _find(id);
+  c.arrived = true;
+  c.arrival = ar_time();
+}
+
+void arBarrierTelemetry::recordLate(int id) {
+  arGuard _(_lock, "arBarrierTelemetry::recordLate");
+  ++_find(id).late;
+}
+
+void arBarrierTelemetry::recordRelease(bool early) {
+  const ar_timeval now = ar_time();
+  arGuard _(_lock, "arBarrierTelemetry::recordRelease");
+  for (ClientMap::iterator i = _clients.begin(); i != _clients.end(); ++i) {
+    Client& c = i->second;
+    if (!c.arrived)
+      continue;
+    c.channels[AR_TIMING_WAIT].add(int(ar_difftimeSafe(now, c.arrival)));
+    c.arrived = false;
+  }
+  ++_releases;
+  if (early)
+    ++_earlyReleases;
+}
+
+void arBarrierTelemetry::reset() {
+  arGuard _(_lock, "arBarrierTelemetry::reset");
+  for (ClientMap::iterator i = _clients.begin(); i != _clients.end(); ++i) {
+    for (int j=0; j<AR_TIMING_NUM_CHANNELS; ++j)
+      i->second.channels[j].reset();
+    i->second.late = 0;
+  }
+  _releases = 0;
+  _earlyReleases = 0;
+  _capped = 0;
+}
+
+// Caller holds _lock.
+int arBarrierTelemetry::_bottleneck(float p) const {
+  // The slowest client does the most work per frame.
+  int idBusiest = AR_LOCAL_ID;
+  int busiest = 0;
+  for (ClientMap::const_iterator i = _clients.begin(); i != _clients.end(); ++i) {
+    const vector<arTimingHistogram>& h = i->second.channels;
+    const int busy = h[AR_TIMING_DRAW].percentile(p) +
+      h[AR_TIMING_RECEIVE].percentile(p) + h[AR_TIMING_PROCESS].percentile(p);
+    if (busy > busiest) {
+      busiest = busy;
+      idBusiest = i->first;
+    }
+  }
+  if (busiest > 0)
+    return idBusiest;
+
+  // No timings reported (e.g. master/slave without tuning data).
+  // The slowest client waits least, since everyone else waits for it.
+  int idLeastWait = AR_LOCAL_ID;
+  int leastWait = -1;
+  for (ClientMap::const_iterator i = _clients.begin(); i != _clients.end(); ++i) {
+    if (i->first == AR_LOCAL_ID)
+      continue;
+    const arTimingHistogram& h = i->second.channels[AR_TIMING_WAIT];
+    if (h.count() == 0)
+      continue;
+    const int wait = h.percentile(.5);
+    if (leastWait < 0 || wait < leastWait) {
+      leastWait = wait;
+      idLeastWait = i->first;
+    }
+  }
+  return idLeastWait;
+}
+
+int arBarrierTelemetry::bottleneck(float p) {
+  arGuard _(_lock, "arBarrierTelemetry::bottleneck");
+  return _bottleneck(p);
+}
+
+string arBarrierTelemetry::summary(float p) {
+  arGuard _(_lock, "arBarrierTelemetry::summary");
+  const int pct = int(p * 100. + .5);
+  string s("barrier timing (usec) over " + ar_intToString(_releases) +
+           " releases (" + ar_intToString(_earlyReleases) + " early, " +
+           ar_intToString(_capped) + " capped), p50/p" + ar_intToString(pct) + "/max:\n");
+  if (_clients.empty())
+    return s + "  no clients.\n";
+
+  const int idSlow = _bottleneck(p);
+  char buf[128];
+  for (ClientMap::const_iterator i = _clients.begin(); i != _clients.end(); ++i) {
+    const Client& c = i->second;
+    s += "  " + c.label + (i->first == idSlow ? " (bottleneck)" : "") + ":";
+    for (int j=0; j<AR_TIMING_NUM_CHANNELS; ++j) {
+      const arTimingHistogram& h = c.channels[j];
+      sprintf(buf, " %s %d/%d/%d", channelNames[j],
+        h.percentile(.5), h.percentile(p), h.maximum());
+      s += buf;
+    }
+    s += ", frame " + ar_intToString(c.frameNum);
+    if (c.late > 0)
+      s += ", late " + ar_intToString(c.late);
+    s += "\n";
+  }
+  return s;
+}
+
+bool arBarrierTelemetry::dumpCSV(const string& path) {
+  FILE* f = fopen(path.c_str(), "w");
+  if (!f) {
+    ar_log_error() << "arBarrierTelemetry failed to write '" << path << "'.\n";
+    return false;
+  }
+
+  fprintf(f, "client,label,channel,late,samples,mean,p50,p90,p95,p99,max");
+  for (int b=0; b<arTimingHistogram::NUM_BUCKETS; ++b)
+    fprintf(f, ",ge%d", arTimingHistogram::bucketFloor(b));
+  fprintf(f, "\n");
+
+  arGuard _(_lock, "arBarrierTelemetry::dumpCSV");
+  for (ClientMap::const_iterator i = _clients.begin(); i != _clients.end(); ++i) {
+    const Client& c = i->second;
+    for (int j=0; j<AR_TIMING_NUM_CHANNELS; ++j) {
+      const arTimingHistogram& h = c.channels[j];
+      fprintf(f, "%d,%s,%s,%ld,%ld,%.1f,%d,%d,%d,%d,%d",
+        i->first, c.label.c_str(), channelNames[j], c.late, h.lifetimeCount(), h.mean(),
+        h.percentile(.5), h.percentile(.9), h.percentile(.95), h.percentile(.99),
+        h.maximum());
+      for (int b=0; b<arTimingHistogram::NUM_BUCKETS; ++b)
+        fprintf(f, ",%ld", h.bucket(b));
+      fprintf(f, "\n");
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+string ar_barrierTelemetryHandleMessage(arBarrierTelemetry& t, const string& body) {
+  if (body == "" || body == "NULL" || body == "print")
+    return t.summary();
+  if (body == "reset") {
+    t.reset();
+    return "barrier timing reset.";
+  }
+  if (body.substr(0, 5) == "dump ") {
+    const string path(body.substr(5));
+    return t.dumpCSV(path) ? "barrier timing written to " + path + "." :
+      "ERROR: failed to write barrier timing to " + path + ".";
+  }
+  return "ERROR: unexpected timing arg '" + body + "' (expected print, reset, or dump <path>).";
+}
@@ -0,0 +1,123 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_BARRIER_TELEMETRY_H
+#define AR_BARRIER_TELEMETRY_H
+
+#include "arDataUtilities.h"
+#include "arThread.h"
+#include "arBarrierCalling.h"
+
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Timing channels kept per barrier client, in microseconds.
+SZG_CALL enum {
+  AR_TIMING_DRAW = 0,     // client's draw (action) callback
+  AR_TIMING_RECEIVE,      // client's time to receive the frame's data
+  AR_TIMING_PROCESS,      // client's time to consume the frame's data
+  AR_TIMING_WAIT,         // time from reaching the barrier to its release
+  AR_TIMING_NUM_CHANNELS
+};
+
+// Rolling window of samples, for percentiles, plus a lifetime
+// histogram with power-of-two buckets (bucket i>0 holds [2^i, 2^(i+1)) usec).
+class SZG_CALL arTimingHistogram {
+ public:
+  arTimingHistogram(int windowSize = 600);
+
+  void add(int usec);
+  void reset();
+
+  int count() const { return _filled; }      // samples in the window
+  long lifetimeCount() const { return _lifetimeCount; }
+  double mean() const;                       // over the window
+  int percentile(float p) const;             // p in [0,1], over the window
+  int maximum() const;                       // over the window
+
+  enum { NUM_BUCKETS = 24 };                 // last bucket is >= 8 seconds
+  long bucket(int i) const
+    { return (i < 0 || i >= NUM_BUCKETS) ? 0 : _buckets[i]; }
+  static int bucketFloor(int i)
+    { return i <= 0 ? 0 : 1 << i; }
+
+ private:
+  vector<int> _window;
+  int _next;
+  int _filled;
+  long _lifetimeCount;
+  long _buckets[NUM_BUCKETS];
+};
+
+// Per-client frame timings reported to an arBarrierServer,
+// so a slow node in a large cluster can be singled out.
+// Thread-safe:  the barrier's receive and release threads write,
+// while message handlers read.
+class SZG_CALL arBarrierTelemetry {
+ public:
+  arBarrierTelemetry(int windowSize = 600);
+
+  // Clients are keyed by socket ID.  The local (master) loop uses AR_LOCAL_ID.
+  enum { AR_LOCAL_ID = -1 };
+  void addClient(int id, const string& label);
+  void removeClient(int id);
+
+  // A client reached the barrier, reporting its last frame's timings.
+  void recordArrival(int id, int drawTime, int rcvTime, int procTime, int frameNum);
+  // A client reached the barrier without timings (e.g. the local loop).
+  void recordArrival(int id);
+  // The barrier released:  charge each arrived client its wait.
+  // "early" means a deadline released it without some clients.
+  void recordRelease(bool early = false);
+  // A client missed an early release; its next arrival is absorbed.
+  void recordLate(int id);
+  // A frame rate cap held back a release.
+  void recordCapped() { arGuard _(_lock, "arBarrierTelemetry::recordCapped"); ++_capped; }
+
+  void reset();
+
+  // One line per client: p50/p95/max per channel,
+  // and the client that keeps the others waiting.
+  string summary(float p = 0.95);
+  // Socket ID of the client with the highest percentile-p busy time
+  // (draw + receive + process), or the least wait if none report timings.
+  int bottleneck(float p = 0.95);
+  // Per-client percentiles and lifetime histograms, as CSV.
+  bool dumpCSV(const string& path);
+
+  long releases() const { return _releases; }
+  long earlyReleases() const { return _earlyReleases; }
+  long cappedReleases() const { return _capped; }
+
+ private:
+  struct Client {
+    string label;
+    int frameNum;
+    long late;
+    bool arrived;
+    ar_timeval arrival;
+    vector<arTimingHistogram> channels;
+  };
+  typedef map<int, Client> ClientMap;
+
+  int _windowSize;
+  long _releases;
+  long _earlyReleases;
+  long _capped;
+  ClientMap _clients;
+  arLock _lock;
+
+  Client& _find(int id);
+  int _bottleneck(float p) const;
+};
+
+// Body of a "timing" phleet message:  "" or "print", "reset", "dump <path>".
+// Returns the message response.
+SZG_CALL string ar_barrierTelemetryHandleMessage(arBarrierTelemetry&,
+                                                 const string& body);
+
+#endif
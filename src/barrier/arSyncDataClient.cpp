@@ -240,6 +240,7 @@ arSyncDataClient::arSyncDataClient():
   _oldRecvSize = 10000;
   _recvSize = 10000;
   _serverSendSize = 10000;
+  _frameNum = 0;
 
   _nullHandshakeState = 0;
 
@@ -559,7 +560,8 @@ void arSyncDataClient::consume() {
   _update(_recvSize, _oldRecvSize, usecFilter);
   _update(_drawTime, drawTime, usecFilter);
   _update(_procTime, procTime, usecFilter);
-  _barrierClient.setTuningData(int(_drawTime), int(_recvTime), int(_procTime), 0);
+  // Unfiltered, so the barrier server's histograms see every hiccup.
+  _barrierClient.setTuningData(int(drawTime), int(_oldRecvTime), int(procTime), _frameNum++);
 }
 
 inline void arSyncDataClient::_update(float& value, float newValue, float filter) {
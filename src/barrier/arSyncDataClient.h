@@ -127,6 +127,7 @@ class SZG_CALL arSyncDataClient{
   float _drawTime;
   float _procTime;
   float _serverSendSize;
+  int _frameNum; // frames consumed, for the barrier server's telemetry
 
   // we guarantee that at least one _nullCallback is executed upon
   // disconnection. This is necessary if, say, something needs to
@@ -6,6 +6,7 @@
 #include "arPrecompiled.h"
 #include "arSyncDataServer.h"
 #include "arLogStream.h"
+#include "arSTLalgo.h"
 
 void ar_syncDataServerConnectionTask(void* pv) {
   arSyncDataServer* server = (arSyncDataServer*)pv;
@@ -71,6 +72,7 @@ void arSyncDataServer::_sendTaskLocal() {
       _dataQueue->swapBuffers();
       _messageBufferFull = false;
       _messageBufferVar.signal();
+      _dequeueFrames();
     _queueLock.unlock();
 
     // Tell the locally connected arSyncDataClient.
@@ -117,6 +119,7 @@ void arSyncDataServer::_sendTaskRemote() {
     _dataQueue->swapBuffers(); // This can crash if app is dkill'ed.
     _messageBufferFull = false;
     _messageBufferVar.signal();
+    _dequeueFrames();
     if (_barrierServer.checkWaitingSockets()) {
       // this is what occurs upon connection
       _barrierServer.lockActivationQueue();
@@ -154,6 +157,16 @@ void arSyncDataServer::_sendTaskRemote() {
   }
 }
 
+// Caller holds _queueLock, and just swapped _dataQueue.
+void arSyncDataServer::_dequeueFrames() {
+  _queuedRecords.clear();
+  ++_framesSent;
+  if (_framesQueued > 1)
+    _framesCoalesced += _framesQueued - 1;
+  _framesQueued = 0;
+  _framesQueuedVar.signal();
+}
+
 arSyncDataServer::arSyncDataServer() :
   _client(NULL),
   _serviceName("NULL"),
@@ -164,6 +177,17 @@ arSyncDataServer::arSyncDataServer() :
   _queueLock("SYNCSERV_QUEUE"),
   _messageBufferVar("arSyncDataServer-messagebuffer"),
   _messageBufferFull(false),
+  _batchDepth(0),
+  _sendLimit(300000),
+  _maxQueuedFrames(1),
+  _framesQueued(0),
+  _framesQueuedVar("arSyncDataServer-framesqueued"),
+  _framesSent(0),
+  _framesCoalesced(0),
+  _producerStalls(0),
+  _recordsCoalesced(0),
+  _bytesCoalesced(0),
+  _coalescing(false),
   _exitProgram(false),
   _sendThreadRunning(false),
   _channel("NULL"),
@@ -282,6 +306,19 @@ bool arSyncDataServer::init(arSZGClient& client) {
   }
   // end of copypaste
 
+  const int sendLimit = client.getAttributeInt("SZG_BARRIER", "send_limit");
+  if (sendLimit > 0)
+    setSendLimit(sendLimit);
+  const int maxQueued = client.getAttributeInt("SZG_BARRIER", "max_queued_frames");
+  if (maxQueued > 0)
+    setMaxQueuedFrames(maxQueued);
+  if (client.getAttribute("SZG_BARRIER", "coalesce", "|false|true|") == "true")
+    setCoalescing(true);
+  // Also compresses the initial dump to a new connection.
+  const int compressBytes = client.getAttributeInt("SZG_BARRIER", "compress_threshold");
+  if (compressBytes > 0)
+    _dataServer.setCompressThreshold(compressBytes);
+
   if (!_barrierServer.init(_serviceNameBarrier, _channel, client)) {
     ar_log_error() << "arSyncDataServer: barrier server failed to init.\n";
     return false;
@@ -349,6 +386,10 @@ void arSyncDataServer::stop() {
   _exitProgram = true;
   // Ensure the send data thread isn't blocked.
   _signalObject.sendSignal();
+  // Nor swapBuffers().
+  _queueLock.lock("arSyncDataServer::stop frames");
+    _framesQueuedVar.signal();
+  _queueLock.unlock();
 
   if (_locallyConnected) {
     // Set the queue variables to "finished."
@@ -376,23 +417,61 @@ void arSyncDataServer::swapBuffers() {
     return;
   }
 
+  _queueLock.lock("arSyncDataServer::swapBuffers");
+    ++_framesQueued;
+  _queueLock.unlock();
   _signalObject.sendSignal();
-  if (_mode != AR_NOSYNC_MANUAL_SERVER) {
+  if (_mode == AR_NOSYNC_MANUAL_SERVER)
+    return;
+
+  if (_maxQueuedFrames <= 1) {
     // Wait for the other side to consume the buffer.
     _signalObjectRelease.receiveSignal();
+    return;
+  }
+
+  // Let frames pile up (and coalesce) while the cluster catches up.
+  arGuard _(_queueLock, "arSyncDataServer::swapBuffers queued");
+  while (_framesQueued >= _maxQueuedFrames && !_exitProgram) {
+    _framesQueuedVar.wait(_queueLock);
   }
 }
 
+void arSyncDataServer::setSendLimit(int bytes) {
+  arGuard _(_queueLock, "arSyncDataServer::setSendLimit");
+  _sendLimit = bytes;
+}
+
+void arSyncDataServer::setMaxQueuedFrames(int frames) {
+  arGuard _(_queueLock, "arSyncDataServer::setMaxQueuedFrames");
+  _maxQueuedFrames = frames < 1 ? 1 : frames;
+  _framesQueuedVar.signal();
+}
+
+string arSyncDataServer::handleTimingMessage(const string& body) {
+  const string response(ar_barrierTelemetryHandleMessage(getTelemetry(), body));
+  return (body == "" || body == "NULL" || body == "print") ?
+    response + queueStatus() : response;
+}
+
+string arSyncDataServer::queueStatus() {
+  arGuard _(_queueLock, "arSyncDataServer::queueStatus");
+  return "queue: " + ar_intToString(_framesSent) + " frames sent, " +
+    ar_intToString(_framesCoalesced) + " coalesced, " +
+    ar_intToString(_producerStalls) + " producer stalls, " +
+    ar_intToString(_recordsCoalesced) + " records (" +
+    ar_intToString(_bytesCoalesced) + " bytes) coalesced, " +
+    ar_intToString(_framesQueued) + "/" + ar_intToString(_maxQueuedFrames) +
+    " frames and " + ar_intToString(_dataQueue ? _dataQueue->getBackBufferSize() : 0) +
+    "/" + ar_intToString(_sendLimit) + " bytes queued.\n" +
+    _dataServer.compressionStatus();
+}
+
 arDatabaseNode* arSyncDataServer::receiveMessage(arStructuredData* data) {
   // Caller ensures atomicity.
   _queueLock.lock("arSyncDataServer::receiveMessage");
-  if (_dataQueue->getBackBufferSize() > _sendLimit &&
-      _barrierServer.getNumberConnectedActive() > 0 &&
-      _mode == AR_SYNC_AUTO_SERVER) {
-    _messageBufferFull = true;
-    while (_messageBufferFull) {
-      _messageBufferVar.wait(_queueLock);
-    }
+  if (_batchDepth == 0) {
+    _waitForRoom();
   }
 
   // Do this after the wait on a full buffer, but before queueing the data.
@@ -410,9 +489,142 @@ arDatabaseNode* arSyncDataServer::receiveMessage(arStructuredData* data) {
 
   if (_barrierServer.getNumberConnectedActive() > 0 || _locallyConnected) {
     // Something, local or remote, wants our data.  Queue it.
-    _dataQueue->forceQueueData(data);
+    _queueData(data);
   }
 
   _queueLock.unlock();
   return node;
 }
+
+// Caller holds _queueLock exactly once (a wait on a recursively held
+// lock would never release it to the send thread).
+void arSyncDataServer::_waitForRoom() {
+  if (_dataQueue->getBackBufferSize() > _sendLimit &&
+      _barrierServer.getNumberConnectedActive() > 0 &&
+      _mode == AR_SYNC_AUTO_SERVER) {
+    _messageBufferFull = true;
+    ++_producerStalls;
+    while (_messageBufferFull) {
+      _messageBufferVar.wait(_queueLock);
+    }
+  }
+}
+
+// A batch may overshoot _sendLimit, since it waits only once, up front.
+void arSyncDataServer::beginBatch() {
+  _queueLock.lock("arSyncDataServer::beginBatch");
+  if (_batchDepth++ == 0) {
+    _waitForRoom();
+  }
+}
+
+void arSyncDataServer::endBatch() {
+  --_batchDepth;
+  _queueLock.unlock();
+}
+
+void arSyncDataServer::addCoalescedTemplate(int templateID, int idField, int indexField,
+                                            int dataField, int stride) {
+  arGuard _(_queueLock, "arSyncDataServer::addCoalescedTemplate");
+  CoalescedTemplate t;
+  t.idField = idField;
+  t.indexField = indexField;
+  t.dataField = dataField;
+  t.stride = stride < 1 ? 1 : stride;
+  _coalescedTemplates[templateID] = t;
+}
+
+void arSyncDataServer::addBarrierTemplate(int templateID) {
+  arGuard _(_queueLock, "arSyncDataServer::addBarrierTemplate");
+  _barrierTemplates.insert(templateID);
+}
+
+void arSyncDataServer::setCoalescing(bool on) {
+  arGuard _(_queueLock, "arSyncDataServer::setCoalescing");
+  _coalescing = on;
+  _queuedRecords.clear();
+}
+
+bool arSyncDataServer::_covers(const QueuedRecord& newer, const QueuedRecord& older) {
+  if (newer.packedCount >= 0) {
+    if (older.packedCount >= 0)
+      return older.packedCount <= newer.packedCount;
+    return older.ids.empty() || older.ids.back() < newer.packedCount;
+  }
+  if (older.packedCount >= 0) {
+    // Does newer.ids contain 0..older.packedCount-1?
+    vector<int>::const_iterator i =
+      lower_bound(newer.ids.begin(), newer.ids.end(), 0);
+    return newer.ids.end() - i >= older.packedCount &&
+      (older.packedCount == 0 || *(i + older.packedCount - 1) == older.packedCount - 1);
+  }
+  return includes(newer.ids.begin(), newer.ids.end(),
+                  older.ids.begin(), older.ids.end());
+}
+
+// Caller holds _queueLock.
+void arSyncDataServer::_queueData(arStructuredData* data) {
+  if (!_coalescing) {
+    _dataQueue->forceQueueData(data);
+    return;
+  }
+
+  const int templateID = data->getID();
+  if (_barrierTemplates.find(templateID) != _barrierTemplates.end()) {
+    // Nothing may be reordered across this.
+    _queuedRecords.clear();
+    _dataQueue->forceQueueData(data);
+    return;
+  }
+  const map<int, CoalescedTemplate>::const_iterator t =
+    _coalescedTemplates.find(templateID);
+  if (t == _coalescedTemplates.end()) {
+    _dataQueue->forceQueueData(data);
+    return;
+  }
+
+  QueuedRecord r;
+  r.offset = _dataQueue->getBackBufferSize();
+  r.size = data->size();
+  r.packedCount = 0;
+  if (t->second.indexField >= 0) {
+    const ARint* ids = (const ARint*)data->getDataPtr(t->second.indexField, AR_INT);
+    const int numIDs = data->getDataDimension(t->second.indexField);
+    if (numIDs > 0 && ids[0] == -1) {
+      // As in arGraphicsArrayNode::receiveData.
+      r.packedCount = t->second.dataField < 0 ? 0 :
+        data->getDataDimension(t->second.dataField) / t->second.stride;
+    }
+    else {
+      r.packedCount = -1;
+      r.ids.assign(ids, ids + numIDs);
+      sort(r.ids.begin(), r.ids.end());
+    }
+  }
+
+  const pair<int, int> key(templateID, data->getDataInt(t->second.idField));
+  map<pair<int, int>, QueuedRecord>::iterator old = _queuedRecords.find(key);
+  if (old != _queuedRecords.end() && _covers(r, old->second)) {
+    QueuedRecord& o = old->second;
+    if (o.size == r.size && _dataQueue->replaceQueuedData(o.offset, data)) {
+      // Overwrite in place.  Later records of other nodes don't care.
+      ++_recordsCoalesced;
+      _bytesCoalesced += r.size;
+      r.offset = o.offset;
+      o = r;
+      return;
+    }
+    if (_dataQueue->eraseQueuedData(o.offset, o.size)) {
+      for (map<pair<int, int>, QueuedRecord>::iterator i = _queuedRecords.begin();
+           i != _queuedRecords.end(); ++i) {
+        if (i->second.offset > o.offset)
+          i->second.offset -= o.size;
+      }
+      ++_recordsCoalesced;
+      _bytesCoalesced += o.size;
+      r.offset = _dataQueue->getBackBufferSize();
+    }
+  }
+  _dataQueue->forceQueueData(data);
+  _queuedRecords[key] = r;
+}
@@ -17,6 +17,9 @@
 #include "arBarrierCalling.h"
 
 #include <list>
+#include <map>
+#include <set>
+#include <vector>
 using namespace std;
 
 // Synchronization modes (for _mode).  Public, for setMode().
@@ -56,7 +59,40 @@ class SZG_CALL arSyncDataServer{
 
   void swapBuffers();
 
+  // Queue bounds.  Beyond sendLimit bytes, receiveMessage() blocks
+  // (in AR_SYNC_AUTO_SERVER mode) until the queue is sent.
+  // In the manual modes, swapBuffers() returns without waiting for the
+  // barrier until maxQueuedFrames frames are unsent;  unsent frames are
+  // coalesced into the next send.  The default of 1 waits every frame.
+  void setSendLimit(int bytes);
+  void setMaxQueuedFrames(int frames);
+  // Counters for the queue policy, for "timing" messages.
+  string queueStatus();
+  // Response to a "timing" message:  barrier telemetry plus queueStatus().
+  string handleTimingMessage(const string& body);
+
+  // Optional coalescing of redundant updates within a frame.
+  // A record of a coalesced template replaces the earlier queued record
+  // of that template with the same node ID (field idField), unless a
+  // barrier record (e.g. make/insert/erase/cut) was queued in between.
+  // If indexField is given, it lists the elements the record updates
+  // (a leading -1 meaning "elements 0 to n-1, n = dimension of dataField
+  // over stride", as in arGraphicsArrayNode), and a record replaces only
+  // records whose elements it covers.
+  void addCoalescedTemplate(int templateID, int idField, int indexField = -1,
+                            int dataField = -1, int stride = 1);
+  void addBarrierTemplate(int templateID);
+  void setCoalescing(bool);
+
   arDatabaseNode* receiveMessage(arStructuredData*);
+  // Between beginBatch() and endBatch(), receiveMessage() neither blocks
+  // on a full queue nor lets the send thread swap buffers, so the
+  // batch's records reach clients together, in one frame.
+  void beginBatch();
+  void endBatch();
+
+  // Per-client frame timings from the barrier.
+  arBarrierTelemetry& getTelemetry() { return _barrierServer.getTelemetry(); }
 
   arDataServer* dataServer() const
     { return (arDataServer*)&_dataServer; } // Hey! This casts away constness.  Explain this.
@@ -74,9 +110,40 @@ class SZG_CALL arSyncDataServer{
   arLock _queueLock; // with _messageBufferVar
   arConditionVar _messageBufferVar;
   bool _messageBufferFull;
+  int _batchDepth; // Guarded by _queueLock.
+  void _waitForRoom();
   // This had better be a pretty large default...
   // How about the 50 avatars, 20 bones each, at 60 fps?
-  enum { _sendLimit = 300000 /* bytes */ };
+  int _sendLimit; // bytes
+  int _maxQueuedFrames;
+  int _framesQueued; // swapBuffers() calls not yet sent.  Guarded by _queueLock.
+  arConditionVar _framesQueuedVar;
+  // Counters.  Guarded by _queueLock.
+  long _framesSent;
+  long _framesCoalesced;
+  long _producerStalls;
+  long _recordsCoalesced;
+  long _bytesCoalesced;
+
+  // Coalescing, all guarded by _queueLock.
+  struct CoalescedTemplate {
+    int idField;
+    int indexField;
+    int dataField;
+    int stride;
+  };
+  struct QueuedRecord {
+    int offset;        // in _dataQueue's back buffer
+    int size;
+    int packedCount;   // elements 0..packedCount-1, or -1 if ids lists them
+    vector<int> ids;   // sorted
+  };
+  bool _coalescing;
+  map<int, CoalescedTemplate> _coalescedTemplates;
+  set<int> _barrierTemplates;
+  map<pair<int, int>, QueuedRecord> _queuedRecords; // (template, node ID)
+  void _queueData(arStructuredData*);
+  static bool _covers(const QueuedRecord& newer, const QueuedRecord& older);
 
   arTemplateDictionary* _dictionary;
   void* _bondedObject;
@@ -106,6 +173,7 @@ class SZG_CALL arSyncDataServer{
   void _sendTask();
   void _sendTaskLocal();
   void _sendTaskRemote();
+  void _dequeueFrames();
 };
 
 #endif
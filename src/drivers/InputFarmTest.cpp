@@ -0,0 +1,132 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+// Load-test the input path without hardware or a szgserver:
+// many arSyntheticSources feed one arInputNode, whose arNetInputSink
+// sends to a local arDataClient.  Reports the rate and latency
+// delivered to the node's sinks and across the network.
+//
+// Usage: InputFarmTest [devices [Hz [seconds [port]]]]
+//   port 0 skips the network.
+
+#include "arPrecompiled.h"
+#define SZG_DO_NOT_EXPORT
+
+#include "arSyntheticSource.h"
+#include "arInputStatsSink.h"
+#include "arInputNode.h"
+#include "arNetInputSink.h"
+#include "arDataClient.h"
+#include "arLogStream.h"
+
+#include <stdlib.h>
+
+arDataClient netClient("InputFarmTest");
+arInputStatsSink netStats;
+bool netRunning = false;
+
+void netTask(void*) {
+  arInputLanguage inp;
+  arStructuredData data(inp.find("input"));
+  int size = 4096;
+  ARchar* buf = new ARchar[size];
+  while (netClient.getData(buf, size)) {
+    data.unpack(buf);
+    netStats.receiveData(0, &data);
+  }
+  delete [] buf;
+  netRunning = false;
+}
+
+int main(int argc, char** argv) {
+  const int cDevice = argc > 1 ? atoi(argv[1]) : 32;
+  const float hz = argc > 2 ? atof(argv[2]) : 1000.;
+  const float seconds = argc > 3 ? atof(argv[3]) : 5.;
+  const int port = argc > 4 ? atoi(argv[4]) : 44344;
+  if (cDevice <= 0 || hz <= 0. || seconds <= 0.) {
+    ar_log_error() << "usage: InputFarmTest [devices [Hz [seconds [port]]]]\n";
+    return 1;
+  }
+
+  arInputNode node;
+  vector<arSyntheticSource*> devices;
+  int i;
+  for (i=0; i<cDevice; ++i) {
+    arSyntheticSource* d = new arSyntheticSource;
+    d->setSignature(2, 4, 2);
+    d->setRate(hz);
+    d->setJitter(.1e6 / hz);
+    d->setBurst(10, 1.);
+    d->setTrajectory(i%2 ? "figure8" : "circle");
+    node.addInputSource(d, true);
+    devices.push_back(d);
+  }
+  arInputStatsSink nodeStats;
+  node.addInputSink(&nodeStats, false);
+  arNetInputSink netSink;
+  if (port > 0) {
+    netSink.setStandalonePort(port, "127.0.0.1");
+    node.addInputSink(&netSink, false);
+  }
+
+  arSZGClient szgClient;
+  if (!node.init(szgClient) || !node.start()) {
+    ar_log_error() << "InputFarmTest failed to start input node.\n";
+    return 1;
+  }
+  arThread netThread;
+  if (port > 0) {
+    if (!netClient.dialUpFallThrough("127.0.0.1", port)) {
+      ar_log_error() << "InputFarmTest failed to connect to port " << port << ".\n";
+      return 1;
+    }
+    netRunning = true;
+    netThread.beginThread(netTask, NULL);
+  }
+
+  // Measure after the threads and connection settle.
+  ar_usleep(500000);
+  long sentBefore = 0;
+  for (i=0; i<cDevice; ++i)
+    sentBefore += devices[i]->getPackets();
+  nodeStats.reset();
+  netStats.reset();
+  ar_usleep(int(seconds * 1e6));
+
+  // Snapshot before stopping, since an overloaded node stops slowly.
+  long sent = -sentBefore;
+  long late = 0;
+  for (i=0; i<cDevice; ++i) {
+    sent += devices[i]->getPackets();
+    late += devices[i]->getLate();
+  }
+  const long delivered = nodeStats.getPackets();
+  const string nodeStatus(nodeStats.status());
+  // Let the network drain.
+  ar_usleep(200000);
+  const string netStatus(netStats.status());
+  node.stop();
+
+  cout << "InputFarmTest: " << cDevice << " devices at " << hz << " Hz for " <<
+    seconds << " s, sent " << sent << " packets (" << int(sent / seconds) <<
+    "/s), " << late << " late.\n" << devices[0]->status() <<
+    "arInputNode:  " << nodeStatus;
+  if (port > 0)
+    cout << "arNetInputSink:  " << netStatus;
+
+  // In-process delivery is synchronous, so only packets
+  // in flight at either snapshot may be miscounted.
+  bool ok = labs(delivered - sent) <= 2*cDevice;
+  if (port > 0) {
+    ok = ok && netStats.getPackets() > 0;
+    netClient.closeConnection();
+    arSleepBackoff a(5, 20, 1.1);
+    for (i=0; i<100 && netRunning; ++i)
+      a.sleep();
+  }
+  if (!ok)
+    ar_log_error() << "InputFarmTest lost packets.\n";
+  return ok ? 0 : 1;
+}
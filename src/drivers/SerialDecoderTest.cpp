@@ -0,0 +1,266 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+// Test and benchmark the serial frame decoders without hardware:
+// a pseudoterminal stands in for the tracker, streaming frames
+// (with line noise between them) at a fixed rate.  Each frame's
+// sequence number is encoded in its x coordinate, so the sink can
+// measure latency from write() to delivery.
+//
+// Modes:  "event" is arRS232Port::startReading();  "block" is the old
+// drivers' ar_read() with a read timeout;  "sleep" is ar_read() and
+// ar_usleep(10 msec) when nothing has arrived.
+//
+// Usage: SerialDecoderTest [frames [Hz]]
+
+#include "arPrecompiled.h"
+#define SZG_DO_NOT_EXPORT
+
+#include "arSerialDecoders.h"
+#include "arThread.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+
+#ifdef AR_USE_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+const float METERS_PER_FOOT = 12.0 * 0.0254;
+
+enum { PPT, LOGITECH };
+
+// Record each frame's latency, from its sequence number.
+class LatencySink: public arInputSink {
+ public:
+  LatencySink(int device, const vector<ar_timeval>& sent) :
+    _device(device), _sent(sent), _wrong(0) {}
+  void receiveData(int, arStructuredData* d) {
+    const ar_timeval now = ar_time();
+    const float* m = (const float*)d->getDataPtr("matrices", AR_FLOAT);
+    if (d->getDataDimension("matrices") < 16) {
+      ++_wrong;
+      return;
+    }
+    const float x = m[12];
+    const long seq = _device == PPT ?
+      lround(x * METERS_PER_FOOT * 3276.8) : lround(x * 12000.);
+    if (seq < 0 || seq >= long(_sent.size())) {
+      ++_wrong;
+      return;
+    }
+    _latency.push_back(ar_difftime(now, _sent[seq]));
+  }
+  const int _device;
+  const vector<ar_timeval>& _sent;
+  vector<double> _latency;
+  int _wrong;
+};
+
+static void makeFrame(int device, int seq, vector<unsigned char>& f) {
+  if (device == PPT) {
+    f.assign(arPPTDecoder::PACKET_SIZE, 0);
+    f[0] = 'o';
+    f[1] = 1;
+    f[2] = (seq >> 8) & 0xff;
+    f[3] = seq & 0xff;
+    f[arPPTDecoder::PACKET_SIZE-1] =
+      arPPTDecoder::checksum(&f[0], arPPTDecoder::PACKET_SIZE-1);
+  }
+  else {
+    f.assign(arLogitechDecoder::RECORD_SIZE, 0);
+    f[0] = 0x80;
+    f[1] = (seq >> 14) & 0x3f;
+    f[2] = (seq >> 7) & 0x7f;
+    f[3] = seq & 0x7f;
+  }
+}
+
+#ifdef AR_USE_LINUX
+
+struct Writer {
+  int fd;
+  int device;
+  int frames;
+  int hz;
+  vector<ar_timeval>* sent;
+  bool done;
+};
+
+// Stream frames, and a few bytes of noise between some of them:
+// bytes without a frame start, or (Logitech) the start of a truncated record.
+void writerTask(void* pv) {
+  Writer& w = *(Writer*)pv;
+  srand(1);
+  vector<unsigned char> frame;
+  vector<unsigned char> noise;
+  const ar_timeval start = ar_time();
+  for (int seq=0; seq<w.frames; ++seq) {
+    const double due = seq * 1e6 / w.hz;
+    const double wait = due - ar_difftime(ar_time(), start);
+    if (wait > 0)
+      ar_usleep(int(wait));
+
+    noise.clear();
+    if (rand() % 4 == 0) {
+      const int cb = 1 + rand() % 5;
+      if (w.device == PPT) {
+        for (int i=0; i<cb; ++i)
+          noise.push_back(rand() % ('o'-1) + 1);
+      }
+      else {
+        makeFrame(w.device, seq, noise);
+        noise.resize(cb);
+      }
+    }
+    makeFrame(w.device, seq, frame);
+    frame.insert(frame.begin(), noise.begin(), noise.end());
+    (*w.sent)[seq] = ar_time();
+    if (write(w.fd, &frame[0], frame.size()) != int(frame.size()))
+      ar_log_error() << "SerialDecoderTest: short write.\n";
+  }
+  w.done = true;
+}
+
+static double cpuSeconds() {
+  struct rusage r;
+  getrusage(RUSAGE_SELF, &r);
+  return r.ru_utime.tv_sec + r.ru_stime.tv_sec +
+    (r.ru_utime.tv_usec + r.ru_stime.tv_usec) * 1e-6;
+}
+
+static bool run(int device, const string& mode, int frames, int hz) {
+  const int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+    ar_log_error() << "SerialDecoderTest: no pseudoterminal.\n";
+    return false;
+  }
+
+  arRS232Port port;
+  if (!port.ar_open(ptsname(master), 115200, 8, 1, "none")) {
+    close(master);
+    return false;
+  }
+
+  arPPTDecoder ppt;
+  arLogitechDecoder logitech;
+  arInputSource& source = device == PPT ?
+    (arInputSource&)ppt : (arInputSource&)logitech;
+  arSerialFrameDecoder& decoder = device == PPT ?
+    (arSerialFrameDecoder&)ppt : (arSerialFrameDecoder&)logitech;
+  vector<ar_timeval> sent(frames);
+  LatencySink sink(device, sent);
+  source.setInputNode(&sink);
+
+  Writer w = { master, device, frames, hz, &sent, false };
+  const double cpuStart = cpuSeconds();
+  const ar_timeval start = ar_time();
+  bool ok = true;
+  if (mode == "event") {
+    port.setReadTimeout(2);
+    ok = port.startReading(&decoder);
+  }
+  arThread writer;
+  ok = ok && writer.beginThread(writerTask, &w);
+
+  if (ok && mode != "event") {
+    port.setReadTimeout(mode == "block" ? 2 : 0);
+    const int frameSize = device == PPT ?
+      int(arPPTDecoder::PACKET_SIZE) : int(arLogitechDecoder::RECORD_SIZE);
+    char buf[4096];
+    vector<unsigned char> pending;
+    arTimer idle;
+    idle.start(2e5);
+    while (!w.done || !idle.done()) {
+      const int got = port.ar_read(buf, mode == "block" ? frameSize : 1, sizeof(buf));
+      if (got < 0)
+        break;
+      if (got == 0) {
+        if (mode == "sleep")
+          ar_usleep(10000);
+        continue;
+      }
+      idle.start(2e5);
+      const ar_timeval arrival = ar_time();
+      pending.insert(pending.end(), buf, buf+got);
+      int used = 0;
+      for (;;) {
+        const int n = decoder.decode(&pending[0]+used, pending.size()-used, arrival);
+        if (n <= 0)
+          break;
+        used += n;
+      }
+      pending.erase(pending.begin(), pending.begin()+used);
+    }
+  }
+  else if (ok) {
+    while (!w.done)
+      ar_usleep(10000);
+    // Let the last frames arrive.
+    arSleepBackoff a(5, 20, 1.1);
+    for (int i=0; i<40 && int(sink._latency.size()) < frames; ++i)
+      a.sleep();
+  }
+  while (!w.done)
+    ar_usleep(10000);
+  const double cpu = cpuSeconds() - cpuStart;
+  const double elapsed = ar_difftime(ar_time(), start) * 1e-6;
+  const long wakeups = port.getWakeups();
+  port.ar_close();
+  close(master);
+  if (!ok)
+    return false;
+
+  vector<double>& l = sink._latency;
+  sort(l.begin(), l.end());
+  double sum = 0.;
+  for (unsigned i=0; i<l.size(); ++i)
+    sum += l[i];
+  const long decoded = device == PPT ? ppt.getFrames() : logitech.getFrames();
+  const long skipped = device == PPT ? ppt.getSkipped() : logitech.getSkipped();
+  cout << (device == PPT ? "PPT     " : "Logitech") << " " << mode << ":\t" <<
+    decoded << "/" << frames << " frames, " << skipped << " noise bytes skipped";
+  if (mode == "event")
+    cout << ", " << wakeups << " wakeups";
+  cout << ".\n";
+  if (!l.empty())
+    cout << "\tlatency usec: mean " << int(sum / l.size()) <<
+      ", p99 " << int(l[l.size()*99/100]) << ", max " << int(l.back()) <<
+      ";  cpu " << int(100. * cpu / elapsed) << "%.\n";
+  return decoded == frames && sink._wrong == 0 && int(l.size()) == frames;
+}
+
+int main(int argc, char** argv) {
+  const int frames = argc > 1 ? atoi(argv[1]) : 2000;
+  const int hz = argc > 2 ? atoi(argv[2]) : 1000;
+  if (frames <= 0 || frames > 32767 || hz <= 0) {
+    ar_log_error() << "usage: SerialDecoderTest [frames(1-32767) [Hz]]\n";
+    return 1;
+  }
+  bool ok = true;
+  const char* modes[3] = { "event", "block", "sleep" };
+  for (int device=PPT; device<=LOGITECH; ++device)
+    for (int i=0; i<3; ++i) {
+      // Only the event-driven reader must be exact;  the others
+      // are there to compare with.
+      if (!run(device, modes[i], frames, hz) && i == 0)
+        ok = false;
+    }
+  return ok ? 0 : 1;
+}
+
+#else
+
+int main(int, char**) {
+  cout << "SerialDecoderTest needs Linux pseudoterminals.\n";
+  return 0;
+}
+
+#endif
@@ -196,10 +196,14 @@ void arInputSource::queueMatrix(int i, const arMatrix4& value) {
 }
 
 void arInputSource::sendQueue() {
+  sendQueue(ar_time());
+}
+
+void arInputSource::sendQueue(const ar_timeval& timestamp) {
   if (!_data || _iAll <= 0)
     return;
 
-  if (!_fillCommonData(_data) ||
+  if (!_fillCommonData(_data, timestamp) ||
       !_data->dataIn("types", _types, AR_INT, _iAll) ||
       !_data->dataIn("indices", _indices, AR_INT, _iAll) ||
       !_data->dataIn("buttons", _buttons, AR_INT, _iButton) ||
@@ -247,8 +251,11 @@ void arInputSource::_setDeviceElements(int buttons, int axes, int matrices) {
 }
 
 bool arInputSource::_fillCommonData(arStructuredData* d) {
+  return _fillCommonData(d, ar_time());
+}
+
+bool arInputSource::_fillCommonData(arStructuredData* d, const ar_timeval& t) {
   const ARint signature[3] = { _numberButtons, _numberAxes, _numberMatrices };
-  const ar_timeval t(ar_time());
   const ARint theTime[2] = { t.sec, t.usec };
   return d->dataIn("signature", signature, AR_INT, 3) &&
          d->dataIn("timestamp", theTime, AR_INT, 2);
@@ -57,8 +57,10 @@ class SZG_CALL arInputSource{
   void queueAxis(int index, float value);
   void queueMatrix(int index, const arMatrix4& value);
   void queueMatrix(const arMatrix4& value) { queueMatrix(0, value); }
-  // Send accumulated items in one packet.
+  // Send accumulated items in one packet, stamped now
+  // or (for a driver that timestamps its own input) then.
   void sendQueue();
+  void sendQueue(const ar_timeval& timestamp);
 
   virtual void handleMessage( const string& /*messageType*/, const string& /*messageBody*/ ) {}
 
@@ -91,6 +93,7 @@ class SZG_CALL arInputSource{
     { _setDeviceElements(nums[0], nums[1], nums[2]); }
 
   bool _fillCommonData(arStructuredData*);
+  bool _fillCommonData(arStructuredData*, const ar_timeval&);
 
   // Send data to the input sink.
   void _sendData(arStructuredData* theData = NULL);
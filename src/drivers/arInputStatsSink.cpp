@@ -0,0 +1,82 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arInputStatsSink.h"
+
+#include <algorithm>
+
+arInputStatsSink::arInputStatsSink() :
+  _lock("STATS_SINK") {
+  reset();
+}
+
+void arInputStatsSink::reset() {
+  arGuard _(_lock, "arInputStatsSink::reset");
+  _start = ar_time();
+  _packets = _events = _skew = 0;
+  _channelPackets.clear();
+  _latency.clear();
+}
+
+void arInputStatsSink::receiveData(int channel, arStructuredData* data) {
+  const ar_timeval now = ar_time();
+  if (!data || channel < 0)
+    return;
+  ARint t[2];
+  const bool stamped = data->getDataDimension(_inp._TIMESTAMP) == 2 &&
+    data->dataOut(_inp._TIMESTAMP, t, AR_INT, 2);
+  const int events = data->getDataDimension(_inp._TYPES);
+
+  arGuard _(_lock, "arInputStatsSink::receiveData");
+  ++_packets;
+  _events += events;
+  if (unsigned(channel) >= _channelPackets.size())
+    _channelPackets.resize(channel+1, 0);
+  ++_channelPackets[channel];
+  if (stamped) {
+    const double usec = ar_difftime(now, ar_timeval(t[0], t[1]));
+    if (usec < 0.)
+      ++_skew;
+    else
+      _latency.push_back(usec);
+  }
+}
+
+void arInputStatsSink::getLatency(double& mean, double& p99, double& max) {
+  arGuard _(_lock, "arInputStatsSink::getLatency");
+  mean = p99 = max = 0.;
+  if (_latency.empty())
+    return;
+  double sum = 0.;
+  for (vector<float>::const_iterator i = _latency.begin(); i != _latency.end(); ++i) {
+    sum += *i;
+    if (*i > max)
+      max = *i;
+  }
+  mean = sum / _latency.size();
+  vector<float> sorted(_latency);
+  vector<float>::iterator i = sorted.begin() + sorted.size()*99/100;
+  nth_element(sorted.begin(), i, sorted.end());
+  p99 = *i;
+}
+
+string arInputStatsSink::status() {
+  double mean, p99, max;
+  getLatency(mean, p99, max);
+  arGuard _(_lock, "arInputStatsSink::status");
+  const double seconds = ar_difftime(ar_time(), _start) * 1e-6;
+  ostringstream s;
+  s << _packets << " packets (" << _events << " events) from " <<
+    _channelPackets.size() << " channels in " << seconds << " s:  " <<
+    (seconds > 0. ? int(_packets / seconds) : 0) << " packets/s, " <<
+    (seconds > 0. ? int(_events / seconds) : 0) << " events/s.\n" <<
+    "  latency usec: mean " << int(mean) << ", p99 " << int(p99) <<
+    ", max " << int(max);
+  if (_skew > 0)
+    s << ";  " << _skew << " timestamps in the future";
+  s << ".\n";
+  return s.str();
+}
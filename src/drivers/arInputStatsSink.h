@@ -0,0 +1,46 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_INPUT_STATS_SINK_H
+#define AR_INPUT_STATS_SINK_H
+
+#include "arInputSink.h"
+#include "arInputLanguage.h"
+#include "arThread.h"
+#include "arDriversCalling.h"
+
+#include <vector>
+
+// Measure what reaches a sink:  packets and events per channel,
+// their rate, and latency from each packet's timestamp.
+// Add it to an arInputNode with addInputSink(), or feed it packets
+// from an arDataClient.  Latency is meaningful only if the sender's
+// clock is this host's.
+
+class SZG_CALL arInputStatsSink: public arInputSink {
+ public:
+  arInputStatsSink();
+
+  void receiveData(int, arStructuredData*);
+
+  void reset();
+  long getPackets() const { return _packets; }
+  long getEvents() const { return _events; }
+  // Mean, 99th percentile and maximum latency in usec, since reset().
+  void getLatency(double& mean, double& p99, double& max);
+  string status();
+
+ private:
+  arInputLanguage _inp;
+  arLock _lock;
+  ar_timeval _start;
+  long _packets;
+  long _events;
+  vector<long> _channelPackets;
+  vector<float> _latency;
+  long _skew;  // packets from the future
+};
+
+#endif
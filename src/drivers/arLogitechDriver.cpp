@@ -41,22 +41,8 @@ Here is PForth code for the arPForthFilter to transform coords
 
 DriverFactory(arLogitechDriver, "arInputSource")
 
-void ar_LogitechDriverEventTask(void* driver) {
-  arLogitechDriver* logDriver = (arLogitechDriver*) driver;
-  logDriver->_eventThreadRunning = true;
-  logDriver->_startStreaming();
-  bool stat(true);
-  while ((!logDriver->_stopped)&&(stat)) {
-    stat = logDriver->_update();
-  }
-  logDriver->_eventThreadRunning = false;
-}
-
 arLogitechDriver::arLogitechDriver() :
-  _woken( false ),
-  _stopped( false ),
-  _charsInBuffer( 0 ),
-  _eventThreadRunning( false )
+  _woken( false )
 {}
 
 arLogitechDriver::~arLogitechDriver() {
@@ -92,19 +78,17 @@ bool arLogitechDriver::start() {
     return false;
   }
 
-  if (!_eventThread.beginThread(ar_LogitechDriverEventTask, this)) {
-    ar_log_error() << "arLogitechDriver failed to start event thread.\n";
+  if (!_startStreaming())
+    return false;
+  if (!_comPort.startReading(this)) {
+    ar_log_error() << "arLogitechDriver failed to start reading serial port.\n";
     return false;
   }
   return true;
 }
 
 bool arLogitechDriver::stop() {
-  _stopped = true;
-  arSleepBackoff a(10, 20, 1.1);
-  while (_eventThreadRunning) {
-    a.sleep();
-  }
+  _comPort.stopReading();
 
   if (_woken) {
     if (!_reset()) {
@@ -188,86 +172,3 @@ bool arLogitechDriver::_runDiagnostics() {
     ar_log_error() << "EEPROM failed.\n";
   return false;
 }
-
-bool arLogitechDriver::_update() {
-  using namespace arLogitechDriverSpace;
-  const unsigned numToRead = ELEMENT_SIZE - _charsInBuffer;
-  const int numRead = _comPort.ar_read( _dataBuffer+_charsInBuffer, numToRead, MAX_DATA );
-  if (numRead < 0) {
-    cerr << "arLogitechDriver error: read() failed in _update().\n";
-    return false;
-  }
-  if (numRead == 0) {
-    return true;
-  }
-  _charsInBuffer += numRead;
-  const unsigned int numElements = static_cast<unsigned int>(floor(_charsInBuffer/(float)ELEMENT_SIZE));
-  if (numElements > 0) {
-    unsigned int i;
-    for (i=0; i<numElements; ++i) {
-      _convertSendData( _dataBuffer+i*ELEMENT_SIZE );
-    }
-    const unsigned numUsed = numElements*ELEMENT_SIZE;
-    const unsigned numLeft = _charsInBuffer - numUsed;
-    for (i=0; i<numLeft; ++i) {
-      _dataBuffer[i] = _dataBuffer[i+numUsed];
-    }
-    _charsInBuffer = numLeft;
-  }
-  return true;
-}
-
-// interpretations of misc bits - buttons on input devices
-#define logitech_FLAGBIT           0x80
-#define logitech_FRINGEBIT         0x40
-#define logitech_OUTOFRANGEBIT     0x20
-#define logitech_RESERVED          0x10
-#define logitech_SUSPENDBUTTON     0x08
-#define logitech_LEFTBUTTON        0x04
-#define logitech_MIDDLEBUTTON      0x02
-#define logitech_RIGHTBUTTON       0x01
-
-void arLogitechDriver::_convertSendData( char* record ) {
-
-  // collect unit's miscellaneous information
-  //const short buttons = (unsigned char)record[0] & (unsigned char)~logitech_FLAGBIT;
-
-  long ax=0, ay=0, az=0;
-  // absolute translational data
-  // Sign extend if needed.
-  ax = (record[1] & 0x40) ? 0xFFE00000 : 0;
-  ax |= (long)(record[1] & 0x7f) << 14;
-  ax |= (long)(record[2] & 0x7f) << 7;
-  ax |= (record[3] & 0x7f);
-
-  ay = (record[4] & 0x40) ? 0xFFE00000 : 0;
-  ay |= (long)(record[4] & 0x7f) << 14;
-  ay |= (long)(record[5] & 0x7f) << 7;
-  ay |= (record[6] & 0x7f);
-
-  az = (record[7] & 0x40) ? 0xFFE00000 : 0;
-  az |= (long)(record[7] & 0x7f) << 14;
-  az |= (long)(record[8] & 0x7f) << 7;
-  az |= (record[9] & 0x7f);
-
-  // calculate the positional floating point values
-  const float INCHES_TO_FEET = 1./12.;
-  const float x = INCHES_TO_FEET * ((float) ax) / 1000.0;
-  const float y = INCHES_TO_FEET * ((float) ay) / 1000.0;
-  const float z = INCHES_TO_FEET * ((float) az) / 1000.0;
-
-  // absolute rotational data
-  const short arx = ((record[10] & 0x7f) << 7) + (record[11] & 0x7f);
-  const short ary = ((record[12] & 0x7f) << 7) + (record[13] & 0x7f);
-  const short arz = ((record[14] & 0x7f) << 7) + (record[15] & 0x7f);
-
-  // calculate the rotational floating point values
-  const float xAngle = ar_convertToRad( ((float) arx) / 40.0 );
-  const float yAngle = ar_convertToRad( ((float) ary) / 40.0 );
-  const float zAngle = ar_convertToRad( ((float) arz) / 40.0 );
-
-  sendMatrix( ar_translationMatrix(x, y, z) *
-     ar_rotationMatrix('y', yAngle) *
-     ar_rotationMatrix('x', xAngle) *
-     ar_rotationMatrix('z', zAngle) );
-}
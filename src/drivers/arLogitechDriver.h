@@ -6,8 +6,7 @@
 #ifndef AR_LOGITECH_DRIVER_H
 #define AR_LOGITECH_DRIVER_H
 
-#include "arInputSource.h"
-#include "arRS232Port.h"
+#include "arSerialDecoders.h"
 
 #include "arDriversCalling.h"
 
@@ -17,8 +16,8 @@ const unsigned int MAX_ELEMENTS = 5;
 const unsigned int MAX_DATA = ELEMENT_SIZE*MAX_ELEMENTS;
 };
 
-class arLogitechDriver: public arInputSource {
-  friend void ar_LogitechDriverEventTask(void*);
+// The port's reading thread decodes records as they arrive.
+class arLogitechDriver: public arLogitechDecoder {
  public:
   arLogitechDriver();
   ~arLogitechDriver();
@@ -31,15 +30,9 @@ class arLogitechDriver: public arInputSource {
   bool _reset();
   bool _startStreaming();
   bool _runDiagnostics();
-  bool _update();
-  void _convertSendData( char* record );
   bool _woken;
-  bool _stopped;
   arRS232Port    _comPort;
   char _dataBuffer[arLogitechDriverSpace::MAX_DATA];
-  unsigned int _charsInBuffer;
-  arThread _eventThread;
-  bool _eventThreadRunning;
 };
 
 #endif
@@ -43,6 +43,21 @@ bool arNetInputSink::init(arSZGClient& SZGClient) {
 }
 
 bool arNetInputSink::start() {
+  if (_port > 0) {
+    if (_fValid)
+      return true;
+    _dataServer.setPort(_port);
+    _dataServer.setInterface(_interface);
+    if (!_dataServer.beginListening(_inp.getDictionary())) {
+      ar_log_error() << "arNetInputSink failed to listen on port " << _port << ".\n";
+      return false;
+    }
+    _fValid = true;
+    arThread dummy(ar_netInputSinkConnectionTask, this);
+    ar_log_remark() << "arNetInputSink started standalone on port " << _port << ".\n";
+    return true;
+  }
+
   if (!_szgClient) {
     // todo: unify "start before init" checks in many classes.
     ar_log_error() << "arNetInputSink can't start before init.\n";
@@ -21,6 +21,10 @@ class SZG_CALL arNetInputSink: public arInputSink{
 
   bool setSlot(unsigned slot);
   bool init(arSZGClient&);
+  // Instead of registering a service with the szgserver,
+  // start() listens on this port (e.g. InputFarmTest).
+  void setStandalonePort(int port, const string& interface = "INADDR_ANY")
+    { _port = port; _interface = interface; }
   bool start();
   void setInfo(const string& info);
   virtual void receiveData(int, arStructuredData*);
@@ -0,0 +1,169 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arSerialDecoders.h"
+
+const float PPT_RANGE = 32768.0;
+const float METERS_PER_FOOT = 12.0 * 0.0254;
+const float FEET_PER_METER = 1./METERS_PER_FOOT;
+
+arPPTDecoder::arPPTDecoder() :
+  _imAlive(false),
+  _lastNumLights(1),
+  _frames(0),
+  _skipped(0) {
+  _setDeviceElements( 0, 0, 1 );
+  _resetStatusTimer();
+}
+
+// Code lifted from WorldViz' VizPPTStreamingCode.h
+static float ar_PPTUnstuffBytes(float max, const unsigned char *storage) {
+  return (short int)(storage[0] * 256 + storage[1]) / PPT_RANGE * max;
+}
+
+unsigned char arPPTDecoder::checksum(const unsigned char* buffer, int length) {
+  unsigned char checksum = 0;
+  for(int i = 0; i < length; i++)
+    checksum += buffer[i];
+  return checksum;
+}
+// End lifted code
+
+int arPPTDecoder::decode(const unsigned char* bytes, int count, const ar_timeval& arrival) {
+  // Skip to the next 'o'.
+  int i = 0;
+  while (i < count && bytes[i] != 'o')
+    ++i;
+  if (i > 0) {
+    _skipped += i;
+    return i;
+  }
+  if (count < PACKET_SIZE)
+    return 0;
+
+  // A packet begins with 'o', has 1 to 4 lights, and its checksum matches.
+  const int numlights = bytes[1];
+  if (numlights < 1 || numlights > MAX_LIGHTS ||
+      bytes[PACKET_SIZE-1] != checksum(bytes, PACKET_SIZE-1)) {
+    ++_skipped;
+    return 1;
+  }
+
+  if (!_imAlive) {
+    ar_log_remark() << "arPPTDriver found PPT.\n";
+    _imAlive = true;
+  }
+  _resetStatusTimer();
+
+  if (numlights != _lastNumLights) {
+    _setDeviceElements( 0, 0, numlights );
+    _lastNumLights = numlights;
+  }
+  for (int j=0; j<numlights; ++j) {
+    const float x = ar_PPTUnstuffBytes(10.0, bytes + j*6+2);
+    const float y = ar_PPTUnstuffBytes(10.0, bytes + j*6+4);
+    const float z = ar_PPTUnstuffBytes(10.0, bytes + j*6+6);
+    // change coordinate systems from PPT's left-handed to OpenGL's
+    // right-handed, and from PPT's meters to Syzygy's feet.
+    queueMatrix( j, ar_translationMatrix( x*FEET_PER_METER, y*FEET_PER_METER, -z*FEET_PER_METER ) );
+  }
+  sendQueue(arrival);
+  ++_frames;
+  return PACKET_SIZE;
+}
+
+void arPPTDecoder::onTimeout() {
+  if (_statusTimer.done() && _imAlive) {
+    ar_log_error() << "arPPTDriver lost PPT.\n";
+    _imAlive = false;
+  }
+}
+
+void arPPTDecoder::_resetStatusTimer() {
+  const double PPT_TIMEOUT = 5.;
+  _statusTimer.start( PPT_TIMEOUT*1.e6 );
+}
+
+// interpretations of misc bits - buttons on input devices
+#define logitech_FLAGBIT           0x80
+#define logitech_FRINGEBIT         0x40
+#define logitech_OUTOFRANGEBIT     0x20
+#define logitech_RESERVED          0x10
+#define logitech_SUSPENDBUTTON     0x08
+#define logitech_LEFTBUTTON        0x04
+#define logitech_MIDDLEBUTTON      0x02
+#define logitech_RIGHTBUTTON       0x01
+
+arLogitechDecoder::arLogitechDecoder() :
+  _frames(0),
+  _skipped(0) {
+  _setDeviceElements( 0, 0, 1 );
+}
+
+int arLogitechDecoder::decode(const unsigned char* record, int count, const ar_timeval& arrival) {
+  // Skip to the next flag byte.
+  int i = 0;
+  while (i < count && !(record[i] & logitech_FLAGBIT))
+    ++i;
+  if (i > 0) {
+    _skipped += i;
+    return i;
+  }
+  if (count < RECORD_SIZE)
+    return 0;
+  // A flag byte inside the record means this one was truncated.
+  for (i=1; i<RECORD_SIZE; ++i) {
+    if (record[i] & logitech_FLAGBIT) {
+      _skipped += i;
+      return i;
+    }
+  }
+
+  // collect unit's miscellaneous information
+  //const short buttons = record[0] & (unsigned char)~logitech_FLAGBIT;
+
+  long ax=0, ay=0, az=0;
+  // absolute translational data
+  // Sign extend if needed.
+  ax = (record[1] & 0x40) ? 0xFFE00000 : 0;
+  ax |= (long)(record[1] & 0x7f) << 14;
+  ax |= (long)(record[2] & 0x7f) << 7;
+  ax |= (record[3] & 0x7f);
+
+  ay = (record[4] & 0x40) ? 0xFFE00000 : 0;
+  ay |= (long)(record[4] & 0x7f) << 14;
+  ay |= (long)(record[5] & 0x7f) << 7;
+  ay |= (record[6] & 0x7f);
+
+  az = (record[7] & 0x40) ? 0xFFE00000 : 0;
+  az |= (long)(record[7] & 0x7f) << 14;
+  az |= (long)(record[8] & 0x7f) << 7;
+  az |= (record[9] & 0x7f);
+
+  // calculate the positional floating point values
+  const float INCHES_TO_FEET = 1./12.;
+  const float x = INCHES_TO_FEET * ((float) ax) / 1000.0;
+  const float y = INCHES_TO_FEET * ((float) ay) / 1000.0;
+  const float z = INCHES_TO_FEET * ((float) az) / 1000.0;
+
+  // absolute rotational data
+  const short arx = ((record[10] & 0x7f) << 7) + (record[11] & 0x7f);
+  const short ary = ((record[12] & 0x7f) << 7) + (record[13] & 0x7f);
+  const short arz = ((record[14] & 0x7f) << 7) + (record[15] & 0x7f);
+
+  // calculate the rotational floating point values
+  const float xAngle = ar_convertToRad( ((float) arx) / 40.0 );
+  const float yAngle = ar_convertToRad( ((float) ary) / 40.0 );
+  const float zAngle = ar_convertToRad( ((float) arz) / 40.0 );
+
+  queueMatrix( ar_translationMatrix(x, y, z) *
+     ar_rotationMatrix('y', yAngle) *
+     ar_rotationMatrix('x', xAngle) *
+     ar_rotationMatrix('z', zAngle) );
+  sendQueue(arrival);
+  ++_frames;
+  return RECORD_SIZE;
+}
@@ -0,0 +1,65 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_SERIAL_DECODERS_H
+#define AR_SERIAL_DECODERS_H
+
+#include "arInputSource.h"
+#include "arRS232Port.h"
+#include "arDriversCalling.h"
+
+// Frame decoders for streaming serial trackers, run by
+// arRS232Port::startReading() as bytes arrive.  Each resynchronizes
+// after line noise by skipping bytes until a valid frame starts,
+// and stamps its events with the frames' arrival time.
+//
+// They live in libarDrivers (not the driver plugins) so that
+// SerialDecoderTest can exercise them against a simulated port.
+
+// WorldViz PPT:  27-byte frames, 'o', light count (1 to 4),
+// 6 bytes per light, zero padding, checksum.
+class SZG_CALL arPPTDecoder: public arInputSource, public arSerialFrameDecoder {
+ public:
+  arPPTDecoder();
+
+  int decode(const unsigned char* bytes, int count, const ar_timeval& arrival);
+  void onTimeout();
+
+  long getFrames() const { return _frames; }
+  long getSkipped() const { return _skipped; }
+
+  enum { PACKET_SIZE = 27, MAX_LIGHTS = 4 };
+  static unsigned char checksum(const unsigned char* buffer, int length);
+
+ protected:
+  void _resetStatusTimer();
+
+ private:
+  bool _imAlive;
+  int _lastNumLights;
+  arTimer _statusTimer;
+  long _frames;
+  long _skipped;
+};
+
+// Logitech 6D head tracker:  16-byte records whose first byte
+// (and no other) has the high bit set.
+class SZG_CALL arLogitechDecoder: public arInputSource, public arSerialFrameDecoder {
+ public:
+  arLogitechDecoder();
+
+  int decode(const unsigned char* bytes, int count, const ar_timeval& arrival);
+
+  long getFrames() const { return _frames; }
+  long getSkipped() const { return _skipped; }
+
+  enum { RECORD_SIZE = 16 };
+
+ private:
+  long _frames;
+  long _skipped;
+};
+
+#endif
@@ -0,0 +1,13 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+// Plugin for arSyntheticSource, configured by SZG_SYNTHETIC.
+// To run several in one DeviceServer, list it several times
+// in the input node's configuration.
+
+#include "arPrecompiled.h"
+#include "arSyntheticSource.h"
+
+DriverFactory(arSyntheticSource, "arInputSource")
@@ -0,0 +1,247 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arSyntheticSource.h"
+
+#include <math.h>
+#include <stdio.h>
+
+// Distinct trajectories for devices made one after another.
+static int ar_syntheticSourceCount = 0;
+
+void ar_syntheticSourceTask(void* p) {
+  ((arSyntheticSource*)p)->_run();
+}
+
+arSyntheticSource::arSyntheticSource() :
+  _rate(60.),
+  _jitter(0.),
+  _burstSize(0),
+  _burstInterval(1.),
+  _trajectory("circle"),
+  _seed(-1 - ar_syntheticSourceCount),
+  _phase(0.618034 * ar_syntheticSourceCount++),
+  _stopped(true),
+  _running(false),
+  _packets(0),
+  _late(0) {
+  _setDeviceElements(2, 2, 2);
+}
+
+arSyntheticSource::~arSyntheticSource() {
+  stop();
+}
+
+bool arSyntheticSource::init(arSZGClient& SZGClient) {
+  // Absent parameters keep what was set, so this works without a szgserver.
+  int sig[3] = { getNumberButtons(), getNumberAxes(), getNumberMatrices() };
+  if (SZGClient.getAttributeInts("SZG_SYNTHETIC", "signature", sig, 3))
+    setSignature(sig[0], sig[1], sig[2]);
+
+  float rate = 60.;
+  if (SZGClient.getAttributeFloats("SZG_SYNTHETIC", "rate", &rate) && !setRate(rate))
+    return false;
+  float jitter = 0.;
+  if (SZGClient.getAttributeFloats("SZG_SYNTHETIC", "jitter", &jitter))
+    setJitter(jitter);
+  float burst[2] = { 0., 1. };
+  if (SZGClient.getAttributeFloats("SZG_SYNTHETIC", "burst", burst, 2))
+    setBurst(int(burst[0]), burst[1]);
+
+  const string trajectory(SZGClient.getAttribute("SZG_SYNTHETIC", "trajectory"));
+  if (trajectory != "NULL") {
+    // A keyframe file may be in SZG_DATA/path.
+    const string found(ar_fileFind(trajectory, "", SZGClient.getDataPath()));
+    if (!setTrajectory(found == "NULL" ? trajectory : found))
+      return false;
+  }
+
+  ar_log_remark() << "arSyntheticSource inited.\n" << status();
+  return true;
+}
+
+bool arSyntheticSource::setRate(float hz) {
+  if (hz <= 0. || hz > 1e6) {
+    ar_log_error() << "arSyntheticSource ignoring rate " << hz << " Hz.\n";
+    return false;
+  }
+  _rate = hz;
+  return true;
+}
+
+void arSyntheticSource::setJitter(float usec) {
+  _jitter = usec < 0. ? 0. : usec;
+}
+
+void arSyntheticSource::setBurst(int size, float interval) {
+  _burstSize = size < 0 ? 0 : size;
+  _burstInterval = interval > 0. ? interval : 1.;
+}
+
+void arSyntheticSource::setSeed(long seed) {
+  _seed = seed > 0 ? -seed : seed;  // ar_randUniformFloat reseeds from negatives
+}
+
+bool arSyntheticSource::setTrajectory(const string& trajectory) {
+  _keys.clear();
+  if (trajectory == "circle" || trajectory == "figure8" || trajectory == "still") {
+    _trajectory = trajectory;
+    return true;
+  }
+
+  FILE* f = fopen(trajectory.c_str(), "r");
+  if (!f) {
+    ar_log_error() << "arSyntheticSource: no trajectory '" << trajectory << "'.\n";
+    return false;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    float k[5] = { 0., 0., 0., 0., 0. };
+    const int n = sscanf(line, "%f %f %f %f %f", k, k+1, k+2, k+3, k+4);
+    if (n < 4)
+      continue;  // comment or blank
+    if (!_keys.empty() && k[0] <= _keys[_keys.size()-5]) {
+      ar_log_error() << "arSyntheticSource: trajectory '" << trajectory <<
+        "' has times out of order.\n";
+      _keys.clear();
+      fclose(f);
+      return false;
+    }
+    _keys.insert(_keys.end(), k, k+5);
+  }
+  fclose(f);
+  if (_keys.size() < 10) {
+    ar_log_error() << "arSyntheticSource: trajectory '" << trajectory <<
+      "' needs two keyframes.\n";
+    _keys.clear();
+    return false;
+  }
+  _trajectory = trajectory;
+  return true;
+}
+
+bool arSyntheticSource::start() {
+  if (_running) {
+    ar_log_error() << "arSyntheticSource already started.\n";
+    return false;
+  }
+  _buttons.assign(getNumberButtons(), -1);
+  _packets = _late = 0;
+  _stopped = false;
+  _running = true;
+  if (!_thread.beginThread(ar_syntheticSourceTask, this)) {
+    ar_log_error() << "arSyntheticSource failed to start thread.\n";
+    _running = false;
+    return false;
+  }
+  return true;
+}
+
+bool arSyntheticSource::stop() {
+  _stopped = true;
+  arSleepBackoff a(5, 20, 1.1);
+  while (_running)
+    a.sleep();
+  return true;
+}
+
+string arSyntheticSource::status() const {
+  ostringstream s;
+  s << "arSyntheticSource: " << getNumberButtons() << " buttons, " <<
+    getNumberAxes() << " axes, " << getNumberMatrices() << " matrices at " <<
+    _rate << " Hz, jitter " << _jitter << " usec, ";
+  if (_burstSize > 0)
+    s << "bursts of " << _burstSize << " every " << _burstInterval << " s, ";
+  s << "trajectory " << _trajectory << ".\n";
+  if (_packets > 0)
+    s << "  Sent " << _packets << " packets, " << _late << " late.\n";
+  return s.str();
+}
+
+void arSyntheticSource::_run() {
+  const double period = 1e6 / _rate;
+  _start = ar_time();
+  double due = 0.;           // usec after _start
+  double burst = _burstInterval * 1e6;
+  while (!_stopped) {
+    double now = ar_difftime(ar_time(), _start);
+    if (now < due) {
+      ar_usleep(int(due - now));
+      continue;
+    }
+    if (now - due > period)
+      ++_late;
+    if (now - due > 1e6) {
+      // Starved for a second.  Don't flood the sinks catching up.
+      due = now;
+    }
+
+    _send(due * 1e-6);
+    if (_burstSize > 0 && now >= burst) {
+      for (int i=0; i<_burstSize; ++i)
+        _send(due * 1e-6);
+      burst += _burstInterval * 1e6;
+    }
+
+    due += period;
+    if (_jitter > 0.)
+      due += _jitter * (2.*ar_randUniformFloat(&_seed) - 1.);
+  }
+  _running = false;
+}
+
+void arSyntheticSource::_send(double t) {
+  int i;
+  for (i=0; i<getNumberMatrices(); ++i)
+    queueMatrix(i, _pose(t + 0.37*i + _phase));
+  for (i=0; i<getNumberAxes(); ++i)
+    queueAxis(i, sin(2*M_PI*((.5 + .1*i)*t + _phase)));
+  // Button i toggles at i+1 Hz.
+  for (i=0; i<getNumberButtons(); ++i) {
+    const int b = int(floor((t + _phase) * (i+1))) & 1;
+    if (b != _buttons[i]) {
+      _buttons[i] = b;
+      queueButton(i, b);
+    }
+  }
+  sendQueue();
+  ++_packets;
+}
+
+arMatrix4 arSyntheticSource::_pose(double t) const {
+  float x = 0., y = 5., z = 0., azimuth = 0.;
+  if (!_keys.empty()) {
+    const unsigned n = _keys.size() / 5;
+    const double t0 = _keys[0];
+    t = t0 + fmod(t, double(_keys[(n-1)*5] - t0));
+    unsigned i = 0;
+    while (i+2 < n && _keys[(i+1)*5] <= t)
+      ++i;
+    const float* a = &_keys[i*5];
+    const float* b = a + 5;
+    const float s = (t - a[0]) / (b[0] - a[0]);
+    x = a[1] + s*(b[1]-a[1]);
+    y = a[2] + s*(b[2]-a[2]);
+    z = a[3] + s*(b[3]-a[3]);
+    azimuth = a[4] + s*(b[4]-a[4]);
+  }
+  else if (_trajectory == "circle") {
+    // Radius 2 feet, 4 seconds around, facing ahead.
+    const float a = 2*M_PI * t / 4.;
+    x = 2. * cos(a);
+    z = 2. * sin(a);
+    azimuth = -ar_convertToDeg(a);
+  }
+  else if (_trajectory == "figure8") {
+    const float a = 2*M_PI * t / 6.;
+    x = 2. * sin(a);
+    y = 5. + .5 * sin(3.*a);
+    z = sin(2.*a);
+    azimuth = 30. * sin(a);
+  }
+  return ar_translationMatrix(x, y, z) *
+    ar_rotationMatrix('y', ar_convertToRad(azimuth));
+}
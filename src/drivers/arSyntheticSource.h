@@ -0,0 +1,81 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_SYNTHETIC_SOURCE_H
+#define AR_SYNTHETIC_SOURCE_H
+
+#include "arInputSource.h"
+#include "arThread.h"
+
+#include "arDriversCalling.h"
+
+#include <string>
+#include <vector>
+
+// Headless input device, to load-test DeviceServer, arInputNode and
+// arNetInputSink without hardware.  Each packet has every matrix and axis,
+// and the buttons that changed.  Many may run in one process, each with
+// its own thread;  see InputFarmTest.  The plugin arSyntheticDriver
+// is this, configured by SZG_SYNTHETIC.
+//
+// Packets are timestamped when sent, so sinks can measure latency
+// (see arInputStatsSink).  Below the sleep granularity of the host
+// (roughly 10 kHz), due packets are sent together, keeping the rate.
+
+class SZG_CALL arSyntheticSource: public arInputSource {
+  friend void ar_syntheticSourceTask(void*);
+ public:
+  arSyntheticSource();
+  ~arSyntheticSource();
+
+  // SZG_SYNTHETIC/signature "buttons axes matrices", rate (Hz),
+  // jitter (usec), burst "packets seconds", and trajectory.
+  bool init(arSZGClient&);
+  bool start();
+  bool stop();
+
+  // Configure before start().
+  void setSignature(int buttons, int axes, int matrices)
+    { _setDeviceElements(buttons, axes, matrices); }
+  bool setRate(float hz);
+  // Perturb each interval by up to +-usec.
+  void setJitter(float usec);
+  // Every interval seconds, send size extra packets back to back.
+  void setBurst(int size, float interval);
+  // "circle" (default), "figure8", "still", or a file of keyframes,
+  // lines of "seconds x y z azimuth", looped.  Matrices follow it at
+  // staggered phases, so they differ.
+  bool setTrajectory(const string& trajectory);
+  void setSeed(long seed);
+
+  long getPackets() const { return _packets; }
+  // Packets sent over one interval late.
+  long getLate() const { return _late; }
+  string status() const;
+
+ private:
+  float _rate;
+  float _jitter;
+  int _burstSize;
+  float _burstInterval;
+  string _trajectory;
+  vector<float> _keys;  // seconds x y z azimuth, seconds x y z azimuth, ...
+  long _seed;
+  float _phase;
+
+  arThread _thread;
+  bool _stopped;
+  bool _running;
+  long _packets;
+  long _late;
+  ar_timeval _start;
+  vector<int> _buttons;
+
+  void _run();
+  void _send(double seconds);
+  arMatrix4 _pose(double seconds) const;
+};
+
+#endif
@@ -0,0 +1,183 @@
+// Benchmark arBinaryDataSaver against arXMLDataSaver, without a szgserver.
+// Each saves the same per-frame records (a timestamp, head and wand
+// matrices, a button, a label); reports records/sec and the slowest
+// saveData().  Then checks that the binary file converts to the same
+// trial records as the XML file, and that a file torn in mid-block
+// reads and recovers up to its last complete block.
+//
+// Usage: DataSaverTest [records [block records]]
+
+#include "arPrecompiled.h"
+#define SZG_DO_NOT_EXPORT
+
+#include "arXMLDataSaver.h"
+#include "arBinaryDataSaver.h"
+#include "arBinaryDataReader.h"
+#include "arDataUtilities.h"
+
+#include <stdlib.h>
+
+static const char* xmlPath = "DataSaverTest_dat.xml";
+static const char* binPath = "DataSaverTest_dat.bin";
+static const char* convertedPath = "DataSaverTest_converted.xml";
+static const char* tornPath = "DataSaverTest_torn.bin";
+
+static string fileContents( const char* path ) {
+  string s;
+  FILE* f = fopen( path, "rb" );
+  if (!f)
+    return s;
+  char buf[65536];
+  size_t n;
+  while ((n = fread( buf, 1, sizeof(buf), f )) > 0)
+    s.append( buf, n );
+  fclose( f );
+  return s;
+}
+
+static long fileSize( const char* path ) {
+  return long(fileContents( path ).size());
+}
+
+// Trial records, after the header.
+static string trialRecords( const char* path ) {
+  const string s( fileContents( path ) );
+  const string::size_type i = s.find( "<trial_data>" );
+  return i == string::npos ? string() : s.substr( i );
+}
+
+// Save records with saver, returning seconds.
+static double run( arDataSaver& saver, const char* path, int records,
+                   double& usecWorst ) {
+  arExperimentDataRecord factors;
+  factors.addField( "condition", AR_CHAR );
+  factors.setStringFieldValue( "condition", "binocular" );
+  int block = 0;
+  factors.addField( "block", AR_INT, &block, 1 );
+
+  arExperimentDataRecord data;
+  double time = 0.;
+  float head[16], wand[16];
+  int button = 0;
+  data.addField( "time", AR_DOUBLE, &time, 1 );
+  data.addField( "head", AR_FLOAT, head, 16 );
+  data.addField( "wand", AR_FLOAT, wand, 16 );
+  data.addField( "button", AR_INT, &button, 1 );
+  data.addField( "label", AR_CHAR );
+  data.setStringFieldValue( "label", "" );
+
+  remove( path );
+  if (!saver.open( path, "DataSaverTest", "benchmark", factors, data )) {
+    cerr << "DataSaverTest error: failed to open " << path << endl;
+    exit(1);
+  }
+
+  usecWorst = 0.;
+  const ar_timeval start = ar_time();
+  for (int r=0; r<records; ++r) {
+    time = r / 60.;
+    for (int i=0; i<16; ++i) {
+      head[i] = float(r + i) * .25f;
+      wand[i] = float(r - i) * .125f;
+    }
+    button = (r / 30) % 2;
+    block = r / 1000;
+    char label[32];
+    sprintf( label, (r % 7) ? "frame %d" : "", r );
+    data.setStringFieldValue( "label", label );
+
+    const ar_timeval t = ar_time();
+    if (!saver.saveData( factors, data )) {
+      cerr << "DataSaverTest error: saveData() failed.\n";
+      exit(1);
+    }
+    const double usec = ar_difftime( ar_time(), t );
+    if (usec > usecWorst)
+      usecWorst = usec;
+  }
+  return ar_difftime( ar_time(), start ) / 1.e6;
+}
+
+int main( int argc, char** argv ) {
+  const int records = argc > 1 ? atoi( argv[1] ) : 20000;
+  const int blockRecords = argc > 2 ? atoi( argv[2] ) : 256;
+  bool ok = true;
+
+  double worstXML = 0.;
+  double secXML = 0.;
+  {
+    arXMLDataSaver saver;
+    secXML = run( saver, xmlPath, records, worstXML );
+  }
+  double worstBin = 0.;
+  double secBin = 0.;
+  double secClose = 0.;
+  long stalls = 0;
+  {
+    arBinaryDataSaver saver( blockRecords );
+    secBin = run( saver, binPath, records, worstBin );
+    stalls = saver.getStalls();
+    const ar_timeval t = ar_time();
+    saver.flush();
+    secClose = ar_difftime( ar_time(), t ) / 1.e6;
+  }
+
+  printf( "%d records:\n", records );
+  printf( "  xml:    %9.0f records/sec, slowest saveData %6.0f usec, %8ld bytes\n",
+          records / secXML, worstXML, fileSize( xmlPath ) );
+  printf( "  binary: %9.0f records/sec, slowest saveData %6.0f usec, %8ld bytes\n",
+          records / secBin, worstBin, fileSize( binPath ) );
+  printf( "          %.1f msec to flush, %ld stalls\n", secClose * 1000., stalls );
+
+  arBinaryDataReader reader;
+  if (!reader.open( binPath ) || !reader.complete() ||
+      reader.getNumberRecords() != records) {
+    cerr << "DataSaverTest error: binary file has "
+         << reader.getNumberRecords() << " records.\n";
+    ok = false;
+  }
+  FILE* f = fopen( convertedPath, "w" );
+  if (!f || !reader.writeXML( f )) {
+    cerr << "DataSaverTest error: failed to convert to XML.\n";
+    ok = false;
+  }
+  if (f)
+    fclose( f );
+  reader.close();
+  if (trialRecords( xmlPath ) != trialRecords( convertedPath )) {
+    cerr << "DataSaverTest error: converted records differ from arXMLDataSaver's.\n";
+    ok = false;
+  } else {
+    printf( "  converted binary matches xml\n" );
+  }
+
+  // Tear the last block, as if the experiment crashed while writing it.
+  const string whole( fileContents( binPath ) );
+  f = fopen( tornPath, "wb" );
+  fwrite( whole.data(), 1, whole.size() - 16 - 40, f );
+  fclose( f );
+  reader.open( tornPath );
+  const long survived = reader.getNumberRecords();
+  if (reader.complete() || survived >= records) {
+    cerr << "DataSaverTest error: torn file read " << survived << " records.\n";
+    ok = false;
+  }
+  if (!reader.recover()) {
+    ok = false;
+  }
+  reader.open( tornPath );
+  if (!reader.complete() || reader.getNumberRecords() != survived) {
+    cerr << "DataSaverTest error: recovery failed.\n";
+    ok = false;
+  } else {
+    printf( "  torn file recovered %ld of %d records\n", survived, records );
+  }
+  reader.close();
+
+  remove( xmlPath );
+  remove( binPath );
+  remove( convertedPath );
+  remove( tornPath );
+  printf( ok ? "DataSaverTest passed.\n" : "DataSaverTest FAILED.\n" );
+  return ok ? 0 : 1;
+}
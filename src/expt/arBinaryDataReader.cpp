@@ -0,0 +1,298 @@
+#include "arPrecompiled.h"
+#include "arBinaryDataReader.h"
+#include "arStructuredData.h"
+
+using std::vector;
+using std::string;
+
+const char* const arBinaryDataReader::MAGIC = "SZGCOL01";
+
+// FNV-1a.
+ARint arBinaryDataReader::checksum( const char* data, unsigned int bytes ) {
+  unsigned int h = 2166136261U;
+  for (unsigned int i=0; i<bytes; ++i) {
+    h ^= (unsigned char)data[i];
+    h *= 16777619U;
+  }
+  return ARint(h);
+}
+
+arBinaryDataReader::arBinaryDataReader() :
+  _file(NULL),
+  _end(0),
+  _records(0),
+  _complete(false),
+  _blockRecords(0) {
+}
+
+arBinaryDataReader::~arBinaryDataReader() {
+  close();
+}
+
+void arBinaryDataReader::close() {
+  if (_file) {
+    fclose( _file );
+    _file = NULL;
+  }
+  _columns.clear();
+  _blockOffsets.clear();
+  _end = 0;
+  _records = 0;
+  _complete = false;
+  _blockRecords = 0;
+}
+
+bool arBinaryDataReader::_readInt( ARint& x ) {
+  return fread( &x, sizeof(ARint), 1, _file ) == 1;
+}
+
+bool arBinaryDataReader::_readString( string& s ) {
+  ARint length;
+  if (!_readInt( length ) || length < 0)
+    return false;
+  vector<char> buf( length+1 );
+  if (length > 0 && fread( &buf[0], 1, length, _file ) != unsigned(length))
+    return false;
+  s.assign( &buf[0], length );
+  return true;
+}
+
+bool arBinaryDataReader::open( const string& filePath ) {
+  close();
+  _filePath = filePath;
+  _file = fopen( filePath.c_str(), "rb" );
+  if (!_file) {
+    cerr << "arBinaryDataReader error: couldn't open " << filePath << endl;
+    return false;
+  }
+  char magic[8];
+  ARint byteOrder = 0;
+  if (fread( magic, 1, 8, _file ) != 8 || strncmp( magic, MAGIC, 8 ) ||
+      !_readInt( byteOrder )) {
+    cerr << "arBinaryDataReader error: " << filePath << " isn't a binary data file.\n";
+    close();
+    return false;
+  }
+  if (byteOrder != 0x01020304) {
+    cerr << "arBinaryDataReader error: " << filePath
+         << " was written with the other byte order.\n";
+    close();
+    return false;
+  }
+  ARint numberColumns = 0;
+  if (!_readString( _experimentName ) || !_readString( _runtime ) ||
+      !_readString( _comment ) || !_readString( _description ) ||
+      !_readInt( numberColumns ) || numberColumns < 0) {
+    cerr << "arBinaryDataReader error: truncated header in " << filePath << endl;
+    close();
+    return false;
+  }
+  for (int i=0; i<numberColumns; ++i) {
+    arBinaryDataColumn c;
+    ARint type, size, factor;
+    if (!_readString( c.name ) || !_readInt( type ) || !_readInt( size ) ||
+        !_readInt( factor ) || arDataTypeSize( arDataType(type) ) <= 0) {
+      cerr << "arBinaryDataReader error: bad column in " << filePath << endl;
+      close();
+      return false;
+    }
+    c.type = arDataType(type);
+    c.size = size;
+    c.factor = factor != 0;
+    _columns.push_back( c );
+  }
+
+  // Index the blocks, verifying each.
+  _end = ftell( _file );
+  fseek( _file, 0, SEEK_END );
+  const long fileSize = ftell( _file );
+  fseek( _file, _end, SEEK_SET );
+
+  vector<char> payload;
+  while (true) {
+    ARint marker, a, b, c;
+    if (!_readInt( marker ) || !_readInt( a ) || !_readInt( b ) || !_readInt( c ))
+      break;
+    if (marker == FOOTER_MARKER) {
+      if (a != getNumberBlocks() || b != _records) {
+        cerr << "arBinaryDataReader warning: footer disagrees with blocks in "
+             << filePath << endl;
+      } else {
+        _complete = c == 1;
+      }
+      break;
+    }
+    const long start = _end + long(4*sizeof(ARint));
+    if (marker != BLOCK_MARKER || a < 0 || b < 0 || start + b > fileSize)
+      break;
+    payload.resize( b+1 );
+    if (b > 0 && fread( &payload[0], 1, b, _file ) != unsigned(b))
+      break;
+    if (checksum( &payload[0], b ) != c)
+      break;
+    _blockOffsets.push_back( _end );
+    _records += a;
+    _end = start + b;
+  }
+  if (!_complete) {
+    cerr << "arBinaryDataReader warning: " << filePath
+         << " wasn't closed cleanly;  read " << _records << " records in "
+         << getNumberBlocks() << " blocks.\n";
+  }
+  return true;
+}
+
+bool arBinaryDataReader::recover() {
+  if (!_file) {
+    cerr << "arBinaryDataReader error: recover() before open().\n";
+    return false;
+  }
+  FILE* f = fopen( _filePath.c_str(), "r+b" );
+  if (!f) {
+    cerr << "arBinaryDataReader error: couldn't write " << _filePath << endl;
+    return false;
+  }
+  const ARint footer[4] = { FOOTER_MARKER, getNumberBlocks(), ARint(_records), 1 };
+  const bool ok = fseek( f, _end, SEEK_SET ) == 0 &&
+    fwrite( footer, sizeof(footer), 1, f ) == 1;
+  fclose( f );
+  if (!ok) {
+    cerr << "arBinaryDataReader error: failed to write footer to " << _filePath << endl;
+    return false;
+  }
+  _complete = true;
+  return true;
+}
+
+bool arBinaryDataReader::_readBlock( int block ) {
+  ARint head[4];
+  if (fseek( _file, _blockOffsets[block], SEEK_SET ) != 0 ||
+      fread( head, sizeof(head), 1, _file ) != 1) {
+    cerr << "arBinaryDataReader error: failed to read block " << block << endl;
+    return false;
+  }
+  _blockRecords = head[1];
+  _payload.resize( head[2]+1 );
+  if (head[2] > 0 && fread( &_payload[0], 1, head[2], _file ) != unsigned(head[2])) {
+    cerr << "arBinaryDataReader error: failed to read block " << block << endl;
+    return false;
+  }
+  const char* p = &_payload[0];
+  const char* end = p + head[2];
+  _counts.resize( _columns.size() );
+  _values.resize( _columns.size() );
+  for (unsigned i=0; i<_columns.size(); ++i) {
+    _counts[i] = (const ARint*)p;
+    p += padding( _blockRecords * sizeof(ARint) );
+    if (p > end)
+      break;
+    const int elementSize = arDataTypeSize( _columns[i].type );
+    _values[i].resize( _blockRecords );
+    const char* values = p;
+    for (int r=0; r<_blockRecords && p <= end; ++r) {
+      _values[i][r] = p;
+      if (_counts[i][r] < 0)
+        p = end+1;
+      else
+        p += _counts[i][r] * elementSize;
+    }
+    p = values + padding( p - values );
+  }
+  if (p > end) {
+    cerr << "arBinaryDataReader error: block " << block << " is malformed.\n";
+    return false;
+  }
+  return true;
+}
+
+void arBinaryDataReader::_writeValue( FILE* filePtr, arDataType type, const char* value ) const {
+  switch (type) {
+    case AR_INT:
+      fprintf( filePtr, "%d", *(const ARint*)value );
+      break;
+    case AR_LONG:
+      // AR_LONG_SIZE bytes, as arExperimentDataField stores them.
+      fprintf( filePtr, "%d", *(const ARint*)value );
+      break;
+    case AR_FLOAT:
+      fprintf( filePtr, "%.9g", *(const ARfloat*)value );
+      break;
+    case AR_DOUBLE:
+      fprintf( filePtr, "%.17g", *(const ARdouble*)value );
+      break;
+    case AR_INT64:
+      fprintf( filePtr, "%lld", (long long)*(const ARint64*)value );
+      break;
+    default:
+      break;
+  }
+}
+
+bool arBinaryDataReader::writeCSV( FILE* filePtr ) {
+  if (!_file) {
+    cerr << "arBinaryDataReader error: writeCSV() before open().\n";
+    return false;
+  }
+  unsigned i;
+  for (i=0; i<_columns.size(); ++i)
+    fprintf( filePtr, "%s%s", i ? "," : "", _columns[i].name.c_str() );
+  fprintf( filePtr, "\n" );
+  for (int block=0; block<getNumberBlocks(); ++block) {
+    if (!_readBlock( block ))
+      return false;
+    for (int r=0; r<_blockRecords; ++r) {
+      for (i=0; i<_columns.size(); ++i) {
+        if (i)
+          fputc( ',', filePtr );
+        const char* v = _values[i][r];
+        const int count = _counts[i][r];
+        if (_columns[i].type == AR_CHAR) {
+          fputc( '"', filePtr );
+          for (int j=0; j<count; ++j) {
+            if (v[j] == '"')
+              fputc( '"', filePtr );
+            fputc( v[j], filePtr );
+          }
+          fputc( '"', filePtr );
+          continue;
+        }
+        const int elementSize = arDataTypeSize( _columns[i].type );
+        for (int j=0; j<count; ++j) {
+          if (j)
+            fputc( ' ', filePtr );
+          _writeValue( filePtr, _columns[i].type, v + j*elementSize );
+        }
+      }
+      fprintf( filePtr, "\n" );
+    }
+  }
+  return true;
+}
+
+bool arBinaryDataReader::writeXML( FILE* filePtr ) {
+  if (!_file) {
+    cerr << "arBinaryDataReader error: writeXML() before open().\n";
+    return false;
+  }
+  fputs( _description.c_str(), filePtr );
+  arDataTemplate t( "trial_data" );
+  unsigned i;
+  for (i=0; i<_columns.size(); ++i)
+    t.addAttribute( _columns[i].name, _columns[i].type );
+  arStructuredData record( &t );
+  for (int block=0; block<getNumberBlocks(); ++block) {
+    if (!_readBlock( block ))
+      return false;
+    for (int r=0; r<_blockRecords; ++r) {
+      for (i=0; i<_columns.size(); ++i) {
+        if (!record.dataIn( i, _values[i][r], _columns[i].type, _counts[i][r] )) {
+          cerr << "arBinaryDataReader error: failed to convert field "
+               << _columns[i].name << ".\n";
+          return false;
+        }
+      }
+      record.print( filePtr );
+    }
+  }
+  return true;
+}
@@ -0,0 +1,91 @@
+#ifndef ARBINARYDATAREADER_H
+#define ARBINARYDATAREADER_H
+
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include "arDataType.h"
+// THIS MUST BE THE LAST SZG INCLUDE!
+#include "arExperimentCalling.h"
+
+// The columnar binary data file written by arBinaryDataSaver.
+// All integers are ARints, in the writer's byte order:
+//
+//   header:  "SZGCOL01", 0x01020304 (byte order), then the experiment name,
+//            runtime, comment and XML description (each a length and chars),
+//            then the column count and, per column, its name, arDataType,
+//            declared size, and 1 for a factor or 0 for a data field.
+//   blocks:  BLOCK_MARKER, record count, payload bytes, payload checksum,
+//            then per column: each record's element count, then all of
+//            the column's elements back to back, each list padded to a
+//            multiple of 8 bytes to keep the elements aligned.
+//   footer:  FOOTER_MARKER, block count, record count, 1 if closed cleanly.
+//
+// Each block overwrites the previous footer and is followed by a new one,
+// so the file always ends in a footer unless a write was interrupted.
+// Then the torn block fails its checksum, and reading stops before it.
+
+struct SZG_CALL arBinaryDataColumn {
+  std::string name;
+  arDataType type;
+  unsigned int size;
+  bool factor;
+};
+
+class SZG_CALL arBinaryDataReader {
+  public:
+    enum { BLOCK_MARKER = 0x4b4c4253, FOOTER_MARKER = 0x444e4553 };
+    static const char* const MAGIC;
+    static ARint checksum( const char* data, unsigned int bytes );
+    static unsigned int padding( unsigned int bytes ) { return (bytes+7) & ~7U; }
+
+    arBinaryDataReader();
+    ~arBinaryDataReader();
+
+    // Read the header and index the blocks.
+    bool open( const std::string& filePath );
+    void close();
+    // False if the writer crashed, or the file hasn't been closed yet.
+    bool complete() const { return _complete; }
+    // Write a footer after the last good block, discarding a torn one.
+    bool recover();
+
+    const std::string& getExperimentName() const { return _experimentName; }
+    const std::string& getRuntime() const { return _runtime; }
+    const std::string& getComment() const { return _comment; }
+    const std::string& getDescription() const { return _description; }
+    const std::vector<arBinaryDataColumn>& getColumns() const { return _columns; }
+    long getNumberRecords() const { return _records; }
+    int getNumberBlocks() const { return int(_blockOffsets.size()); }
+
+    // One row per record;  arrays are space-separated in one cell.
+    bool writeCSV( FILE* filePtr );
+    // What arXMLDataSaver would have written.
+    bool writeXML( FILE* filePtr );
+
+  private:
+    FILE* _file;
+    std::string _filePath;
+    std::string _experimentName;
+    std::string _runtime;
+    std::string _comment;
+    std::string _description;
+    std::vector<arBinaryDataColumn> _columns;
+    std::vector<long> _blockOffsets;
+    long _end;     // of the last good block
+    long _records;
+    bool _complete;
+
+    // The current block, unpacked.
+    int _blockRecords;
+    std::vector<char> _payload;
+    std::vector<const ARint*> _counts;
+    std::vector< std::vector<const char*> > _values;
+
+    bool _readInt( ARint& x );
+    bool _readString( std::string& s );
+    bool _readBlock( int block );
+    void _writeValue( FILE* filePtr, arDataType type, const char* value ) const;
+};
+
+#endif        //  #ifndefARBINARYDATAREADER_H
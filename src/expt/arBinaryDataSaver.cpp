@@ -0,0 +1,324 @@
+#include "arPrecompiled.h"
+#include "arBinaryDataSaver.h"
+
+using std::vector;
+using std::string;
+
+void arBinaryDataSaver::Buffer::clear() {
+  records = 0;
+  for (unsigned i=0; i<counts.size(); ++i) {
+    counts[i].clear();
+    values[i].clear();
+  }
+}
+
+void arBinaryDataSaver::Buffer::swap( Buffer& b ) {
+  std::swap( records, b.records );
+  counts.swap( b.counts );
+  values.swap( b.values );
+}
+
+void ar_binaryDataSaverTask( void* saver ) {
+  ((arBinaryDataSaver*)saver)->_writeTask();
+}
+
+arBinaryDataSaver::arBinaryDataSaver( int blockRecords, int flushInterval ) :
+  arDataSaver("bin"),
+  _blockRecords(blockRecords < 1 ? 1 : blockRecords),
+  _flushInterval(flushInterval),
+  _configured(false),
+  _file(NULL),
+  _footerOffset(0),
+  _blocks(0),
+  _recordsWritten(0),
+  _lock("arBinaryDataSaver"),
+  _writeVar("arBinaryDataSaver-write"),
+  _writtenVar("arBinaryDataSaver-written"),
+  _recordsSaved(0),
+  _flushing(false),
+  _exit(false),
+  _running(false),
+  _failed(false),
+  _stalls(0) {
+  _front.records = 0;
+  _back.records = 0;
+}
+
+arBinaryDataSaver::~arBinaryDataSaver() {
+  if (_configured) {
+    flush();
+    _lock.lock("arBinaryDataSaver::~arBinaryDataSaver");
+    _exit = true;
+    _writeVar.signal();
+    while (_running)
+      _writtenVar.wait( _lock );
+    _lock.unlock();
+    if (!_failed)
+      _writeFooter( true, _recordsWritten );
+  }
+  if (_file)
+    fclose( _file );
+}
+
+bool arBinaryDataSaver::init( const string experimentName,
+                              string dataPath, string comment,
+                              const arHumanSubject& subjectData,
+                              arExperimentDataRecord& factors,
+                              arExperimentDataRecord& dataRecords,
+                              arSZGClient& szgClient) {
+  stringstream& errStream = szgClient.startResponse();
+  if (!setFilePath( dataPath, szgClient )) {
+    cerr << "arBinaryDataSaver error: setFilePath() failed.\n";
+    errStream << "arBinaryDataSaver error: setFilePath() failed.\n";
+    return false;
+  }
+  if (!_open( experimentName, comment, &subjectData, factors, dataRecords )) {
+    errStream << "arBinaryDataSaver error: couldn't write data file " << _dataFilePath << endl;
+    return false;
+  }
+  return true;
+}
+
+static bool ar_writeInt( FILE* filePtr, ARint x ) {
+  return fwrite( &x, sizeof(ARint), 1, filePtr ) == 1;
+}
+
+static bool ar_writeString( FILE* filePtr, const string& s ) {
+  return ar_writeInt( filePtr, ARint(s.size()) ) &&
+    (s.empty() || fwrite( s.data(), 1, s.size(), filePtr ) == s.size());
+}
+
+bool arBinaryDataSaver::_open( const string& experimentName,
+                               const string& comment,
+                               const arHumanSubject* subjectData,
+                               arExperimentDataRecord& factors,
+                               arExperimentDataRecord& dataRecords ) {
+  if (_configured) {
+    cerr << "arBinaryDataSaver error: already initialized.\n";
+    return false;
+  }
+  _columns.clear();
+  for (int pass=0; pass<2; ++pass) {
+    arExperimentDataRecord& record = pass==0 ? factors : dataRecords;
+    arExperimentDataField* df = record.getFirstField();
+    while (!!df) {
+      arBinaryDataColumn c;
+      c.name = df->getName();
+      c.type = df->getType();
+      c.size = df->getSize();
+      c.factor = pass==0;
+      if (arDataTypeSize( c.type ) <= 0) {
+        cerr << "arBinaryDataSaver error: field " << c.name << " has no type.\n";
+        return false;
+      }
+      _columns.push_back( c );
+      df = record.getNextField();
+    }
+  }
+
+  _file = fopen( _dataFilePath.c_str(), "wb" );
+  if (_file == NULL) {
+    cerr << "arBinaryDataSaver error: couldn't open data file " << _dataFilePath << endl;
+    return false;
+  }
+  bool ok = fwrite( arBinaryDataReader::MAGIC, 1, 8, _file ) == 8 &&
+    ar_writeInt( _file, 0x01020304 ) &&
+    ar_writeString( _file, experimentName ) &&
+    ar_writeString( _file, ar_currentTimeString() ) &&
+    ar_writeString( _file, comment );
+
+  // The description's length isn't known until it's printed.
+  const long lengthOffset = ftell( _file );
+  ok = ok && ar_writeInt( _file, 0 ) &&
+    _describe( experimentName, comment, subjectData, factors, dataRecords, _file );
+  const long end = ftell( _file );
+  ok = ok && fseek( _file, lengthOffset, SEEK_SET ) == 0 &&
+    ar_writeInt( _file, ARint(end - lengthOffset - sizeof(ARint)) ) &&
+    fseek( _file, end, SEEK_SET ) == 0;
+
+  ok = ok && ar_writeInt( _file, ARint(_columns.size()) );
+  for (unsigned i=0; ok && i<_columns.size(); ++i) {
+    ok = ar_writeString( _file, _columns[i].name ) &&
+      ar_writeInt( _file, _columns[i].type ) &&
+      ar_writeInt( _file, _columns[i].size ) &&
+      ar_writeInt( _file, _columns[i].factor ? 1 : 0 );
+  }
+  _footerOffset = ftell( _file );
+  if (!ok || !_writeFooter( false, 0 )) {
+    cerr << "arBinaryDataSaver error: failed to write header of " << _dataFilePath << endl;
+    fclose( _file );
+    _file = NULL;
+    remove( _dataFilePath.c_str() );
+    return false;
+  }
+
+  _front.counts.resize( _columns.size() );
+  _front.values.resize( _columns.size() );
+  _back.counts.resize( _columns.size() );
+  _back.values.resize( _columns.size() );
+  _factors = factors;
+  _dataFields = dataRecords;
+  _running = true;
+  if (!_writer.beginThread( ar_binaryDataSaverTask, this )) {
+    cerr << "arBinaryDataSaver error: failed to start writer thread.\n";
+    _running = false;
+    return false;
+  }
+  _configured = true;
+  return true;
+}
+
+bool arBinaryDataSaver::_append( Buffer& buffer, unsigned int column,
+                                 arExperimentDataField* df ) {
+  if (column >= _columns.size()) {
+    cerr << "arBinaryDataSaver error: too many fields.\n";
+    return false;
+  }
+  const arBinaryDataColumn& c = _columns[column];
+  const char* p = (const char*)df->getAddress();
+  ARint count = p ? df->getSize() : 0;
+  if (c.type == AR_CHAR && count > 0) {
+    // Up to the terminator, like arXMLDataSaver.
+    const char* end = (const char*)memchr( p, 0, count );
+    if (end)
+      count = end - p;
+  }
+  buffer.counts[column].push_back( count );
+  vector<char>& v = buffer.values[column];
+  v.insert( v.end(), p, p + count * arDataTypeSize( c.type ) );
+  return true;
+}
+
+bool arBinaryDataSaver::saveData( arExperimentDataRecord& newFactors,
+                                  arExperimentDataRecord& newDataRecords ) {
+  if (!_configured) {
+    cerr << "arBinaryDataSaver error: attempt to save data before init().\n";
+    return false;
+  }
+  // validate data record names and types (must match EXACTLY)
+  if (newDataRecords.getNumberFields() != _dataFields.getNumberFields()) {
+    cerr << "arBinaryDataSaver error: data records to save do not match template.\n";
+    return false;
+  }
+  if (!_factors.matchNamesTypes( newFactors ) ||
+      !_dataFields.matchNamesTypes( newDataRecords )) {
+    cerr << "arBinaryDataSaver error: saveData() failed.\n";
+    return false;
+  }
+
+  arGuard _(_lock, "arBinaryDataSaver::saveData");
+  if (_failed) {
+    cerr << "arBinaryDataSaver error: failed to write " << _dataFilePath << endl;
+    return false;
+  }
+  unsigned column = 0;
+  arExperimentDataField* df = newFactors.getFirstField();
+  while (!!df) {
+    _append( _front, column++, df );
+    df = newFactors.getNextField();
+  }
+  df = newDataRecords.getFirstField();
+  while (!!df) {
+    _append( _front, column++, df );
+    df = newDataRecords.getNextField();
+  }
+  ++_front.records;
+  ++_recordsSaved;
+  if (_front.records >= _blockRecords) {
+    _writeVar.signal();
+    if (_front.records >= 2*_blockRecords) {
+      // The writer is a whole buffer behind.
+      ++_stalls;
+      while (_front.records >= _blockRecords && _running && !_failed)
+        _writtenVar.wait( _lock );
+    }
+  }
+  return true;
+}
+
+bool arBinaryDataSaver::flush() {
+  arGuard _(_lock, "arBinaryDataSaver::flush");
+  const long target = _recordsSaved;
+  _flushing = true;
+  _writeVar.signal();
+  while (_recordsWritten < target && _running && !_failed)
+    _writtenVar.wait( _lock );
+  return _recordsWritten >= target;
+}
+
+long arBinaryDataSaver::getRecordsWritten() {
+  arGuard _(_lock, "arBinaryDataSaver::getRecordsWritten");
+  return _recordsWritten;
+}
+
+void arBinaryDataSaver::_writeTask() {
+  _lock.lock("arBinaryDataSaver::_writeTask");
+  while (true) {
+    if (_front.records < _blockRecords && !_flushing && !_exit)
+      _writeVar.wait( _lock, _flushInterval );
+    if (_front.records == 0) {
+      _flushing = false;
+      if (_exit)
+        break;
+      continue;
+    }
+    _back.swap( _front );
+    _flushing = false;
+    _writtenVar.signal();
+    _lock.unlock();
+
+    const bool ok = _writeBlock( _back );
+
+    _lock.lock("arBinaryDataSaver::_writeTask");
+    if (ok) {
+      _recordsWritten += _back.records;
+    } else {
+      _failed = true;
+    }
+    _back.clear();
+    _writtenVar.signal();
+    if (_failed)
+      break;
+  }
+  _running = false;
+  _writtenVar.signal();
+  _lock.unlock();
+}
+
+bool arBinaryDataSaver::_writeBlock( const Buffer& buffer ) {
+  // The payload, padded as arBinaryDataReader expects.
+  vector<char> payload;
+  for (unsigned i=0; i<_columns.size(); ++i) {
+    const char* counts = (const char*)&buffer.counts[i][0];
+    payload.insert( payload.end(), counts, counts + buffer.records*sizeof(ARint) );
+    payload.resize( arBinaryDataReader::padding( payload.size() ) );
+    payload.insert( payload.end(), buffer.values[i].begin(), buffer.values[i].end() );
+    payload.resize( arBinaryDataReader::padding( payload.size() ) );
+  }
+  const ARint bytes = ARint(payload.size());
+  const ARint head[4] = { arBinaryDataReader::BLOCK_MARKER, buffer.records, bytes,
+                          arBinaryDataReader::checksum( bytes ? &payload[0] : NULL, bytes ) };
+
+  // Overwrite the footer, and put a new one after this block.
+  if (fseek( _file, _footerOffset, SEEK_SET ) != 0 ||
+      fwrite( head, sizeof(head), 1, _file ) != 1 ||
+      (bytes > 0 && fwrite( &payload[0], 1, bytes, _file ) != unsigned(bytes))) {
+    cerr << "arBinaryDataSaver error: failed to write " << _dataFilePath << endl;
+    return false;
+  }
+  _footerOffset += long(sizeof(head)) + bytes;
+  ++_blocks;
+  return _writeFooter( false, _recordsWritten + buffer.records );
+}
+
+bool arBinaryDataSaver::_writeFooter( bool closed, long records ) {
+  const ARint footer[4] = { arBinaryDataReader::FOOTER_MARKER, _blocks,
+                            ARint(records), closed ? 1 : 0 };
+  if (fseek( _file, _footerOffset, SEEK_SET ) != 0 ||
+      fwrite( footer, sizeof(footer), 1, _file ) != 1 ||
+      fflush( _file ) != 0) {
+    cerr << "arBinaryDataSaver error: failed to write footer of " << _dataFilePath << endl;
+    return false;
+  }
+  return true;
+}
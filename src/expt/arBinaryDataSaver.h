@@ -0,0 +1,87 @@
+#ifndef ARBINARYDATASAVER_H
+#define ARBINARYDATASAVER_H
+
+#include "arDataSaver.h"
+#include "arBinaryDataReader.h"
+#include "arThread.h"
+// THIS MUST BE THE LAST SZG INCLUDE!
+#include "arExperimentCalling.h"
+
+// Saves trials in the columnar binary format of arBinaryDataReader,
+// which converts them to CSV or XML.
+//
+// saveData() only copies the record into the front buffer.  A writer
+// thread swaps that with the back buffer and writes it as one block,
+// when it holds blockRecords records or when it's flushInterval old,
+// so the frame loop never waits for the disk unless the writer falls
+// a whole buffer behind.
+
+class SZG_CALL arBinaryDataSaver : public arDataSaver {
+  public:
+    arBinaryDataSaver( int blockRecords = 256, int flushInterval = 1000 );
+    // Writes what's left and marks the file closed.
+    virtual ~arBinaryDataSaver();
+    virtual bool init( const std::string experimentName,
+                       std::string dataPath, std::string comment,
+                       const arHumanSubject& subjectData,
+                       arExperimentDataRecord& factors,
+                       arExperimentDataRecord& dataRecords,
+                       arSZGClient& SZGClient);
+    virtual bool saveData( arExperimentDataRecord& factors,
+                           arExperimentDataRecord& dataRecords );
+    // Wait until every saved record is on disk.
+    bool flush();
+    long getRecordsWritten();
+    // How often saveData() waited for the writer.
+    long getStalls() const { return _stalls; }
+
+  protected:
+    virtual bool _open( const std::string& experimentName,
+                        const std::string& comment,
+                        const arHumanSubject* subjectData,
+                        arExperimentDataRecord& factors,
+                        arExperimentDataRecord& dataRecords );
+
+  private:
+    // Records not yet written, column by column.
+    struct Buffer {
+      int records;
+      std::vector< std::vector<ARint> > counts;
+      std::vector< std::vector<char> > values;
+      void clear();
+      void swap( Buffer& );
+    };
+
+    friend void ar_binaryDataSaverTask( void* );
+    void _writeTask();
+    bool _writeBlock( const Buffer& buffer );
+    bool _writeFooter( bool closed, long records );
+    bool _append( Buffer& buffer, unsigned int column, arExperimentDataField* df );
+
+    const int _blockRecords;
+    const int _flushInterval;  // msec
+    bool _configured;
+    std::vector<arBinaryDataColumn> _columns;
+    arExperimentDataRecord _factors;
+    arExperimentDataRecord _dataFields;
+
+    FILE* _file;
+    long _footerOffset;
+    int _blocks;
+    long _recordsWritten;
+
+    arLock _lock;  // guards _front, the flags, and the record counts
+    arConditionVar _writeVar;
+    arConditionVar _writtenVar;
+    Buffer _front;
+    Buffer _back;     // only the writer thread touches this
+    long _recordsSaved;
+    bool _flushing;
+    bool _exit;
+    bool _running;
+    bool _failed;
+    long _stalls;
+    arThread _writer;
+};
+
+#endif        //  #ifndefARBINARYDATASAVER_H
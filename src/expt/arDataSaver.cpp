@@ -5,20 +5,115 @@ bool arDataSaver::setFilePath( std::string& dataPath, arSZGClient& szgClient ) {
   ar_pathAddSlash( dataPath );
   stringstream& errStream = szgClient.startResponse();
   string fileRoot = szgClient.getAttribute("SZG_EXPT","file_name");
-  _dataFilePath = dataPath + fileRoot + "_dat." + _fileSuffix;
+  return _setFilePath( dataPath + fileRoot + "_dat." + _fileSuffix, &errStream );
+}
+
+bool arDataSaver::setFilePath( const std::string& filePath ) {
+  return _setFilePath( filePath, NULL );
+}
+
+bool arDataSaver::_setFilePath( const std::string& filePath, ostream* errStream ) {
+  _dataFilePath = filePath;
   cerr << "Set _dataFilePath to '" << _dataFilePath << "'.\n";
   bool isFile, itExists;
   if (!ar_fileExists( _dataFilePath, itExists, isFile )) {
     cerr << "arDataSaver error: file existence check failed for " << _dataFilePath << endl;
-    errStream << "arDataSaver error: file existence check failed for " << _dataFilePath << endl;
+    if (errStream)
+      *errStream << "arDataSaver error: file existence check failed for " << _dataFilePath << endl;
     return false;
   }
   if (itExists) {
     cerr << "arDataSaver error: an item " << _dataFilePath << " already exists.\n";
-    errStream << "arDataSaver error: an item " << _dataFilePath << " already exists.\n";
+    if (errStream)
+      *errStream << "arDataSaver error: an item " << _dataFilePath << " already exists.\n";
     return false;
   }
   return true;
 }
 
+bool arDataSaver::open( const std::string& filePath,
+                        const std::string& experimentName, const std::string& comment,
+                        arExperimentDataRecord& factors,
+                        arExperimentDataRecord& dataRecords ) {
+  return setFilePath( filePath ) &&
+    _open( experimentName, comment, NULL, factors, dataRecords );
+}
+
+bool arDataSaver::_open( const std::string& /*experimentName*/,
+                         const std::string& /*comment*/,
+                         const arHumanSubject* /*subjectData*/,
+                         arExperimentDataRecord& /*factors*/,
+                         arExperimentDataRecord& /*dataRecords*/ ) {
+  cerr << "arDataSaver error: this data saver doesn't support open().\n";
+  return false;
+}
 
+// Field names (or type names) of a record, |-delimited.
+static string ar_fieldList( arExperimentDataRecord& record, bool types ) {
+  string result;
+  arExperimentDataField* df = record.getFirstField();
+  arExperimentDataField* first = df;
+  while (!!df) {
+    if (df != first)
+      result += "|";
+    result += types ? string(arDataTypeName(df->getType())) : df->getName();
+    df = record.getNextField();
+  }
+  return result;
+}
+
+bool arDataSaver::_describe( const std::string& experimentName,
+                             const std::string& comment,
+                             const arHumanSubject* subjectData,
+                             arExperimentDataRecord& factors,
+                             arExperimentDataRecord& dataRecords,
+                             FILE* filePtr ) {
+  // Setup data template for data file header
+  // NOTE: at some point should probably add hooks so user can add optional fields
+  arDataTemplate headerTemplate( "experiment_description" );
+  headerTemplate.addAttribute( "experiment_name", AR_CHAR );
+  headerTemplate.addAttribute( "runtime", AR_CHAR );
+  headerTemplate.addAttribute( "comment", AR_CHAR );
+  
+  // Pass 1: have a separate field in the header with the type of each parameter
+  // (parameter name suffixed with _type)
+//  for (i=dataRecords.begin(); i!=dataRecords.end(); i++)
+//    headerTemplate.addAttribute( i->_name + "_type", AR_CHAR );
+    
+  // Pass 2: have a 4 fields in the header for parameters & data fields.  First field lists names
+  // (separated by |, I think), second lists types (also |-delimited).
+  // Advantage: Header record format doesn't vary from one experiment to the next
+  // (which would require a separate executable to parse each experiment's data),
+  // but header still contains all info needed to parse data records. Also more compact.
+  // Disadvantage: field has to be parsed when data is analysed.
+  headerTemplate.addAttribute( "factor_names", AR_CHAR );
+  headerTemplate.addAttribute( "factor_types", AR_CHAR );    
+  headerTemplate.addAttribute( "data_names", AR_CHAR );
+  headerTemplate.addAttribute( "data_types", AR_CHAR );    
+    
+  arStructuredData headerData( &headerTemplate );
+  headerData.dataInString( "experiment_name", experimentName );
+  headerData.dataInString( "runtime", ar_currentTimeString() );
+  headerData.dataInString( "comment", comment );
+  headerData.dataInString( "factor_names", ar_fieldList( factors, false ) );
+  headerData.dataInString( "factor_types", ar_fieldList( factors, true ) );
+  headerData.dataInString( "data_names", ar_fieldList( dataRecords, false ) );
+  headerData.dataInString( "data_types", ar_fieldList( dataRecords, true ) );
+
+  const arStructuredData* subjectHeader = 0;
+  const arStructuredData* subjectRecord = 0;
+  if (subjectData) {
+    subjectHeader = subjectData->getHeaderRecord();
+    subjectRecord = subjectData->getSubjectRecord();
+    if ((subjectHeader == 0)||(subjectRecord == 0)) {
+      cerr << "arDataSaver error: NULL subject data.\n";
+      return false;
+    }
+  }
+  headerData.print( filePtr );
+  if (subjectData) {
+    subjectHeader->print( filePtr );
+    subjectRecord->print( filePtr );
+  }
+  return true;
+}
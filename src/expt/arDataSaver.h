@@ -27,15 +27,38 @@ class SZG_CALL arDataSaver {
                        arSZGClient& SZGClient)=0;
     virtual bool saveData( arExperimentDataRecord& factors,
                            arExperimentDataRecord& dataRecords )=0;
+    // Like init(), but with neither a Phleet connection nor a subject,
+    // for offline tools and benchmarks.  filePath must not exist yet.
+    bool open( const std::string& filePath,
+               const std::string& experimentName, const std::string& comment,
+               arExperimentDataRecord& factors,
+               arExperimentDataRecord& dataRecords );
     void setFileSuffix( const std::string& fileSuffix ) {
       _fileSuffix = fileSuffix;
     }
     std::string getFileSuffix() const { return _fileSuffix; }
     virtual bool setFilePath( std::string& dataPath, arSZGClient& szgClient );
+    bool setFilePath( const std::string& filePath );
     std::string getFilePath() const { return _dataFilePath; }
    protected:
       std::string _fileSuffix;
       std::string _dataFilePath;
+      // setFilePath(), also reporting failure to errStream if it's not NULL.
+      bool _setFilePath( const std::string& filePath, std::ostream* errStream );
+      // Print the XML header of a data file: the experiment_description
+      // record, then the subject's header and record (if subjectData).
+      bool _describe( const std::string& experimentName,
+                      const std::string& comment,
+                      const arHumanSubject* subjectData,
+                      arExperimentDataRecord& factors,
+                      arExperimentDataRecord& dataRecords,
+                      FILE* filePtr );
+      // Create _dataFilePath and write its header.  subjectData may be NULL.
+      virtual bool _open( const std::string& experimentName,
+                          const std::string& comment,
+                          const arHumanSubject* subjectData,
+                          arExperimentDataRecord& factors,
+                          arExperimentDataRecord& dataRecords );
 };
 
 typedef std::map< std::string,arDataSaver* > arDataSaverMap_t;
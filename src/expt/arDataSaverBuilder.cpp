@@ -4,6 +4,7 @@
 
 // Add header files for new saver types here
 #include "arXMLDataSaver.h"
+#include "arBinaryDataSaver.h"
 #include "arDummyDataSaver.h"
 
 arDataSaver* arDataSaverBuilder::build( const std::string dataStyle ) {
@@ -13,6 +14,12 @@ arDataSaver* arDataSaverBuilder::build( const std::string dataStyle ) {
     if (dataSaver==0)
       cerr << "arDataSaverBuilder error: couldn't create arXMLDataSaver.\n";
     return dataSaver;
+  } else if (dataStyle == "binary") {
+    cerr << "arDataSaverBuilder remark: data_style == " << dataStyle << endl;
+    arDataSaver* dataSaver = (arDataSaver*)new arBinaryDataSaver;
+    if (dataSaver==0)
+      cerr << "arDataSaverBuilder error: couldn't create arBinaryDataSaver.\n";
+    return dataSaver;
   } else if (dataStyle == "none") {
     cerr << "arDataSaverBuilder remark: data_style == " << dataStyle << endl;
     arDataSaver* dataSaver = (arDataSaver*)new arDummyDataSaver;
@@ -21,7 +28,7 @@ arDataSaver* arDataSaverBuilder::build( const std::string dataStyle ) {
     return dataSaver;
   } else {
     cerr << "arDataSaverBuilder error: data_style is not a valid output data type.\n"
-         << "    Valid values are: xml, none\n"
+         << "    Valid values are: xml, binary, none\n"
          << "    That is all.\n";
     return (arDataSaver*)0;
   }
@@ -470,7 +470,7 @@ bool arExperiment::init( arSZGAppFramework* framework, arSZGClient& SZGClient )
     if (saveData == "false") {
       _dataStyle = "none";
     } else {
-      _dataStyle = "xml";
+      _dataStyle = SZGClient.getAttribute("SZG_EXPT", "data_style", "|xml|binary|");
     }
   }
   arDataSaverBuilder dsBuilder;
@@ -53,6 +53,9 @@
 /// SZG_EXPT/method = "enumerated" and SZG_EXPT/data_style = "xml".
 /// If the file prefix is set to e.g. "test", the config file name for this
 /// case should be "test_config.xml" and the data file will be "test_dat.xml"
+/// SZG_EXPT/data_style = "binary" instead writes the compact columnar
+/// "test_dat.bin" from a background thread (see arBinaryDataSaver);
+/// exptconvert turns that into CSV or XML.
 ///
 /// Example: The experiment name (and the executable name) is "expt1" (executable
 /// name is really "expt1.exe" for win32).  SZG_EXPT/subect = "SHMOO".
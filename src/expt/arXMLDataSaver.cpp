@@ -29,81 +29,19 @@ bool arXMLDataSaver::init( const string experimentName,
     errStream << "arXMLDataSaver error: setFilePath() failed.\n";
     return false;
   }
-  
-  // Setup data template for data file header
-  // NOTE: at some point should probably add hooks so user can add optional fields
-  arDataTemplate headerTemplate( "experiment_description" );
-  headerTemplate.addAttribute( "experiment_name", AR_CHAR );
-  headerTemplate.addAttribute( "runtime", AR_CHAR );
-  headerTemplate.addAttribute( "comment", AR_CHAR );
-  
-  // Pass 1: have a separate field in the header with the type of each parameter
-  // (parameter name suffixed with _type)
-//  for (i=dataRecords.begin(); i!=dataRecords.end(); i++)
-//    headerTemplate.addAttribute( i->_name + "_type", AR_CHAR );
-    
-  // Pass 2: have a 4 fields in the header for parameters & data fields.  First field lists names
-  // (separated by |, I think), second lists types (also |-delimited).
-  // Advantage: Header record format doesn't vary from one experiment to the next
-  // (which would require a separate executable to parse each experiment's data),
-  // but header still contains all info needed to parse data records. Also more compact.
-  // Disadvantage: field has to be parsed when data is analysed.
-  headerTemplate.addAttribute( "factor_names", AR_CHAR );
-  headerTemplate.addAttribute( "factor_types", AR_CHAR );    
-  headerTemplate.addAttribute( "data_names", AR_CHAR );
-  headerTemplate.addAttribute( "data_types", AR_CHAR );    
-    
-  // Setup arStructuredData for file header
-  arStructuredData* headerData = new arStructuredData( &headerTemplate );
-  if (!headerData) {
-    cerr << "headerData error: failed to construct header arStructuredData.\n";
+  if (!_open( experimentName, comment, &subjectData, factors, dataRecords )) {
+    errStream << "arXMLDataSaver error: couldn't write data file " << _dataFilePath << endl;
     return false;
   }
-  headerData->dataIn( "experiment_name", (void*)experimentName.c_str(), AR_CHAR, experimentName.size());  
-  string theTime = ar_currentTimeString();
-  headerData->dataIn( "runtime", (void*)theTime.c_str(), AR_CHAR, theTime.size());
-  headerData->dataIn( "comment", (void*)comment.c_str(), AR_CHAR, comment.size());
-  string nameString, typeString;
+  return true;
+}
 
+bool arXMLDataSaver::_open( const string& experimentName,
+                            const string& comment,
+                            const arHumanSubject* subjectData,
+                            arExperimentDataRecord& factors,
+                            arExperimentDataRecord& dataRecords ) {
   arExperimentDataField* df = factors.getFirstField();
-  arExperimentDataField* first = df;
-  while (!!df) {
-    if (df != first) {
-      nameString = nameString + "|"; // add vertical bar deilimiter
-      typeString = typeString + "|";
-    }
-    nameString = nameString + df->getName();
-    typeString = typeString + arDataTypeName(df->getType());
-    df = factors.getNextField();
-  }
-  headerData->dataIn( "factor_names", (void*)nameString.c_str(), AR_CHAR, nameString.size());
-  headerData->dataIn( "factor_types", (void*)typeString.c_str(), AR_CHAR, typeString.size());
-  nameString = "";
-  typeString = "";
-  df = dataRecords.getFirstField();
-  first = df;
-  while (!!df) {
-    if (df != first) {
-      nameString = nameString + "|"; // add vertical bar deilimiter
-      typeString = typeString + "|";
-    }
-    nameString = nameString + df->getName();
-    typeString = typeString + arDataTypeName(df->getType());
-    df = dataRecords.getNextField();
-  }
-  headerData->dataIn( "data_names", (void*)nameString.c_str(), AR_CHAR, nameString.size());
-  headerData->dataIn( "data_types", (void*)typeString.c_str(), AR_CHAR, typeString.size());
-
-  arStructuredData* subjectHeader = const_cast<arStructuredData*>(subjectData.getHeaderRecord());
-  arStructuredData* subjectRecord = const_cast<arStructuredData*>(subjectData.getSubjectRecord());
-  
-  if ((subjectHeader == 0)||(subjectRecord == 0)) {
-    cerr << "arXMLDataSaver error: NULL subject data.\n";
-    delete headerData;
-    return false;
-  }
-  
-  df = factors.getFirstField();
   while (!!df) {
     _template.addAttribute( df->getName(), df->getType() );
     df = factors.getNextField();
@@ -116,21 +54,19 @@ bool arXMLDataSaver::init( const string experimentName,
   _structuredData = new arStructuredData(&_template);
   if (!_structuredData) {
     cerr << "arXMLDataSaver error: failed to construct dataRecord arStructuredData.\n";
-    delete headerData;
     return false;
   }
   
   FILE* filePtr = fopen( _dataFilePath.c_str(), "w" );
   if (filePtr == NULL) {
     cerr << "arXMLDataSaver error: couldn't open data file " << _dataFilePath << endl;
-    errStream << "arXMLDataSaver error: couldn't open data file " << _dataFilePath << endl;
-    delete headerData;
     return false;
   }
-  headerData->print( filePtr );
-  delete headerData;
-  subjectHeader->print( filePtr );
-  subjectRecord->print( filePtr );
+  if (!_describe( experimentName, comment, subjectData, factors, dataRecords, filePtr )) {
+    fclose( filePtr );
+    remove( _dataFilePath.c_str() );
+    return false;
+  }
   fclose( filePtr );
   
   _factors = factors;
@@ -18,6 +18,12 @@ class SZG_CALL arXMLDataSaver : public arDataSaver {
                        arSZGClient& SZGClient);
     virtual bool saveData( arExperimentDataRecord& factors, 
                            arExperimentDataRecord& dataRecords );
+  protected:
+    virtual bool _open( const std::string& experimentName,
+                        const std::string& comment,
+                        const arHumanSubject* subjectData,
+                        arExperimentDataRecord& factors,
+                        arExperimentDataRecord& dataRecords );
   private:
     bool _configured;
     arDataTemplate _template;
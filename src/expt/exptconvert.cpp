@@ -0,0 +1,59 @@
+// Convert a binary data file from arBinaryDataSaver to CSV or XML.
+// The XML is what arXMLDataSaver would have written.  A file whose
+// experiment crashed converts up to its last complete block;
+// -recover also repairs the file itself.
+//
+// Usage: exptconvert [-csv | -xml] [-recover] file_dat.bin [output]
+
+#include "arPrecompiled.h"
+#define SZG_DO_NOT_EXPORT
+
+#include "arBinaryDataReader.h"
+
+#include <iostream>
+#include <string>
+using namespace std;
+
+int main( int argc, char** argv ) {
+  bool xml = false;
+  bool recover = false;
+  int i = 1;
+  for (; i<argc && argv[i][0] == '-'; ++i) {
+    const string flag( argv[i] );
+    if (flag == "-xml") {
+      xml = true;
+    } else if (flag == "-csv") {
+      xml = false;
+    } else if (flag == "-recover") {
+      recover = true;
+    } else {
+      break;
+    }
+  }
+  if (i != argc-1 && i != argc-2) {
+    cerr << "usage: exptconvert [-csv | -xml] [-recover] file_dat.bin [output]\n";
+    return 1;
+  }
+
+  arBinaryDataReader reader;
+  if (!reader.open( argv[i] ))
+    return 1;
+  cerr << "exptconvert remark: " << reader.getNumberRecords() << " records, "
+       << reader.getColumns().size() << " fields, experiment '"
+       << reader.getExperimentName() << "'.\n";
+  if (recover && !reader.complete() && !reader.recover())
+    return 1;
+
+  FILE* output = stdout;
+  if (i == argc-2) {
+    output = fopen( argv[i+1], "w" );
+    if (!output) {
+      cerr << "exptconvert error: couldn't write " << argv[i+1] << endl;
+      return 1;
+    }
+  }
+  const bool ok = xml ? reader.writeXML( output ) : reader.writeCSV( output );
+  if (output != stdout)
+    fclose( output );
+  return ok ? 0 : 1;
+}
@@ -55,6 +55,12 @@ LDie:
       f->getDatabase()->printStructure();
     }
 
+    else if (messageType=="timing") {
+      f->_SZGClient.messageResponse(messageID,
+        f->_graphicsServer._syncServer.handleTimingMessage(messageBody));
+      continue;
+    }
+
     else if ( messageType == "input" ) {
       if ( messageBody == "on" ) {
         f->_SZGClient.messageResponse( messageID, f->getLabel()+" resuming input." );
@@ -267,6 +267,8 @@ arMasterSlaveFramework::arMasterSlaveFramework( void ):
   _lastFrameTime( 0.005 ),
   _lastComputeTime( 10 ),
   _lastSyncTime( 10 ),
+  _lastExchangeTime( 0 ),
+  _frameNumber( 0 ),
   _firstTimePoll( true ),
 
   // Random numbers.
@@ -740,10 +742,12 @@ void arMasterSlaveFramework::preDraw( void ) {
   }
 
   if ( !_standalone ) {
+    const ar_timeval exchangeStart = ar_time();
     if ( !( getMaster() ? _sendData() : _getData() ) ) {
       _lastComputeTime = ar_difftime( ar_time(), preDrawStart );
       return;
     }
+    _lastExchangeTime = ar_difftime( ar_time(), exchangeStart );
   }
 
   onPlay();
@@ -770,7 +774,8 @@ void arMasterSlaveFramework::preDraw( void ) {
     _framerateGraph.getElement( "sync usec" )->pushNewValue(_lastSyncTime);
 
   // Get performance metrics.
-  _lastComputeTime = ar_difftime( ar_time(), preDrawStart );
+  _drawStartTime = ar_time();
+  _lastComputeTime = ar_difftime( _drawStartTime, preDrawStart );
 }
 
 // Public, so apps can make custom event loops.
@@ -790,6 +795,11 @@ void arMasterSlaveFramework::postDraw( void ) {
     return;
 
   const ar_timeval postDrawStart = ar_time();
+  if ( !getMaster() ) {
+    // Report this frame's timings to the master's barrier telemetry.
+    _barrierClient->setTuningData( int(ar_difftime( postDrawStart, _drawStartTime )),
+      int(_lastExchangeTime), int(_lastComputeTime - _lastExchangeTime), _frameNumber++ );
+  }
   if ( _framerateThrottle ) {
     // Test sync.
     ar_usleep( 200000 );
@@ -2279,6 +2289,12 @@ void arMasterSlaveFramework::_messageTask( void ) {
       _SZGClient.messageResponse( messageID,
         getLabel() + (_showPerformance ? " show" : " hid") + "ing performance graph" );
     }
+    else if ( messageType == "timing" ) {
+      // Only the master's barrier hears every slave.
+      _SZGClient.messageResponse( messageID, ( getMaster() && _barrierServer ) ?
+        ar_barrierTelemetryHandleMessage( _barrierServer->getTelemetry(), messageBody ) :
+        getLabel()+" is not the master; send timing to the master." );
+    }
     else if ( messageType == "reload" ) {
       _requestReloadMsg = messageID;
     }
@@ -356,6 +356,9 @@ class SZG_CALL arMasterSlaveFramework : public arSZGAppFramework {
   double     _lastFrameTime; // msec
   double     _lastComputeTime; // usec
   double     _lastSyncTime; // usec
+  double     _lastExchangeTime; // usec, sending or receiving transfer data
+  ar_timeval _drawStartTime;
+  int        _frameNumber;
   bool       _firstTimePoll;
 
   // Shared random number functions, as might be used in predetermined harmony mode.
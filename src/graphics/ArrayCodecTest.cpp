@@ -0,0 +1,215 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+// Benchmark packed geometry arrays (arGraphicsArrayCodec.h) without a
+// szgserver.  A deforming grid's points, normals, colors and texture
+// coordinates go from one arGraphicsDatabase to another, as floats,
+// quantized, and quantized with deltas;  reports bytes per frame and
+// encode and decode time, and checks each attribute's error.  Then a
+// receiver that misses a frame must skip deltas until the next key frame.
+//
+// Usage: ArrayCodecTest [vertices [frames]]
+
+#include "arPrecompiled.h"
+#define SZG_DO_NOT_EXPORT
+
+#include "arGraphicsDatabase.h"
+#include "arGraphicsArrayCodec.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+static int side = 100;
+
+// The grid at frame f.
+static void makeFrame(int f, vector<float>& points, vector<float>& normals,
+                      vector<float>& colors, vector<float>& tex) {
+  const float t = f / 60.f;
+  const float h = 1.f / side;
+  for (int i=0; i<side; ++i) {
+    for (int j=0; j<side; ++j) {
+      const int k = i*side + j;
+      const float a = i*.3f + t;
+      const float b = j*.2f - t*.7f;
+      points[3*k] = i*h;
+      points[3*k+1] = j*h;
+      points[3*k+2] = .05f * sin(a) * cos(b);
+      const arVector3 n(arVector3(-.05f * .3f/h * cos(a) * cos(b),
+                                  .05f * .2f/h * sin(a) * sin(b), 1.).normalize());
+      n.get(&normals[3*k]);
+      colors[4*k] = float(i) / side;
+      colors[4*k+1] = float(j) / side;
+      colors[4*k+2] = .5f + .5f * sin(t + i*.01f);
+      colors[4*k+3] = 1.f;
+      tex[2*k] = float(i) / (side-1);
+      tex[2*k+1] = float(j) / (side-1);
+    }
+  }
+}
+
+// Points, normals, colors and texture coordinates, with the same IDs
+// in every database.
+static void makeNodes(arGraphicsDatabase& g, arGraphicsArrayNode* nodes[4]) {
+  const char* types[4] = { "points", "normal3", "color4", "tex2" };
+  arDatabaseNode* parent = g.getRoot();
+  for (int i=0; i<4; ++i)
+    parent = nodes[i] = (arGraphicsArrayNode*)g.newNode(parent, types[i]);
+}
+
+struct Errors {
+  Errors() : points(0.), normals(0.), colors(0.), tex(0.) {}
+  float points;
+  float normals;  // radians
+  float colors;
+  float tex;
+};
+
+static const float* values(arGraphicsArrayNode* node, arStructuredData*& r) {
+  r = node->dumpData();
+  // Each array record's fields are its ID, element IDs, and data.
+  return (const float*)r->getDataPtr(2, AR_FLOAT);
+}
+
+static void measure(arGraphicsArrayNode* nodes[4], const vector<float>* want,
+                    Errors& e) {
+  arStructuredData* r;
+  const float* v = values(nodes[0], r);
+  for (unsigned i=0; i<want[0].size(); ++i)
+    e.points = max(e.points, float(fabs(v[i] - want[0][i])));
+  delete r;
+  v = values(nodes[1], r);
+  for (unsigned i=0; i<want[1].size(); i+=3) {
+    const arVector3 a(v + i);
+    const arVector3 b(&want[1][i]);
+    e.normals = max(e.normals, float(atan2(++(a * b), a % b)));
+  }
+  delete r;
+  v = values(nodes[2], r);
+  for (unsigned i=0; i<want[2].size(); ++i)
+    e.colors = max(e.colors, float(fabs(v[i] - want[2][i])));
+  delete r;
+  v = values(nodes[3], r);
+  for (unsigned i=0; i<want[3].size(); ++i)
+    e.tex = max(e.tex, float(fabs(v[i] - want[3][i])));
+  delete r;
+}
+
+static bool same(arGraphicsArrayNode* a, arGraphicsArrayNode* b) {
+  arStructuredData* ra;
+  arStructuredData* rb;
+  const float* va = values(a, ra);
+  const float* vb = values(b, rb);
+  const bool ok = ra->getDataDimension(2) == rb->getDataDimension(2) &&
+    !memcmp(va, vb, ra->getDataDimension(2) * sizeof(float));
+  delete ra;
+  delete rb;
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  const int cVertex = argc > 1 ? atoi(argv[1]) : 10000;
+  const int cFrame = argc > 2 ? atoi(argv[2]) : 300;
+  side = int(sqrt(double(cVertex)));
+  if (side < 2 || cFrame < 2) {
+    ar_log_error() << "usage: ArrayCodecTest [vertices [frames]]\n";
+    return 1;
+  }
+  const int n = side * side;
+  vector<float> want[4];
+  want[0].resize(3*n);
+  want[1].resize(3*n);
+  want[2].resize(4*n);
+  want[3].resize(2*n);
+  arGraphicsLanguage lang;
+  bool ok = true;
+
+  const char* names[3] = { "floats", "quantized", "quantized, delta" };
+  const int encodings[3] = { 0, AR_PACK_ALL & ~AR_PACK_DELTA, AR_PACK_ALL };
+  double bytes[3];
+  printf("%d vertices, %d frames:\n", n, cFrame);
+  for (int c=0; c<3; ++c) {
+    arGraphicsDatabase source, received;
+    arGraphicsArrayNode* from[4];
+    arGraphicsArrayNode* to[4];
+    makeNodes(source, from);
+    makeNodes(received, to);
+    arGraphicsArrayEncoder encoder;
+    encoder.setEncoding(encodings[c]);
+    double usecEncode = 0., usecDecode = 0.;
+    bytes[c] = 0.;
+    Errors e;
+    for (int f=0; f<cFrame; ++f) {
+      makeFrame(f, want[0], want[1], want[2], want[3]);
+      ((arPointsNode*)from[0])->setPoints(n, &want[0][0]);
+      ((arNormal3Node*)from[1])->setNormal3(n, &want[1][0]);
+      ((arColor4Node*)from[2])->setColor4(n, &want[2][0]);
+      ((arTex2Node*)from[3])->setTex2(n, &want[3][0]);
+      for (int i=0; i<4; ++i) {
+        arStructuredData* r = from[i]->dumpData();
+        ar_timeval start = ar_time();
+        arStructuredData* packed = encoder.encode(lang, r);
+        usecEncode += ar_difftime(ar_time(), start);
+        arStructuredData* sent = packed ? packed : r;
+        bytes[c] += sent->size();
+        start = ar_time();
+        if (!received.alter(sent))
+          ok = false;
+        usecDecode += ar_difftime(ar_time(), start);
+        delete r;
+      }
+      if (f % 10 == 0 || f == cFrame-1)
+        measure(to, want, e);
+    }
+    printf("  %-16s %9.0f bytes/frame (%5.1f%%), encode %7.1f usec, decode %7.1f usec "
+           "(%.1f Mvertices/sec)\n", names[c], bytes[c] / cFrame, 100. * bytes[c] / bytes[0],
+           usecEncode / cFrame, usecDecode / cFrame, n * cFrame / usecDecode);
+    printf("  %16s errors: points %.2g, normals %.2g rad, colors %.2g, tex %.2g\n",
+           "", e.points, e.normals, e.colors, e.tex);
+    // One step of a padded box;  half an 8-bit step.
+    const float step = 1.25f * sqrt(2.f) / 65535.f;
+    if (e.points > step || e.normals > 2e-4f || e.colors > .5f/255.f + 1e-6f ||
+        e.tex > step) {
+      ar_log_error() << "ArrayCodecTest: " << names[c] << " too lossy.\n";
+      ok = false;
+    }
+  }
+
+  // A receiver that misses a delta keeps its old values until a key frame.
+  arGraphicsDatabase source, complete, late;
+  arGraphicsArrayNode* from[4];
+  arGraphicsArrayNode* toComplete[4];
+  arGraphicsArrayNode* toLate[4];
+  makeNodes(source, from);
+  makeNodes(complete, toComplete);
+  makeNodes(late, toLate);
+  arGraphicsArrayEncoder encoder;
+  encoder.setEncoding(AR_PACK_ALL);
+  const int keyInterval = 10;
+  encoder.setKeyInterval(keyInterval);
+  const int missed = 3;
+  for (int f=0; f<=keyInterval+1; ++f) {
+    makeFrame(f, want[0], want[1], want[2], want[3]);
+    ((arPointsNode*)from[0])->setPoints(n, &want[0][0]);
+    arStructuredData* r = from[0]->dumpData();
+    arStructuredData* packed = encoder.encode(lang, r);
+    complete.alter(packed);
+    if (f != missed)
+      late.alter(packed);
+    delete r;
+    const bool match = same(toComplete[0], toLate[0]);
+    if (match != (f < missed || f > keyInterval)) {
+      ar_log_error() << "ArrayCodecTest: late receiver " <<
+        (match ? "matched" : "differed") << " at frame " << f << ".\n";
+      ok = false;
+    }
+  }
+  printf("  a receiver missing frame %d recovered at the key frame after %d.\n",
+         missed, keyInterval);
+
+  printf(ok ? "ArrayCodecTest passed.\n" : "ArrayCodecTest FAILED.\n");
+  return ok ? 0 : 1;
+}
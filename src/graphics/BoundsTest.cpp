@@ -0,0 +1,312 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+// Test arGraphicsDatabase's automatic bounds without a window or a
+// szgserver.  On a random scene graph of transforms, points, drawables
+// and instances, every transform's bounds must contain the points drawn
+// below it (and equal them, when transforms only translate).  Changing
+// a transform or some points must recompute only the path above it.
+// Then picking and arViewportCull, with and without the bounds, must
+// agree.
+//
+// Usage: BoundsTest [nodes [changes]]
+
+#include "arPrecompiled.h"
+#define SZG_DO_NOT_EXPORT
+
+#include "arGraphicsDatabase.h"
+#include "arViewportCull.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+
+#include <stdlib.h>
+
+static float frand(float lo, float hi) {
+  return lo + (hi - lo) * (rand() / float(RAND_MAX));
+}
+
+static bool fRotate = false;
+static arMatrix4 randomMatrix(float size) {
+  const arMatrix4 t(ar_translationMatrix(frand(-size, size), frand(-size, size),
+                                         frand(-size, size)));
+  return fRotate ? t * ar_rotationMatrix(arVector3(frand(-1, 1), frand(-1, 1), 1),
+                                         frand(0, 6)) : t;
+}
+
+static vector<arTransformNode*> transforms;
+static vector<arPointsNode*> pointNodes;
+
+static arPointsNode* makeTriangles(arGraphicsDatabase& g, arDatabaseNode* parent) {
+  const int cTriangle = 1 + rand() % 4;
+  vector<float> points(9 * cTriangle);
+  for (unsigned i=0; i<points.size(); ++i)
+    points[i] = frand(-1, 1);
+  arPointsNode* p = (arPointsNode*)g.newNode(parent, "points");
+  p->setPoints(3 * cTriangle, &points[0]);
+  arDrawableNode* d = (arDrawableNode*)g.newNode(p, "drawable");
+  d->setDrawable(DG_TRIANGLES, cTriangle);
+  pointNodes.push_back(p);
+  return p;
+}
+
+// Transforms over points and their drawables;  sometimes an instance
+// node, or a drawable below a transform below its points.
+static int cNode = 0;
+static void makeSubtree(arGraphicsDatabase& g, arDatabaseNode* parent,
+                        int depth, int target) {
+  while (cNode < target) {
+    arTransformNode* t = (arTransformNode*)g.newNode(parent, "transform");
+    t->setTransform(randomMatrix(8. / (depth+1)));
+    transforms.push_back(t);
+    arDatabaseNode* below = t;
+    cNode += 1;
+    if (rand() % 10 == 0) {
+      arInstanceNode* instance = (arInstanceNode*)g.newNode(t, "instance");
+      float matrices[3*16];
+      for (int i=0; i<3; ++i)
+        memcpy(matrices + 16*i, randomMatrix(3.).v, sizeof(arMatrix4));
+      instance->setInstances(3, (const float*)matrices);
+      below = instance;
+      cNode += 1;
+    }
+    arPointsNode* p = makeTriangles(g, below);
+    cNode += 2;
+    if (rand() % 8 == 0) {
+      arTransformNode* t2 = (arTransformNode*)g.newNode(p, "transform");
+      t2->setTransform(randomMatrix(2.));
+      transforms.push_back(t2);
+      arDrawableNode* d = (arDrawableNode*)g.newNode(t2, "drawable");
+      d->setDrawable(DG_TRIANGLES, 1);
+      cNode += 2;
+    }
+    if (depth < 6 && rand() % 3)
+      makeSubtree(g, p, depth+1, cNode + 4 * (1 + rand() % 20));
+    if (depth > 0 && rand() % 4 == 0)
+      return;
+  }
+}
+
+// By brute force, the box around every point drawn below node's
+// children, in their frame m (and, if all, each point).
+// Drawables draw the nearest points above.
+static void truth(arDatabaseNode* node, const arMatrix4& m, arPointsNode* points,
+                  arGraphicsBounds& box, vector<arVector3>* all = NULL) {
+  const list<arDatabaseNode*> children = node->getChildren();
+  for (list<arDatabaseNode*>::const_iterator i = children.begin(); i != children.end(); ++i) {
+    arDatabaseNode* child = *i;
+    const int code = child->getTypeCode();
+    if (code == AR_G_DRAWABLE_NODE && points) {
+      const vector<arVector3> p(points->getPoints());
+      for (unsigned j=0; j<p.size(); ++j) {
+        box.add(m * p[j]);
+        if (all)
+          all->push_back(m * p[j]);
+      }
+    }
+    else if (code == AR_G_POINTS_NODE) {
+      truth(child, m, (arPointsNode*)child, box, all);
+    }
+    else if (code == AR_G_TRANSFORM_NODE) {
+      truth(child, m * ((arTransformNode*)child)->getTransform(), points, box, all);
+    }
+    else if (code == AR_G_INSTANCE_NODE) {
+      const vector<arMatrix4> instances(((arInstanceNode*)child)->getMatrices());
+      for (unsigned j=0; j<instances.size(); ++j)
+        truth(child, m * instances[j], points, box, all);
+    }
+    else {
+      truth(child, m, points, box, all);
+    }
+  }
+}
+
+// Check every transform's bounds against truth().  If exact, they must match.
+static bool checkBounds(arGraphicsDatabase& g, bool exact, int& cBounded) {
+  cBounded = 0;
+  for (unsigned i=0; i<transforms.size(); ++i) {
+    arVector3 lo, hi;
+    if (!g.getBounds(transforms[i], lo, hi))
+      continue;
+    ++cBounded;
+    arGraphicsBounds box;
+    truth(transforms[i], ar_identityMatrix(), NULL, box);
+    if (!(box.flags & arGraphicsBounds::BOX))
+      continue;
+    for (int k=0; k<3; ++k) {
+      const float slack = 1e-4 * (1. + fabs(box.min.v[k]) + fabs(box.max.v[k]));
+      if (lo.v[k] > box.min.v[k] + slack || hi.v[k] < box.max.v[k] - slack ||
+          (exact && (lo.v[k] < box.min.v[k] - slack || hi.v[k] > box.max.v[k] + slack))) {
+        ar_log_error() << "BoundsTest: wrong bounds for node " <<
+          transforms[i]->getID() << ".\n";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Each pick, without and with the bounds.
+static bool checkPicks(arGraphicsDatabase& g, int cRay, double& usecOff, double& usecOn) {
+  bool ok = true;
+  usecOff = usecOn = 0.;
+  for (int i=0; i<cRay; ++i) {
+    const arVector3 origin(frand(-10, 10), frand(-10, 10), 40.);
+    const arRay ray(origin, arVector3(frand(-.2, .2), frand(-.2, .2), -1.));
+    g.setAutoBounds(false);
+    ar_timeval start = ar_time();
+    arGraphicsNode* off = g.intersectGeometry(ray);
+    usecOff += ar_difftime(ar_time(), start);
+    g.setAutoBounds(true);
+    start = ar_time();
+    arGraphicsNode* on = g.intersectGeometry(ray);
+    usecOn += ar_difftime(ar_time(), start);
+    if (on != off) {
+      ar_log_error() << "BoundsTest: bounds changed a pick.\n";
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+// Nothing culled may have a point inside the frustum.
+static bool checkCull(arDatabaseNode* node, const arMatrix4& m,
+                      const arViewportCull& cull, const arFrustumPlanes& planes,
+                      int& cCulled) {
+  const list<arDatabaseNode*> children = node->getChildren();
+  for (list<arDatabaseNode*>::const_iterator i = children.begin(); i != children.end(); ++i) {
+    arDatabaseNode* child = *i;
+    if (child->getTypeCode() != AR_G_TRANSFORM_NODE) {
+      if (child->getTypeCode() != AR_G_INSTANCE_NODE &&
+          !checkCull(child, m, cull, planes, cCulled))
+        return false;
+      continue;
+    }
+    const arMatrix4 childModel(m * ((arTransformNode*)child)->getTransform());
+    if (cull.visible(child->getID(), 0) == 0) {
+      ++cCulled;
+      arPointsNode* points = NULL;
+      for (arDatabaseNode* p = node; p && !points; p = p->getParent())
+        if (p->getTypeCode() == AR_G_POINTS_NODE)
+          points = (arPointsNode*)p;
+      arGraphicsBounds box;
+      vector<arVector3> all;
+      truth(child, childModel, points, box, &all);
+      for (unsigned j=0; j<all.size(); ++j) {
+        if (arBoundingSphere(all[j], 0.).intersectViewFrustum(planes)) {
+          ar_log_error() << "BoundsTest: culled visible node " << child->getID() << ".\n";
+          return false;
+        }
+      }
+      continue;
+    }
+    if (!checkCull(child, childModel, cull, planes, cCulled))
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  const int target = argc > 1 ? atoi(argv[1]) : 100000;
+  const int cChange = argc > 2 ? atoi(argv[2]) : 1000;
+  bool ok = true;
+
+  // Correctness, on small scenes.
+  for (int pass=0; pass<2; ++pass) {
+    fRotate = pass == 1;
+    arGraphicsDatabase g;
+    transforms.clear();
+    pointNodes.clear();
+    cNode = 0;
+    srand(pass + 1);
+    makeSubtree(g, g.getRoot(), 0, 2000);
+    int cBounded = 0;
+    ok &= checkBounds(g, !fRotate, cBounded);
+    for (int i=0; i<50; ++i) {
+      transforms[rand() % transforms.size()]->setTransform(randomMatrix(4.));
+      arPointsNode* p = pointNodes[rand() % pointNodes.size()];
+      vector<arVector3> points(p->getPoints());
+      points[0] = arVector3(frand(-3, 3), frand(-3, 3), frand(-3, 3));
+      p->setPoints(points);
+    }
+    ok &= checkBounds(g, !fRotate, cBounded);
+    g.newNode(transforms[0], "billboard");
+    arVector3 lo, hi;
+    if (g.getBounds(transforms[0], lo, hi)) {
+      ar_log_error() << "BoundsTest: billboard bounded.\n";
+      ok = false;
+    }
+    cout << "BoundsTest: " << cNode << " nodes, " << (fRotate ? "rotated" : "translated") <<
+      ", " << cBounded << " of " << transforms.size() << " transforms bounded.\n";
+  }
+
+  // Cost.
+  fRotate = true;
+  arGraphicsDatabase g;
+  transforms.clear();
+  pointNodes.clear();
+  cNode = 0;
+  srand(3);
+  makeSubtree(g, g.getRoot(), 0, target);
+  arVector3 lo, hi;
+  (void)g.getBoundsRecomputed();
+  ar_timeval start = ar_time();
+  g.getBounds(g.getRoot(), lo, hi);
+  const double usecAll = ar_difftime(ar_time(), start);
+  const int cAll = g.getBoundsRecomputed();
+
+  start = ar_time();
+  for (int i=0; i<cChange; ++i)
+    g.getBounds(g.getRoot(), lo, hi);
+  const double usecSteady = ar_difftime(ar_time(), start) / cChange;
+  const int cSteady = g.getBoundsRecomputed();
+
+  double usecTransform = 0.;
+  for (int i=0; i<cChange; ++i) {
+    transforms[rand() % transforms.size()]->setTransform(randomMatrix(4.));
+    start = ar_time();
+    g.getBounds(g.getRoot(), lo, hi);
+    usecTransform += ar_difftime(ar_time(), start);
+  }
+  const int cTransform = g.getBoundsRecomputed();
+
+  double usecPoints = 0.;
+  for (int i=0; i<cChange; ++i) {
+    arPointsNode* p = pointNodes[rand() % pointNodes.size()];
+    vector<arVector3> points(p->getPoints());
+    points[0] = arVector3(frand(-1, 1), frand(-1, 1), frand(-1, 1));
+    p->setPoints(points);
+    start = ar_time();
+    g.getBounds(g.getRoot(), lo, hi);
+    usecPoints += ar_difftime(ar_time(), start);
+  }
+  const int cPoints = g.getBoundsRecomputed();
+
+  cout << "  " << cNode << " nodes:  all bounds " << usecAll / 1000. << " msec (" <<
+    cAll << " nodes),\n  unchanged " << usecSteady << " usec (" << cSteady <<
+    " nodes),\n  after a transform changes " << usecTransform / cChange << " usec (" <<
+    double(cTransform) / cChange << " nodes),\n  after points change " <<
+    usecPoints / cChange << " usec (" << double(cPoints) / cChange << " nodes).\n";
+  if (cSteady != 0 || cAll < int(transforms.size()) ||
+      cTransform > cChange * 20 || cPoints > cChange * 20) {
+    ar_log_error() << "BoundsTest: recomputed too much.\n";
+    ok = false;
+  }
+
+  double usecOff = 0., usecOn = 0.;
+  ok &= checkPicks(g, 20, usecOff, usecOn);
+  cout << "  pick: " << usecOff / 20. << " usec per ray without bounds, " <<
+    usecOn / 20. << " usec with.\n";
+
+  const arMatrix4 view(ar_translationMatrix(0, 0, -20));
+  vector<arMatrix4> clip(1, ar_frustumMatrix(1., .2, .2, .1, 100., arVector3(0, 0, 0)) * view);
+  arViewportCull cull;
+  cull.cull(g.getRoot(), clip, true);
+  int cCulled = 0;
+  ok &= checkCull(g.getRoot(), ar_identityMatrix(), cull, arFrustumPlanes(clip[0]), cCulled);
+  cout << "  " << cCulled << " subtrees culled.  " << cull.status();
+
+  printf(ok ? "BoundsTest passed.\n" : "BoundsTest FAILED.\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+// Benchmark arGraphicsCommandBuffer without a szgserver:  1 to 8 threads
+// each build and then animate their own subtree of transforms in an
+// arGraphicsDatabase, either with dg* calls serialized by a lock (as an
+// app must, since dg* calls share one record per type) or with one
+// command buffer per thread, submitted once per frame.
+// Both must leave every transform at its last frame's matrix.
+//
+// Usage: CommandBufferTest [max threads [transforms per thread [frames]]]
+
+#include "arPrecompiled.h"
+#define SZG_DO_NOT_EXPORT
+
+#include "arGraphicsDatabase.h"
+#include "arGraphicsAPI.h"
+#include "arGraphicsCommandBuffer.h"
+#include "arTransformNode.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+#include "arThread.h"
+
+#include <stdlib.h>
+
+static arLock dgLock("CommandBufferTest");
+static int cTransform = 200;
+static int cFrame = 100;
+
+static arMatrix4 pose(int thread, int i, int frame) {
+  return ar_translationMatrix(thread, i, frame) *
+    ar_rotationMatrix('y', .01 * (i + frame));
+}
+
+struct Worker {
+  int thread;
+  bool buffered;
+  vector<int> IDs;
+  arSignalObject done;
+};
+
+static void work(void* p) {
+  Worker& w = *(Worker*)p;
+  const string prefix("thread" + ar_intToString(w.thread));
+  arGraphicsCommandBuffer buffer;
+  int i;
+
+  // Build the subtree.
+  if (w.buffered) {
+    buffer.begin();
+    const int root = dgTransform(prefix, "root", ar_identityMatrix());
+    for (i=0; i<cTransform; ++i)
+      w.IDs.push_back(dgTransform(prefix + "." + ar_intToString(i),
+                                  prefix, ar_identityMatrix()));
+    buffer.end();
+    if (root < 0 || !buffer.submit())
+      w.IDs.clear();
+  } else {
+    arGuard _(dgLock, "CommandBufferTest build");
+    dgTransform(prefix, "root", ar_identityMatrix());
+    for (i=0; i<cTransform; ++i)
+      w.IDs.push_back(dgTransform(prefix + "." + ar_intToString(i),
+                                  prefix, ar_identityMatrix()));
+  }
+
+  // Animate it.
+  for (int frame=0; frame<cFrame && !w.IDs.empty(); ++frame) {
+    if (w.buffered) {
+      buffer.begin();
+      for (i=0; i<cTransform; ++i)
+        dgTransform(w.IDs[i], pose(w.thread, i, frame));
+      buffer.end();
+      buffer.submit();
+    } else {
+      for (i=0; i<cTransform; ++i) {
+        arGuard _(dgLock, "CommandBufferTest frame");
+        dgTransform(w.IDs[i], pose(w.thread, i, frame));
+      }
+    }
+  }
+  w.done.sendSignal();
+}
+
+// Returns msec, or -1 if the scene graph is wrong.
+static double run(int cThread, bool buffered) {
+  arGraphicsDatabase database;
+  dgSetGraphicsDatabase(&database);
+  vector<Worker> workers(cThread);
+  int t;
+  const ar_timeval start = ar_time();
+  for (t=0; t<cThread; ++t) {
+    workers[t].thread = t;
+    workers[t].buffered = buffered;
+    arThread dummy(work, &workers[t]);
+  }
+  for (t=0; t<cThread; ++t)
+    workers[t].done.receiveSignal();
+  const double msec = ar_difftime(ar_time(), start) / 1000.;
+
+  for (t=0; t<cThread; ++t) {
+    const string prefix("thread" + ar_intToString(t));
+    if (int(workers[t].IDs.size()) != cTransform)
+      return -1.;
+    for (int i=0; i<cTransform; ++i) {
+      arTransformNode* node = (arTransformNode*)database.getNode(workers[t].IDs[i], false);
+      if (!node || node->getName() != prefix + "." + ar_intToString(i) ||
+          database.getParentRef(node)->getName() != prefix ||
+          !(node->getTransform() == pose(t, i, cFrame-1))) {
+        ar_log_error() << "CommandBufferTest: wrong node " << workers[t].IDs[i] << ".\n";
+        return -1.;
+      }
+    }
+  }
+  return msec;
+}
+
+int main(int argc, char** argv) {
+  const int cThreadMax = argc > 1 ? atoi(argv[1]) : 8;
+  if (argc > 2)
+    cTransform = atoi(argv[2]);
+  if (argc > 3)
+    cFrame = atoi(argv[3]);
+  if (cThreadMax < 1 || cTransform < 1 || cFrame < 1) {
+    ar_log_error() << "usage: CommandBufferTest [max threads [transforms per thread [frames]]]\n";
+    return 1;
+  }
+
+  cout << "CommandBufferTest: " << cTransform << " transforms per thread, "
+       << cFrame << " frames.\n";
+  bool ok = true;
+  for (int cThread=1; cThread<=cThreadMax; cThread*=2) {
+    const double locked = run(cThread, false);
+    const double buffered = run(cThread, true);
+    if (locked < 0. || buffered < 0.) {
+      ok = false;
+      continue;
+    }
+    const double updates = double(cThread) * cTransform * cFrame;
+    cout << "  " << cThread << " threads:  locked dg* " << locked << " msec ("
+         << updates / locked << " updates/msec), buffered " << buffered
+         << " msec (" << updates / buffered << " updates/msec).\n";
+  }
+  if (!ok)
+    ar_log_error() << "CommandBufferTest failed.\n";
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,260 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+// Benchmark arInstanceNode against the same copies as separate subtrees
+// (transform, material, points, normals, drawable), without a szgserver:
+// the bytes a server sends for the whole scene and for moving every copy,
+// and the cost of applying that update.  With a display, also the cost
+// of drawing a frame:  subtrees, instances in a loop, and instances with
+// hardware instancing.  All three images must match.
+//
+// Usage: InstanceTest [copies [frames]]
+
+#include "arPrecompiled.h"
+#define SZG_DO_NOT_EXPORT
+
+#include "arGraphicsDatabase.h"
+#include "arGraphicsAPI.h"
+#include "arGraphicsUtilities.h"
+#include "arGUIWindowManager.h"
+#include "arGUIWindow.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// A unit sphere, as independent triangles with normals.
+static void makeSphere(vector<float>& points) {
+  const int cLat = 12;
+  const int cLong = 16;
+  for (int i=0; i<cLat; ++i) {
+    for (int j=0; j<cLong; ++j) {
+      arVector3 v[4];
+      for (int k=0; k<4; ++k) {
+        const float lat = M_PI * ((i + k/2) / float(cLat) - .5);
+        const float lon = 2 * M_PI * (j + (k==1 || k==2)) / cLong;
+        v[k] = arVector3(cos(lat)*cos(lon), sin(lat), cos(lat)*sin(lon));
+      }
+      const int tris[6] = { 0, 1, 2, 0, 2, 3 };
+      for (int t=0; t<6; ++t)
+        for (int c=0; c<3; ++c)
+          points.push_back(v[tris[t]].v[c]);
+    }
+  }
+}
+
+// Where copy i is, at time t.
+static arMatrix4 placement(int i, int copies, float t) {
+  const int side = int(ceil(sqrt(float(copies))));
+  return ar_translationMatrix(2.5 * (i % side - side/2.), 2.5 * (i / side - side/2.),
+                              -2.5 * side) *
+    ar_rotationMatrix('y', t + .3*i) * ar_scaleMatrix(.8);
+}
+
+static arVector4 color(int i) {
+  return arVector4(i%3 == 0 ? 1. : .3, i%3 == 1 ? 1. : .3, i%3 == 2 ? 1. : .3, 1.);
+}
+
+// Bytes a server sends a new client for node and the nodes below it:
+// a "make node" record and the node's own record each.
+static int wireBytes(arGraphicsDatabase& g, arDatabaseNode* node,
+                     arStructuredData& makeNode) {
+  int bytes = 0;
+  if (g.fillNodeData(&makeNode, node)) {
+    bytes += makeNode.size();
+    arStructuredData* r = node->dumpData();
+    if (r) {
+      bytes += r->size();
+      delete r;
+    }
+  }
+  const list<arDatabaseNode*> children(node->getChildren());
+  for (list<arDatabaseNode*>::const_iterator i = children.begin();
+       i != children.end(); ++i)
+    bytes += wireBytes(g, *i, makeNode);
+  return bytes;
+}
+
+static arGraphicsDatabase subtrees;
+static arGraphicsDatabase instanced;
+static vector<int> transformIDs;
+static int instanceID = -1;
+
+static void makeScenes(int copies) {
+  vector<float> sphere;
+  makeSphere(sphere);
+  const int cTri = sphere.size() / 9;
+
+  dgSetGraphicsDatabase(&subtrees);
+  dgLight("light", "root", 0, arVector4(1, 1, 1, 0), arVector3(1, 1, 1));
+  int i;
+  for (i=0; i<copies; ++i) {
+    const string name("copy" + ar_intToString(i));
+    transformIDs.push_back(dgTransform(name, "root", placement(i, copies, 0.)));
+    const arVector4 c(color(i));
+    dgMaterial(name + " material", name, arVector3(c.v[0], c.v[1], c.v[2]));
+    dgPoints(name + " points", name + " material", 3*cTri, &sphere[0]);
+    dgNormal3(name + " normals", name + " points", 3*cTri, &sphere[0]);
+    dgDrawable(name + " drawable", name + " normals", DG_TRIANGLES, cTri);
+  }
+
+  dgSetGraphicsDatabase(&instanced);
+  dgLight("light", "root", 0, arVector4(1, 1, 1, 0), arVector3(1, 1, 1));
+  vector<float> instances(20*copies + 1);
+  for (i=0; i<copies; ++i) {
+    memcpy(&instances[20*i], placement(i, copies, 0.).v, 16*sizeof(float));
+    memcpy(&instances[20*i + 16], color(i).v, 4*sizeof(float));
+  }
+  instanceID = dgInstances("copies", "root", copies, &instances[0]);
+  dgMaterial("material", "copies", arVector3(1, 1, 1));
+  dgPoints("points", "material", 3*cTri, &sphere[0]);
+  dgNormal3("normals", "points", 3*cTri, &sphere[0]);
+  dgDrawable("drawable", "normals", DG_TRIANGLES, cTri);
+}
+
+// Move every copy, returning the bytes sent.
+static int moveSubtrees(int copies, float t) {
+  dgSetGraphicsDatabase(&subtrees);
+  int bytes = 0;
+  for (int i=0; i<copies; ++i) {
+    dgTransform(transformIDs[i], placement(i, copies, t));
+    bytes += subtrees.transformData->size();
+  }
+  return bytes;
+}
+
+static int moveInstances(int copies, float t) {
+  dgSetGraphicsDatabase(&instanced);
+  vector<float> instances(20*copies + 1);
+  for (int i=0; i<copies; ++i) {
+    memcpy(&instances[20*i], placement(i, copies, t).v, 16*sizeof(float));
+    memcpy(&instances[20*i + 16], color(i).v, 4*sizeof(float));
+  }
+  dgInstances(instanceID, copies, &instances[0]);
+  return instanced.instanceData->size();
+}
+
+// Drawing, in the window's draw callback.
+static const int cPixel = 512;
+static arGraphicsDatabase* drawing = NULL;
+static double usecDraw = 0.;
+static vector<unsigned char> image;
+static int fHardware = -1;  // Needs the window's GL context.
+
+static void drawCB(arGUIWindowInfo*) {
+  if (fHardware < 0)
+    fHardware = ar_instancingSupported() ? 1 : 0;
+  glViewport(0, 0, cPixel, cPixel);
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  glFrustum(-.1, .1, -.1, .1, .2, 1000.);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+  glEnable(GL_DEPTH_TEST);
+  glClearColor(0, 0, 0, 1);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  drawing->activateLights();
+  const ar_timeval start = ar_time();
+  drawing->draw();
+  glFinish();
+  usecDraw += ar_difftime(ar_time(), start);
+  image.resize(4*cPixel*cPixel);
+  glReadPixels(0, 0, cPixel, cPixel, GL_RGBA, GL_UNSIGNED_BYTE, &image[0]);
+}
+
+// Milliseconds per frame, or -1 on failure.
+static double timeDraw(arGUIWindowManager& wm, int ID, arGraphicsDatabase& g,
+                       int cFrame, vector<unsigned char>& result) {
+  drawing = &g;
+  wm.drawWindow(ID, true);  // Not timed:  compiles shaders, etc.
+  usecDraw = 0.;
+  for (int frame=0; frame<cFrame; ++frame) {
+    wm.drawWindow(ID, true);
+    wm.swapWindowBuffer(ID, true);
+  }
+  result = image;
+  return usecDraw / 1000. / cFrame;
+}
+
+// Pixels differing by more than rounding.
+static int compare(const vector<unsigned char>& a, const vector<unsigned char>& b) {
+  int diffs = 0;
+  for (unsigned i=0; i<a.size() && i<b.size(); ++i)
+    if (abs(int(a[i]) - int(b[i])) > 8)
+      ++diffs;
+  return diffs;
+}
+
+int main(int argc, char** argv) {
+  const int copies = argc > 1 ? atoi(argv[1]) : 1000;
+  const int cFrame = argc > 2 ? atoi(argv[2]) : 50;
+  if (copies <= 0) {
+    ar_log_error() << "InstanceTest: nonpositive number of copies.\n";
+    return 1;
+  }
+
+  makeScenes(copies);
+  arStructuredData makeNode(subtrees._gfx.find("make node"));
+  const int bytesSubtrees = wireBytes(subtrees, subtrees.getRoot(), makeNode);
+  const int bytesInstanced = wireBytes(instanced, instanced.getRoot(), makeNode);
+  cout << "InstanceTest: " << copies << " copies.\n"
+       << "Scene:   " << bytesSubtrees << " bytes as subtrees, "
+       << bytesInstanced << " bytes instanced.\n";
+
+  double usecSubtrees = 0.;
+  double usecInstanced = 0.;
+  int updateSubtrees = 0;
+  int updateInstanced = 0;
+  for (int frame=0; frame<cFrame; ++frame) {
+    const float t = .05 * (frame+1);
+    ar_timeval start = ar_time();
+    updateSubtrees = moveSubtrees(copies, t);
+    usecSubtrees += ar_difftime(ar_time(), start);
+    start = ar_time();
+    updateInstanced = moveInstances(copies, t);
+    usecInstanced += ar_difftime(ar_time(), start);
+  }
+  cout << "Update:  " << updateSubtrees << " bytes in " << copies
+       << " records as subtrees, " << updateInstanced << " bytes in 1 instanced.\n"
+       << "Applied: " << usecSubtrees / cFrame << " usec as subtrees, "
+       << usecInstanced / cFrame << " usec instanced, per frame.\n";
+
+  if (!getenv("DISPLAY")) {
+    cout << "No DISPLAY, so not drawing.\n";
+    return 0;
+  }
+  arGUIWindowManager wm(NULL, NULL, NULL, NULL, false);
+  const int ID = wm.addWindow(arGUIWindowConfig(50, 50, cPixel, cPixel, 16, 0, true,
+    AR_ZORDER_TOP, false, false, "InstanceTest", getenv("DISPLAY")));
+  if (ID < 0) {
+    ar_log_error() << "InstanceTest failed to open a window.\n";
+    return 1;
+  }
+  wm.registerDrawCallback(ID, new arDefaultGUIRenderCallback(drawCB));
+
+  vector<unsigned char> imageSubtrees, imageLoop, imageHardware;
+  instanced.setInstancing(false);
+  const double msecSubtrees = timeDraw(wm, ID, subtrees, cFrame, imageSubtrees);
+  const double msecLoop = timeDraw(wm, ID, instanced, cFrame, imageLoop);
+  cout << "Draw:    " << msecSubtrees << " msec as subtrees, "
+       << msecLoop << " msec instanced in a loop";
+  bool ok = compare(imageSubtrees, imageLoop) == 0;
+  if (fHardware) {
+    instanced.setInstancing(true);
+    const double msecHardware = timeDraw(wm, ID, instanced, cFrame, imageHardware);
+    cout << ", " << msecHardware << " msec with hardware instancing";
+    ok &= compare(imageSubtrees, imageHardware) == 0;
+  }
+  cout << ", per frame.\n";
+  if (!fHardware)
+    cout << "No hardware instancing.\n";
+  wm.deleteWindow(ID);
+  if (!ok) {
+    ar_log_error() << "InstanceTest: images differ.\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,152 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+// Benchmark arGraphicsPeer's regions of interest without a szgserver.
+// A source peer holds a city:  a grid of blocks, each a bounding sphere
+// over a building and a moving car.  Two peers mirror it, one
+// subscribing to a region at one corner.  Reports the bytes each mirror
+// receives for the dump and for animating every car, then moves the
+// region to the opposite corner and checks that the cars there caught up.
+//
+// Usage: InterestTest [blocks per side [frames [port]]]
+
+#include "arPrecompiled.h"
+#define SZG_DO_NOT_EXPORT
+
+#include "arGraphicsPeer.h"
+#include "arGraphicsAPI.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+
+#include <stdlib.h>
+
+static const float spacing = 100.;
+
+static arMatrix4 carMatrix(int block, int frame) {
+  return ar_translationMatrix(float(frame % 40), 0., float(block % 7));
+}
+
+// Cars of blocks within the region, whose transforms don't match the source's.
+static int countStale(arGraphicsPeer* source, arGraphicsPeer* mirror,
+                      int side, const arBoundingSphere& region, int& cInside) {
+  int cStale = 0;
+  cInside = 0;
+  for (int i=0; i<side*side; ++i) {
+    const arVector3 center((i % side) * spacing, 0., (i / side) * spacing);
+    if (++(center - region.position) > region.radius)
+      continue;
+    ++cInside;
+    const string name("car" + ar_intToString(i));
+    arTransformNode* a = (arTransformNode*)source->getNode(name, false);
+    arTransformNode* b = (arTransformNode*)mirror->getNode(name, false);
+    if (!a || !b || a->getTransform() != b->getTransform())
+      ++cStale;
+  }
+  return cStale;
+}
+
+int main(int argc, char** argv) {
+  const int side = argc > 1 ? atoi(argv[1]) : 40;
+  const int cFrame = argc > 2 ? atoi(argv[2]) : 50;
+  const int port = argc > 3 ? atoi(argv[3]) : 44376;
+  if (side < 2 || cFrame < 1) {
+    ar_log_error() << "usage: InterestTest [blocks per side [frames [port]]]\n";
+    return 1;
+  }
+
+  // Because it is unsafe to delete an arDataServer that is receiving
+  // connections, these peers are never deleted.
+  arGraphicsPeer* source = new arGraphicsPeer;
+  arGraphicsPeer* all = new arGraphicsPeer;
+  arGraphicsPeer* roi = new arGraphicsPeer;
+  all->setName("all");
+  roi->setName("roi");
+  if (!source->startStandalone(port, "127.0.0.1") ||
+      !all->startStandalone(port+1, "127.0.0.1") ||
+      !roi->startStandalone(port+2, "127.0.0.1")) {
+    return 1;
+  }
+
+  // Each block:  transform, bounding sphere, building (100 points),
+  // car transform, car (8 points).
+  dgSetGraphicsDatabase(source);
+  vector<float> building(300);
+  vector<float> car(24);
+  unsigned j;
+  for (j=0; j<building.size(); ++j)
+    building[j] = float(j % 40);
+  for (j=0; j<car.size(); ++j)
+    car[j] = float(j % 3);
+  vector<int> cars;
+  int i;
+  for (i=0; i<side*side; ++i) {
+    const string n(ar_intToString(i));
+    dgTransform("block" + n, "root",
+      ar_translationMatrix((i % side) * spacing, 0., (i / side) * spacing));
+    dgBoundingSphere("sphere" + n, "block" + n, 0, spacing * .6, arVector3(0, 0, 0));
+    dgPoints("building" + n, "sphere" + n, building.size()/3, &building[0]);
+    cars.push_back(dgTransform("car" + n, "sphere" + n, carMatrix(i, 0)));
+    dgPoints("carPoints" + n, "car" + n, car.size()/3, &car[0]);
+  }
+
+  if (all->connectToPeer("source", "127.0.0.1", port) < 0 ||
+      roi->connectToPeer("source", "127.0.0.1", port) < 0) {
+    ar_log_error() << "InterestTest failed to connect.\n";
+    return 1;
+  }
+  // A tenth of the city, at one corner.
+  const float radius = spacing * side * .35;
+  const float margin = spacing * .5;
+  arBoundingSphere region(arVector3(0, 0, 0), radius);
+  roi->setInterest("source", region, margin);
+  all->pingPeer("source");
+  roi->pingPeer("source");
+
+  all->pullSerial("source", 0, 0, AR_TRANSIENT_NODE, AR_TRANSIENT_NODE, AR_IGNORE_NODE);
+  roi->pullSerial("source", 0, 0, AR_TRANSIENT_NODE, AR_TRANSIENT_NODE, AR_IGNORE_NODE);
+  const double dumpAll = source->getBytesSent("all");
+  const double dumpRoi = source->getBytesSent("roi");
+
+  const ar_timeval start = ar_time();
+  for (int frame=1; frame<=cFrame; ++frame) {
+    for (i=0; i<int(cars.size()); ++i)
+      dgTransform(cars[i], carMatrix(i, frame));
+  }
+  source->flush();
+  source->pingPeer("all");
+  source->pingPeer("roi");
+  const double usecAnimate = ar_difftime(ar_time(), start);
+  const double animateAll = source->getBytesSent("all") - dumpAll;
+  const double animateRoi = source->getBytesSent("roi") - dumpRoi;
+
+  int cInside = 0;
+  const int cStaleBefore = countStale(source, roi, side, region, cInside);
+  cout << "InterestTest: " << side*side << " blocks, " << cFrame << " frames in " <<
+    usecAnimate / 1000. << " msec.\n" <<
+    "  dump:      all " << dumpAll << " bytes, region " << dumpRoi << " bytes (" <<
+    100. * dumpRoi / dumpAll << "%).\n" <<
+    "  animation: all " << animateAll << " bytes, region " << animateRoi << " bytes (" <<
+    100. * animateRoi / animateAll << "%).\n" <<
+    "  " << cStaleBefore << " of " << cInside << " cars in the region are stale.\n";
+
+  // Move the region to the opposite corner.
+  const double before = source->getBytesSent("roi");
+  region.position = arVector3(spacing * (side-1), 0, spacing * (side-1));
+  roi->setInterest("source", region, margin);
+  roi->pingPeer("source");
+  source->flush();
+  source->pingPeer("roi");
+  const int cStaleAfter = countStale(source, roi, side, region, cInside);
+  cout << "  moved region:  " << source->getBytesSent("roi") - before <<
+    " bytes of catch-up, " << cStaleAfter << " of " << cInside <<
+    " cars in the region are stale.\n" << source->printConnections();
+
+  const bool ok = cStaleBefore == 0 && cStaleAfter == 0 &&
+    animateRoi < animateAll && cInside > 0;
+  if (!ok)
+    ar_log_error() << "InterestTest failed.\n";
+  // Skip the peers' destructors.
+  exit(ok ? 0 : 1);
+}
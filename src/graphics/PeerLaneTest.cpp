@@ -0,0 +1,177 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+// Benchmark arGraphicsPeer's outbound lanes without a szgserver.
+// One peer mirrors another's scene graph of transforms over geometry,
+// while the source peer animates the first transform.  The animation
+// travels in the interactive lane, so it should arrive promptly even
+// while the bulk lane is still carrying the dump.  Reports the latency
+// of those transform updates and the writes per record.  First checks that
+// a node_map record keeps transforms to the nodes it maps out of the
+// interactive lane.
+//
+// Usage: PeerLaneTest [nodes [bulk cap, bytes/sec [port]]]
+
+#include "arPrecompiled.h"
+#define SZG_DO_NOT_EXPORT
+
+#include "arGraphicsPeer.h"
+#include "arGraphicsAPI.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+#include "arThread.h"
+
+#include <algorithm>
+#include <stdlib.h>
+
+// The matrix of an animated transform carries this in element 13,
+// and its send time (usec since start) in element 12.
+static const float marker = 12345.;
+static ar_timeval start;
+
+static double usecSinceStart() {
+  return ar_difftime(ar_time(), start);
+}
+
+// A mirroring peer that times the animated transforms it receives.
+class LatencyPeer: public arGraphicsPeer {
+ public:
+  LatencyPeer() : _lock("LatencyPeer") {}
+  arDatabaseNode* alter(arStructuredData* data, bool refNode = false) {
+    if (data->getID() == _gfx.AR_TRANSFORM) {
+      const float* m = (const float*)data->getDataPtr(_gfx.AR_TRANSFORM_MATRIX, AR_FLOAT);
+      if (m && m[13] == marker) {
+        arGuard _(_lock, "LatencyPeer::alter");
+        latencies.push_back(usecSinceStart() - m[12]);
+      }
+    }
+    return arGraphicsPeer::alter(data, refNode);
+  }
+  vector<double> getLatencies() {
+    arGuard _(_lock, "LatencyPeer::getLatencies");
+    return latencies;
+  }
+ private:
+  arLock _lock;
+  vector<double> latencies;
+};
+
+struct Pull {
+  LatencyPeer* peer;
+  arSignalObject done;
+};
+
+static void pull(void* p) {
+  Pull* pull = (Pull*)p;
+  pull->peer->pullSerial("source", 0, 0,
+    AR_TRANSIENT_NODE, AR_TRANSIENT_NODE, AR_IGNORE_NODE);
+  pull->done.sendSignal();
+}
+
+int main(int argc, char** argv) {
+  const int cNode = argc > 1 ? atoi(argv[1]) : 2000;
+  const int bulkCap = argc > 2 ? atoi(argv[2]) : 0;
+  const int port = argc > 3 ? atoi(argv[3]) : 44366;
+  if (cNode < 1) {
+    ar_log_error() << "usage: PeerLaneTest [nodes [bulk cap, bytes/sec [port]]]\n";
+    return 1;
+  }
+
+  // A node_map record holds back transforms to the nodes it maps,
+  // which the receiver can't name until it arrives.
+  arGraphicsLanguage gfx;
+  arStructuredData nodeMap(gfx.find("graphics admin"));
+  nodeMap.dataInString(gfx.AR_GRAPHICS_ADMIN_ACTION, "node_map");
+  const int ids[4] = { 100, 7, 101, 9 };
+  nodeMap.dataIn(gfx.AR_GRAPHICS_ADMIN_NODE_ID, ids, AR_INT, 4);
+  arGraphicsPeerLane lane;
+  lane.append(&nodeMap, ids[1], ids[3]);
+  const bool held = lane.holds(ids[1]) && lane.holds(ids[3]);
+  vector<ARchar> sent;
+  lane.take(sent, ar_time(), true, 0);
+  if (!held || lane.holds(ids[1]) || lane.holds(ids[3])) {
+    ar_log_error() << "PeerLaneTest: node_map didn't hold its nodes.\n";
+    return 1;
+  }
+
+  // Because it is unsafe to delete an arDataServer that is receiving
+  // connections, these peers are never deleted.
+  arGraphicsPeer* source = new arGraphicsPeer;
+  LatencyPeer* mirror = new LatencyPeer;
+  source->setLaneCap(AR_BULK_LANE, bulkCap);
+  if (!source->startStandalone(port, "127.0.0.1") ||
+      !mirror->startStandalone(port+1, "127.0.0.1")) {
+    return 1;
+  }
+
+  // Transforms over 300 points each, about 3.6 KB per node.
+  dgSetGraphicsDatabase(source);
+  vector<float> points(900);
+  int i;
+  for (i=0; i<int(points.size()); ++i)
+    points[i] = float(i);
+  for (i=0; i<cNode; ++i) {
+    const string name("node" + ar_intToString(i));
+    dgTransform(name, "root", ar_identityMatrix());
+    dgPoints(name + ".points", name, points.size()/3, &points[0]);
+  }
+  const int animated = source->getNodeID("node0");
+
+  if (mirror->connectToPeer("source", "127.0.0.1", port) < 0) {
+    ar_log_error() << "PeerLaneTest failed to connect.\n";
+    return 1;
+  }
+
+  // Animate node0 at 100 Hz until the dump is done, and a bit after.
+  start = ar_time();
+  Pull p;
+  p.peer = mirror;
+  arThread dummy(pull, &p);
+  arSignalObject& done = p.done;
+  bool fDone = false;
+  double usecDump = 0.;
+  int cUpdate = 0;
+  for (int afterDump = 0; afterDump < 20; ) {
+    arMatrix4 m(ar_translationMatrix(0., 0., 0.));
+    m[12] = usecSinceStart();
+    m[13] = marker;
+    dgTransform(animated, m);
+    ++cUpdate;
+    ar_usleep(10000);
+    if (fDone) {
+      ++afterDump;
+    }
+    else if (mirror->getNodeID("node" + ar_intToString(cNode-1), false) >= 0) {
+      // Wait for dump-done.
+      done.receiveSignal();
+      fDone = true;
+      usecDump = usecSinceStart();
+    }
+  }
+  source->flush();
+  ar_usleep(100000);
+
+  vector<double> latencies(mirror->getLatencies());
+  const int cMirrored = mirror->getNodeID("node" + ar_intToString(cNode-1), false) >= 0 ?
+    cNode : 0;
+  cout << "PeerLaneTest: mirrored " << cNode << " nodes in " << usecDump / 1000. <<
+    " msec, bulk cap " << bulkCap << " bytes/s.\n" <<
+    "  " << latencies.size() << " of " << cUpdate << " animated transforms arrived";
+  if (!latencies.empty()) {
+    sort(latencies.begin(), latencies.end());
+    double sum = 0.;
+    for (i=0; i<int(latencies.size()); ++i)
+      sum += latencies[i];
+    cout << ", latency mean " << sum / latencies.size() / 1000. << " msec, p99 " <<
+      latencies[latencies.size() * 99 / 100] / 1000. << " msec, max " <<
+      latencies.back() / 1000. << " msec";
+  }
+  cout << ".\n" << source->printConnections();
+  const bool ok = cMirrored == cNode && !latencies.empty();
+  if (!ok)
+    ar_log_error() << "PeerLaneTest failed.\n";
+  // Skip the peers' destructors.
+  exit(ok ? 0 : 1);
+}
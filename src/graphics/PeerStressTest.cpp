@@ -0,0 +1,152 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+// Stress arGraphicsPeer with many peers altering one hub, without a
+// szgserver.  Each writer peer mirrors the hub and, from its own thread,
+// animates the transforms of its own subtree.  Reports the alters per
+// second that the hub applies, with and without concurrent alters,
+// and checks that the hub ends up with each writer's transforms.
+//
+// Usage: PeerStressTest [writers [transforms per writer [seconds [port]]]]
+
+#include "arPrecompiled.h"
+#define SZG_DO_NOT_EXPORT
+
+#include "arGraphicsPeer.h"
+#include "arGraphicsAPI.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+#include "arThread.h"
+
+#include <stdlib.h>
+
+// The hub counts the transforms it applies.
+class CountingPeer: public arGraphicsPeer {
+ public:
+  arDatabaseNode* alter(arStructuredData* data, bool refNode = false) {
+    arDatabaseNode* result = arGraphicsPeer::alter(data, refNode);
+    if (data->getID() == _gfx.AR_TRANSFORM)
+      ++alters;
+    return result;
+  }
+  arIntAtom alters;
+};
+
+struct Writer {
+  arGraphicsPeer* peer;
+  vector<arTransformNode*> nodes;
+  double seconds;
+  int frames;
+  arSignalObject done;
+};
+
+static void animate(void* w) {
+  Writer* writer = (Writer*)w;
+  const ar_timeval start = ar_time();
+  while (ar_difftime(ar_time(), start) < writer->seconds * 1e6) {
+    ++writer->frames;
+    for (unsigned i=0; i<writer->nodes.size(); ++i)
+      writer->nodes[i]->setTransform(
+        ar_translationMatrix(float(writer->frames), float(i), 0.));
+  }
+  writer->done.sendSignal();
+}
+
+int main(int argc, char** argv) {
+  const int cWriter = argc > 1 ? atoi(argv[1]) : 4;
+  const int cNode = argc > 2 ? atoi(argv[2]) : 100;
+  const double seconds = argc > 3 ? atof(argv[3]) : 2.;
+  const int port = argc > 4 ? atoi(argv[4]) : 44386;
+  if (cWriter < 1 || cNode < 1 || seconds <= 0.) {
+    ar_log_error() << "usage: PeerStressTest [writers [transforms per writer [seconds [port]]]]\n";
+    return 1;
+  }
+
+  // Because it is unsafe to delete an arDataServer that is receiving
+  // connections, these peers are never deleted.
+  CountingPeer* hub = new CountingPeer;
+  if (!hub->startStandalone(port, "127.0.0.1"))
+    return 1;
+  dgSetGraphicsDatabase(hub);
+  int i, j;
+  for (i=0; i<cWriter; ++i) {
+    const string w("w" + ar_intToString(i));
+    dgTransform(w, "root", ar_identityMatrix());
+    for (j=0; j<cNode; ++j)
+      dgTransform(w + "_" + ar_intToString(j), w, ar_identityMatrix());
+  }
+
+  vector<Writer*> writers;
+  for (i=0; i<cWriter; ++i) {
+    Writer* writer = new Writer;
+    writer->peer = new arGraphicsPeer;
+    writer->peer->setName("writer" + ar_intToString(i));
+    if (!writer->peer->startStandalone(port+1+i, "127.0.0.1") ||
+        writer->peer->connectToPeer("hub", "127.0.0.1", port) < 0) {
+      ar_log_error() << "PeerStressTest failed to connect.\n";
+      return 1;
+    }
+    // Updates go to the hub, but not back.
+    writer->peer->pullSerial("hub", 0, 0,
+      AR_TRANSIENT_NODE, AR_IGNORE_NODE, AR_TRANSIENT_NODE);
+    const string w("w" + ar_intToString(i) + "_");
+    for (j=0; j<cNode; ++j) {
+      arTransformNode* node = (arTransformNode*)
+        writer->peer->getNode(w + ar_intToString(j), false);
+      if (!node) {
+        ar_log_error() << "PeerStressTest: writer lacks node " << w << j << ".\n";
+        return 1;
+      }
+      writer->nodes.push_back(node);
+    }
+    writer->seconds = seconds;
+    writers.push_back(writer);
+  }
+
+  bool ok = true;
+  for (int concurrent=1; concurrent>=0; --concurrent) {
+    hub->setConcurrentAlters(concurrent == 1);
+    hub->alters = 0;
+    const ar_timeval start = ar_time();
+    vector<arThread*> threads;
+    for (i=0; i<cWriter; ++i) {
+      writers[i]->frames = 0;
+      threads.push_back(new arThread(animate, writers[i]));
+    }
+    long sent = 0;
+    for (i=0; i<cWriter; ++i) {
+      writers[i]->done.receiveSignal();
+      writers[i]->peer->flush();
+      // The hub has applied everything this writer sent.
+      writers[i]->peer->pingPeer("hub");
+      sent += long(writers[i]->frames) * cNode;
+    }
+    const double usec = ar_difftime(ar_time(), start);
+    const int applied = hub->alters;
+
+    // Compare each writer's transforms with the hub's.
+    int cWrong = 0;
+    for (i=0; i<cWriter; ++i) {
+      const string w("w" + ar_intToString(i) + "_");
+      for (j=0; j<cNode; ++j) {
+        arTransformNode* node = (arTransformNode*)hub->getNode(w + ar_intToString(j), false);
+        if (!node || node->getTransform() != writers[i]->nodes[j]->getTransform())
+          ++cWrong;
+      }
+    }
+    cout << "PeerStressTest: " << (concurrent ? "concurrent" : "serialized") << " alters, " <<
+      cWriter << " writers x " << cNode << " transforms:  hub applied " << applied <<
+      " of " << sent << " alters in " << usec / 1e6 << " s, " <<
+      applied / (usec / 1e6) << " alters/s;  " << cWrong << " transforms differ.\n";
+    if (applied != sent || cWrong > 0)
+      ok = false;
+    for (i=0; i<cWriter; ++i)
+      delete threads[i];
+  }
+  if (!ok)
+    ar_log_error() << "PeerStressTest failed.\n";
+  // Skip the peers' destructors.
+  exit(ok ? 0 : 1);
+}
@@ -0,0 +1,130 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+// Benchmark arImagePyramid without a display or a szgserver:
+// write the pyramid of a synthetic image, then fly a 1920 x 1080 view
+// across it (pan, zoom out, zoom in, pan), once without prefetch and
+// once with it.  Reports the tile cache's hit rate and resident memory,
+// against arLargeImage's copy of the whole image plus its tiles.
+//
+// Usage: PyramidTest [side [cacheMB [frames]]]
+//        PyramidTest image.ppm|image.jpg out.pyr [tileSize]   (just convert)
+
+#include "arPrecompiled.h"
+#define SZG_DO_NOT_EXPORT
+
+#include "arImagePyramid.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#ifdef AR_USE_LINUX
+#include <unistd.h>
+#endif
+
+// Resident set size, or 0 if unknown.
+static long residentBytes() {
+#ifdef AR_USE_LINUX
+  long pages = 0;
+  long resident = 0;
+  FILE* f = fopen("/proc/self/statm", "r");
+  if (!f)
+    return 0;
+  const bool ok = fscanf(f, "%ld %ld", &pages, &resident) == 2;
+  fclose(f);
+  return ok ? resident * sysconf(_SC_PAGESIZE) : 0;
+#else
+  return 0;
+#endif
+}
+
+// Where the view is, frame of frames:  center and width in image pixels.
+static void flight(int frame, int frames, int side, double& u, double& v, double& w) {
+  const double key[5][3] = {
+    { .1, .2, 1920 }, { .7, .2, 1920 }, { .5, .5, double(side) }, { .8, .7, 1920 }, { .3, .9, 1920 }
+  };
+  const double t = 4. * frame / frames;
+  const int k = min(3, int(t));
+  const double f = t - k;
+  u = key[k][0] + f * (key[k+1][0] - key[k][0]);
+  v = key[k][1] + f * (key[k+1][1] - key[k][1]);
+  w = key[k][2] * pow(key[k+1][2] / key[k][2], f);
+}
+
+static bool fly(arImagePyramid& pyramid, const string& name, float lookahead,
+                int side, int frames) {
+  if (!pyramid.open(name))
+    return false;
+  pyramid.setLookahead(lookahead);
+  long peakRSS = 0;
+  for (int frame=0; frame<frames; ++frame) {
+    double u, v, w;
+    flight(frame, frames, side, u, v, w);
+    const double hu = w / side / 2.;
+    const double hv = hu * 1080. / 1920.;
+    pyramid.setView(u - hu, v - hv, u + hu, v + hv, 1920, 1080);
+    // A frame at 60 Hz.
+    ar_usleep(16667);
+    peakRSS = max(peakRSS, residentBytes());
+  }
+  cout << "  lookahead " << lookahead << ":  " << pyramid.status();
+  if (peakRSS > 0)
+    cout << "  process resident peak " << peakRSS / 1048576 << " MB.\n";
+  pyramid.close();
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (argc > 2 && !isdigit(argv[1][0])) {
+    arTexture image;
+    if (!image.readImage(argv[1])) {
+      ar_log_error() << "PyramidTest failed to read '" << argv[1] << "'.\n";
+      return 1;
+    }
+    return arImagePyramid::write(image, argv[2], argc > 3 ? atoi(argv[3]) : 256) ? 0 : 1;
+  }
+
+  const int side = argc > 1 ? atoi(argv[1]) : 8192;
+  const int cacheMB = argc > 2 ? atoi(argv[2]) : 32;
+  const int frames = argc > 3 ? atoi(argv[3]) : 600;
+  if (side <= 0 || cacheMB <= 0 || frames <= 0) {
+    ar_log_error() << "usage: PyramidTest [side [cacheMB [frames]]]\n";
+    return 1;
+  }
+  const string name("PyramidTest.pyr");
+
+  ar_timeval start = ar_time();
+  {
+    vector<char> pixels(size_t(side) * side * 3);
+    for (int y=0; y<side; ++y) {
+      for (int x=0; x<side; ++x) {
+        char* p = &pixels[(size_t(y) * side + x) * 3];
+        p[0] = char(x);
+        p[1] = char(y);
+        p[2] = char((x / 64 + y / 64) % 2 ? 255 : 0);
+      }
+    }
+    arTexture image;
+    if (!image.fill(side, side, false, &pixels[0]))
+      return 1;
+    pixels.clear();
+    if (!arImagePyramid::write(image, name))
+      return 1;
+  }
+  const double cbImage = 3. * side * side;
+  cout << "PyramidTest: " << side << " x " << side << " image written in " <<
+    ar_difftime(ar_time(), start) / 1e6 << " sec.\n" <<
+    "  arLargeImage would hold " << 2. * cbImage / 1048576 <<
+    " MB (the image and its tiles);  the cache holds " << cacheMB << " MB.\n";
+
+  arImagePyramid pyramid(cacheMB << 20);
+  if (!fly(pyramid, name, 0., side, frames) ||
+      !fly(pyramid, name, 8., side, frames))
+    return 1;
+  remove(name.c_str());
+  return 0;
+}
@@ -0,0 +1,218 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+// Benchmark arGraphicsSnapshot without a window or a szgserver.
+// A source database records a stream of frames, each moving every
+// transform and deforming some points, as arGraphicsClient would receive
+// them.  Each frame is applied and then "drawn" (read every transform,
+// then sleep as if the graphics card were busy), first serially into one
+// database, then through a snapshot.  Reports the frame times and the
+// overlap.  Every drawn frame must be whole (all transforms from one
+// frame), and exactly one frame behind with the snapshot;  after flush(),
+// the front must match the serial database.
+//
+// Usage: SnapshotTest [transforms [frames [drawUsec]]]
+
+#include "arPrecompiled.h"
+#define SZG_DO_NOT_EXPORT
+
+#include "arGraphicsSnapshot.h"
+#include "arQueuedData.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// Queues each record it applies, like arGraphicsServer.
+class RecordingDatabase : public arGraphicsDatabase {
+ public:
+  virtual arDatabaseNode* alter(arStructuredData* data, bool refNode=false) {
+    arDatabaseNode* node = arGraphicsDatabase::alter(data, refNode);
+    // After alter(), since "make node" records get their IDs there.
+    if (node)
+      queue.forceQueueData(data);
+    return node;
+  }
+  arQueuedData queue;
+};
+
+static const int cPoint = 64;
+
+class Source {
+ public:
+  Source(int cTransform) : _points(3 * cPoint) {
+    arDatabaseNode* root = _g.getRoot();
+    for (int i=0; i<cTransform; ++i) {
+      arTransformNode* t = (arTransformNode*)_g.newNode(root, "transform");
+      _transforms.push_back(t);
+      IDs.push_back(t->getID());
+      if (i % 4 == 0) {
+        _pointsNodes.push_back((arPointsNode*)_g.newNode(t, "points"));
+        IDs.push_back(_pointsNodes.back()->getID());
+      }
+    }
+  }
+
+  // Frame f's records.  Valid until the next call.
+  ARchar* frame(int f) {
+    for (unsigned i=0; i<_transforms.size(); ++i)
+      _transforms[i]->setTransform(ar_translationMatrix(f, i, 0));
+    for (unsigned j=0; j<_pointsNodes.size(); ++j) {
+      for (int k=0; k<cPoint; ++k) {
+        _points[3*k] = k;
+        _points[3*k+1] = sin(f * .1f + j);
+        _points[3*k+2] = j;
+      }
+      _pointsNodes[j]->setPoints(cPoint, &_points[0]);
+    }
+    _g.queue.swapBuffers();
+    return _g.queue.getFrontBufferRaw();
+  }
+
+  const vector<arTransformNode*>& transforms() const { return _transforms; }
+  vector<int> IDs;  // every node's
+
+ private:
+  RecordingDatabase _g;
+  vector<arTransformNode*> _transforms;
+  vector<arPointsNode*> _pointsNodes;
+  vector<float> _points;
+};
+
+// Read every transform, like a draw.  The frame they all show, or -1 if
+// they differ (a torn frame), or -2 if the database is still empty.
+static int draw(arGraphicsDatabase& g, const vector<int>& IDs, int usecDraw) {
+  int frame = -2;
+  for (unsigned i=0; i<IDs.size(); ++i) {
+    arTransformNode* t = (arTransformNode*)g.getNodeRef(IDs[i], false);
+    if (!t)
+      return -2;
+    const int f = int(t->getTransform().v[12]);
+    t->unref();
+    if (frame == -2)
+      frame = f;
+    else if (f != frame)
+      frame = -1;
+  }
+  ar_usleep(usecDraw);
+  return frame;
+}
+
+// Nodes IDs have the same type and data in a and b.
+static bool sameState(arGraphicsDatabase& a, arGraphicsDatabase& b,
+                      const vector<int>& IDs) {
+  for (unsigned i=0; i<IDs.size(); ++i) {
+    arDatabaseNode* na = a.getNode(IDs[i], false);
+    arDatabaseNode* nb = b.getNode(IDs[i], false);
+    if (!na || !nb || na->getTypeString() != nb->getTypeString())
+      return false;
+    arStructuredData* da = na->dumpData();
+    arStructuredData* db = nb->dumpData();
+    ARchar* bufA = new ARchar[da->size()];
+    ARchar* bufB = new ARchar[db->size()];
+    da->pack(bufA);
+    db->pack(bufB);
+    const bool same = da->size() == db->size() && !memcmp(bufA, bufB, da->size());
+    delete [] bufA;
+    delete [] bufB;
+    delete da;
+    delete db;
+    if (!same)
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  const int cTransform = argc > 1 ? atoi(argv[1]) : 4000;
+  const int cFrame = argc > 2 ? atoi(argv[2]) : 200;
+  const int usecDraw = argc > 3 ? atoi(argv[3]) : 5000;
+  if (cTransform < 1 || cFrame < 2 || usecDraw < 0) {
+    ar_log_error() << "usage: SnapshotTest [transforms [frames [drawUsec]]]\n";
+    return 1;
+  }
+  bool ok = true;
+  vector<int> IDs;
+  vector<int> allIDs;
+
+  // Serially:  apply, then draw.
+  arGraphicsDatabase serial;
+  double usecSerial = 0., usecApply = 0.;
+  int bytes = 0;
+  {
+    Source source(cTransform);
+    for (unsigned i=0; i<source.transforms().size(); ++i)
+      IDs.push_back(source.transforms()[i]->getID());
+    allIDs = source.IDs;
+    // The frame that makes the nodes isn't timed.
+    serial.handleDataQueue(source.frame(0));
+    for (int f=1; f<cFrame; ++f) {
+      ARchar* buffer = source.frame(f);
+      ARint size = 0;
+      ar_unpackData(buffer, &size, AR_INT, 1);
+      bytes += size;
+      const ar_timeval start = ar_time();
+      ok &= serial.handleDataQueue(buffer);
+      usecApply += ar_difftime(ar_time(), start);
+      const int drawn = draw(serial, IDs, usecDraw);
+      usecSerial += ar_difftime(ar_time(), start);
+      if (drawn != f) {
+        ar_log_error() << "SnapshotTest: serial frame " << f << " drew " << drawn << ".\n";
+        ok = false;
+      }
+    }
+  }
+
+  // Through a snapshot:  apply the next frame while drawing.
+  arGraphicsDatabase a, b;
+  arGraphicsSnapshot snapshot(a, b);
+  double usecSnapshot = 0.;
+  if (!snapshot.start())
+    return 1;
+  {
+    Source source(cTransform);
+    snapshot.consume(source.frame(0));
+    int torn = 0;
+    for (int f=1; f<cFrame; ++f) {
+      ARchar* buffer = source.frame(f);
+      const ar_timeval start = ar_time();
+      ok &= snapshot.consume(buffer);
+      const int drawn = draw(snapshot.front(), IDs, usecDraw);
+      usecSnapshot += ar_difftime(ar_time(), start);
+      if (drawn == -1)
+        ++torn;
+      else if (drawn != f-1) {
+        ar_log_error() << "SnapshotTest: snapshot frame " << f << " drew " << drawn << ".\n";
+        ok = false;
+      }
+    }
+    if (torn) {
+      ar_log_error() << "SnapshotTest: " << torn << " torn frames.\n";
+      ok = false;
+    }
+  }
+  const string status(snapshot.status());
+  snapshot.flush();
+  if (!sameState(snapshot.front(), serial, allIDs)) {
+    ar_log_error() << "SnapshotTest: after flush(), the front differs from the serial database.\n";
+    ok = false;
+  }
+  snapshot.clear();
+  if (!sameState(a, b, allIDs) || &snapshot.front() != &a) {
+    ar_log_error() << "SnapshotTest: after clear(), the copies differ.\n";
+    ok = false;
+  }
+
+  const int n = cFrame - 1;
+  printf("%d transforms, %d frames of %d KB, %d usec drawing:\n",
+         cTransform, n, bytes / n / 1024, usecDraw);
+  printf("  serial:   %7.0f usec/frame (applying %.0f)\n", usecSerial / n, usecApply / n);
+  printf("  snapshot: %7.0f usec/frame (%.0f%% of serial)\n",
+         usecSnapshot / n, 100. * usecSnapshot / usecSerial);
+  printf("  %s", status.c_str());
+  printf(ok ? "SnapshotTest passed.\n" : "SnapshotTest FAILED.\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+// Benchmark arGraphicsTraversal without a window or a szgserver:
+// a random scene graph is traversed by 1, 2, 4, ... threads, and every
+// traversal must match the single-threaded one.  Then arViewportCull
+// culls both eyes at once, and must keep every sphere that each eye's
+// own frustum test keeps.
+//
+// Usage: TraversalTest [nodes [frames [maxThreads]]]
+
+#include "arPrecompiled.h"
+#define SZG_DO_NOT_EXPORT
+
+#include "arGraphicsDatabase.h"
+#include "arGraphicsTraversal.h"
+#include "arViewportCull.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+
+#include <stdlib.h>
+
+static float frand(float lo, float hi) {
+  return lo + (hi - lo) * (rand() / float(RAND_MAX));
+}
+
+// Transforms, culled by bounding spheres, over materials and drawables.
+static int cNode = 0;
+static void makeSubtree(arGraphicsDatabase& g, arDatabaseNode* parent,
+                        int depth, int target) {
+  while (cNode < target) {
+    arTransformNode* t = (arTransformNode*)g.newNode(parent, "transform");
+    t->setTransform(ar_translationMatrix(frand(-4, 4), frand(-4, 4), frand(-4, 2)));
+    arBoundingSphereNode* b =
+      (arBoundingSphereNode*)g.newNode(t, "bounding sphere");
+    arBoundingSphere s(arVector3(0, 0, 0), 3. / (depth+1));
+    s.visibility = true;
+    b->setBoundingSphere(s);
+    arMaterialNode* m = (arMaterialNode*)g.newNode(b, "material");
+    arDrawableNode* d = (arDrawableNode*)g.newNode(m, "drawable");
+    d->setDrawable(DG_TRIANGLES, 1);
+    cNode += 4;
+    if (depth < 6 && rand() % 3)
+      makeSubtree(g, m, depth+1, cNode + 4 * (1 + rand() % 40));
+    if (depth > 0 && rand() % 4 == 0)
+      return;
+  }
+}
+
+int main(int argc, char** argv) {
+  const int target = argc > 1 ? atoi(argv[1]) : 200000;
+  const int cFrame = argc > 2 ? atoi(argv[2]) : 20;
+  const int maxThreads = argc > 3 ? atoi(argv[3]) : 16;
+
+  arGraphicsDatabase g;
+  srand(1);
+  makeSubtree(g, g.getRoot(), 0, target);
+  const arMatrix4 view(ar_translationMatrix(0, 0, -20));
+  const arMatrix4 projection(ar_frustumMatrix(1., 1., 1., .1, 100., arVector3(0, 0, 0)));
+  cout << "TraversalTest: " << cNode << " nodes, " << ar_numProcessors() <<
+    " processors.\n";
+
+  arGraphicsTraversal traversal;
+  vector<arDatabaseNode*> drawn;
+  vector<pair<int, int> > culled;
+  bool ok = true;
+  for (int threads=1; threads<=maxThreads; threads*=2) {
+    traversal.setThreads(threads);
+    double usecDraw = 0.;
+    double usecCull = 0.;
+    for (int frame=0; frame<cFrame; ++frame) {
+      arGraphicsContext context;
+      ar_timeval start = ar_time();
+      traversal.drawList(g.getRoot(), view, &projection, context);
+      usecDraw += ar_difftime(ar_time(), start);
+
+      vector<pair<int, int> > visible;
+      start = ar_time();
+      traversal.cull(g.getRoot(), view, projection, visible);
+      usecCull += ar_difftime(ar_time(), start);
+
+      const vector<arGraphicsContext::Deferred>& d = context.getDeferred();
+      vector<arDatabaseNode*> nodes;
+      for (vector<arGraphicsContext::Deferred>::const_iterator i = d.begin(); i != d.end(); ++i)
+        nodes.push_back(i->node);
+      if (threads == 1 && frame == 0) {
+        drawn = nodes;
+        culled = visible;
+      }
+      else if (nodes != drawn || visible != culled) {
+        ar_log_error() << "TraversalTest: " << threads <<
+          " threads changed the traversal.\n";
+        ok = false;
+      }
+    }
+    cout << "  " << threads << " threads: draw list " <<
+      usecDraw / cFrame / 1000. << " msec (" << drawn.size() << " nodes, " <<
+      traversal.getTasks() << " tasks), motion cull " <<
+      usecCull / cFrame / 1000. << " msec (" << culled.size() << " spheres).\n";
+  }
+
+  // Stereo:  eyes 6 cm apart.
+  vector<arMatrix4> clip;
+  vector<arMatrix4> eyeView;
+  int eye;
+  for (eye=0; eye<2; ++eye) {
+    const arVector3 eyePosition(eye ? .03 : -.03, 0, 0);
+    eyeView.push_back(ar_translationMatrix(-eyePosition) * view);
+    clip.push_back(ar_frustumMatrix(1., 1., 1., .1, 100., eyePosition) * eyeView.back());
+  }
+  traversal.setThreads(1);
+  arViewportCull viewportCull;
+  double usecUnion = 0.;
+  for (int frame=0; frame<cFrame; ++frame) {
+    for (eye=0; eye<2; ++eye) {
+      if (frame > 0)
+        continue;
+      vector<pair<int, int> > visible;
+      traversal.cull(g.getRoot(), eyeView[eye],
+        ar_frustumMatrix(1., 1., 1., .1, 100., arVector3(eye ? .03 : -.03, 0, 0)), visible);
+      viewportCull.cull(g.getRoot(), clip);
+      for (vector<pair<int, int> >::const_iterator i = visible.begin(); i != visible.end(); ++i) {
+        if (i->second && viewportCull.visible(i->first, eye) != 1) {
+          ar_log_error() << "TraversalTest: viewport cull lost sphere " << i->first << ".\n";
+          ok = false;
+        }
+      }
+    }
+    viewportCull.cull(g.getRoot(), clip);
+    usecUnion += viewportCull.getUsec();
+  }
+  cout << "  both eyes' viewport cull: " << usecUnion / cFrame / 1000. <<
+    " msec.\n  " << viewportCull.status();
+  return ok ? 0 : 1;
+}
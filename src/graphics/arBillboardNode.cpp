@@ -17,7 +17,7 @@ arBillboardNode::arBillboardNode():
   _typeString = "billboard";
 }
 
-void arBillboardNode::draw(arGraphicsContext*) {
+void arBillboardNode::draw(arGraphicsContext* context) {
   // Local copies.
   _nodeLock.lock("arBillboardNode::draw");
     const string text = _text;
@@ -67,6 +67,8 @@ void arBillboardNode::draw(arGraphicsContext*) {
 
   // Render text last, for its transparency.
   alphabet->renderText(parse, format);
+  if (context)
+    context->invalidateState();
 }
 
 bool arBillboardNode::receiveData(arStructuredData* inData) {
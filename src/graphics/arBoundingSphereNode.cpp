@@ -13,7 +13,7 @@ arBoundingSphereNode::arBoundingSphereNode() {
   _typeString = "bounding sphere";
 }
 
-void arBoundingSphereNode::draw(arGraphicsContext*) {
+void arBoundingSphereNode::draw(arGraphicsContext* context) {
   _nodeLock.lock("arBoundingSphereNode::draw");
     const bool vis = _boundingSphere.visibility;
     arVector3 p(_boundingSphere.position);
@@ -29,6 +29,8 @@ void arBoundingSphereNode::draw(arGraphicsContext*) {
   glTranslatef(p[0], p[1], p[2]);
   ar_glutWireSphere(r, 15, 15);
   glPopMatrix();
+  if (context)
+    context->invalidateState();
 }
 
 bool arBoundingSphereNode::receiveData(arStructuredData* inData) {
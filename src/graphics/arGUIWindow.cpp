@@ -17,6 +17,7 @@
 #include "arGUIEventManager.h"
 #include "arGUIInfo.h"
 #include "arGUIWindow.h"
+#include "arGUIWindowManager.h"
 
 // convenience define
 const double USEC = 1000000.0;
@@ -175,6 +176,8 @@ arGUIWindow::arGUIWindow( int ID, arGUIWindowConfig windowConfig,
   _zorder( AR_ZORDER_TOP ),
   _cursor( AR_CURSOR_NONE ),
   _lastFrameTime(ar_time()),
+  _drawTime( 0. ),
+  _drawTimeAverage( 0. ),
   _GUIEventManager(new arGUIEventManager( userData )),
   _windowBuffer(new arGUIWindowBuffer( true )),
   _creationCond("arGUIWindow-create, ID = " + ar_intToString(_ID)),
@@ -262,7 +265,11 @@ void arGUIWindow::_drawHandler( void )
   if (_graphicsWindow) {
     _graphicsWindow->setPixelDimensions( getPosX(), getPosY(), getWidth(), getHeight() );
   }
+  const ar_timeval start = ar_time();
   (*_drawCallback)( windowInfo, _graphicsWindow );
+  _drawTime = ar_difftimeSafe( ar_time(), start );
+  _drawTimeAverage = _drawTimeAverage == 0. ? _drawTime :
+    .9 * _drawTimeAverage + .1 * _drawTime;
 
   delete windowInfo;
 
@@ -332,6 +339,19 @@ void arGUIWindow::_mainLoop( void )
       // print error?
     }
   }
+
+  // Events queued after the last _processWMEvents won't run.  Release
+  // their waiters, and drop out of any swap barrier they were counted in.
+  arGuard _(_WMEventsMutex, "arGUIWindow::_mainLoop exit");
+  while ( !_WMEvents.empty() ) {
+    arWMEvent* wmEvent = _WMEvents.front();
+    if ( wmEvent->getEvent().getState() == AR_WINDOW_SWAP &&
+         wmEvent->getEvent().getFlag() == 1 && _windowManager ) {
+      _windowManager->_swapBarrier( wmEvent->getEvent().getPosX(), false );
+    }
+    wmEvent->signal();
+    _WMEvents.pop();
+  }
 }
 
 int arGUIWindow::_consumeWindowEvents( void )
@@ -419,6 +439,12 @@ arWMEvent* arGUIWindow::addWMEvent( arGUIWindowInfo& wmEvent )
   _usableEventsMutex.unlock();
 
   arGuard _(_WMEventsMutex, "arGUIWindow::addWMEvent WMEvents");
+  if ( !_running ) {
+    // Stopped meanwhile, so _mainLoop already released what was queued.
+    event->signal();
+    event->wait( false );
+    return NULL;
+  }
   _WMEvents.push( event );
   // If we are waiting in _consumeWindowEvents, release.
   _WMEventsVar.signal();
@@ -482,6 +508,10 @@ int arGUIWindow::_processWMEvents( void )
       break;
 
       case AR_WINDOW_SWAP:
+        // From swapAllWindowBuffers, wait for every window's thread.
+        if ( wmEvent->getEvent().getFlag() == 1 && _windowManager ) {
+          _windowManager->_swapBarrier( wmEvent->getEvent().getPosX() );
+        }
         if ( swap() < 0 ) {
           ar_log_error() << "_processWMEvents: swap failed.\n";
         }
@@ -702,6 +702,11 @@ class SZG_CALL arGUIWindow
     bool running( void ) const { return _running; }
     bool eventsPending( void ) const;
 
+    // Microseconds in the draw callback, most recent and smoothed.
+    // Written by the window's own thread in threaded mode.
+    float getDrawTime( void ) const { return _drawTime; }
+    float getDrawTimeAverage( void ) const { return _drawTimeAverage; }
+
     arCursor getCursor( void ) const { return _cursor; }
 
     int getBpp( void ) const { return _windowConfig.getBpp(); }
@@ -930,6 +935,8 @@ class SZG_CALL arGUIWindow
     arCursor _cursor;                           // The current window cursor.
 
     ar_timeval _lastFrameTime;                  // For framerate throttling
+    float _drawTime;                            // usec in the last _drawHandler
+    float _drawTimeAverage;                     // ...smoothed
 
     arGUIEventManager* _GUIEventManager;        // The window's arGUIEventManager.
     arGUIWindowBuffer* _windowBuffer;           // The window's arGUIWindowBuffer.
@@ -56,7 +56,13 @@ arGUIWindowManager::arGUIWindowManager( void (*windowCB)( arGUIWindowInfo* ) ,
   _windowInitGLCallback( windowInitGLCB ),
   _maxID( 0 ),
   _threaded( threaded ),
-  _fActivatedFramelock( false )
+  _fActivatedFramelock( false ),
+  _swapWindows( 0 ),
+  _swapWaiting( 0 ),
+  _swapGeneration( 0 ),
+  _swapEven( false ),
+  _swapOdd( false ),
+  _drawAllTime( 0. )
 {
 #if defined( AR_USE_LINUX ) || defined( AR_USE_DARWIN ) || defined( AR_USE_SGI )
   // seems to be necessary on OS X, not necessarily under linux, but probably
@@ -394,12 +400,102 @@ int arGUIWindowManager::drawWindow( const int ID, bool blocking )
 
 int arGUIWindowManager::swapAllWindowBuffers( bool blocking )
 {
-  return addAllWMEvent( arGUIWindowInfo( AR_WINDOW_EVENT, AR_WINDOW_SWAP ), blocking );
+  if ( !_threaded || _windows.size() < 2 ) {
+    return addAllWMEvent( arGUIWindowInfo( AR_WINDOW_EVENT, AR_WINDOW_SWAP ), blocking );
+  }
+
+  // Each window's thread swaps only after every window finished drawing
+  // and reached the swap, so windows on different projectors swap together
+  // (after the cluster barrier, if the caller syncs before swapping).
+  // Until the events are queued, no window can complete the barrier.
+  _swapLock.lock( "arGUIWindowManager::swapAllWindowBuffers" );
+    if ( _swapWaiting > 0 ) {
+      // A nonblocking swap's barrier is still open.  Don't wait for it.
+      _swapRelease();
+    }
+    const int generation = _swapGeneration;
+    _swapWindows = _windows.size() + 1;
+  _swapLock.unlock();
+
+  // A stopped window refuses the event, so count only those that took it.
+  // The event carries its barrier's generation, in posX.
+  EventVector eventHandles;
+  for( WindowIterator witr = _windows.begin(); witr != _windows.end(); witr++ ) {
+    arWMEvent* eventHandle = addWMEvent( witr->second->getID(),
+      arGUIWindowInfo( AR_WINDOW_EVENT, AR_WINDOW_SWAP, -1, 1, generation ) );
+    if ( eventHandle )
+      eventHandles.push_back( eventHandle );
+  }
+
+  _swapLock.lock( "arGUIWindowManager::swapAllWindowBuffers" );
+    if ( generation == _swapGeneration ) {
+      _swapWindows = eventHandles.size();
+      if ( _swapWaiting > 0 && _swapWaiting >= _swapWindows )
+        _swapRelease();
+    }
+  _swapLock.unlock();
+
+  for( EventIterator eitr = eventHandles.begin(); eitr != eventHandles.end(); eitr++ )
+    (*eitr)->wait( blocking );
+  return 0;
+}
+
+void arGUIWindowManager::_swapBarrier( const int generation, const bool wait )
+{
+  _swapLock.lock( "arGUIWindowManager::_swapBarrier" );
+  if ( generation != _swapGeneration ) {
+    // Already released (superseded by a later swap).
+    _swapLock.unlock();
+    return;
+  }
+  arThreadEvent& release = ( generation % 2 ) ? _swapOdd : _swapEven;
+  if ( ++_swapWaiting >= _swapWindows ) {
+    _swapRelease();
+    _swapLock.unlock();
+    return;
+  }
+  _swapLock.unlock();
+  if ( wait )
+    release.wait();
+}
+
+void arGUIWindowManager::_swapRelease( void )
+{
+  // Alternate two manual-reset events.  When the last window arrives,
+  // every window has left the previous barrier, so its event can be reset.
+  arThreadEvent& release = ( _swapGeneration % 2 ) ? _swapOdd : _swapEven;
+  _swapWaiting = 0;
+  ++_swapGeneration;
+  (( _swapGeneration % 2 ) ? _swapOdd : _swapEven).reset();
+  release.signal();
 }
 
 int arGUIWindowManager::drawAllWindows( bool blocking )
 {
-  return addAllWMEvent( arGUIWindowInfo( AR_WINDOW_EVENT, AR_WINDOW_DRAW ), blocking );
+  const ar_timeval start = ar_time();
+  const int ok = addAllWMEvent( arGUIWindowInfo( AR_WINDOW_EVENT, AR_WINDOW_DRAW ), blocking );
+  if ( blocking || !_threaded ) {
+    _drawAllTime = ar_difftimeSafe( ar_time(), start );
+  }
+  return ok;
+}
+
+std::string arGUIWindowManager::getDrawTimes( void )
+{
+  std::string s;
+  float total = 0.;
+  for ( WindowIterator i = _windows.begin(); i != _windows.end(); ++i ) {
+    const arGUIWindow* w = i->second;
+    total += w->getDrawTime();
+    s += "window " + ar_intToString( i->first ) + ": " +
+      ar_intToString( int( w->getDrawTime() ) ) + " usec (average " +
+      ar_intToString( int( w->getDrawTimeAverage() ) ) + ")\n";
+  }
+  if ( s.empty() )
+    return "No windows.\n";
+  return s + "all windows" + ( _threaded ? ", in parallel: " : ", serially: " ) +
+    ar_intToString( int( _drawAllTime ) ) + " usec (sum " +
+    ar_intToString( int( total ) ) + ")\n";
 }
 
 int arGUIWindowManager::consumeWindowEvents( const int ID, bool /*blocking*/ )
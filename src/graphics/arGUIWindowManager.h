@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "arGUIDefines.h"
+#include "arThread.h"
 #include "arGraphicsCalling.h"
 
 class arWMEvent;
@@ -353,6 +354,9 @@ class SZG_CALL arGUIWindowManager
     /**
      * Issue a swap request to every window.
      *
+     * @note In multi-threaded mode the windows' threads wait for each
+     *       other before swapping, so all windows swap together.
+     *
      * @note Operates similarly to \ref swapWindowBuffer with respect to
      *       single- vs multi-threading.
      *
@@ -574,6 +578,10 @@ class SZG_CALL arGUIWindowManager
     bool isThreaded( void ) const { return _threaded; }
     void setThreaded( bool threaded );
 
+    // Each window's draw time, and the last blocking drawAllWindows()'s
+    // (in multi-threaded mode, the slowest window's rather than the sum).
+    std::string getDrawTimes( void );
+
     void setUserData( void* userData ) { _userData = userData; }
     void* getUserData( void ) const { return _userData; }
     //@}
@@ -627,6 +635,7 @@ class SZG_CALL arGUIWindowManager
     //@}
 
   private:
+    friend class arGUIWindow;
 
     /**
      * Add a window manager message to a window.
@@ -682,6 +691,18 @@ class SZG_CALL arGUIWindowManager
      */
     void _sendDeleteEvent( const int ID );
 
+    /**
+     * Called from each window's thread on a swap from
+     * \ref swapAllWindowBuffers, to return only when all have called it.
+     * A window that stops before its swap calls it with wait false.
+     *
+     * @param generation The swap's barrier, from the event's posX.
+     * @param wait       False to only be counted.
+     */
+    void _swapBarrier( const int generation, const bool wait = true );
+    // Opens the current swap barrier.  Call with _swapLock held.
+    void _swapRelease( void );
+
     //@{
     /** @name Wrappers for the keyboard, mouse, and window callbacks.
      *
@@ -705,6 +726,14 @@ class SZG_CALL arGUIWindowManager
     bool _threaded;           // False iff windowmanager is singlethreaded.
     void* _userData;          // Default user defined data pointer passed to created windows.
     bool _fActivatedFramelock;
+
+    arLock _swapLock;         // Guards what follows.
+    int _swapWindows;         // Windows in the current swap barrier.
+    int _swapWaiting;         // ...of which have arrived.
+    int _swapGeneration;      // Swap barriers completed.
+    arThreadEvent _swapEven;  // Releases even-numbered barriers.
+    arThreadEvent _swapOdd;   // Releases odd ones.
+    float _drawAllTime;       // usec in the last blocking drawAllWindows.
 };
 
 #endif
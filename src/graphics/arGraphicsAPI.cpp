@@ -5,6 +5,7 @@
 
 #include "arPrecompiled.h"
 #include "arGraphicsAPI.h"
+#include "arGraphicsCommandBuffer.h"
 #include "arHead.h"
 
 // global variables
@@ -15,6 +16,33 @@ void dgSetGraphicsDatabase(arGraphicsDatabase* database) {
   __database = database;
 }
 
+arGraphicsDatabase* dgGetGraphicsDatabase() {
+  return __database;
+}
+
+// While this thread records into an arGraphicsCommandBuffer,
+// fill the buffer's own record instead of the database's shared one,
+// and append it to the buffer instead of altering the database.
+static arStructuredData* __record(arStructuredData* data) {
+  arGraphicsCommandBuffer* buffer = arGraphicsCommandBuffer::current();
+  return buffer ? buffer->scratch(data) : data;
+}
+
+static bool __alter(arStructuredData* data) {
+  arGraphicsCommandBuffer* buffer = arGraphicsCommandBuffer::current();
+  return buffer ? buffer->record(data) : __database->alter(data) != NULL;
+}
+
+// Returns the new node's ID, or -1.
+static int __makeNode(const string& name, const string& parent,
+                      const string& type) {
+  arGraphicsCommandBuffer* buffer = arGraphicsCommandBuffer::current();
+  if (buffer)
+    return buffer->makeNode(name, parent, type);
+  arDatabaseNode* node = dgMakeNode(name, parent, type);
+  return node ? node->getID() : -1;
+}
+
 string dgGetNodeName(int nodeID) {
   arDatabaseNode* theNode = __database->getNode(nodeID);
   if (!theNode) {
@@ -35,6 +63,10 @@ arDatabaseNode* dgMakeNode(const string& name,
     cerr << "syzygy error: dgSetGraphicsDatabase not yet called.\n";
     return NULL;
   }
+  if (arGraphicsCommandBuffer::current()) {
+    cerr << "dgMakeNode error: no node exists while recording an arGraphicsCommandBuffer.\n";
+    return NULL;
+  }
 
   arDatabaseNode* parentNode = __database->getNode(parent);
   if (!parentNode)
@@ -56,8 +88,8 @@ arDatabaseNode* dgMakeNode(const string& name,
 }
 
 int dgViewer( const string& parent, const arHead& head) {
-  arDatabaseNode* node = dgMakeNode("szg_viewer", parent, "viewer");
-  return node && dgViewer(node->getID(), head) ? node->getID() : -1;
+  const int ID = __makeNode("szg_viewer", parent, "viewer");
+  return ID >= 0 && dgViewer(ID, head) ? ID : -1;
 }
 
 // Friend of arHead, to directly access its data.
@@ -71,7 +103,7 @@ bool dgViewer( int ID, const arHead& head ) {
 #endif
   if (ID < 0)
     return false;
-  arStructuredData* data = __database->viewerData;
+  arStructuredData* data = __record(__database->viewerData);
   if (!data->dataIn(__gfx.AR_VIEWER_ID, &ID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_VIEWER_MATRIX, head._matrix.v , AR_FLOAT, AR_FLOATS_PER_MATRIX) ||
       !data->dataIn(__gfx.AR_VIEWER_MID_EYE_OFFSET, head._midEyeOffset.v , AR_FLOAT, AR_FLOATS_PER_POINT) ||
@@ -84,7 +116,7 @@ bool dgViewer( int ID, const arHead& head ) {
     cerr << "dgViewer error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 #if 0
@@ -98,7 +130,7 @@ bool dgViewer(const arMatrix4& headMatrix, const arVector3& midEyeOffset,
   }
   int fixedHeadInt = (int)fixedHeadMode;
   const ARint ID = node->getID();
-  arStructuredData* data = __database->viewerData;
+  arStructuredData* data = __record(__database->viewerData);
   if (!data->dataIn(__gfx.AR_VIEWER_ID, &ID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_VIEWER_MATRIX, headMatrix.v, AR_FLOAT, AR_FLOATS_PER_MATRIX) ||
       !data->dataIn(__gfx.AR_VIEWER_MID_EYE_OFFSET, midEyeOffset.v, AR_FLOAT, AR_FLOATS_PER_POINT) ||
@@ -111,80 +143,80 @@ bool dgViewer(const arMatrix4& headMatrix, const arVector3& midEyeOffset,
     cerr << "dgViewer error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
   }
 #endif
 
 int dgTransform(const string& name, const string& parent,
                 const arMatrix4& matrix) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "transform");
-  return node && dgTransform(node->getID(), matrix) ? node->getID() : -1;
+  const int ID = __makeNode(name, parent, "transform");
+  return ID >= 0 && dgTransform(ID, matrix) ? ID : -1;
 }
 
 bool dgTransform(int ID, const arMatrix4& matrix) {
   if (ID < 0)
     return false;
-  arStructuredData* data = __database->transformData;
+  arStructuredData* data = __record(__database->transformData);
   if (!data->dataIn(__gfx.AR_TRANSFORM_ID, &ID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_TRANSFORM_MATRIX, matrix.v, AR_FLOAT, AR_FLOATS_PER_MATRIX)) {
     cerr << "dgTransform error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int  dgPoints(const string& name, const string& parent,
               int num, int* IDs, float* coords) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "points");
-  return node && dgPoints(node->getID(), num, IDs, coords) ?
-    node->getID() : -1;
+  const int ID = __makeNode(name, parent, "points");
+  return ID >= 0 && dgPoints(ID, num, IDs, coords) ?
+    ID : -1;
 }
 
 bool dgPoints(int ID, int num, int* IDs, float* coords) {
   if (ID < 0)
     return false;
-  arStructuredData* data = __database->pointsData;
+  arStructuredData* data = __record(__database->pointsData);
   if (!data->dataIn(__gfx.AR_POINTS_ID, &ID, AR_INT, 1) ||
       !data->ptrIn(__gfx.AR_POINTS_POINT_IDS, IDs, num) ||
       !data->ptrIn(__gfx.AR_POINTS_POSITIONS, coords, AR_FLOATS_PER_POINT*num)) {
     cerr << "dgPoints error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgPoints(const string& name, const string& parent, int numPoints,
              float* positions) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "points");
-  return node && dgPoints(node->getID(), numPoints, positions) ?
-    node->getID() : -1;
+  const int ID = __makeNode(name, parent, "points");
+  return ID >= 0 && dgPoints(ID, numPoints, positions) ?
+    ID : -1;
 }
 
 bool dgPoints(int ID, int numPoints, float* positions) {
   if (ID < 0)
     return false;
   int IDs[1] = {-1};
-  arStructuredData* data = __database->pointsData;
+  arStructuredData* data = __record(__database->pointsData);
   if (!data->dataIn(__gfx.AR_POINTS_ID, &ID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_POINTS_POINT_IDS, IDs, AR_INT, 1) ||
       !data->ptrIn(__gfx.AR_POINTS_POSITIONS, positions, AR_FLOATS_PER_POINT*numPoints)) {
     cerr << "dgPoints error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgTexture(const string& name, const string& parent,
               const string& filename, int alphaValue) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "texture");
-  return node && dgTexture(node->getID(), filename, alphaValue) ?
-    node->getID() : -1;
+  const int ID = __makeNode(name, parent, "texture");
+  return ID >= 0 && dgTexture(ID, filename, alphaValue) ?
+    ID : -1;
 }
 
 bool dgTexture(int ID, const string& filename, int alphaValue) {
   if (ID < 0)
     return false;
-  arStructuredData* data = __database->textureData;
+  arStructuredData* data = __record(__database->textureData);
 
   // Zero width tells the implementation that this is
   // a file, not a bitmap. (This is a little confused.)
@@ -196,14 +228,14 @@ bool dgTexture(int ID, const string& filename, int alphaValue) {
     cerr << "dgTexture error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgTexture(const string& name, const string& parent,
               bool alpha, int w, int h, const char* pixels) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "texture");
-  return node && dgTexture(node->getID(), alpha, w, h, pixels) ?
-    node->getID() : -1;
+  const int ID = __makeNode(name, parent, "texture");
+  return ID >= 0 && dgTexture(ID, alpha, w, h, pixels) ?
+    ID : -1;
 }
 
 bool dgTexture(int ID, bool alpha, int w, int h, const char* pixels) {
@@ -211,7 +243,7 @@ bool dgTexture(int ID, bool alpha, int w, int h, const char* pixels) {
     return false;
   const int bytesPerPixel = alpha ? 4 : 3;
   const int cPixels = w * h * bytesPerPixel;
-  arStructuredData* data = __database->textureData;
+  arStructuredData* data = __record(__database->textureData);
   if (!data->dataIn(__gfx.AR_TEXTURE_ID, &ID, AR_INT, 1) ||
       !data->dataInString(__gfx.AR_TEXTURE_FILE, "") ||
       !data->dataIn(__gfx.AR_TEXTURE_ALPHA, &alpha, AR_INT, 1) ||
@@ -221,21 +253,21 @@ bool dgTexture(int ID, bool alpha, int w, int h, const char* pixels) {
     cerr << "dgTexture error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgBoundingSphere(const string& name, const string& parent,
                      int visibility, float radius, const arVector3& position) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "bounding sphere");
-  return node && dgBoundingSphere(node->getID(), visibility, radius, position)
-    ? node->getID() : -1;
+  const int ID = __makeNode(name, parent, "bounding sphere");
+  return ID >= 0 && dgBoundingSphere(ID, visibility, radius, position)
+    ? ID : -1;
 }
 
 bool dgBoundingSphere(int ID, int visibility, float radius,
                       const arVector3& position) {
   if (ID < 0)
     return false;
-  arStructuredData* data = __database->boundingSphereData;
+  arStructuredData* data = __record(__database->boundingSphereData);
   if (!data->dataIn(__gfx.AR_BOUNDING_SPHERE_ID, &ID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_BOUNDING_SPHERE_VISIBILITY, &visibility, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_BOUNDING_SPHERE_RADIUS, &radius, AR_FLOAT, 1) ||
@@ -243,87 +275,149 @@ bool dgBoundingSphere(int ID, int visibility, float radius,
     cerr << "dgBoundingSphere error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 bool dgErase(const string& name) {
-  arStructuredData* data = __database->eraseData;
-  arDatabaseNode* node = __database->getNode(name);
-  if (!node) {
+  arStructuredData* data = __record(__database->eraseData);
+  arGraphicsCommandBuffer* buffer = arGraphicsCommandBuffer::current();
+  int ID = buffer ? buffer->getNodeID(name) : __database->getNodeID(name);
+  if (ID < 0) {
     // error message was already printed in the above.
     return false;
   }
-  int ID = node->getID();
   if (!data->dataIn(__gfx.AR_ERASE_ID, &ID, AR_INT, 1)) {
     cerr << "dgErase error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgBillboard(const string& name, const string& parent,
                  int visibility, const string& text) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "billboard");
-  return node && dgBillboard(node->getID(), visibility, text) ?
-    node->getID() : -1;
+  const int ID = __makeNode(name, parent, "billboard");
+  return ID >= 0 && dgBillboard(ID, visibility, text) ?
+    ID : -1;
 }
 
 bool dgBillboard(int ID, int visibility, const string& text) {
   if (ID < 0)
     return false;
-  arStructuredData* data = __database->billboardData;
+  arStructuredData* data = __record(__database->billboardData);
   if (!data->dataIn(__gfx.AR_BILLBOARD_ID, &ID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_BILLBOARD_VISIBILITY, &visibility, AR_INT, 1) ||
       !data->dataInString(__gfx.AR_BILLBOARD_TEXT, text)) {
     cerr << "dgBillboard error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgVisibility(const string& name, const string& parent, int visibility) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "visibility");
-  return node && dgVisibility(node->getID(), visibility) ?
-    node->getID() : -1;
+  const int ID = __makeNode(name, parent, "visibility");
+  return ID >= 0 && dgVisibility(ID, visibility) ?
+    ID : -1;
 }
 
 bool dgVisibility(int ID, int visibility) {
   if (ID < 0)
     return false;
-  arStructuredData* data = __database->visibilityData;
+  arStructuredData* data = __record(__database->visibilityData);
   if (!data->dataIn(__gfx.AR_VISIBILITY_ID, &ID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_VISIBILITY_VISIBILITY, &visibility, AR_INT, 1)) {
     cerr << "dgVisibility error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
+}
+
+int dgLOD(const string& name, const string& parent, int mode,
+          const vector<float>& ranges, const arVector3& center, float radius) {
+  const int ID = __makeNode(name, parent, "lod");
+  return ID >= 0 && dgLOD(ID, mode, ranges, center, radius) ?
+    ID : -1;
+}
+
+bool dgLOD(int ID, int mode, const vector<float>& ranges,
+           const arVector3& center, float radius) {
+  if (ID < 0)
+    return false;
+  arStructuredData* data = __record(__database->lodData);
+  const float none = 0.;
+  if (!data->dataIn(__gfx.AR_LOD_ID, &ID, AR_INT, 1) ||
+      !data->dataIn(__gfx.AR_LOD_MODE, &mode, AR_INT, 1) ||
+      !data->dataIn(__gfx.AR_LOD_RANGES, ranges.empty() ? &none : &ranges[0],
+                    AR_FLOAT, ranges.size()) ||
+      !data->dataIn(__gfx.AR_LOD_CENTER, center.v, AR_FLOAT, 3) ||
+      !data->dataIn(__gfx.AR_LOD_RADIUS, &radius, AR_FLOAT, 1)) {
+    cerr << "dgLOD error: dataIn failed.\n";
+    return false;
+  }
+  return __alter(data);
+}
+
+int dgInstances(const string& name, const string& parent,
+                int numInstances, float* instances) {
+  const int ID = __makeNode(name, parent, "instance");
+  return ID >= 0 && dgInstances(ID, numInstances, instances) ?
+    ID : -1;
+}
+
+bool dgInstances(int ID, int numInstances, float* instances) {
+  if (ID < 0 || numInstances < 0)
+    return false;
+  int IDs[1] = {-1};
+  arStructuredData* data = __record(__database->instanceData);
+  if (!data->dataIn(__gfx.AR_INSTANCE_ID, &ID, AR_INT, 1) ||
+      !data->dataIn(__gfx.AR_INSTANCE_IDS, IDs, AR_INT, 1) ||
+      !data->ptrIn(__gfx.AR_INSTANCE_INSTANCES, instances, 20*numInstances) ||
+      !data->dataIn(__gfx.AR_INSTANCE_COUNT, &numInstances, AR_INT, 1)) {
+    cerr << "dgInstances error: dataIn failed.\n";
+    return false;
+  }
+  return __alter(data);
+}
+
+bool dgInstances(int ID, int numInstances, int* IDs, float* instances) {
+  if (ID < 0)
+    return false;
+  const int keep = -1;
+  arStructuredData* data = __record(__database->instanceData);
+  if (!data->dataIn(__gfx.AR_INSTANCE_ID, &ID, AR_INT, 1) ||
+      !data->ptrIn(__gfx.AR_INSTANCE_IDS, IDs, numInstances) ||
+      !data->ptrIn(__gfx.AR_INSTANCE_INSTANCES, instances, 20*numInstances) ||
+      !data->dataIn(__gfx.AR_INSTANCE_COUNT, &keep, AR_INT, 1)) {
+    cerr << "dgInstances error: dataIn failed.\n";
+    return false;
+  }
+  return __alter(data);
 }
 
 int dgBlend(const string& name, const string& parent, float factor) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "blend");
-  return node && dgBlend(node->getID(), factor) ?
-    node->getID() : -1;
+  const int ID = __makeNode(name, parent, "blend");
+  return ID >= 0 && dgBlend(ID, factor) ?
+    ID : -1;
 }
 
 bool dgBlend(int ID, float factor) {
   if (ID < 0)
     return false;
-  arStructuredData* data = __database->blendData;
+  arStructuredData* data = __record(__database->blendData);
   if (!data->dataIn(__gfx.AR_BLEND_ID, &ID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_BLEND_FACTOR, &factor, AR_FLOAT, 1)) {
     cerr << "dgBlend error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgStateInt(const string& nodeName, const string& parentName,
                const string& stateName,
                arGraphicsStateValue val1,
                arGraphicsStateValue val2 ) {
-  arDatabaseNode* node = dgMakeNode(nodeName, parentName, "state");
-  return (node && dgStateInt( node->getID(), stateName, val1, val2 )) ?
-    (node->getID()) : (-1);
+  const int ID = __makeNode(nodeName, parentName, "state");
+  return (ID >= 0 && dgStateInt( ID, stateName, val1, val2 )) ?
+    ID : -1;
 }
 bool dgStateInt( int nodeID, const string& stateName,
     arGraphicsStateValue val1, arGraphicsStateValue val2 ) {
@@ -333,7 +427,7 @@ bool dgStateInt( int nodeID, const string& stateName,
   tmp[0] = val1;
   tmp[1] = val2;
   float ftmp(0.);
-  arStructuredData* data = __database->graphicsStateData;
+  arStructuredData* data = __record(__database->graphicsStateData);
   if (!data->dataIn(__gfx.AR_GRAPHICS_STATE_ID, &nodeID, AR_INT, 1) ||
       !data->dataInString( __gfx.AR_GRAPHICS_STATE_STRING, stateName ) ||
       !data->dataIn( __gfx.AR_GRAPHICS_STATE_INT, tmp, AR_INT, 2 ) ||
@@ -341,14 +435,14 @@ bool dgStateInt( int nodeID, const string& stateName,
     cerr << "dgStateInt error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgStateFloat( const string& nodeName, const string& parentName,
     const string& stateName, float value ) {
-  arDatabaseNode* node = dgMakeNode(nodeName, parentName, "state");
-  return (node && dgStateFloat( node->getID(), stateName, value )) ?
-    (node->getID()) : (-1);
+  const int ID = __makeNode(nodeName, parentName, "state");
+  return (ID >= 0 && dgStateFloat( ID, stateName, value )) ?
+    ID : -1;
 }
 bool dgStateFloat( int nodeID, const string& stateName, float value ) {
   if (nodeID < 0)
@@ -356,7 +450,7 @@ bool dgStateFloat( int nodeID, const string& stateName, float value ) {
   arGraphicsStateValue tmp[2];
   tmp[0] = AR_G_FALSE;
   tmp[1] = AR_G_FALSE;
-  arStructuredData* data = __database->graphicsStateData;
+  arStructuredData* data = __record(__database->graphicsStateData);
   if (!data->dataIn(__gfx.AR_GRAPHICS_STATE_ID, &nodeID, AR_INT, 1) ||
       !data->dataInString( __gfx.AR_GRAPHICS_STATE_STRING, stateName ) ||
       !data->dataIn( __gfx.AR_GRAPHICS_STATE_INT, tmp, AR_INT, 2 ) ||
@@ -364,40 +458,40 @@ bool dgStateFloat( int nodeID, const string& stateName, float value ) {
     cerr << "dgStateFloat error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgNormal3(const string& name, const string& parent, int numNormals,
               int* IDs, float* normals) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "normal3");
-  return node && dgNormal3(node->getID(), numNormals, IDs, normals) ?
-    node->getID() : -1;
+  const int ID = __makeNode(name, parent, "normal3");
+  return ID >= 0 && dgNormal3(ID, numNormals, IDs, normals) ?
+    ID : -1;
 }
 
 bool dgNormal3(int ID, int numNormals, int* IDs, float* normals) {
   if (ID < 0)
     return false;
-  arStructuredData* data = __database->normal3Data;
+  arStructuredData* data = __record(__database->normal3Data);
   if (!data->dataIn(__gfx.AR_NORMAL3_ID, &ID, AR_INT, 1) ||
       !data->ptrIn(__gfx.AR_NORMAL3_NORMAL_IDS, IDs, numNormals) ||
       !data->ptrIn(__gfx.AR_NORMAL3_NORMALS, normals, AR_FLOATS_PER_NORMAL*numNormals)) {
     cerr << "dgNormal3 error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgNormal3(const string& name, const string& parent, int numNormals,
               float* normals) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "normal3");
-  return node && dgNormal3(node->getID(), numNormals, normals) ?
-    node->getID() : -1;
+  const int ID = __makeNode(name, parent, "normal3");
+  return ID >= 0 && dgNormal3(ID, numNormals, normals) ?
+    ID : -1;
 }
 
 bool dgNormal3(int ID, int numNormals, float* normals) {
   if (ID < 0)
     return false;
-  arStructuredData* data = __database->normal3Data;
+  arStructuredData* data = __record(__database->normal3Data);
   int IDs = -1;
   if (!data->dataIn(__gfx.AR_NORMAL3_ID, &ID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_NORMAL3_NORMAL_IDS, &IDs, AR_INT, 1) ||
@@ -405,7 +499,7 @@ bool dgNormal3(int ID, int numNormals, float* normals) {
     cerr << "dgNormal3 error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 // there sure is alot of cut-and-pasting with the API commands associated
@@ -414,145 +508,145 @@ bool dgNormal3(int ID, int numNormals, float* normals) {
 
 int dgColor4(const string& name, const string& parent, int numColors,
              int* IDs, float* colors) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "color4");
-  return node && dgColor4(node->getID(), numColors, IDs, colors) ?
-    node->getID() : -1;
+  const int ID = __makeNode(name, parent, "color4");
+  return ID >= 0 && dgColor4(ID, numColors, IDs, colors) ?
+    ID : -1;
 }
 
 bool dgColor4(int ID, int numColors, int* IDs, float* colors) {
   if (ID < 0)
     return false;
-  arStructuredData* data = __database->color4Data;
+  arStructuredData* data = __record(__database->color4Data);
   if (!data->dataIn(__gfx.AR_COLOR4_ID, &ID, AR_INT, 1) ||
       !data->ptrIn(__gfx.AR_COLOR4_COLOR_IDS, IDs, numColors) ||
       !data->ptrIn(__gfx.AR_COLOR4_COLORS, colors, AR_FLOATS_PER_COLOR*numColors)) {
     cerr << "dgColor4 error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgColor4(const string& name, const string& parent, int numColors,
              float* colors) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "color4");
-  return node && dgColor4(node->getID(), numColors, colors) ?
-    node->getID() : -1;
+  const int ID = __makeNode(name, parent, "color4");
+  return ID >= 0 && dgColor4(ID, numColors, colors) ?
+    ID : -1;
 }
 
 bool dgColor4(int ID, int numColors, float* colors) {
   if (ID < 0)
     return false;
   int IDs[1] = {-1};
-  arStructuredData* data = __database->color4Data;
+  arStructuredData* data = __record(__database->color4Data);
   if (!data->dataIn(__gfx.AR_COLOR4_ID, &ID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_COLOR4_COLOR_IDS, IDs, AR_INT, 1) ||
       !data->ptrIn(__gfx.AR_COLOR4_COLORS, colors, AR_FLOATS_PER_COLOR*numColors)) {
     cerr << "dgColor4 error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgTex2(const string& name, const string& parent, int numTexcoords,
            int* IDs, float* coords) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "tex2");
-  return node && dgTex2(node->getID(), numTexcoords, IDs, coords) ?
-    node->getID() : -1;
+  const int ID = __makeNode(name, parent, "tex2");
+  return ID >= 0 && dgTex2(ID, numTexcoords, IDs, coords) ?
+    ID : -1;
 }
 
 bool dgTex2(int ID, int numTexcoords, int* IDs, float* coords) {
   if (ID < 0)
     return false;
-  arStructuredData* data = __database->tex2Data;
+  arStructuredData* data = __record(__database->tex2Data);
   if (!data->dataIn(__gfx.AR_TEX2_ID, &ID, AR_INT, 1) ||
       !data->ptrIn(__gfx.AR_TEX2_TEX_IDS, IDs, numTexcoords) ||
       !data->ptrIn(__gfx.AR_TEX2_COORDS, coords, AR_FLOATS_PER_TEXCOORD*numTexcoords)) {
     cerr << "dgTex2 error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgTex2(const string& name, const string& parent, int numTexcoords,
            float* coords) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "tex2");
-  return node && dgTex2(node->getID(), numTexcoords, coords) ?
-    node->getID() : -1;
+  const int ID = __makeNode(name, parent, "tex2");
+  return ID >= 0 && dgTex2(ID, numTexcoords, coords) ?
+    ID : -1;
 }
 
 bool dgTex2(int ID, int numTexcoords, float* coords) {
   if (ID < 0)
     return false;
   int IDs[1] = {-1};
-  arStructuredData* data = __database->tex2Data;
+  arStructuredData* data = __record(__database->tex2Data);
   if (!data->dataIn(__gfx.AR_TEX2_ID, &ID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_TEX2_TEX_IDS, IDs, AR_INT, 1) ||
       !data->ptrIn(__gfx.AR_TEX2_COORDS, coords, AR_FLOATS_PER_TEXCOORD*numTexcoords)) {
     cerr << "dgTex2 error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgIndex(const string& name, const string& parent, int numIndices,
             int* IDs, int* indices) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "index");
-  return node && dgIndex(node->getID(), numIndices, IDs, indices) ?
-    node->getID() : -1;
+  const int ID = __makeNode(name, parent, "index");
+  return ID >= 0 && dgIndex(ID, numIndices, IDs, indices) ?
+    ID : -1;
 }
 
 bool dgIndex(int ID, int numIndices, int* IDs, int* indices) {
   if (ID < 0)
     return false;
-  arStructuredData* data = __database->indexData;
+  arStructuredData* data = __record(__database->indexData);
   if (!data->dataIn(__gfx.AR_INDEX_ID, &ID, AR_INT, 1) ||
       !data->ptrIn(__gfx.AR_INDEX_INDEX_IDS, IDs, numIndices) ||
       !data->ptrIn(__gfx.AR_INDEX_INDICES, indices, numIndices)) {
     cerr << "dgIndex error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgIndex(const string& name, const string& parent, int numIndices,
             int* indices) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "index");
-  return node && dgIndex(node->getID(), numIndices, indices) ?
-    node->getID() : -1;
+  const int ID = __makeNode(name, parent, "index");
+  return ID >= 0 && dgIndex(ID, numIndices, indices) ?
+    ID : -1;
 }
 
 bool dgIndex(int ID, int numIndices, int* indices) {
   if (ID < 0)
     return false;
   int IDs[1] = {-1};
-  arStructuredData* data = __database->indexData;
+  arStructuredData* data = __record(__database->indexData);
   if (!data->dataIn(__gfx.AR_INDEX_ID, &ID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_INDEX_INDEX_IDS, IDs, AR_INT, 1) ||
       !data->ptrIn(__gfx.AR_INDEX_INDICES, indices, numIndices)) {
     cerr << "dgIndex error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgDrawable(const string& name, const string& parent,
                int drawableType, int numPrimitives) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "drawable");
-  return node && dgDrawable(node->getID(), drawableType, numPrimitives) ?
-    node->getID() : -1;
+  const int ID = __makeNode(name, parent, "drawable");
+  return ID >= 0 && dgDrawable(ID, drawableType, numPrimitives) ?
+    ID : -1;
 }
 
 bool dgDrawable(int ID, int drawableType, int numPrimitives) {
   if (ID < 0)
     return false;
-  arStructuredData* data = __database->drawableData;
+  arStructuredData* data = __record(__database->drawableData);
   if (!data->dataIn(__gfx.AR_DRAWABLE_ID, &ID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_DRAWABLE_TYPE, &drawableType, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_DRAWABLE_NUMBER, &numPrimitives, AR_INT, 1)) {
     cerr << "dgDrawable error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgMaterial(const string& name,
@@ -563,10 +657,10 @@ int dgMaterial(const string& name,
                const arVector3& emissive,
                float exponent,
                float alpha) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "material");
-  return node && dgMaterial(node->getID(), diffuse, ambient,
+  const int ID = __makeNode(name, parent, "material");
+  return ID >= 0 && dgMaterial(ID, diffuse, ambient,
                             specular, emissive, exponent, alpha) ?
-    node->getID() : -1;
+    ID : -1;
 }
 
 bool dgMaterial(int ID,
@@ -578,7 +672,7 @@ bool dgMaterial(int ID,
                 float alpha) {
   if (ID < 0)
     return false;
-  arStructuredData* data = __database->materialData;
+  arStructuredData* data = __record(__database->materialData);
   if (!data->dataIn(__gfx.AR_MATERIAL_ID, &ID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_MATERIAL_DIFFUSE, diffuse.v, AR_FLOAT, 3) ||
       !data->dataIn(__gfx.AR_MATERIAL_AMBIENT, ambient.v, AR_FLOAT, 3) ||
@@ -589,7 +683,7 @@ bool dgMaterial(int ID,
     cerr << "dgMaterial error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 // OpenGL interprets light positions weirdly.  If the fourth value
@@ -608,11 +702,11 @@ int dgLight(const string& name,
             const arVector3& spotDirection,
             float spotCutoff,
             float spotExponent) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "light");
-  return node && dgLight(node->getID(), lightID, position,
+  const int ID = __makeNode(name, parent, "light");
+  return ID >= 0 && dgLight(ID, lightID, position,
                          diffuse, ambient, specular, attenuate, spotDirection,
                          spotCutoff, spotExponent) ?
-    node->getID() : -1;
+    ID : -1;
 }
 
 bool dgLight(int ID,
@@ -632,7 +726,7 @@ bool dgLight(int ID,
                    spotDirection.v[2],
                    spotCutoff,
                    spotExponent };
-  arStructuredData* data = __database->lightData;
+  arStructuredData* data = __record(__database->lightData);
   if (!data->dataIn(__gfx.AR_LIGHT_ID, &ID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_LIGHT_LIGHT_ID, &lightID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_LIGHT_POSITION, position.v, AR_FLOAT, 4) ||
@@ -644,7 +738,7 @@ bool dgLight(int ID,
     cerr << "dgLight error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgCamera(const string& name, const string& parent,
@@ -653,11 +747,11 @@ int dgCamera(const string& name, const string& parent,
              const arVector3& eyePosition,
              const arVector3& centerPosition,
              const arVector3& upDirection) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "persp camera");
-  return node && dgCamera(node->getID(), cameraID, leftClip,
+  const int ID = __makeNode(name, parent, "persp camera");
+  return ID >= 0 && dgCamera(ID, cameraID, leftClip,
                           rightClip, bottomClip, topClip, nearClip, farClip,
                           eyePosition, centerPosition, upDirection) ?
-    node->getID() : -1;
+    ID : -1;
 }
 
 bool dgCamera(int ID,
@@ -674,7 +768,7 @@ bool dgCamera(int ID,
                     centerPosition.v[0], centerPosition.v[1],
                     centerPosition.v[2],
                     upDirection.v[0], upDirection.v[1], upDirection.v[2]};
-  arStructuredData* data = __database->perspCameraData;
+  arStructuredData* data = __record(__database->perspCameraData);
   if (!data->dataIn(__gfx.AR_PERSP_CAMERA_ID, &ID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_PERSP_CAMERA_CAMERA_ID, &cameraID, AR_INT, 1) ||
       !data->dataIn(__gfx.AR_PERSP_CAMERA_FRUSTUM, temp1, AR_FLOAT, 6) ||
@@ -682,27 +776,27 @@ bool dgCamera(int ID,
     cerr << "dgCamera error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgBumpMap(const string& name, const string& parent,
               const string& filename, float height) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "bump map");
-  return node && dgBumpMap(node->getID(), filename, height) ?
-    node->getID() : -1;
+  const int ID = __makeNode(name, parent, "bump map");
+  return ID >= 0 && dgBumpMap(ID, filename, height) ?
+    ID : -1;
 }
 
 bool dgBumpMap(int ID, const string& filename, float height) {
   if (ID < 0)
     return false;
-  arStructuredData* data = __database->bumpMapData;
+  arStructuredData* data = __record(__database->bumpMapData);
   if (!data->dataIn(__gfx.AR_BUMPMAP_ID, &ID, AR_INT, 1) ||
       !data->dataInString(__gfx.AR_BUMPMAP_FILE, filename) ||
       !data->dataIn(__gfx.AR_BUMPMAP_HEIGHT, &height, AR_FLOAT, 1)) {
     cerr << "dgBumpMap error: dataIn failed.\n";
     return false;
   }
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgPlugin(const string& name,
@@ -713,15 +807,15 @@ int dgPlugin(const string& name,
                long* longData, int numLongs,
                double* doubleData, int numDoubles,
                std::vector< std::string >* stringData ) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "graphics plugin");
-  if (!node) {
+  const int ID = __makeNode(name, parent, "graphics plugin");
+  if (ID < 0) {
     return -1;
   }
-  if (!dgPlugin( node->getID(), fileName, intData, numInts, floatData, numFloats,
+  if (!dgPlugin( ID, fileName, intData, numInts, floatData, numFloats,
         longData, numLongs, doubleData, numDoubles, stringData )) {
     return -1;
   }
-  return node->getID();
+  return ID;
 }
 
 bool dgPlugin( int ID, const string& fileName,
@@ -732,7 +826,7 @@ bool dgPlugin( int ID, const string& fileName,
                std::vector< std::string >* stringData ) {
   if (ID < 0)
     return false;
-  arStructuredData* data = __database->graphicsPluginData;
+  arStructuredData* data = __record(__database->graphicsPluginData);
   if (!data->dataIn( __gfx.AR_GRAPHICS_PLUGIN_ID, &ID, AR_INT, 1 )) {
     ar_log_error() << "dgPlugin failed to set ID.\n";
     return false;
@@ -782,7 +876,7 @@ bool dgPlugin( int ID, const string& fileName,
     return false;
   }
 
-  return __database->alter(data);
+  return __alter(data);
 }
 
 int dgPlugin(const string& name,
@@ -793,10 +887,10 @@ int dgPlugin(const string& name,
                std::vector<long>& longData,
                std::vector<double>& doubleData,
                std::vector< std::string >& stringData ) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "graphics plugin");
-  return (node && dgPlugin( node->getID(), fileName, intData, floatData, longData,
+  const int ID = __makeNode(name, parent, "graphics plugin");
+  return (ID >= 0 && dgPlugin( ID, fileName, intData, floatData, longData,
                             doubleData, stringData )) ?
-    node->getID() : -1;
+    ID : -1;
 }
 
 bool dgPlugin( int ID, const string& fileName,
@@ -841,11 +935,11 @@ int dgPython(const string& name,
                long* longData, int numLongs,
                double* doubleData, int numDoubles,
                std::vector< std::string >* stringData ) {
-  arDatabaseNode* node = dgMakeNode(name, parent, "graphics plugin");
-  return (node && dgPython( node->getID(), moduleName, factoryName, reloadModule,
+  const int ID = __makeNode(name, parent, "graphics plugin");
+  return (ID >= 0 && dgPython( ID, moduleName, factoryName, reloadModule,
         intData, numInts, floatData, numFloats,
         longData, numLongs, doubleData, numDoubles, stringData )) ?
-    node->getID() : -1;
+    ID : -1;
 }
 
 bool dgPython( int ID, const string& moduleName,
@@ -30,6 +30,10 @@ const int AR_FLOATS_PER_TEXCOORD = 2;
 const int AR_FLOATS_PER_COLOR = 4;
 
 SZG_CALL void dgSetGraphicsDatabase(arGraphicsDatabase*);
+SZG_CALL arGraphicsDatabase* dgGetGraphicsDatabase();
+
+// All dg* calls are routed to the calling thread's arGraphicsCommandBuffer,
+// between its begin() and end().
 
 SZG_CALL string dgGetNodeName(int);
 
@@ -70,6 +74,20 @@ SZG_CALL bool dgBillboard(int, int, const string&);
 SZG_CALL int dgVisibility(const string&, const string&, int);
 SZG_CALL bool dgVisibility(int, int);
 
+// See arLODNode.h.
+SZG_CALL int dgLOD(const string& name, const string& parent, int mode,
+                   const vector<float>& ranges,
+                   const arVector3& center, float radius);
+SZG_CALL bool dgLOD(int ID, int mode, const vector<float>& ranges,
+                    const arVector3& center, float radius);
+
+// Instances are 20 floats each:  a column-major matrix, then an RGBA.
+// Without IDs, replace all of them;  with IDs, change or add some.
+SZG_CALL int dgInstances(const string& name, const string& parent,
+                         int numInstances, float* instances);
+SZG_CALL bool dgInstances(int ID, int numInstances, float* instances);
+SZG_CALL bool dgInstances(int ID, int numInstances, int* IDs, float* instances);
+
 SZG_CALL int dgBlend(const string&, const string&, float);
 SZG_CALL bool dgBlend(int, float);
 
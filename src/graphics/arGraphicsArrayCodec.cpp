@@ -0,0 +1,426 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arGraphicsArrayCodec.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+
+#include <math.h>
+#include <sstream>
+
+// How a record type packs.
+struct arPackKind {
+  int flag;
+  int IDField;
+  int indexField;
+  int dataField;
+  unsigned stride;   // floats per element
+  unsigned codes;    // codes per element
+  unsigned axes;     // quantized against a range, or 0
+};
+
+static bool ar_packKind(const arGraphicsLanguage& l, int recordType, arPackKind& k) {
+  if (recordType == l.AR_POINTS) {
+    const arPackKind p = { AR_PACK_POSITIONS, l.AR_POINTS_ID,
+      l.AR_POINTS_POINT_IDS, l.AR_POINTS_POSITIONS, 3, 3, 3 };
+    k = p;
+  }
+  else if (recordType == l.AR_NORMAL3) {
+    const arPackKind p = { AR_PACK_NORMALS, l.AR_NORMAL3_ID,
+      l.AR_NORMAL3_NORMAL_IDS, l.AR_NORMAL3_NORMALS, 3, 2, 0 };
+    k = p;
+  }
+  else if (recordType == l.AR_COLOR4) {
+    const arPackKind p = { AR_PACK_COLORS, l.AR_COLOR4_ID,
+      l.AR_COLOR4_COLOR_IDS, l.AR_COLOR4_COLORS, 4, 4, 0 };
+    k = p;
+  }
+  else if (recordType == l.AR_TEX2) {
+    const arPackKind p = { AR_PACK_TEX, l.AR_TEX2_ID,
+      l.AR_TEX2_TEX_IDS, l.AR_TEX2_COORDS, 2, 2, 2 };
+    k = p;
+  }
+  else {
+    return false;
+  }
+  return true;
+}
+
+static const float CODE_MAX = 65535.f;
+
+// The box around count elements, as each axis's minimum and then its
+// step per code.  A padded box leaves deltas room to deform.
+static void ar_packRange(const arPackKind& k, const float* v, int count, bool pad,
+                         float* range) {
+  for (unsigned axis=0; axis<k.axes; ++axis) {
+    float lo = v[axis];
+    float hi = lo;
+    for (int i=1; i<count; ++i) {
+      const float x = v[k.stride*i + axis];
+      if (x < lo)
+        lo = x;
+      else if (x > hi)
+        hi = x;
+    }
+    float extent = hi - lo;
+    const float least = 1e-6f * (1.f + fabs(lo) + fabs(hi));
+    if (extent < least)
+      extent = least;
+    if (pad) {
+      lo -= extent / 8.f;
+      extent *= 1.25f;
+    }
+    range[axis] = lo;
+    range[k.axes + axis] = extent / CODE_MAX;
+  }
+}
+
+static inline unsigned short ar_octCode(float x) {
+  return (unsigned short)((x * .5f + .5f) * CODE_MAX + .5f);
+}
+
+static inline float ar_octValue(unsigned short c) {
+  return c * (2.f / CODE_MAX) - 1.f;
+}
+
+static inline float ar_sign(float x) {
+  return x < 0.f ? -1.f : 1.f;
+}
+
+// Quantize count elements into codes.  False if one lies outside range.
+static bool ar_quantize(const arPackKind& k, const float* v, int count,
+                        const float* range, vector<unsigned short>& codes) {
+  codes.resize(count * k.codes);
+  unsigned short* c = codes.empty() ? NULL : &codes[0];
+  int i;
+  switch (k.flag) {
+  case AR_PACK_POSITIONS:
+  case AR_PACK_TEX:
+    for (i=0; i<count; ++i) {
+      for (unsigned axis=0; axis<k.axes; ++axis) {
+        const float q = (v[axis] - range[axis]) / range[k.axes + axis] + .5f;
+        if (!(q >= 0.f && q < CODE_MAX + 1.f))
+          return false;
+        *c++ = (unsigned short)q;
+      }
+      v += k.stride;
+    }
+    break;
+  case AR_PACK_NORMALS:
+    // Octahedral:  project onto |x|+|y|+|z| = 1, then fold the lower
+    // half over the upper.
+    for (i=0; i<count; ++i, v+=3) {
+      float s = fabs(v[0]) + fabs(v[1]) + fabs(v[2]);
+      float x = 0.f, y = 0.f;
+      if (s > 0.f) {
+        x = v[0] / s;
+        y = v[1] / s;
+        if (v[2] < 0.f) {
+          const float t = x;
+          x = (1.f - fabs(y)) * ar_sign(t);
+          y = (1.f - fabs(t)) * ar_sign(y);
+        }
+      }
+      *c++ = ar_octCode(x);
+      *c++ = ar_octCode(y);
+    }
+    break;
+  case AR_PACK_COLORS:
+    for (i=0; i<count*4; ++i) {
+      const float x = v[i];
+      *c++ = (unsigned short)(x <= 0.f ? 0 : x >= 1.f ? 255 : int(x * 255.f + .5f));
+    }
+    break;
+  }
+  return true;
+}
+
+static void ar_dequantize(const arPackKind& k, const unsigned short* c, int count,
+                          const float* range, float* v) {
+  int i;
+  switch (k.flag) {
+  case AR_PACK_POSITIONS:
+  case AR_PACK_TEX:
+    for (i=0; i<count; ++i) {
+      for (unsigned axis=0; axis<k.axes; ++axis)
+        v[axis] = range[axis] + *c++ * range[k.axes + axis];
+      v += k.stride;
+    }
+    break;
+  case AR_PACK_NORMALS:
+    for (i=0; i<count; ++i, v+=3) {
+      float x = ar_octValue(*c++);
+      float y = ar_octValue(*c++);
+      const float z = 1.f - fabs(x) - fabs(y);
+      if (z < 0.f) {
+        const float t = x;
+        x = (1.f - fabs(y)) * ar_sign(t);
+        y = (1.f - fabs(t)) * ar_sign(y);
+      }
+      const float s = 1.f / sqrt(x*x + y*y + z*z);
+      v[0] = x * s;
+      v[1] = y * s;
+      v[2] = z * s;
+    }
+    break;
+  case AR_PACK_COLORS:
+    for (i=0; i<count*4; ++i)
+      v[i] = *c++ * (1.f / 255.f);
+    break;
+  }
+}
+
+// Key frames hold codes as bytes (colors) or 16-bit little-endian words.
+static int ar_writeKey(const arPackKind& k, const vector<unsigned short>& codes,
+                       unsigned char* out) {
+  unsigned char* p = out;
+  if (k.flag == AR_PACK_COLORS) {
+    for (unsigned i=0; i<codes.size(); ++i)
+      *p++ = (unsigned char)codes[i];
+  }
+  else {
+    for (unsigned i=0; i<codes.size(); ++i) {
+      *p++ = (unsigned char)(codes[i] & 0xff);
+      *p++ = (unsigned char)(codes[i] >> 8);
+    }
+  }
+  return p - out;
+}
+
+// Deltas are zigzagged varints;  a zero byte starts a run of unchanged
+// codes, whose length less one follows as a varint.
+static inline unsigned char* ar_writeVarint(unsigned v, unsigned char* p) {
+  while (v >= 0x80) {
+    *p++ = (unsigned char)(v | 0x80);
+    v >>= 7;
+  }
+  *p++ = (unsigned char)v;
+  return p;
+}
+
+static inline bool ar_readVarint(const unsigned char*& p, const unsigned char* end,
+                                 unsigned& v) {
+  v = 0;
+  for (int shift=0; p<end && shift<32; shift+=7) {
+    const unsigned char b = *p++;
+    v |= unsigned(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+static int ar_writeDelta(const vector<unsigned short>& base,
+                         const vector<unsigned short>& codes, unsigned char* out) {
+  unsigned char* p = out;
+  const unsigned n = codes.size();
+  for (unsigned i=0; i<n; ) {
+    if (codes[i] == base[i]) {
+      unsigned run = 1;
+      while (i+run < n && codes[i+run] == base[i+run])
+        ++run;
+      *p++ = 0;
+      p = ar_writeVarint(run - 1, p);
+      i += run;
+      continue;
+    }
+    const int d = int(codes[i]) - int(base[i]);
+    p = ar_writeVarint(d < 0 ? unsigned(-d) * 2 - 1 : unsigned(d) * 2, p);
+    ++i;
+  }
+  return p - out;
+}
+
+static bool ar_readDelta(const unsigned char* p, const unsigned char* end,
+                         vector<unsigned short>& codes) {
+  const unsigned n = codes.size();
+  unsigned i = 0;
+  while (p < end && i < n) {
+    unsigned v;
+    if (*p == 0) {
+      ++p;
+      if (!ar_readVarint(p, end, v) || v >= n - i)
+        return false;
+      i += v + 1;
+      continue;
+    }
+    if (!ar_readVarint(p, end, v))
+      return false;
+    const int d = (v & 1) ? -int((v + 1) / 2) : int(v / 2);
+    codes[i] = (unsigned short)(codes[i] + d);
+    ++i;
+  }
+  return p == end && i == n;
+}
+
+enum { FORMAT_TYPE = 0, FORMAT_ENCODING, FORMAT_COUNT, FORMAT_STREAM,
+       FORMAT_FRAME, FORMAT_BASE, FORMAT_SIZE };
+
+arGraphicsArrayEncoder::arGraphicsArrayEncoder() :
+  records(0),
+  keyFrames(0),
+  bytesRaw(0.),
+  bytesPacked(0.),
+  _encoding(0),
+  _keyInterval(60),
+  _packed(NULL) {
+  // Tell streams from different encoders apart, in case a receiver
+  // gets a node's records from two of them.
+  static int serial = 0;
+  const ar_timeval now = ar_time();
+  _stream = int((unsigned(now.usec) ^ (unsigned(now.sec) << 10) ^
+                 unsigned(++serial) * 2654435761u) & 0x7fffffff);
+}
+
+arGraphicsArrayEncoder::~arGraphicsArrayEncoder() {
+  delete _packed;
+}
+
+void arGraphicsArrayEncoder::setEncoding(int encoding) {
+  _encoding = encoding & AR_PACK_ALL;
+  _streams.clear();
+}
+
+void arGraphicsArrayEncoder::setKeyInterval(int frames) {
+  _keyInterval = frames < 1 ? 1 : frames;
+}
+
+arStructuredData* arGraphicsArrayEncoder::encode(const arGraphicsLanguage& l,
+                                                 arStructuredData* data) {
+  arPackKind k;
+  if (!_encoding || !ar_packKind(l, data->getID(), k) || !(_encoding & k.flag))
+    return NULL;
+
+  // Only whole arrays, in order.
+  const int count = data->getDataDimension(k.dataField) / k.stride;
+  const int cID = data->getDataDimension(k.indexField);
+  const ARint* IDs = (const ARint*)data->getDataPtr(k.indexField, AR_INT);
+  if (count <= 0 || cID <= 0)
+    return NULL;
+  if (IDs[0] != -1) {
+    if (cID != count)
+      return NULL;
+    for (int i=0; i<count; ++i)
+      if (IDs[i] != i)
+        return NULL;
+  }
+
+  if (!_packed) {
+    _packed = new arStructuredData(
+      ((arGraphicsLanguage&)l).find(l.AR_PACKED_ARRAY));
+  }
+  const float* v = (const float*)data->getDataPtr(k.dataField, AR_FLOAT);
+  Stream& s = _streams[data->getDataInt(k.IDField)];
+  const unsigned cCode = count * k.codes;
+  bool delta = (_encoding & AR_PACK_DELTA) && s.frame >= 0 &&
+    s.codes.size() == cCode && s.key < _keyInterval &&
+    ar_quantize(k, v, count, s.range, _codes);
+  if (!delta) {
+    ar_packRange(k, v, count, (_encoding & AR_PACK_DELTA) != 0, s.range);
+    (void)ar_quantize(k, v, count, s.range, _codes);
+  }
+
+  // Deltas can take 3 bytes per code.
+  _packed->setDataDimension(l.AR_PACKED_ARRAY_CODES, 3 * cCode);
+  unsigned char* out =
+    (unsigned char*)_packed->getDataPtr(l.AR_PACKED_ARRAY_CODES, AR_CHAR);
+  const int cByte = delta ? ar_writeDelta(s.codes, _codes, out) :
+                            ar_writeKey(k, _codes, out);
+  _packed->setDataDimension(l.AR_PACKED_ARRAY_CODES, cByte);
+  s.codes.swap(_codes);
+
+  const ARint format[FORMAT_SIZE] = { data->getID(),
+    k.flag | (delta ? AR_PACK_DELTA : 0), count, _stream, s.frame + 1,
+    delta ? s.frame : -1 };
+  ++s.frame;
+  s.key = delta ? s.key + 1 : 0;
+
+  // The whole ID field, which may carry arGraphicsPeer's routing.
+  _packed->dataIn(l.AR_PACKED_ARRAY_ID, data->getDataPtr(k.IDField, AR_INT),
+                  AR_INT, data->getDataDimension(k.IDField));
+  _packed->dataIn(l.AR_PACKED_ARRAY_FORMAT, format, AR_INT, FORMAT_SIZE);
+  _packed->dataIn(l.AR_PACKED_ARRAY_RANGE, s.range, AR_FLOAT, 2 * k.axes);
+
+  ++records;
+  if (!delta)
+    ++keyFrames;
+  bytesRaw += data->size();
+  bytesPacked += _packed->size();
+  return _packed;
+}
+
+string arGraphicsArrayEncoder::print() const {
+  ostringstream s;
+  s << "  packing " << _encoding << ": " << records << " records (" <<
+    keyFrames << " key frames), " << bytesRaw << " bytes packed into " <<
+    bytesPacked << ".\n";
+  return s.str();
+}
+
+bool ar_unpackArray(const arGraphicsLanguage& l, arStructuredData* packed,
+                    int recordType, unsigned stride,
+                    arLightFloatBuffer& elements, arPackedArrayState& state) {
+  arPackKind k;
+  if (packed->getDataDimension(l.AR_PACKED_ARRAY_FORMAT) != FORMAT_SIZE ||
+      !ar_packKind(l, recordType, k) || k.stride != stride) {
+    ar_log_error() << "ar_unpackArray: malformed record.\n";
+    return false;
+  }
+  const ARint* format = (const ARint*)packed->getDataPtr(l.AR_PACKED_ARRAY_FORMAT, AR_INT);
+  const int count = format[FORMAT_COUNT];
+  const bool delta = (format[FORMAT_ENCODING] & AR_PACK_DELTA) != 0;
+  if (format[FORMAT_TYPE] != recordType ||
+      (format[FORMAT_ENCODING] & ~AR_PACK_DELTA) != k.flag ||
+      count <= 0 ||
+      packed->getDataDimension(l.AR_PACKED_ARRAY_RANGE) != int(2 * k.axes)) {
+    ar_log_error() << "ar_unpackArray: malformed record.\n";
+    return false;
+  }
+
+  const unsigned cCode = count * k.codes;
+  const unsigned char* p =
+    (const unsigned char*)packed->getDataPtr(l.AR_PACKED_ARRAY_CODES, AR_CHAR);
+  const int cByte = packed->getDataDimension(l.AR_PACKED_ARRAY_CODES);
+  if (delta) {
+    if (state.stream != format[FORMAT_STREAM] ||
+        state.frame != format[FORMAT_BASE] || state.codes.size() != cCode) {
+      // Lost the base (another sender, or an unpacked update to the
+      // sender's node).  Wait for a key frame.
+      ar_log_debug() << "ar_unpackArray skipping delta without its base.\n";
+      return true;
+    }
+    if (!ar_readDelta(p, p + cByte, state.codes)) {
+      state.frame = -1;
+      ar_log_error() << "ar_unpackArray: malformed delta.\n";
+      return false;
+    }
+  }
+  else {
+    const unsigned width = k.flag == AR_PACK_COLORS ? 1 : 2;
+    if (unsigned(cByte) != cCode * width) {
+      ar_log_error() << "ar_unpackArray: malformed key frame.\n";
+      return false;
+    }
+    state.codes.resize(cCode);
+    if (width == 1) {
+      for (unsigned i=0; i<cCode; ++i)
+        state.codes[i] = p[i];
+    }
+    else {
+      for (unsigned i=0; i<cCode; ++i, p+=2)
+        state.codes[i] = (unsigned short)(p[0] | (p[1] << 8));
+    }
+  }
+  state.stream = format[FORMAT_STREAM];
+  state.frame = format[FORMAT_FRAME];
+
+  // Like arGraphicsArrayNode::_mergeElements() of a whole array.
+  elements.grow(stride * count);
+  ar_dequantize(k, &state.codes[0], count,
+                (const float*)packed->getDataPtr(l.AR_PACKED_ARRAY_RANGE, AR_FLOAT),
+                elements.v);
+  return true;
+}
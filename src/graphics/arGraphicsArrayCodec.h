@@ -0,0 +1,100 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_GRAPHICS_ARRAY_CODEC_H
+#define AR_GRAPHICS_ARRAY_CODEC_H
+
+#include "arGraphicsLanguage.h"
+#include "arLightFloatBuffer.h"
+#include "arGraphicsCalling.h"
+
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Quantized encodings of arGraphicsArrayNode records, for the wire.
+// A "packed array" record replaces a points, normal3, color4 or tex2
+// record that sets the whole array:  positions and texture coordinates
+// become 16 bits per coordinate, relative to the array's box;  normals,
+// two 16-bit octahedral coordinates;  colors, 8 bits per channel.
+//
+// With AR_PACK_DELTA, a frame sends only each code's change from the
+// node's previous frame, as variable-length integers (runs of unchanged
+// codes cost two bytes), so a slowly deforming mesh costs about a byte
+// per coordinate.  A delta names the frame it's based on;  a receiver
+// without that frame (e.g. another peer altered the node in between)
+// ignores deltas until the next key frame.
+
+enum {
+  AR_PACK_POSITIONS = 1,
+  AR_PACK_NORMALS = 2,
+  AR_PACK_COLORS = 4,
+  AR_PACK_TEX = 8,
+  AR_PACK_DELTA = 16,
+  AR_PACK_ALL = 31
+};
+
+// What a receiving node keeps of a packed stream, to apply deltas.
+class SZG_CALL arPackedArrayState {
+ public:
+  arPackedArrayState() : stream(-1), frame(-1) {}
+
+  int stream;
+  int frame;
+  vector<unsigned short> codes;
+};
+
+// One connection's encoder.  It remembers each node's last frame.
+class SZG_CALL arGraphicsArrayEncoder {
+ public:
+  arGraphicsArrayEncoder();
+  ~arGraphicsArrayEncoder();
+
+  // A combination of AR_PACK_*, or 0 to send records as they are.
+  // Forgets the previous frames.
+  void setEncoding(int);
+  int getEncoding() const { return _encoding; }
+  // Deltas follow a key frame at most this many frames (default 60),
+  // so a receiver that lost its base recovers.
+  void setKeyInterval(int frames);
+
+  // The packed form of data, or NULL to send data as it is
+  // (other records, partial arrays, or kinds not in the encoding).
+  // The result is reused by the next encode().
+  arStructuredData* encode(const arGraphicsLanguage&, arStructuredData* data);
+  string print() const;
+
+  // Statistics.
+  long records;
+  long keyFrames;
+  double bytesRaw;
+  double bytesPacked;
+
+ private:
+  struct Stream {
+    Stream() : frame(-1), key(0) {}
+    int frame;
+    int key;  // frames since the last key frame
+    float range[6];
+    vector<unsigned short> codes;
+  };
+  int _encoding;
+  int _keyInterval;
+  int _stream;
+  map<int, Stream> _streams; // by node ID
+  arStructuredData* _packed;
+  vector<unsigned short> _codes;
+  vector<ARchar> _bytes;
+};
+
+// Apply a packed array record (for records of recordType, stride floats
+// per element) to elements, the way arGraphicsArrayNode applies an
+// unpacked one.  False if it's malformed or a delta without its base.
+SZG_CALL bool ar_unpackArray(const arGraphicsLanguage&, arStructuredData* packed,
+                             int recordType, unsigned stride,
+                             arLightFloatBuffer& elements, arPackedArrayState&);
+
+#endif
@@ -8,6 +8,15 @@
 #include "arGraphicsDatabase.h"
 
 bool arGraphicsArrayNode::receiveData(arStructuredData* inData) {
+  if (inData->getID() == _g->AR_PACKED_ARRAY) {
+    // Decode straight into _commandBuffer.
+    arGuard _(_nodeLock, "arGraphicsArrayNode::receiveData packed");
+    if (!ar_unpackArray(*_g, inData, _recordType, _arrayStride, _commandBuffer, _packed))
+      return false;
+    _commandBuffer.setType(_recordType);
+    return true;
+  }
+
   if (!_g->checkNodeID(_recordType, inData->getID(), "arGraphicsArrayNode"))
     return false;
 
@@ -6,6 +6,7 @@
 #define AR_GRAPHICS_ARRAY_NODE_H
 
 #include "arGraphicsNode.h"
+#include "arGraphicsArrayCodec.h"
 #include "arGraphicsCalling.h"
 
 class SZG_CALL arGraphicsArrayNode : public arGraphicsNode {
@@ -36,6 +37,9 @@ class SZG_CALL arGraphicsArrayNode : public arGraphicsNode {
   int _indexField;
   int _dataField;
 
+  // For "packed array" records' deltas.
+  arPackedArrayState _packed;
+
   unsigned _numElements() const
     { return _commandBuffer.size() / _arrayStride; }
   void _mergeElements(int number, void* elements, int* IDs = NULL);
@@ -39,8 +39,9 @@ void ar_graphicsClientDraw( arGraphicsClient* c, arGraphicsWindow& win, arViewpo
   glColor3f(1.0, 1.0, 1.0);
   if (c->_overrideColor[0] == -1) {
     // Compute the view transform, from info in the database's viewer node.
-    c->_graphicsDatabase.activateLights();
-    c->_graphicsDatabase.draw(win, view);
+    arGraphicsDatabase& g = c->_snapshot.front();
+    g.activateLights();
+    g.draw(win, view);
   } else {
     // colored background
     glMatrixMode(GL_PROJECTION);
@@ -61,7 +62,9 @@ void ar_graphicsClientDraw( arGraphicsClient* c, arGraphicsWindow& win, arViewpo
 
 // Callback registered with the arSyncDataClient.
 bool ar_graphicsClientConsumptionCallback(void* client, ARchar* buf) {
-  if (!((arGraphicsClient*)client)->_graphicsDatabase.handleDataQueue(buf)) {
+  arGraphicsClient* c = (arGraphicsClient*) client;
+  if (!(c->_fSnapshot ? c->_snapshot.consume(buf) :
+        c->_graphicsDatabase.handleDataQueue(buf))) {
     ar_log_error() << "arGraphicsClient failed to consume buffer.\n";
     return false;
   }
@@ -179,6 +182,9 @@ void arGraphicsClient::render(arGUIWindowInfo& wI, arGraphicsWindow& w) {
 }
 
 arGraphicsClient::arGraphicsClient() :
+  _snapshot(_graphicsDatabase, _shadowDatabase),
+  _fSnapshot(false),
+  _fSnapshotWanted(false),
   _windowManager(NULL),
   _guiParser(NULL),
   _overrideColor(-1, -1, -1),
@@ -220,11 +226,25 @@ bool arGraphicsClient::configure(arSZGClient* szgClient) {
   string textPath(szgClient->getAttribute("SZG_RENDER", "text_path"));
   ar_pathAddSlash(textPath);
   loadAlphabet(textPath.c_str());
+  setStateSorting(szgClient->getAttribute("SZG_RENDER", "state_sort",
+    "|false|true|") == "true");
+  setViewportCulling(szgClient->getAttribute("SZG_RENDER", "viewport_cull",
+    "|false|true|") == "true");
+  setInstancing(szgClient->getAttribute("SZG_RENDER", "instancing",
+    "|true|false|") == "true");
+  const int threads = szgClient->getAttributeInt("SZG_RENDER", "traversal_threads");
+  if (threads != 0)
+    setTraversalThreads(threads < 0 ? 0 : threads);
+  setSnapshot(szgClient->getAttribute("SZG_RENDER", "snapshot",
+    "|false|true|") == "true");
+  const int assetMB = szgClient->getAttributeInt("SZG_ASSETS", "cache_mb");
+  if (assetMB > 0)
+    ar_assetCache().setMaxBytes(assetMB << 20);
   return true;
 }
 
 bool arGraphicsClient::updateHead() {
-  arHead* head = _graphicsDatabase.getHead();
+  arHead* head = _snapshot.front().getHead();
   if (!head) {
     ar_log_error() << "arGraphicsClient: no head to update.\n";
     return false;
@@ -234,22 +254,84 @@ bool arGraphicsClient::updateHead() {
   return true;
 }
 
+// Both copies of the database get every setting.
+
 void arGraphicsClient::loadAlphabet(const char* thePath) {
   _graphicsDatabase.loadAlphabet(thePath);
+  _shadowDatabase.loadAlphabet(thePath);
 }
 
 void arGraphicsClient::setTexturePath(const string& thePath) {
   _graphicsDatabase.setTexturePath(thePath);
+  _shadowDatabase.setTexturePath(thePath);
 }
 
 void arGraphicsClient::setDataBundlePath(const string& bundlePathName,
                                     const string& bundleSubDirectory) {
   _graphicsDatabase.setDataBundlePath(bundlePathName, bundleSubDirectory);
+  _shadowDatabase.setDataBundlePath(bundlePathName, bundleSubDirectory);
 }
 
 void arGraphicsClient::addDataBundlePathMap(const string& bundlePathName,
                                     const string& bundlePath) {
   _graphicsDatabase.addDataBundlePathMap(bundlePathName, bundlePath);
+  _shadowDatabase.addDataBundlePathMap(bundlePathName, bundlePath);
+}
+
+void arGraphicsClient::setStateCaching(bool f) {
+  _graphicsDatabase.setStateCaching(f);
+  _shadowDatabase.setStateCaching(f);
+}
+
+void arGraphicsClient::setStateSorting(bool f) {
+  _graphicsDatabase.setStateSorting(f);
+  _shadowDatabase.setStateSorting(f);
+}
+
+void arGraphicsClient::setInstancing(bool f) {
+  _graphicsDatabase.setInstancing(f);
+  _shadowDatabase.setInstancing(f);
+}
+
+void arGraphicsClient::setTraversalThreads(int n) {
+  _graphicsDatabase.setTraversalThreads(n);
+  _shadowDatabase.setTraversalThreads(n);
+}
+
+void arGraphicsClient::setViewportCulling(bool f) {
+  _graphicsDatabase.setViewportCulling(f);
+  _shadowDatabase.setViewportCulling(f);
+}
+
+// Called from the consumption thread, like the arSyncDataClient callbacks.
+void arGraphicsClient::reset() {
+  _snapshot.clear();
+  _graphicsDatabase.reset();
+  _shadowDatabase.reset();
+  if (_fSnapshot == _fSnapshotWanted)
+    return;
+
+  // Both copies are empty, so they agree.
+  _fSnapshot = _fSnapshotWanted;
+  if (!_fSnapshot) {
+    _snapshot.stop();
+  }
+  else if (!_snapshot.start()) {
+    _fSnapshot = false;
+  }
+  ar_log_remark() << "arGraphicsClient snapshot " << (_fSnapshot ? "on" : "off") << ".\n";
+}
+
+// Call from the consumption thread.
+void arGraphicsClient::setSnapshot(bool f) {
+  _fSnapshotWanted = f;
+  if (f != _fSnapshot && _graphicsDatabase.empty() && _shadowDatabase.empty())
+    reset();
+}
+
+string arGraphicsClient::getSnapshotStats() {
+  return _fSnapshot ? _snapshot.status() :
+    string(_fSnapshotWanted ? "Snapshot on after the next disconnect.\n" : "Snapshot off.\n");
 }
 
 // Define on which networks this object will try to connect to a server,
@@ -7,6 +7,7 @@
 #define AR_GRAPHICS_CLIENT_H
 
 #include "arGraphicsDatabase.h"
+#include "arGraphicsSnapshot.h"
 #include "arSyncDataClient.h"
 #include "arGraphicsWindow.h"
 #include "arVRCamera.h"
@@ -76,8 +77,21 @@ class SZG_CALL arGraphicsClient{
   void setNetworks(string networks);
   bool start(arSZGClient&, bool startSynchronization=true);
 
-  bool empty() { return _graphicsDatabase.empty(); }
-  void reset() { _graphicsDatabase.reset(); }
+  bool empty() { return _snapshot.front().empty(); }
+  void reset();
+  void setStateCaching(bool f);
+  void setStateSorting(bool f);
+  void setInstancing(bool f);
+  void setTraversalThreads(int n);
+  void setViewportCulling(bool f);
+  string getCullStats() { return _snapshot.front().getCullStats(); }
+  string getStateStats() { return _snapshot.front().getStateStats(); }
+  // Draw the previous frame while a thread applies the next one to a
+  // second copy of the scene graph (see arGraphicsSnapshot).
+  // Takes effect now if the database is empty, else at the next reset().
+  void setSnapshot(bool);
+  bool getSnapshot() const { return _fSnapshot; }
+  string getSnapshotStats();
 
   void setOverrideColor(arVector3 overrideColor);
   // copy the head from the arViewerNode to here
@@ -101,6 +115,7 @@ class SZG_CALL arGraphicsClient{
   void drawAllWindows() {
     _windowManager->drawAllWindows(true); // Simultaneously if threaded.  Blocks.
   }
+  string getDrawTimes() { return _windowManager->getDrawTimes(); }
   void requestScreenshot(const string& path, int x, int y, int width, int height);
   bool screenshotRequested();
   void takeScreenshot(bool fStereo);
@@ -110,6 +125,10 @@ class SZG_CALL arGraphicsClient{
 
  protected:
   arGraphicsDatabase _graphicsDatabase;
+  arGraphicsDatabase _shadowDatabase;  // the other copy, for _snapshot
+  arGraphicsSnapshot _snapshot;        // its front() is drawn
+  bool _fSnapshot;
+  bool _fSnapshotWanted;
   arGraphicsWindow   _graphicsWindow;
 
   arGUIWindowManager* _windowManager;
@@ -0,0 +1,130 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arGraphicsCommandBuffer.h"
+#include "arGraphicsAPI.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+#include "arThread.h"
+
+static arThreadLocal __current;
+
+arGraphicsCommandBuffer::arGraphicsCommandBuffer(arGraphicsDatabase* database) :
+  _database(database),
+  _thread(false),
+  _bytes(HEADER_SIZE),
+  _records(0),
+  _nextID(0),
+  _endID(0),
+  _reserve(64) {
+}
+
+arGraphicsCommandBuffer::~arGraphicsCommandBuffer() {
+  if (current() == this)
+    end();
+  for (map<int, arStructuredData*>::iterator i = _scratch.begin();
+       i != _scratch.end(); ++i) {
+    delete i->second;
+  }
+}
+
+arGraphicsCommandBuffer* arGraphicsCommandBuffer::current() {
+  return (arGraphicsCommandBuffer*)__current.get();
+}
+
+bool arGraphicsCommandBuffer::begin() {
+  if (current()) {
+    ar_log_error() << "arGraphicsCommandBuffer: this thread is already recording.\n";
+    return false;
+  }
+  if (!_database)
+    _database = dgGetGraphicsDatabase();
+  if (!_database) {
+    ar_log_error() << "arGraphicsCommandBuffer: no database.\n";
+    return false;
+  }
+  __current.set(this);
+  _thread = true;
+  return true;
+}
+
+void arGraphicsCommandBuffer::end() {
+  if (current() == this)
+    __current.set(NULL);
+  _thread = false;
+}
+
+bool arGraphicsCommandBuffer::submit() {
+  if (_records == 0)
+    return true;
+  if (!_database) {
+    ar_log_error() << "arGraphicsCommandBuffer: no database.\n";
+    return false;
+  }
+  ARint header[2] = { ARint(_bytes.size()), _records };
+  ar_packData(&_bytes[0], header, AR_INT, 2);
+  const bool ok = _database->alterBatch(&_bytes[0]);
+  clear();
+  return ok;
+}
+
+void arGraphicsCommandBuffer::clear() {
+  _bytes.resize(HEADER_SIZE);
+  _records = 0;
+  _names.clear();
+}
+
+arStructuredData* arGraphicsCommandBuffer::scratch(arStructuredData* shared) {
+  const int templateID = shared->getID();
+  map<int, arStructuredData*>::iterator i = _scratch.find(templateID);
+  if (i != _scratch.end())
+    return i->second;
+  arStructuredData* data = new arStructuredData(_lang.find(templateID));
+  _scratch[templateID] = data;
+  return data;
+}
+
+bool arGraphicsCommandBuffer::record(arStructuredData* data) {
+  const int offset = _bytes.size();
+  _bytes.resize(offset + data->size());
+  if (!data->pack(&_bytes[offset])) {
+    ar_log_error() << "arGraphicsCommandBuffer failed to pack a record.\n";
+    _bytes.resize(offset);
+    return false;
+  }
+  ++_records;
+  return true;
+}
+
+int arGraphicsCommandBuffer::makeNode(const string& name,
+                                      const string& parent,
+                                      const string& type) {
+  int parentID = getNodeID(parent);
+  if (parentID < 0)
+    return -1;
+
+  if (_nextID >= _endID) {
+    _nextID = _database->reserveNodeIDs(_reserve);
+    _endID = _nextID + _reserve;
+  }
+  int ID = _nextID++;
+  arStructuredData* data = scratch(_database->makeNodeData);
+  if (!data->dataIn(_lang.AR_MAKE_NODE_PARENT_ID, &parentID, AR_INT, 1) ||
+      !data->dataIn(_lang.AR_MAKE_NODE_ID, &ID, AR_INT, 1) ||
+      !data->dataInString(_lang.AR_MAKE_NODE_NAME, name) ||
+      !data->dataInString(_lang.AR_MAKE_NODE_TYPE, type) ||
+      !record(data)) {
+    ar_log_error() << "arGraphicsCommandBuffer failed to make node '" << name << "'.\n";
+    return -1;
+  }
+  _names[name] = ID;
+  return ID;
+}
+
+int arGraphicsCommandBuffer::getNodeID(const string& name) {
+  map<string, int>::const_iterator i = _names.find(name);
+  return i == _names.end() ? _database->getNodeID(name) : i->second;
+}
@@ -0,0 +1,74 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_GRAPHICS_COMMAND_BUFFER_H
+#define AR_GRAPHICS_COMMAND_BUFFER_H
+
+#include "arGraphicsDatabase.h"
+#include "arGraphicsLanguage.h"
+#include "arGraphicsCalling.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Records one thread's dg* calls (arGraphicsAPI.h), to apply as a batch.
+//
+// Between begin() and end(), the calling thread's dg* calls append to
+// the buffer instead of altering the database.  submit() applies the
+// whole buffer while holding the database's lock once;  through an
+// arGraphicsServer, the batch reaches szgrender in one frame.  Threads
+// updating disjoint subtrees thus contend once per batch, not per call.
+//
+// Nodes made while recording get IDs reserved from the database in
+// advance, so the returned IDs are valid before submit().  For the same
+// reason dgMakeNode(), which returns a node, fails while recording.
+
+class SZG_CALL arGraphicsCommandBuffer {
+ public:
+  // NULL means the database of dgSetGraphicsDatabase().
+  arGraphicsCommandBuffer(arGraphicsDatabase* database = NULL);
+  ~arGraphicsCommandBuffer();
+
+  // Route this thread's dg* calls here.  Buffers don't nest.
+  bool begin();
+  void end();
+  bool recording() const { return _thread; }
+
+  // Apply the records, then clear().  False if any record failed.
+  bool submit();
+  void clear();
+
+  int getRecords() const { return _records; }
+  int getBytes() const { return _bytes.size() - HEADER_SIZE; }
+  // How many node IDs to reserve from the database at once.
+  void setReserve(int count) { _reserve = count < 1 ? 1 : count; }
+
+  // The buffer recording for the calling thread, or NULL.
+  static arGraphicsCommandBuffer* current();
+
+  // For arGraphicsAPI.cpp.
+  // This buffer's own copy of a record, to fill without locking.
+  arStructuredData* scratch(arStructuredData* shared);
+  bool record(arStructuredData*);
+  int makeNode(const string& name, const string& parent, const string& type);
+  // Nodes made while recording, then those already in the database.
+  int getNodeID(const string& name);
+
+ private:
+  enum { HEADER_SIZE = 2*AR_INT_SIZE }; // as in arDatabase::handleDataQueue
+  arGraphicsDatabase* _database;
+  arGraphicsLanguage _lang;
+  bool _thread;
+  vector<ARchar> _bytes;
+  int _records;
+  map<int, arStructuredData*> _scratch; // by template ID
+  map<string, int> _names;
+  int _nextID; // reserved IDs are [_nextID, _endID)
+  int _endID;
+  int _reserve;
+};
+
+#endif
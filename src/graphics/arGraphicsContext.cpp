@@ -12,153 +12,85 @@
 #include "arGraphicsStateNode.h"
 #include "arMaterialNode.h"
 #include "arBlendNode.h"
+#include "arGraphicsNode.h"
+#include "arLODNode.h"
+#include "arGraphicsUtilities.h"
+#include "arViewportCull.h"
+
+#include <algorithm>
 
 arGraphicsContext::arGraphicsContext( arGraphicsWindow* win, arViewport* view ) :
   _graphicsWindow(win),
-  _viewport(view) {
+  _viewport(view),
+  _cull(NULL),
+  _cullViewport(-1),
+  _instances(0),
+  _viewpoint(0, 0, 0),
+  _fCache(true),
+  _glIssued(0),
+  _glSkipped(0) {
+  invalidateState();
 }
 
 arGraphicsContext::~arGraphicsContext() {
 }
 
-void arGraphicsContext::pushNode(arDatabaseNode* node) {
-  int nodeType = node->getTypeCode();
+int arGraphicsContext::_stackIndex(int nodeType) {
   switch(nodeType) {
   case AR_G_POINTS_NODE:
-    _pointsStack.push_front(node);
-    break;
+    return STACK_POINTS;
   case AR_G_BLEND_NODE:
-    _blendStack.push_front(node);
-    break;
+    return STACK_BLEND;
   case AR_G_NORMAL3_NODE:
-    _normal3Stack.push_front(node);
-    break;
+    return STACK_NORMAL3;
   case AR_G_COLOR4_NODE:
-    _color4Stack.push_front(node);
-    break;
+    return STACK_COLOR4;
   case AR_G_TEX2_NODE:
-    _tex2Stack.push_front(node);
-    break;
+    return STACK_TEX2;
   case AR_G_INDEX_NODE:
-    _indexStack.push_front(node);
-    break;
+    return STACK_INDEX;
   case AR_G_MATERIAL_NODE:
-    _materialStack.push_front(node);
-    break;
+    return STACK_MATERIAL;
   case AR_G_TEXTURE_NODE:
-    _textureStack.push_front(node);
-    break;
+    return STACK_TEXTURE;
   case AR_G_BUMP_MAP_NODE:
-    _bumpMapStack.push_front(node);
-    break;
-  case AR_G_GRAPHICS_STATE_NODE:
+    return STACK_BUMP_MAP;
+  default:
+    return -1;
+  }
+}
+
+void arGraphicsContext::pushNode(arDatabaseNode* node) {
+  const int nodeType = node->getTypeCode();
+  if (nodeType == AR_G_GRAPHICS_STATE_NODE) {
     // There is quite a variation in what pushing graphics state does.
     _pushGraphicsState(node);
-    break;
-  default:
-    break;
+    return;
   }
+  const int i = _stackIndex(nodeType);
+  if (i >= 0)
+    _nodeStack[i].push_back(node);
 }
 
 void arGraphicsContext::popNode(arDatabaseNode* node) {
-  int nodeType = node->getTypeCode();
-  switch(nodeType) {
-  case AR_G_POINTS_NODE:
-    _pointsStack.pop_front();
-    break;
-  case AR_G_BLEND_NODE:
-    _blendStack.pop_front();
-    break;
-  case AR_G_NORMAL3_NODE:
-    _normal3Stack.pop_front();
-    break;
-  case AR_G_COLOR4_NODE:
-    _color4Stack.pop_front();
-    break;
-  case AR_G_TEX2_NODE:
-    _tex2Stack.pop_front();
-    break;
-  case AR_G_INDEX_NODE:
-    _indexStack.pop_front();
-    break;
-  case AR_G_MATERIAL_NODE:
-    _materialStack.pop_front();
-    break;
-  case AR_G_TEXTURE_NODE:
-    _textureStack.pop_front();
-    break;
-  case AR_G_BUMP_MAP_NODE:
-    _bumpMapStack.pop_front();
-    break;
-  case AR_G_GRAPHICS_STATE_NODE:
+  const int nodeType = node->getTypeCode();
+  if (nodeType == AR_G_GRAPHICS_STATE_NODE) {
     _popGraphicsState(node);
-  default:
-    break;
+    return;
   }
+  const int i = _stackIndex(nodeType);
+  if (i >= 0)
+    _nodeStack[i].pop_back();
 }
 
 arDatabaseNode* arGraphicsContext::getNode(int nodeType) {
-  arDatabaseNode* result = NULL;
-  switch(nodeType) {
-  case AR_G_POINTS_NODE:
-    if (!_pointsStack.empty()) {
-      result = _pointsStack.front();
-    }
-    break;
-  case AR_G_BLEND_NODE:
-    if (!_blendStack.empty()) {
-      result = _blendStack.front();
-    }
-    break;
-  case AR_G_NORMAL3_NODE:
-    if (!_normal3Stack.empty()) {
-      result = _normal3Stack.front();
-    }
-    break;
-  case AR_G_COLOR4_NODE:
-    if (!_color4Stack.empty()) {
-      result = _color4Stack.front();
-    }
-    break;
-  case AR_G_TEX2_NODE:
-    if (!_tex2Stack.empty()) {
-      result = _tex2Stack.front();
-    }
-    break;
-  case AR_G_INDEX_NODE:
-    if (!_indexStack.empty()) {
-      result = _indexStack.front();
-    }
-    break;
-  case AR_G_MATERIAL_NODE:
-    if (!_materialStack.empty()) {
-      result = _materialStack.front();
-    }
-    break;
-  case AR_G_TEXTURE_NODE:
-    if (!_textureStack.empty()) {
-      result = _textureStack.front();
-    }
-    break;
-  case AR_G_BUMP_MAP_NODE:
-    if (!_bumpMapStack.empty()) {
-      result = _bumpMapStack.front();
-    }
-    break;
-  }
-  return result;
+  const int i = _stackIndex(nodeType);
+  return (i < 0 || _nodeStack[i].empty()) ? NULL : _nodeStack[i].back();
 }
 
 void arGraphicsContext::clear() {
-  _pointsStack.clear();
-  _blendStack.clear();
-  _normal3Stack.clear();
-  _color4Stack.clear();
-  _tex2Stack.clear();
-  _indexStack.clear();
-  _materialStack.clear();
-  _textureStack.clear();
-  _bumpMapStack.clear();
+  for (int i=0; i<STACK_COUNT; ++i)
+    _nodeStack[i].clear();
 
   _pointSizeStateStack.clear();
   _lineWidthStateStack.clear();
@@ -167,6 +99,122 @@ void arGraphicsContext::clear() {
   _depthTestStateStack.clear();
   _blendStateStack.clear();
   _blendFuncStateStack.clear();
+  _instanceColorStack.clear();
+  _deferred.clear();
+}
+
+void arGraphicsContext::invalidateState() {
+  for (int i=0; i<CAP_COUNT; ++i)
+    _cap[i] = -1;
+  _shadeModelGL = -1;
+  _pointSizeGL = -1.;
+  _lineWidthGL = -1.;
+  _blendSrcGL = -1;
+  _blendDstGL = -1;
+  _twoSideGL = -1;
+  _colorMaterialGL = -1;
+  _materialKnown = false;
+  _textureGL = NULL;
+}
+
+// Count a GL call, and report whether to skip it.
+bool arGraphicsContext::_skip(bool same) {
+  if (same && _fCache) {
+    ++_glSkipped;
+    return true;
+  }
+  ++_glIssued;
+  return false;
+}
+
+void arGraphicsContext::_enable(int cap, bool on) {
+  if (_skip(_cap[cap] == int(on)))
+    return;
+  _cap[cap] = on;
+  static const GLenum caps[CAP_COUNT] = {
+    GL_LIGHTING, GL_TEXTURE_2D, GL_BLEND, GL_DEPTH_TEST,
+    GL_NORMALIZE, GL_COLOR_MATERIAL };
+  if (on)
+    glEnable(caps[cap]);
+  else
+    glDisable(caps[cap]);
+}
+
+void arGraphicsContext::_shadeModel(GLenum m) {
+  if (_skip(_shadeModelGL == int(m)))
+    return;
+  _shadeModelGL = m;
+  glShadeModel(m);
+}
+
+void arGraphicsContext::_pointSize(float s) {
+  if (_skip(_pointSizeGL == s))
+    return;
+  _pointSizeGL = s;
+  glPointSize(s);
+}
+
+void arGraphicsContext::_lineWidth(float w) {
+  if (_skip(_lineWidthGL == w))
+    return;
+  _lineWidthGL = w;
+  glLineWidth(w);
+}
+
+void arGraphicsContext::_blendFunc(GLenum src, GLenum dst) {
+  if (_skip(_blendSrcGL == int(src) && _blendDstGL == int(dst)))
+    return;
+  _blendSrcGL = src;
+  _blendDstGL = dst;
+  glBlendFunc(src, dst);
+}
+
+void arGraphicsContext::_lightModelTwoSide(bool f) {
+  if (_skip(_twoSideGL == int(f)))
+    return;
+  _twoSideGL = f;
+  glLightModeli(GL_LIGHT_MODEL_TWO_SIDE, f ? GL_TRUE : GL_FALSE);
+}
+
+void arGraphicsContext::_colorMaterial() {
+  if (_skip(_colorMaterialGL == 1))
+    return;
+  _colorMaterialGL = 1;
+  glColorMaterial(GL_FRONT_AND_BACK, GL_DIFFUSE);
+}
+
+// m[] is diffuse, ambient, specular, emission.
+void arGraphicsContext::_material(const arVector4* m, float shininess) {
+  // One glMaterial per component.
+  const bool same = _materialKnown && _shininessGL == shininess &&
+    m[0] == _materialGL[0] && m[1] == _materialGL[1] &&
+    m[2] == _materialGL[2] && m[3] == _materialGL[3];
+  if (same && _fCache) {
+    _glSkipped += 5;
+    return;
+  }
+  _glIssued += 5;
+  _materialKnown = true;
+  _shininessGL = shininess;
+  for (int i=0; i<4; ++i)
+    _materialGL[i] = m[i];
+  glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, m[0].v);
+  glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, m[1].v);
+  glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, m[2].v);
+  glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, m[3].v);
+  glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, shininess);
+}
+
+void arGraphicsContext::_activateTexture(arTexture* t) {
+  // activate() enables GL_TEXTURE_2D, binds, and sets the texture env.
+  // Reloading a dirty texture can't be skipped.
+  if (_cap[CAP_TEXTURE_2D] == 1 && _textureGL == t && !t->dirty() && _fCache) {
+    _glSkipped += 3;
+    return;
+  }
+  _glIssued += 3;
+  _cap[CAP_TEXTURE_2D] = 1;
+  _textureGL = t->activate() ? t : NULL;
 }
 
 void arGraphicsContext::setPointState(float& blendFactor) {
@@ -175,10 +223,10 @@ void arGraphicsContext::setPointState(float& blendFactor) {
   // Texture mapping: always disabled for points.
   // Point size: Use value from stack.
 
-  glDisable(GL_LIGHTING);
-  glShadeModel(GL_SMOOTH);
-  glDisable(GL_TEXTURE_2D);
-  glPointSize(_pointSizeStateStack.empty() ? 1.0 : _pointSizeStateStack.front());
+  _enable(CAP_LIGHTING, false);
+  _shadeModel(GL_SMOOTH);
+  _enable(CAP_TEXTURE_2D, false);
+  _pointSize(_pointSizeStateStack.empty() ? 1.0 : _pointSizeStateStack.back());
   // Set the common state (over the various types of primitives).
   _setState(blendFactor);
 }
@@ -189,10 +237,10 @@ void arGraphicsContext::setLineState(float& blendFactor) {
   // Texture mapping: always disabled for lines.
   // Line width: Use value from stack.
 
-  glDisable(GL_LIGHTING);
-  glShadeModel(GL_SMOOTH);
-  glDisable(GL_TEXTURE_2D);
-  glLineWidth(_lineWidthStateStack.empty() ? 1.0 : _lineWidthStateStack.front());
+  _enable(CAP_LIGHTING, false);
+  _shadeModel(GL_SMOOTH);
+  _enable(CAP_TEXTURE_2D, false);
+  _lineWidth(_lineWidthStateStack.empty() ? 1.0 : _lineWidthStateStack.back());
   // Set the common state (over the various types of primitives).
   _setState(blendFactor);
 }
@@ -204,39 +252,29 @@ void arGraphicsContext::setTriangleState(float& blendFactor) {
   //                  of an ancestor texture node.
 
   // Lighting.
-  glEnable(GL_NORMALIZE);
-  glLightModeli(GL_LIGHT_MODEL_TWO_SIDE, GL_TRUE);
-  if (_lightingStateStack.empty() ||
-      _lightingStateStack.front() != AR_G_FALSE) {
-    glEnable(GL_LIGHTING);
-  }
-  else{
-    glDisable(GL_LIGHTING);
-  }
+  _enable(CAP_NORMALIZE, true);
+  _lightModelTwoSide(true);
+  _enable(CAP_LIGHTING, _lightingStateStack.empty() ||
+                        _lightingStateStack.back() != AR_G_FALSE);
 
   // Shade model
-  if (_shadeModelStateStack.empty() ||
-      _shadeModelStateStack.front() != AR_G_FLAT) {
-    glShadeModel(GL_SMOOTH);
-  }
-  else{
-    glShadeModel(GL_FLAT);
-  }
+  _shadeModel(_shadeModelStateStack.empty() ||
+              _shadeModelStateStack.back() != AR_G_FLAT ? GL_SMOOTH : GL_FLAT);
 
   // Texture.
   bool forceBlend = false;
-  if (_textureStack.empty()) {
-    glDisable(GL_TEXTURE_2D);
+  if (_nodeStack[STACK_TEXTURE].empty()) {
+    _enable(CAP_TEXTURE_2D, false);
   }
   else{
-    arTextureNode* tn = (arTextureNode*)_textureStack.front();
+    arTextureNode* tn = (arTextureNode*)_nodeStack[STACK_TEXTURE].back();
     arTexture* t = tn->getTexture();
     if (t) {
       if (t->getDepth() == 4) {
         forceBlend = true;
       }
       // Activating the texture also enables GL_TEXTURE_2D.
-      t->activate();
+      _activateTexture(t);
     }
   }
 
@@ -251,39 +289,39 @@ void arGraphicsContext::_pushGraphicsState(arDatabaseNode* node) {
   switch(g->getStateID()) {
   case AR_G_POINT_SIZE:
     if (g->getStateValueFloat(f)) {
-      _pointSizeStateStack.push_front(f);
+      _pointSizeStateStack.push_back(f);
     }
     else{
-      _pointSizeStateStack.push_front(1.0);
+      _pointSizeStateStack.push_back(1.0);
     }
     break;
   case AR_G_LINE_WIDTH:
     if (g->getStateValueFloat(f)) {
-      _lineWidthStateStack.push_front(f);
+      _lineWidthStateStack.push_back(f);
     }
     else{
-      _lineWidthStateStack.push_front(1.0);
+      _lineWidthStateStack.push_back(1.0);
     }
     break;
   case AR_G_SHADE_MODEL:
     g->getStateValuesInt(v1, v2);
-    _shadeModelStateStack.push_front(v1);
+    _shadeModelStateStack.push_back(v1);
     break;
   case AR_G_LIGHTING:
     g->getStateValuesInt(v1, v2);
-    _lightingStateStack.push_front(v1);
+    _lightingStateStack.push_back(v1);
     break;
   case AR_G_BLEND:
     g->getStateValuesInt(v1, v2);
-    _blendStateStack.push_front(v1);
+    _blendStateStack.push_back(v1);
     break;
   case AR_G_DEPTH_TEST:
     g->getStateValuesInt(v1, v2);
-    _depthTestStateStack.push_front(v1);
+    _depthTestStateStack.push_back(v1);
     break;
   case AR_G_BLEND_FUNC:
     g->getStateValuesInt(v1, v2);
-    _blendFuncStateStack.push_front(make_pair<arGraphicsStateValue, arGraphicsStateValue>(v1, v2));
+    _blendFuncStateStack.push_back(make_pair<arGraphicsStateValue, arGraphicsStateValue>(v1, v2));
     break;
   default:
     break;
@@ -294,25 +332,25 @@ void arGraphicsContext::_popGraphicsState(arDatabaseNode* node) {
 arGraphicsStateNode* g = (arGraphicsStateNode*) node;
   switch(g->getStateID()) {
   case AR_G_POINT_SIZE:
-    _pointSizeStateStack.pop_front();
+    _pointSizeStateStack.pop_back();
     break;
   case AR_G_LINE_WIDTH:
-    _lineWidthStateStack.pop_front();
+    _lineWidthStateStack.pop_back();
     break;
   case AR_G_SHADE_MODEL:
-    _shadeModelStateStack.pop_front();
+    _shadeModelStateStack.pop_back();
     break;
   case AR_G_LIGHTING:
-    _lightingStateStack.pop_front();
+    _lightingStateStack.pop_back();
     break;
   case AR_G_BLEND:
-    _blendStateStack.pop_front();
+    _blendStateStack.pop_back();
     break;
   case AR_G_DEPTH_TEST:
-    _depthTestStateStack.pop_front();
+    _depthTestStateStack.pop_back();
     break;
   case AR_G_BLEND_FUNC:
-    _blendFuncStateStack.pop_front();
+    _blendFuncStateStack.pop_back();
     break;
   default:
     break;
@@ -357,68 +395,275 @@ void arGraphicsContext::_setState(float& blendFactor, bool forceBlend) {
   // There are two ways blending can be enabled: either we have a blend node
   // explicitly set to blend (value < 1.0) OR we are forcing blending
   // (which might happen if a texture has an alpha channel).
-  if (_blendStack.empty() && !forceBlend) {
-    glDisable(GL_BLEND);
+  const vector<arDatabaseNode*>& blendStack = _nodeStack[STACK_BLEND];
+  if (blendStack.empty() && !forceBlend) {
+    _enable(CAP_BLEND, false);
   }
   else{
     // We can get here because forceBlend is true, so make sure that
     // the blendStack isn't empty.
-    if (!_blendStack.empty()) {
-      blendFactor = ((arBlendNode*)_blendStack.front())->getBlend();
+    if (!blendStack.empty()) {
+      blendFactor = ((arBlendNode*)blendStack.back())->getBlend();
     }
     if (blendFactor < 1.0 || forceBlend) {
-      glEnable(GL_BLEND);
+      _enable(CAP_BLEND, true);
       // The blend functions need to get set now.
       if (_blendFuncStateStack.empty()) {
         // The default if nothing is specified.
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        _blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
       }
       else{
-        pair<arGraphicsStateValue, arGraphicsStateValue> p =
-          _blendFuncStateStack.front();
-        glBlendFunc(_decodeBlendFunction(p.first),
-                    _decodeBlendFunction(p.second));
+        const pair<arGraphicsStateValue, arGraphicsStateValue>& p =
+          _blendFuncStateStack.back();
+        _blendFunc(_decodeBlendFunction(p.first),
+                   _decodeBlendFunction(p.second));
       }
     }
     else{
       // There is indeed a blend node... but it is set to non-transparent.
-      glDisable(GL_BLEND);
+      _enable(CAP_BLEND, false);
     }
   }
 
   // Color.
-  glEnable(GL_COLOR_MATERIAL);
-  glColorMaterial(GL_FRONT_AND_BACK, GL_DIFFUSE);
-  if (_materialStack.empty()) {
-    glColor4f(1, 1, 1, 1);
+  _enable(CAP_COLOR_MATERIAL, true);
+  _colorMaterial();
+  // Vertex colors overwrite the current color, so always set it.
+  ++_glIssued;
+  if (_nodeStack[STACK_MATERIAL].empty()) {
+    if (_instanceColorStack.empty())
+      glColor4f(1, 1, 1, 1);
+    else
+      glColor4fv(_instanceColorStack.back().v);
   }
   else {
-    arMaterialNode* mn = (arMaterialNode*) _materialStack.front();
+    arMaterialNode* mn = (arMaterialNode*) _nodeStack[STACK_MATERIAL].back();
     arMaterial* m = mn->getMaterialPtr();
-    arVector4 temp(m->diffuse[0], m->diffuse[1],
-                   m->diffuse[2], m->alpha*blendFactor);
-    glColor4fv(temp.v);
+    const arVector4 material[4] = {
+      arVector4(m->diffuse[0], m->diffuse[1], m->diffuse[2], m->alpha*blendFactor),
+      arVector4(m->ambient[0], m->ambient[1], m->ambient[2], m->alpha),
+      arVector4(m->specular[0], m->specular[1], m->specular[2], m->alpha),
+      arVector4(m->emissive[0], m->emissive[1], m->emissive[2], m->alpha)
+    };
+    if (_instanceColorStack.empty()) {
+      glColor4fv(material[0].v);
+    }
+    else {
+      const arVector4& c = _instanceColorStack.back();
+      glColor4f(material[0].v[0]*c.v[0], material[0].v[1]*c.v[1],
+                material[0].v[2]*c.v[2], material[0].v[3]*c.v[3]);
+    }
     // Set the material normally also. Grumble.
-    glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, temp.v);
-    temp = arVector4(m->ambient[0], m->ambient[1],
-                     m->ambient[2], m->alpha);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, temp.v);
-    temp = arVector4(m->specular[0], m->specular[1],
-                     m->specular[2], m->alpha);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, temp.v);
-    temp = arVector4(m->emissive[0], m->emissive[1],
-                     m->emissive[2], m->alpha);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, temp.v);
-    glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, m->exponent);
+    _material(material, m->exponent);
   }
 
   // Depth test.
-  if (_depthTestStateStack.empty() ||
-      _depthTestStateStack.front() != AR_G_FALSE) {
-    glEnable(GL_DEPTH_TEST);
+  _enable(CAP_DEPTH_TEST, _depthTestStateStack.empty() ||
+                          _depthTestStateStack.back() != AR_G_FALSE);
+}
+
+enum {
+  AR_DEFER_POINT_SIZE = 1,
+  AR_DEFER_LINE_WIDTH = 2,
+  AR_DEFER_SHADE_MODEL = 4,
+  AR_DEFER_LIGHTING = 8,
+  AR_DEFER_DEPTH_TEST = 16,
+  AR_DEFER_BLEND_FUNC = 32,
+  AR_DEFER_INSTANCE_COLOR = 64
+};
+
+// Queue a node for drawDeferred(), if it's one that draws.
+bool arGraphicsContext::deferDraw(arDatabaseNode* node) {
+  arMatrix4 modelView;
+  glGetFloatv(GL_MODELVIEW_MATRIX, modelView.v);
+  Deferred d;
+  if (!capture(node, modelView, d))
+    return false;
+
+  d.order = int(_deferred.size());
+  _deferred.push_back(d);
+  return true;
+}
+
+// Queue what another thread captured, after what's already queued.
+void arGraphicsContext::deferDraw(const vector<Deferred>& drawList) {
+  const int order = int(_deferred.size());
+  _deferred.insert(_deferred.end(), drawList.begin(), drawList.end());
+  for (vector<Deferred>::iterator i = _deferred.begin() + order; i != _deferred.end(); ++i)
+    i->order = int(i - _deferred.begin());
+}
+
+// Thread-safe:  reads only the stacks, and makes no GL calls.
+bool arGraphicsContext::capture(arDatabaseNode* node, const arMatrix4& modelView,
+                                Deferred& d) const {
+  const int code = node->getTypeCode();
+  if (code != AR_G_DRAWABLE_NODE && code != AR_G_BILLBOARD_NODE &&
+      code != AR_G_BOUNDING_SPHERE_NODE && code != AR_G_GRAPHICS_PLUGIN_NODE)
+    return false;
+
+  d.node = node;
+  d.modelView = modelView;
+  int i;
+  for (i=0; i<STACK_COUNT; ++i)
+    d.top[i] = _nodeStack[i].empty() ? NULL : _nodeStack[i].back();
+  d.flags = 0;
+  if (!_pointSizeStateStack.empty()) {
+    d.flags |= AR_DEFER_POINT_SIZE;
+    d.pointSize = _pointSizeStateStack.back();
   }
-  else{
-    glDisable(GL_DEPTH_TEST);
+  if (!_lineWidthStateStack.empty()) {
+    d.flags |= AR_DEFER_LINE_WIDTH;
+    d.lineWidth = _lineWidthStateStack.back();
   }
+  if (!_shadeModelStateStack.empty()) {
+    d.flags |= AR_DEFER_SHADE_MODEL;
+    d.shadeModel = _shadeModelStateStack.back();
+  }
+  if (!_lightingStateStack.empty()) {
+    d.flags |= AR_DEFER_LIGHTING;
+    d.lighting = _lightingStateStack.back();
+  }
+  if (!_depthTestStateStack.empty()) {
+    d.flags |= AR_DEFER_DEPTH_TEST;
+    d.depthTest = _depthTestStateStack.back();
+  }
+  if (!_blendFuncStateStack.empty()) {
+    d.flags |= AR_DEFER_BLEND_FUNC;
+    d.blendFunc = _blendFuncStateStack.back();
+  }
+  if (!_instanceColorStack.empty()) {
+    d.flags |= AR_DEFER_INSTANCE_COLOR;
+    d.instanceColor = _instanceColorStack.back();
+  }
+  d.order = 0;
+
+  // Sort keys.  Nodes other than drawables set state themselves,
+  // so treat them like blended geometry:  last, in traversal order.
+  arTexture* t = d.top[STACK_TEXTURE] ?
+    ((arTextureNode*)d.top[STACK_TEXTURE])->getTexture() : NULL;
+  d.texture = t;
+  d.material = d.top[STACK_MATERIAL];
+  d.blended = code != AR_G_DRAWABLE_NODE ||
+    (t && t->getDepth() == 4) ||
+    (d.top[STACK_BLEND] && ((arBlendNode*)d.top[STACK_BLEND])->getBlend() < 1.0);
+  return true;
+}
+
+int arGraphicsContext::getPrecomputedVisibility(int nodeID) const {
+  return _cull ? _cull->visible(nodeID, _cullViewport) : -1;
+}
+
+int arGraphicsContext::selectLOD(arDatabaseNode* node,
+                                 const arMatrix4& modelView) const {
+  return ((arLODNode*)node)->select(_rootInverse * modelView, _viewpoint);
+}
+
+void arGraphicsContext::inherit(const arGraphicsContext& parent) {
+  _cull = parent._cull;
+  _cullViewport = parent._cullViewport;
+  _viewpoint = parent._viewpoint;
+  _rootInverse = parent._rootInverse;
+  int i;
+  for (i=0; i<STACK_COUNT; ++i)
+    _nodeStack[i] = parent._nodeStack[i];
+  _pointSizeStateStack = parent._pointSizeStateStack;
+  _lineWidthStateStack = parent._lineWidthStateStack;
+  _shadeModelStateStack = parent._shadeModelStateStack;
+  _lightingStateStack = parent._lightingStateStack;
+  _depthTestStateStack = parent._depthTestStateStack;
+  _blendStateStack = parent._blendStateStack;
+  _blendFuncStateStack = parent._blendFuncStateStack;
+  _instanceColorStack = parent._instanceColorStack;
+}
+
+// Nested instance nodes multiply their colors.
+void arGraphicsContext::pushInstanceColor(const float* rgba) {
+  arVector4 c(rgba);
+  if (!_instanceColorStack.empty()) {
+    const arVector4& outer = _instanceColorStack.back();
+    for (int i=0; i<4; ++i)
+      c.v[i] *= outer.v[i];
+  }
+  _instanceColorStack.push_back(c);
+}
+
+void arGraphicsContext::popInstanceColor() {
+  if (!_instanceColorStack.empty())
+    _instanceColorStack.pop_back();
+}
+
+bool arGraphicsContext::beginInstances(const float* instances, int count) {
+  if (_instances > 0 || count <= 0 || !ar_beginInstancing(instances, count))
+    return false;
+  _instances = count;
+  return true;
 }
 
+void arGraphicsContext::endInstances() {
+  if (_instances > 0) {
+    ar_endInstancing();
+    _instances = 0;
+  }
+}
+
+bool arGraphicsContext::_deferredLess(const Deferred& a, const Deferred& b) {
+  if (a.blended != b.blended)
+    return !a.blended;
+  if (!a.blended) {
+    if (a.texture != b.texture)
+      return a.texture < b.texture;
+    if (a.material != b.material)
+      return a.material < b.material;
+  }
+  return a.order < b.order;
+}
+
+// Rebuild the stacks to hold just what d inherited.
+void arGraphicsContext::_restore(const Deferred& d) {
+  int i;
+  for (i=0; i<STACK_COUNT; ++i) {
+    _nodeStack[i].clear();
+    if (d.top[i])
+      _nodeStack[i].push_back(d.top[i]);
+  }
+  _pointSizeStateStack.clear();
+  _lineWidthStateStack.clear();
+  _shadeModelStateStack.clear();
+  _lightingStateStack.clear();
+  _depthTestStateStack.clear();
+  _blendFuncStateStack.clear();
+  _instanceColorStack.clear();
+  if (d.flags & AR_DEFER_POINT_SIZE)
+    _pointSizeStateStack.push_back(d.pointSize);
+  if (d.flags & AR_DEFER_LINE_WIDTH)
+    _lineWidthStateStack.push_back(d.lineWidth);
+  if (d.flags & AR_DEFER_SHADE_MODEL)
+    _shadeModelStateStack.push_back(d.shadeModel);
+  if (d.flags & AR_DEFER_LIGHTING)
+    _lightingStateStack.push_back(d.lighting);
+  if (d.flags & AR_DEFER_DEPTH_TEST)
+    _depthTestStateStack.push_back(d.depthTest);
+  if (d.flags & AR_DEFER_BLEND_FUNC)
+    _blendFuncStateStack.push_back(d.blendFunc);
+  if (d.flags & AR_DEFER_INSTANCE_COLOR)
+    _instanceColorStack.push_back(d.instanceColor);
+}
+
+// After the traversal, which left the stacks empty.
+void arGraphicsContext::drawDeferred(bool sorted) {
+  if (_deferred.empty())
+    return;
+
+  arMatrix4 modelView;
+  glGetFloatv(GL_MODELVIEW_MATRIX, modelView.v);
+  if (sorted)
+    sort(_deferred.begin(), _deferred.end(), _deferredLess);
+  for (vector<Deferred>::const_iterator i = _deferred.begin(); i != _deferred.end(); ++i) {
+    _restore(*i);
+    glLoadMatrixf(i->modelView.v);
+    ((arGraphicsNode*)i->node)->draw(this);
+  }
+  _deferred.clear();
+  clear();
+  glLoadMatrixf(modelView.v);
+}
@@ -12,9 +12,22 @@
 #include "arViewport.h"
 #include "arGraphicsCalling.h"
 
-#include <list>
+#include <vector>
+
+class arTexture;
+class arViewportCull;
 
 // Information maintained during the traversal of a scene graph.
+//
+// A shadow copy of the GL state that drawables set skips redundant
+// glEnable, glBlendFunc, glMaterial and texture binds.  Nodes that
+// change GL state behind the context's back must call invalidateState().
+//
+// With state sorting, deferDraw() queues drawing nodes (with their
+// modelview matrix and the attribute nodes above them) instead of drawing
+// them during traversal;  drawDeferred() then draws them ordered by blend,
+// texture and material, to minimize state changes.  Opaque geometry
+// precedes blended geometry, and blended geometry keeps traversal order.
 
 class SZG_CALL arGraphicsContext {
  public:
@@ -34,32 +47,132 @@ class SZG_CALL arGraphicsContext {
   arGraphicsWindow* getWindow() { return _graphicsWindow; }
   arViewport* getViewport() { return _viewport; }
 
+  // Visibility computed for all viewports by arViewportCull:
+  // 1 or 0 for bounding sphere nodeID, or -1 if not computed.
+  void setViewportCull(const arViewportCull* cull, int viewport)
+    { _cull = cull; _cullViewport = viewport; }
+  int getPrecomputedVisibility(int nodeID) const;
+
+  // Level of detail is chosen relative to viewpoint, in the coordinates
+  // that rootModelView (the modelview matrix at the root) maps to the eye.
+  // Default:  the eye.
+  void setViewpoint(const arVector3& viewpoint, const arMatrix4& rootModelView)
+    { _viewpoint = viewpoint; _rootInverse = rootModelView.inverse(); }
+  // Which child of arLODNode node to draw, at modelView.
+  int selectLOD(arDatabaseNode* node, const arMatrix4& modelView) const;
+
+  // arInstanceNode's per-instance RGBA, multiplying the colors drawn below.
+  void pushInstanceColor(const float* rgba);
+  void popInstanceColor();
+  // Hardware instancing of the drawables below an arInstanceNode,
+  // count instances of 20 floats each (see ar_beginInstancing()).
+  // False if unsupported, or already instancing.
+  bool beginInstances(const float* instances, int count);
+  void endInstances();
+  int getInstances() const { return _instances; }
+
+  // Shadow GL state.
+  void setStateCaching(bool f) { _fCache = f; invalidateState(); }
+  void invalidateState();
+  int getGLCallsIssued() const { return _glIssued; }
+  int getGLCallsSkipped() const { return _glSkipped; }
+
+  // Attribute nodes, indexed by _stackIndex().
+  enum { STACK_POINTS, STACK_BLEND, STACK_NORMAL3, STACK_COLOR4, STACK_TEX2,
+         STACK_INDEX, STACK_MATERIAL, STACK_TEXTURE, STACK_BUMP_MAP, STACK_COUNT };
+
+  // One drawing node, with what it inherits.
+  struct Deferred {
+    arDatabaseNode* node;
+    arMatrix4 modelView;
+    arDatabaseNode* top[STACK_COUNT];
+    float pointSize;
+    float lineWidth;
+    arVector4 instanceColor;
+    arGraphicsStateValue shadeModel;
+    arGraphicsStateValue lighting;
+    arGraphicsStateValue depthTest;
+    pair<arGraphicsStateValue, arGraphicsStateValue> blendFunc;
+    int flags;  // which of the above are set
+    int order;  // in traversal
+    bool blended;
+    const void* texture;
+    const void* material;
+  };
+
+  // State sorting.
+  bool deferDraw(arDatabaseNode* node);
+  // Sorted, or else in traversal order.
+  void drawDeferred(bool sorted = true);
+
+  // For traversals in other threads (arGraphicsTraversal):
+  // copy the attribute stacks and viewport cull of the parent traversal,
+  void inherit(const arGraphicsContext& parent);
+  // describe a drawing node at a given modelview matrix (false if
+  // node doesn't draw), and queue a list of them, in traversal order.
+  bool capture(arDatabaseNode* node, const arMatrix4& modelView, Deferred& d) const;
+  void deferDraw(const vector<Deferred>& drawList);
+  const vector<Deferred>& getDeferred() const { return _deferred; }
+
  protected:
   arGraphicsWindow* _graphicsWindow;
   arViewport*       _viewport;
-  list<arDatabaseNode*>   _pointsStack;
-  list<arDatabaseNode*>    _blendStack;
-  list<arDatabaseNode*>  _normal3Stack;
-  list<arDatabaseNode*>   _color4Stack;
-  list<arDatabaseNode*>     _tex2Stack;
-  list<arDatabaseNode*>    _indexStack;
-  list<arDatabaseNode*> _materialStack;
-  list<arDatabaseNode*>  _textureStack;
-  list<arDatabaseNode*>  _bumpMapStack;
-
-  list<float>                _pointSizeStateStack;
-  list<float>                _lineWidthStateStack;
-  list<arGraphicsStateValue> _shadeModelStateStack;
-  list<bool>                 _lightingStateStack;
-  list<bool>                 _depthTestStateStack;
-  list<bool>                 _blendStateStack;
-  list<pair<arGraphicsStateValue, arGraphicsStateValue> > _blendFuncStateStack;
+  const arViewportCull* _cull;
+  int _cullViewport;
+  vector<arVector4> _instanceColorStack;
+  int _instances;
+  arVector3 _viewpoint;
+  arMatrix4 _rootInverse;
+
+  vector<arDatabaseNode*> _nodeStack[STACK_COUNT];
+  static int _stackIndex(int nodeType);
+
+  vector<float>                _pointSizeStateStack;
+  vector<float>                _lineWidthStateStack;
+  vector<arGraphicsStateValue> _shadeModelStateStack;
+  vector<arGraphicsStateValue> _lightingStateStack;
+  vector<arGraphicsStateValue> _depthTestStateStack;
+  vector<arGraphicsStateValue> _blendStateStack;
+  vector<pair<arGraphicsStateValue, arGraphicsStateValue> > _blendFuncStateStack;
 
   void _pushGraphicsState(arDatabaseNode* node);
   void _popGraphicsState(arDatabaseNode* node);
   GLenum _decodeBlendFunction(arGraphicsStateValue v);
   void _setState(float& blendFactor, bool forceBlend = false);
 
+  // Shadow GL state.  -1 or NULL means unknown.
+  enum { CAP_LIGHTING, CAP_TEXTURE_2D, CAP_BLEND, CAP_DEPTH_TEST,
+         CAP_NORMALIZE, CAP_COLOR_MATERIAL, CAP_COUNT };
+  bool _fCache;
+  int _glIssued;
+  int _glSkipped;
+  int _cap[CAP_COUNT];
+  int _shadeModelGL;
+  float _pointSizeGL;
+  float _lineWidthGL;
+  int _blendSrcGL;
+  int _blendDstGL;
+  int _twoSideGL;
+  int _colorMaterialGL;
+  bool _materialKnown;
+  arVector4 _materialGL[4];   // diffuse, ambient, specular, emission
+  float _shininessGL;
+  arTexture* _textureGL;
+
+  bool _skip(bool same);
+  void _enable(int cap, bool on);
+  void _shadeModel(GLenum);
+  void _pointSize(float);
+  void _lineWidth(float);
+  void _blendFunc(GLenum src, GLenum dst);
+  void _lightModelTwoSide(bool);
+  void _colorMaterial();
+  void _material(const arVector4* m, float shininess);
+  void _activateTexture(arTexture*);
+
+  vector<Deferred> _deferred;
+  static bool _deferredLess(const Deferred&, const Deferred&);
+  void _restore(const Deferred&);
 };
 
 #endif
@@ -13,6 +13,18 @@ arGraphicsDatabase::arGraphicsDatabase() :
   _pathTexFont(""),
   _fFirstTexFont(true),
   _viewerNodeID(-1),
+  _fLOD(false),
+  _fStateCache(true),
+  _fStateSort(false),
+  _fInstancing(true),
+  _glCallsIssued(0),
+  _glCallsSkipped(0),
+  _fViewportCull(false),
+  _cullLock("VIEWPORT_CULL"),
+  _fAutoBounds(true),
+  _boundsLock("BOUNDS"),
+  _boundsGeneration(0),
+  _boundsRecomputed(0),
   _fComplainedImage(false),
   _fComplainedPPM(false)
 {
@@ -49,6 +61,8 @@ arGraphicsDatabase::arGraphicsDatabase() :
   bumpMapData = new arStructuredData(d, "bump map");
   graphicsStateData = new arStructuredData(d, "graphics state");
   graphicsPluginData = new arStructuredData(d, "graphics plugin");
+  lodData = new arStructuredData(d, "lod");
+  instanceData = new arStructuredData(d, "instance");
 
   if (!transformData      || !*transformData ||
       !pointsData         || !*pointsData ||
@@ -68,6 +82,7 @@ arGraphicsDatabase::arGraphicsDatabase() :
       !perspCameraData    || !*perspCameraData ||
       !bumpMapData        || !*bumpMapData ||
       !graphicsPluginData || !*graphicsPluginData ||
+      !lodData            || !*lodData ||
       !graphicsStateData  || !*graphicsStateData) {
     ar_log_error() << "arGraphicsDatabase: incomplete dictionary.\n";
   }
@@ -134,6 +149,9 @@ arGraphicsDatabase::~arGraphicsDatabase() {
   if (graphicsPluginData) {
     delete graphicsPluginData;
   }
+  if (lodData) {
+    delete lodData;
+  }
 
   // Don't forget to get rid of the textures. However, deleting them isn't
   // so smart. Instead, unref and let that operator delete if no one else
@@ -143,10 +161,19 @@ arGraphicsDatabase::~arGraphicsDatabase() {
        ++i) {
     i->second->unref();
   }
+  _releaseAssets();
+  _deleteCulls();
 }
 
 arDatabaseNode* arGraphicsDatabase::alter(arStructuredData* inData, bool refNode) {
-  return arDatabase::alter(inData, refNode);
+  arDatabaseNode* result = arDatabase::alter(inData, refNode);
+  const int id = inData->getID();
+  if (result && (id == _gfx.AR_MAKE_NODE || id == _gfx.AR_INSERT ||
+                 id == _gfx.AR_CUT || id == _gfx.AR_ERASE)) {
+    // Rare, so recompute every node's bounds instead of finding which.
+    _invalidateAllBounds();
+  }
+  return result;
 }
 
 void arGraphicsDatabase::reset() {
@@ -168,6 +195,20 @@ void arGraphicsDatabase::reset() {
     }
   }
   _textureNameContainer.clear();
+  _releaseAssets();
+  // Node IDs will be reused.
+  _deleteCulls();
+  _fLOD = false;
+  _invalidateAllBounds();
+}
+
+void arGraphicsDatabase::_releaseAssets() {
+  arAssetCache& cache = ar_assetCache();
+  for (vector<arAsset*>::iterator i = _textureAssets.begin();
+       i != _textureAssets.end(); ++i) {
+    cache.release(*i);
+  }
+  _textureAssets.clear();
 }
 
 // Alphabet-handling functions suck.
@@ -221,6 +262,33 @@ void arGraphicsDatabase::setTexturePath(const string& thePath) {
   }
 }
 
+arTexture* arGraphicsDatabase::_newTexture() {
+  arTexture* t = new arTexture;
+  // The default for the arTexture object is to use GL_DECAL mode, but we
+  // want LIT textures.
+  t->setTextureFunc(GL_MODULATE);
+  return t;
+}
+
+// Return (and ref) the texture in an image file, or NULL.
+// Textures are shared with other databases through ar_assetCache().
+arTexture* arGraphicsDatabase::_loadTexture(const string& fileName, int alpha) {
+  const string kind("texture/" + ar_intToString(alpha));
+  arAssetCache& cache = ar_assetCache();
+  arAsset* a = cache.acquire(kind, fileName);
+  if (!a) {
+    arTexture* t = _newTexture();
+    if (!t->readImage(fileName.c_str(), alpha, false)) {
+      t->unref();
+      return NULL;
+    }
+    t->mipmap(true);
+    a = cache.insert(kind, fileName, new arTextureAsset(t));
+  }
+  _textureAssets.push_back(a);
+  return static_cast<arTextureAsset*>(a)->texture()->ref();
+}
+
 // Return (and ref) a new texture. Caller must unref.
 arTexture* arGraphicsDatabase::addTexture(const string& name, int* theAlpha) {
   const map<string, arTexture*, less<string> >::iterator
@@ -230,10 +298,7 @@ arTexture* arGraphicsDatabase::addTexture(const string& name, int* theAlpha) {
     return iFind->second;
   }
 
-  arTexture* theTexture = new arTexture;
-  // The default for the arTexture object is to use GL_DECAL mode, but we
-  // want LIT textures.
-  theTexture->setTextureFunc(GL_MODULATE);
+  arTexture* theTexture = NULL;
   std::vector<std::string> triedPaths;
   if (name.length() <= 0) {
     ar_log_error() << "arGraphicsDatabase ignoring empty filename for texture.\n";
@@ -257,8 +322,8 @@ arTexture* arGraphicsDatabase::addTexture(const string& name, int* theAlpha) {
         s += name;
         ar_fixPathDelimiter(s);
         triedPaths.push_back( s );
-        fDone = theTexture->readImage(s.c_str(), *theAlpha, false);
-        theTexture->mipmap(true);
+        theTexture = _loadTexture(s, *theAlpha);
+        fDone = theTexture != NULL;
       }
     }
 
@@ -269,10 +334,12 @@ arTexture* arGraphicsDatabase::addTexture(const string& name, int* theAlpha) {
       s = *i + name;
       ar_fixPathDelimiter(s);
       triedPaths.push_back( s );
-      fDone = theTexture->readImage(s.c_str(), *theAlpha, false);
-      theTexture->mipmap(true);
+      theTexture = _loadTexture(s, *theAlpha);
+      fDone = theTexture != NULL;
     }
     if (!fDone) {
+      theTexture = _newTexture();
+      theTexture->mipmap(true);
       theTexture->dummy();
       if (!_fComplainedImage) {
         _fComplainedImage = true;
@@ -287,6 +354,8 @@ arTexture* arGraphicsDatabase::addTexture(const string& name, int* theAlpha) {
     }
   }
   triedPaths.clear();
+  if (!theTexture)
+    theTexture = _newTexture();
   _textureNameContainer.insert(
     map<string, arTexture*, less<string> >::value_type(name, theTexture));
 
@@ -419,17 +488,114 @@ void arGraphicsDatabase::setVRCameraID(int cameraID) {
 }
 
 void arGraphicsDatabase::draw( arGraphicsWindow& win, arViewport& view ) {
-  stack<arMatrix4> transformStack;
   arGraphicsContext context( &win, &view );
   const arMatrix4 projectionMatrix(view.getCamera()->getProjectionMatrix());
-  _draw((arGraphicsNode*)&_rootNode, transformStack, &context, &projectionMatrix);
+  if (_fViewportCull) {
+    _updateBounds();
+    int index = -1;
+    const arViewportCull* cull = _viewportCull(win, view, index);
+    context.setViewportCull(cull, index);
+  }
+  _drawRoot(context, &projectionMatrix);
+}
+
+// Called during win's _renderPass(), with its viewports locked.
+const arViewportCull* arGraphicsDatabase::_viewportCull(
+    arGraphicsWindow& win, arViewport& view, int& index) {
+  vector<arViewport>& viewports = *win.getViewports();
+  index = int(&view - &viewports[0]);
+  if (viewports.empty() || index < 0 || index >= int(viewports.size())) {
+    // Not one of win's.
+    index = -1;
+    return NULL;
+  }
+
+  arGuard _(_cullLock, "arGraphicsDatabase::_viewportCull");
+  WindowCull*& w = _culls[&win];
+  if (!w)
+    w = new WindowCull;
+  if (w->drawn.size() != viewports.size() || w->drawn[index]) {
+    // A new frame.  Each viewport's camera is set up as in
+    // arViewport::activate(), then view's is restored.
+    vector<arMatrix4> clip;
+    for (vector<arViewport>::iterator i = viewports.begin(); i != viewports.end(); ++i) {
+      arCamera* c = i->getCamera();
+      if (!c) {
+        // Can't cull viewports after this one.
+        break;
+      }
+      c->setEyeSign(i->getEyeSign());
+      c->setScreen(i->getScreen());
+      clip.push_back(c->getProjectionMatrix() * c->getModelviewMatrix());
+    }
+    arCamera* c = view.getCamera();
+    c->setEyeSign(view.getEyeSign());
+    c->setScreen(view.getScreen());
+    w->cull.cull(&_rootNode, clip, _fAutoBounds);
+    w->drawn.assign(viewports.size(), false);
+  }
+  w->drawn[index] = true;
+  return &w->cull;
+}
+
+void arGraphicsDatabase::_deleteCulls() {
+  arGuard _(_cullLock, "arGraphicsDatabase::_deleteCulls");
+  for (map<const arGraphicsWindow*, WindowCull*>::iterator i = _culls.begin();
+       i != _culls.end(); ++i)
+    delete i->second;
+  _culls.clear();
+}
+
+string arGraphicsDatabase::getCullStats() {
+  arGuard _(_cullLock, "arGraphicsDatabase::getCullStats");
+  if (!_fViewportCull)
+    return "Viewport culling off.\n";
+  string s;
+  for (map<const arGraphicsWindow*, WindowCull*>::const_iterator i = _culls.begin();
+       i != _culls.end(); ++i)
+    s += i->second->cull.status();
+  return s.empty() ? "No viewports culled yet.\n" : s;
 }
 
 
 void arGraphicsDatabase::draw(const arMatrix4* projectionMatrix) {
-  stack<arMatrix4> transformStack;
   arGraphicsContext context;
-  _draw((arGraphicsNode*)&_rootNode, transformStack, &context, projectionMatrix);
+  _drawRoot(context, projectionMatrix);
+}
+
+void arGraphicsDatabase::_drawRoot(arGraphicsContext& context,
+                                   const arMatrix4* projectionMatrix) {
+  stack<arMatrix4> transformStack;
+  context.setStateCaching(_fStateCache);
+  _updateBounds();
+  arMatrix4 modelView;
+  glGetFloatv(GL_MODELVIEW_MATRIX, modelView.v);
+  if (_fLOD) {
+    // Select levels of detail from the head, not from each eye,
+    // so both eyes and all render nodes agree.
+    arHead* head = getHead(false);
+    if (head)
+      context.setViewpoint(head->getMidEyePosition(), modelView);
+  }
+  if (_traversal.getThreads() > 1) {
+    _traversal.drawList(&_rootNode, modelView, projectionMatrix, context, _fAutoBounds);
+    context.drawDeferred(_fStateSort);
+  }
+  else {
+    _draw((arGraphicsNode*)&_rootNode, transformStack, &context, projectionMatrix);
+    context.drawDeferred();
+  }
+  _glCallsIssued = context.getGLCallsIssued();
+  _glCallsSkipped = context.getGLCallsSkipped();
+}
+
+string arGraphicsDatabase::getStateStats() const {
+  const int total = _glCallsIssued + _glCallsSkipped;
+  return "GL state calls: " + ar_intToString(_glCallsIssued) + " issued, " +
+    ar_intToString(_glCallsSkipped) + " skipped (" +
+    ar_intToString(total ? 100 * _glCallsSkipped / total : 0) + "%)" +
+    (_fStateCache ? "" : ", caching off") +
+    (_fStateSort ? ", sorted" : "") + ".\n";
 }
 
 void arGraphicsDatabase::_draw(arGraphicsNode* node,
@@ -463,19 +629,55 @@ void arGraphicsDatabase::_draw(arGraphicsNode* node,
   //   If this is an invisible visibility node, draw neither node nor children.
   if (code != -1 && code != AR_D_NAME_NODE) {
     // These nodes are just arDatabaseNodes, not arGraphicsNodes.
-    node->draw(context);
+    if (!_fStateSort || !context->deferDraw(node))
+      node->draw(context);
+  }
+
+  // Cull view-frustum.  Not while hardware instancing, since
+  // the modelview matrix doesn't include the instances' matrices.
+  // A transform node's automatic bounds are in its children's frame,
+  // which its draw() just applied.
+  if (projectionMatrix && context->getInstances() == 0 &&
+      (code == AR_G_BOUNDING_SPHERE_NODE ||
+       (code == AR_G_TRANSFORM_NODE && _fAutoBounds))) {
+    int visible = context->getPrecomputedVisibility(node->getID());
+    if (visible < 0) {
+      arBoundingSphere b;
+      if (code == AR_G_BOUNDING_SPHERE_NODE)
+        b = ((arBoundingSphereNode*)node)->getBoundingSphere();
+      else if (!node->_boundingSphere(b))
+        visible = 1;
+      if (visible < 0) {
+        glGetFloatv(GL_MODELVIEW_MATRIX, modelViewMatrix.v);
+        visible = b.intersectViewFrustum(*projectionMatrix * modelViewMatrix);
+      }
+    }
+    if (!visible) {
+      if (code == AR_G_TRANSFORM_NODE) {
+        glLoadMatrixf(transformStack.top().v);
+        transformStack.pop();
+      }
+      goto done;
+    }
   }
 
-  // Cull view-frustum.
-  if (projectionMatrix && code == AR_G_BOUNDING_SPHERE_NODE) {
+  if (code == AR_G_LOD_NODE) {
+    // Draw only the child for the current level.
     glGetFloatv(GL_MODELVIEW_MATRIX, modelViewMatrix.v);
-    arBoundingSphere b = ((arBoundingSphereNode*)node)->getBoundingSphere();
-    if (!b.intersectViewFrustum(*projectionMatrix * modelViewMatrix)) {
-      goto done;
+    int level = context->selectLOD(node, modelViewMatrix);
+    const list<arDatabaseNode*>& children = node->_children;
+    for (list<arDatabaseNode*>::const_iterator i = children.begin();
+         i != children.end(); ++i) {
+      if (level-- == 0) {
+        _draw((arGraphicsNode*)(*i), transformStack, context, projectionMatrix);
+        break;
+      }
     }
   }
-
-  if ( !(code == AR_G_VISIBILITY_NODE &&
+  else if (code == AR_G_INSTANCE_NODE) {
+    _drawInstances(node, transformStack, context, projectionMatrix);
+  }
+  else if ( !(code == AR_G_VISIBILITY_NODE &&
        !((arVisibilityNode*)node)->getVisibility() ) ) {
     // Not an invisible visibility node.  Draw children.
     // Use _children, not getChildren(), to avoid copying the whole list.
@@ -494,6 +696,193 @@ done:
   context->popNode(node);
 }
 
+// Draw an arInstanceNode's children once per instance:  with hardware
+// instancing, one GL call per drawable;  otherwise, in a loop.
+void arGraphicsDatabase::_drawInstances(arGraphicsNode* node,
+                                        stack<arMatrix4>& transformStack,
+                                        arGraphicsContext* context,
+                                        const arMatrix4* projectionMatrix) {
+  // Copy, so instances can change while the children draw.
+  vector<float> instances;
+  ((arInstanceNode*)node)->getInstances(instances);
+  const int number = int(instances.size()) / 20;
+  if (number == 0)
+    return;
+
+  const list<arDatabaseNode*>& children = node->_children;
+  list<arDatabaseNode*>::const_iterator i;
+  if (_fInstancing && !_fStateSort && _instanceable(node) &&
+      context->beginInstances(&instances[0], number)) {
+    for (i = children.begin(); i != children.end(); ++i)
+      _draw((arGraphicsNode*)(*i), transformStack, context, projectionMatrix);
+    context->endInstances();
+    return;
+  }
+
+  arMatrix4 modelView;
+  glGetFloatv(GL_MODELVIEW_MATRIX, modelView.v);
+  for (int j=0; j<number; ++j) {
+    const float* instance = &instances[20*j];
+    glLoadMatrixf(modelView.v);
+    glMultMatrixf(instance);
+    context->pushInstanceColor(instance + 16);
+    for (i = children.begin(); i != children.end(); ++i)
+      _draw((arGraphicsNode*)(*i), transformStack, context, projectionMatrix);
+    context->popInstanceColor();
+  }
+  glLoadMatrixf(modelView.v);
+}
+
+// Whether hardware instancing draws node's subtree correctly:  only
+// drawables go through ar_beginInstancing(), so billboards, plugins,
+// visible bounding spheres and bump maps need the loop.
+bool arGraphicsDatabase::_instanceable(arDatabaseNode* node) {
+  const int code = node->getTypeCode();
+  if (code == AR_G_BILLBOARD_NODE || code == AR_G_GRAPHICS_PLUGIN_NODE ||
+      code == AR_G_BUMP_MAP_NODE)
+    return false;
+  if (code == AR_G_BOUNDING_SPHERE_NODE &&
+      ((arBoundingSphereNode*)node)->getBoundingSphere().visibility)
+    return false;
+  const list<arDatabaseNode*>& children = ((arGraphicsNode*)node)->_children;
+  for (list<arDatabaseNode*>::const_iterator i = children.begin();
+       i != children.end(); ++i) {
+    if (!_instanceable(*i))
+      return false;
+  }
+  return true;
+}
+
+bool arGraphicsDatabase::getBounds(arDatabaseNode* node, arVector3& min, arVector3& max) {
+  if (!node)
+    return false;
+  arGuard _(_boundsLock, "arGraphicsDatabase::getBounds");
+  const arGraphicsBounds& b = _updateBounds(node);
+  if (!b.finite())
+    return false;
+  min = b.min;
+  max = b.max;
+  return true;
+}
+
+bool arGraphicsDatabase::getBoundingSphere(arDatabaseNode* node, arBoundingSphere& b) {
+  arVector3 min, max;
+  if (!getBounds(node, min, max))
+    return false;
+  b.position = .5 * (min + max);
+  b.radius = .5 * ++(max - min);
+  b.visibility = false;
+  return true;
+}
+
+int arGraphicsDatabase::getBoundsRecomputed() {
+  arGuard _(_boundsLock, "arGraphicsDatabase::getBoundsRecomputed");
+  const int n = _boundsRecomputed;
+  _boundsRecomputed = 0;
+  return n;
+}
+
+arGraphicsBounds& arGraphicsDatabase::_boundsOf(arDatabaseNode* node) {
+  const int code = node->getTypeCode();
+  return (code == -1 || code == AR_D_NAME_NODE) ?
+    _plainBounds[node] : ((arGraphicsNode*)node)->_bounds;
+}
+
+// Before a traversal reads nodes' _bounds unlocked.
+void arGraphicsDatabase::_updateBounds() {
+  if (!_fAutoBounds)
+    return;
+  arGuard _(_boundsLock, "arGraphicsDatabase::_updateBounds");
+  (void)_updateBounds(&_rootNode);
+}
+
+// Call while _boundsLock'd.  Only stale nodes are visited, so after
+// one transform changes, just the path above it is recomputed.
+const arGraphicsBounds& arGraphicsDatabase::_updateBounds(arDatabaseNode* node) {
+  arGraphicsBounds& b = _boundsOf(node);
+  if (b.generation == _boundsGeneration)
+    return b;
+  ++_boundsRecomputed;
+
+  const int code = node->getTypeCode();
+  arGraphicsBounds own;
+  if (code == AR_G_POINTS_NODE) {
+    own = ((arPointsNode*)node)->getPointsBounds();
+  }
+  else if (code == AR_G_DRAWABLE_NODE) {
+    own.flags = arGraphicsBounds::INHERITS;
+  }
+  else if (code == AR_G_BILLBOARD_NODE || code == AR_G_GRAPHICS_PLUGIN_NODE ||
+           code == AR_G_BUMP_MAP_NODE) {
+    own.flags = arGraphicsBounds::UNBOUNDED;
+  }
+
+  // Like _draw(), every child (so every level of an LOD node, and
+  // what's below invisible visibility nodes, which may reappear).
+  arGraphicsBounds below;
+  const list<arDatabaseNode*>& children = ((arGraphicsNode*)node)->_children;
+  for (list<arDatabaseNode*>::const_iterator i = children.begin(); i != children.end(); ++i) {
+    arDatabaseNode* child = *i;
+    const arGraphicsBounds& c = _updateBounds(child);
+    if (child->getTypeCode() != AR_G_TRANSFORM_NODE) {
+      below.add(c);
+      continue;
+    }
+    const arMatrix4 m(((arTransformNode*)child)->getTransform());
+    below.addBox(c, m);
+    below.flags |= c.flags & arGraphicsBounds::UNBOUNDED;
+    if (c.flags & arGraphicsBounds::INHERITS) {
+      // Drawables below the transform draw points from above it.
+      // Only this node's own are known to be the ones they draw.
+      if (code == AR_G_POINTS_NODE)
+        below.addBox(own, m);
+      else
+        below.flags |= arGraphicsBounds::UNBOUNDED;
+    }
+  }
+
+  if (code == AR_G_INSTANCE_NODE) {
+    // The children draw once per instance's matrix.
+    vector<float> instances;
+    ((arInstanceNode*)node)->getInstances(instances);
+    const arGraphicsBounds inside(below);
+    below = arGraphicsBounds();
+    if (inside.flags & (arGraphicsBounds::INHERITS | arGraphicsBounds::UNBOUNDED))
+      below.flags = arGraphicsBounds::UNBOUNDED;
+    for (size_t j=0; j+20 <= instances.size(); j+=20)
+      below.addBox(inside, arMatrix4(&instances[j]));
+  }
+  else if (code == AR_G_POINTS_NODE) {
+    // Drawables below draw these points, already in own.
+    below.flags &= ~arGraphicsBounds::INHERITS;
+  }
+
+  b = own;
+  b.add(below);
+  b.generation = _boundsGeneration;
+  return b;
+}
+
+// Stale node's bounds and its ancestors'.  Ancestors of a stale
+// node are already stale, so this usually stops at once.
+void arGraphicsDatabase::_invalidateBounds(arDatabaseNode* node) {
+  arGuard _(_boundsLock, "arGraphicsDatabase::_invalidateBounds");
+  for (; node; node = node->getParent()) {
+    arGraphicsBounds& b = _boundsOf(node);
+    if (b.generation != _boundsGeneration)
+      break;
+    b.generation = -1;
+  }
+}
+
+void arGraphicsDatabase::_invalidateAllBounds() {
+  arGuard _(_boundsLock, "arGraphicsDatabase::_invalidateAllBounds");
+  if (++_boundsGeneration < 0)
+    _boundsGeneration = 0;
+  // Forget erased name nodes.
+  _plainBounds.clear();
+}
+
 // Return the ID of the bounding-sphere node with the closest point of
 // intersection to a ray.
 // If no bounding sphere intersects, return the "not a node" ID.
@@ -691,6 +1080,7 @@ arGraphicsNode* arGraphicsDatabase::intersectGeometry(const arRay& theRay,
   arGraphicsContext context;
   arGraphicsNode* bestNode = NULL;
   float bestDistance = -1;
+  _updateBounds();
   _intersectGeometry((arGraphicsNode*)&_rootNode, &context, rayStack,
                      excludeBelow, bestNode, bestDistance);
   return bestNode;
@@ -766,6 +1156,19 @@ void arGraphicsDatabase::_intersectGeometry(arGraphicsNode* node,
     rayStack.push(arRay((!theMatrix)*currentRay.getOrigin(),
                         (!theMatrix)*currentRay.getDirection()
                         - (!theMatrix)*arVector3(0, 0, 0)));
+
+    // Skip what the ray misses, by the automatic bounds.
+    arBoundingSphere bounds;
+    if (_fAutoBounds && node->_boundingSphere(bounds)) {
+      arRay localRay(rayStack.top());
+      if (localRay.intersect(bounds) < 0) {
+        rayStack.pop();
+        if (context) {
+          context->popNode(node);
+        }
+        return;
+      }
+    }
   }
 
   // If this is a bounding sphere, intersect.
@@ -816,10 +1219,29 @@ void arGraphicsDatabase::_intersectGeometry(arGraphicsNode* node,
   // Handle intersections with children.
   // For thread-safety, hold (and then unrelease) references to the node pointers,
   list<arDatabaseNode*> children = node->getChildrenRef();
-  for (list<arDatabaseNode*>::iterator i = children.begin();
-       i != children.end(); ++i) {
-    _intersectGeometry((arGraphicsNode*)(*i), context, rayStack,
-                       excludeBelow, bestNode, bestDistance);
+  if (node->getTypeCode() == AR_G_INSTANCE_NODE) {
+    // Each instance's copy, as drawn (and as bounded above).
+    const vector<arMatrix4> instances(((arInstanceNode*)node)->getMatrices());
+    for (vector<arMatrix4>::const_iterator j = instances.begin(); j != instances.end(); ++j) {
+      const arMatrix4 inverse(!*j);
+      const arRay currentRay(rayStack.top());
+      rayStack.push(arRay(inverse*currentRay.getOrigin(),
+                          inverse*currentRay.getDirection()
+                          - inverse*arVector3(0, 0, 0)));
+      for (list<arDatabaseNode*>::iterator i = children.begin();
+           i != children.end(); ++i) {
+        _intersectGeometry((arGraphicsNode*)(*i), context, rayStack,
+                           excludeBelow, bestNode, bestDistance);
+      }
+      rayStack.pop();
+    }
+  }
+  else {
+    for (list<arDatabaseNode*>::iterator i = children.begin();
+         i != children.end(); ++i) {
+      _intersectGeometry((arGraphicsNode*)(*i), context, rayStack,
+                         excludeBelow, bestNode, bestDistance);
+    }
   }
   ar_unrefNodeList(children);
 
@@ -897,15 +1319,16 @@ void arGraphicsDatabase::activateLights() {
 // to the head matrix it holds (because of the VR camera, which needs
 // a head matrix, all other cameras have one as well).
 // Thread-safe.
-arHead* arGraphicsDatabase::getHead() {
+arHead* arGraphicsDatabase::getHead(bool fWarn) {
   arViewerNode* viewerNode = NULL;
   // getNodeRef not getNode, for thread safety.
   if (_viewerNodeID != -1)
-    viewerNode = (arViewerNode*) getNodeRef(_viewerNodeID);
+    viewerNode = (arViewerNode*) getNodeRef(_viewerNodeID, fWarn);
   if (!viewerNode)
-    viewerNode = (arViewerNode*) getNodeRef("szg_viewer");
+    viewerNode = (arViewerNode*) getNodeRef("szg_viewer", fWarn);
   if (!viewerNode) {
-    ar_log_error() << "arGraphicsDatabase: getHead() failed.\n";
+    if (fWarn)
+      ar_log_error() << "arGraphicsDatabase: getHead() failed.\n";
     return NULL;
   }
 
@@ -1030,6 +1453,13 @@ arDatabaseNode* arGraphicsDatabase::_makeNode(const string& type) {
   else if (type == "graphics plugin") {
     outNode = (arDatabaseNode*) new arGraphicsPluginNode();
   }
+  else if (type == "lod") {
+    outNode = (arDatabaseNode*) new arLODNode();
+    _fLOD = true;
+  }
+  else if (type == "instance") {
+    outNode = (arDatabaseNode*) new arInstanceNode();
+  }
   else {
     ar_log_error() << "arGraphicsDatabase: makeNode factory got unknown type '"
                    << type << "'.\n";
@@ -35,6 +35,10 @@
 #include "arBumpMapNode.h"
 #include "arGraphicsStateNode.h"
 #include "arGraphicsPluginNode.h"
+#include "arLODNode.h"
+#include "arInstanceNode.h"
+#include "arGraphicsTraversal.h"
+#include "arViewportCull.h"
 
 #include "arGraphicsCalling.h"
 
@@ -44,6 +48,7 @@
 class SZG_CALL arGraphicsDatabase: public arDatabase{
  // Needs assignment operator and copy constructor, for pointer members.
  public:
+  friend class arGraphicsNode;
   arGraphicsDatabase();
   virtual ~arGraphicsDatabase();
 
@@ -73,17 +78,53 @@ class SZG_CALL arGraphicsDatabase: public arDatabase{
 
   void draw( arGraphicsWindow& win, arViewport& view );
   void draw(const arMatrix4* projectionMatrix = NULL);
+  // Skip redundant GL state changes, and draw in state-sorted order.
+  void setStateCaching(bool f) { _fStateCache = f; }
+  void setStateSorting(bool f) { _fStateSort = f; }
+  bool getStateSorting() const { return _fStateSort; }
+  // Draw arInstanceNode with hardware instancing if the GL supports it,
+  // unless state sorting or more than one traversal thread.  Default true.
+  void setInstancing(bool f) { _fInstancing = f; }
+  bool getInstancing() const { return _fInstancing; }
+  // Threads that traverse the scene graph for draw() and motion culling.
+  // With more than one, drawing nodes are queued for
+  // arGraphicsContext::drawDeferred() (sorted if setStateSorting()).
+  void setTraversalThreads(int threads) { _traversal.setThreads(threads); }
+  int getTraversalThreads() const { return _traversal.getThreads(); }
+  // Cull all of a window's viewports (and eyes) together, when
+  // draw(win, view) draws its first viewport of a frame (see arViewportCull).
+  void setViewportCulling(bool f) { _fViewportCull = f; }
+  bool getViewportCulling() const { return _fViewportCull; }
+  // Cost of each window's most recent viewport cull.
+  string getCullStats();
+  // GL state calls issued and skipped by the most recent draw().
+  string getStateStats() const;
   int intersect(const arRay&);
   list<arDatabaseNode*> intersect(const arBoundingSphere& b, bool addRef=false);
   list<arDatabaseNode*> intersectRef(const arBoundingSphere& b);
   list<int>* intersectList(const arRay&);
   arGraphicsNode* intersectGeometry(const arRay& theRay, int excludeBelow = -1);
 
+  // Automatic bounds:  the box around the points drawn at and below node,
+  // in the frame node's children draw in.  Recomputed lazily, only above
+  // changed points, transforms and instances (or everywhere, after the
+  // graph's structure changes).  False if nothing is drawn, or if it can't
+  // be bounded (billboards, plugins, bump maps, or drawables using points
+  // from above a transform).
+  bool getBounds(arDatabaseNode* node, arVector3& min, arVector3& max);
+  bool getBoundingSphere(arDatabaseNode* node, arBoundingSphere& b);
+  // Also cull and pick at transform nodes, by their automatic bounds.
+  // Default true.
+  void setAutoBounds(bool f) { _fAutoBounds = f; }
+  bool getAutoBounds() const { return _fAutoBounds; }
+  // Nodes whose bounds were recomputed, since the last call.
+  int getBoundsRecomputed();
+
   bool registerLight(arGraphicsNode* node, arLight* theLight);
   bool removeLight(arGraphicsNode* node);
   void activateLights();
 
-  arHead* getHead();
+  arHead* getHead(bool fWarn = true);
   bool registerCamera(arGraphicsNode* node, arPerspectiveCamera* theCamera);
   bool removeCamera(arGraphicsNode* node);
   // Normally we use the default "VR camera"... however, the database can
@@ -110,6 +151,8 @@ class SZG_CALL arGraphicsDatabase: public arDatabase{
   arStructuredData* bumpMapData;
   arStructuredData* graphicsStateData;
   arStructuredData* graphicsPluginData;
+  arStructuredData* lodData;
+  arStructuredData* instanceData;
 
   arGraphicsLanguage _gfx;
 
@@ -119,6 +162,10 @@ class SZG_CALL arGraphicsDatabase: public arDatabase{
   arLock _texturePathLock; // guards _texturePath
   list<string>* _texturePath;
   map<string, arTexture*, less<string> > _textureNameContainer;
+  vector<arAsset*> _textureAssets;  // from ar_assetCache()
+  arTexture* _newTexture();
+  arTexture* _loadTexture(const string& fileName, int alpha);
+  void _releaseAssets();
   arTexFont _texFont;
   string _pathTexFont;
   bool _fFirstTexFont;
@@ -132,9 +179,45 @@ class SZG_CALL arGraphicsDatabase: public arDatabase{
   pair<arGraphicsNode*, arPerspectiveCamera*> _cameraContainer[8];
   // The ID of the node that contains the VR camera information.
   int _viewerNodeID;
-
+  // Whether an LOD node was ever made, so drawing needs the viewpoint.
+  bool _fLOD;
+
+  bool _fStateCache;
+  bool _fStateSort;
+  bool _fInstancing;
+  int _glCallsIssued;
+  int _glCallsSkipped;
+  arGraphicsTraversal _traversal;
+
+  // Per window, since windows may draw in different threads.
+  struct WindowCull {
+    arViewportCull cull;
+    vector<bool> drawn;  // Viewports drawn since the cull.
+  };
+  bool _fViewportCull;
+  arLock _cullLock;  // guards _culls
+  map<const arGraphicsWindow*, WindowCull*> _culls;
+  const arViewportCull* _viewportCull(arGraphicsWindow&, arViewport&, int& index);
+  void _deleteCulls();
+  void _drawRoot(arGraphicsContext&, const arMatrix4*);
   void _draw(arGraphicsNode*, stack<arMatrix4>&, arGraphicsContext*,
              const arMatrix4*);
+  void _drawInstances(arGraphicsNode*, stack<arMatrix4>&, arGraphicsContext*,
+                      const arMatrix4*);
+  bool _instanceable(arDatabaseNode*);
+
+  // Automatic bounds.
+  bool _fAutoBounds;
+  arLock _boundsLock;  // guards every node's _bounds, and what follows
+  int _boundsGeneration;
+  // The root's and name nodes', which aren't arGraphicsNodes.
+  map<const arDatabaseNode*, arGraphicsBounds> _plainBounds;
+  int _boundsRecomputed;
+  arGraphicsBounds& _boundsOf(arDatabaseNode*);
+  void _updateBounds();
+  const arGraphicsBounds& _updateBounds(arDatabaseNode*);
+  void _invalidateBounds(arDatabaseNode*);
+  void _invalidateAllBounds();
   void _intersect(arGraphicsNode*, float&, int&, stack<arRay>&);
   void _intersect(arGraphicsNode* node,
                   const arBoundingSphere& b,
@@ -43,7 +43,9 @@ enum {
   AR_G_DRAWABLE_NODE = 15,
   AR_G_BUMP_MAP_NODE = 16,
   AR_G_GRAPHICS_STATE_NODE = 17,
-  AR_G_GRAPHICS_PLUGIN_NODE = 18
+  AR_G_GRAPHICS_PLUGIN_NODE = 18,
+  AR_G_LOD_NODE = 19,
+  AR_G_INSTANCE_NODE = 20
 };
 
 enum arGraphicsStateID {
@@ -29,7 +29,10 @@ arGraphicsLanguage::arGraphicsLanguage():
   _bumpMap("bump map"),
   _graphicsAdmin("graphics admin"),
   _graphicsState("graphics state"),
-  _graphicsPlugin("graphics plugin") {
+  _graphicsPlugin("graphics plugin"),
+  _lod("lod"),
+  _instance("instance"),
+  _packedArray("packed array") {
 
   AR_TRANSFORM_ID = _transform.add("ID", AR_INT);
   AR_TRANSFORM_MATRIX = _transform.add("matrix", AR_FLOAT);
@@ -139,6 +142,7 @@ arGraphicsLanguage::arGraphicsLanguage():
   AR_GRAPHICS_ADMIN_ACTION = _graphicsAdmin.add("action", AR_CHAR);
   AR_GRAPHICS_ADMIN_NODE_ID = _graphicsAdmin.add("node_ID", AR_INT);
   AR_GRAPHICS_ADMIN_NAME = _graphicsAdmin.add("name", AR_CHAR);
+  AR_GRAPHICS_ADMIN_REGION = _graphicsAdmin.add("region", AR_FLOAT);
   AR_GRAPHICS_ADMIN = _dictionary.add(&_graphicsAdmin);
 
   AR_GRAPHICS_STATE_ID = _graphicsState.add("ID", AR_INT);
@@ -157,6 +161,26 @@ arGraphicsLanguage::arGraphicsLanguage():
   AR_GRAPHICS_PLUGIN_NUMSTRINGS   = _graphicsPlugin.add("numstrings", AR_INT);
   AR_GRAPHICS_PLUGIN        = _dictionary.add(&_graphicsPlugin);
 
+  // Last, so the IDs of older records don't change.
+  AR_LOD_ID = _lod.add("ID", AR_INT);
+  AR_LOD_MODE = _lod.add("mode", AR_INT);
+  AR_LOD_RANGES = _lod.add("ranges", AR_FLOAT);
+  AR_LOD_CENTER = _lod.add("center", AR_FLOAT);
+  AR_LOD_RADIUS = _lod.add("radius", AR_FLOAT);
+  AR_LOD = _dictionary.add(&_lod);
+
+  AR_INSTANCE_ID = _instance.add("ID", AR_INT);
+  AR_INSTANCE_IDS = _instance.add("instance IDs", AR_INT);
+  AR_INSTANCE_INSTANCES = _instance.add("instances", AR_FLOAT);
+  AR_INSTANCE_COUNT = _instance.add("count", AR_INT);
+  AR_INSTANCE = _dictionary.add(&_instance);
+
+  AR_PACKED_ARRAY_ID = _packedArray.add("ID", AR_INT);
+  AR_PACKED_ARRAY_FORMAT = _packedArray.add("format", AR_INT);
+  AR_PACKED_ARRAY_RANGE = _packedArray.add("range", AR_FLOAT);
+  AR_PACKED_ARRAY_CODES = _packedArray.add("codes", AR_CHAR);
+  AR_PACKED_ARRAY = _dictionary.add(&_packedArray);
+
 }
 
 string arGraphicsLanguage::typeFromID(int ID) {
@@ -168,7 +192,7 @@ string arGraphicsLanguage::typeFromID(int ID) {
 }
 
 const char* arGraphicsLanguage::_stringFromID(const int id) const {
-  const int cnames = 22;
+  const int cnames = 25;
 
   const int ids[] = {
     AR_TRANSFORM,
@@ -193,6 +217,9 @@ const char* arGraphicsLanguage::_stringFromID(const int id) const {
     AR_GRAPHICS_ADMIN,
     AR_GRAPHICS_STATE,
     AR_GRAPHICS_PLUGIN,
+    AR_LOD,
+    AR_INSTANCE,
+    AR_PACKED_ARRAY,
     };
 
   static const char* names[cnames+1] = {
@@ -218,6 +245,9 @@ const char* arGraphicsLanguage::_stringFromID(const int id) const {
     "AR_GRAPHICS_ADMIN",
     "AR_GRAPHICS_STATE",
     "AR_GRAPHICS_PLUGIN",
+    "AR_LOD",
+    "AR_INSTANCE",
+    "AR_PACKED_ARRAY",
     "(unknown!)"
     };
 
@@ -137,6 +137,7 @@ class SZG_CALL arGraphicsLanguage:public arDatabaseLanguage{
   int AR_GRAPHICS_ADMIN_ACTION;
   int AR_GRAPHICS_ADMIN_NODE_ID;
   int AR_GRAPHICS_ADMIN_NAME;
+  int AR_GRAPHICS_ADMIN_REGION;
 
   int AR_GRAPHICS_STATE;        // Used in manipulating rendering state inside
   int AR_GRAPHICS_STATE_ID;     // the scene graph. Stuff like point size,
@@ -154,6 +155,25 @@ class SZG_CALL arGraphicsLanguage:public arDatabaseLanguage{
   int AR_GRAPHICS_PLUGIN_STRING;
   int AR_GRAPHICS_PLUGIN_NUMSTRINGS;
 
+  int AR_LOD;
+  int AR_LOD_ID;
+  int AR_LOD_MODE;
+  int AR_LOD_RANGES;
+  int AR_LOD_CENTER;
+  int AR_LOD_RADIUS;
+
+  int AR_INSTANCE;
+  int AR_INSTANCE_ID;
+  int AR_INSTANCE_IDS;
+  int AR_INSTANCE_INSTANCES;
+  int AR_INSTANCE_COUNT;
+
+  int AR_PACKED_ARRAY;          // a points, normal3, color4 or tex2 record,
+  int AR_PACKED_ARRAY_ID;       // quantized for the wire (arGraphicsArrayCodec.h)
+  int AR_PACKED_ARRAY_FORMAT;
+  int AR_PACKED_ARRAY_RANGE;
+  int AR_PACKED_ARRAY_CODES;
+
  protected:
   arDataTemplate _transform;
   arDataTemplate _points;
@@ -175,6 +195,9 @@ class SZG_CALL arGraphicsLanguage:public arDatabaseLanguage{
   arDataTemplate _graphicsAdmin;
   arDataTemplate _graphicsState;
   arDataTemplate _graphicsPlugin;
+  arDataTemplate _lod;
+  arDataTemplate _instance;
+  arDataTemplate _packedArray;
 public:
   const char* _stringFromID(const int) const;
   string numstringFromID(const int) const;
@@ -48,6 +48,21 @@ void arGraphicsNode::_accumulateTransform(const arGraphicsNode* n, arMatrix4& m)
   }
 }
 
+bool arGraphicsNode::_boundingSphere(arBoundingSphere& b) const {
+  if (!_owningDatabase || !_bounds.finite() ||
+      _bounds.generation != _owningDatabase->_boundsGeneration)
+    return false;
+  b.position = .5 * (_bounds.min + _bounds.max);
+  b.radius = .5 * ++(_bounds.max - _bounds.min);
+  b.visibility = false;
+  return true;
+}
+
+void arGraphicsNode::_invalidateBounds(arDatabaseNode* node) {
+  if (_owningDatabase && node)
+    _owningDatabase->_invalidateBounds(node);
+}
+
 arStructuredData* arGraphicsNode::_getRecord(const bool owned, const int id) {
   arStructuredData* r = owned ? getStorage(id) : _g->makeDataRecord(id);
   if (!r) {
@@ -56,3 +71,40 @@ arStructuredData* arGraphicsNode::_getRecord(const bool owned, const int id) {
   }
   return r;
 }
+
+void arGraphicsBounds::add(const arVector3& v) {
+  if (!(flags & BOX)) {
+    flags |= BOX;
+    min = max = v;
+    return;
+  }
+  for (int i=0; i<3; ++i) {
+    if (v.v[i] < min.v[i])
+      min.v[i] = v.v[i];
+    if (v.v[i] > max.v[i])
+      max.v[i] = v.v[i];
+  }
+}
+
+void arGraphicsBounds::add(const arGraphicsBounds& b) {
+  flags |= b.flags & ~BOX;
+  if (b.flags & BOX) {
+    add(b.min);
+    add(b.max);
+  }
+}
+
+// Transform the center, and take each new half-extent from the
+// absolute values of m's rows (Arvo), instead of all eight corners.
+void arGraphicsBounds::addBox(const arGraphicsBounds& b, const arMatrix4& m) {
+  if (!(b.flags & BOX))
+    return;
+  const arVector3 center(m * (.5 * (b.min + b.max)));
+  const arVector3 half(.5 * (b.max - b.min));
+  arVector3 extent;
+  for (int i=0; i<3; ++i)
+    extent.v[i] = fabs(m.v[i]) * half.v[0] + fabs(m.v[4+i]) * half.v[1] +
+      fabs(m.v[8+i]) * half.v[2];
+  add(center - extent);
+  add(center + extent);
+}
@@ -13,16 +13,42 @@
 #include "arGraphicsLanguage.h"
 #include "arDatabaseNode.h"
 #include "arGraphicsContext.h"
+#include "arRay.h"
 #include "arGraphicsCalling.h"
 
 class arGraphicsDatabase;
 
+// A subtree's automatic bounds (see arGraphicsDatabase::getBounds()).
+
+class SZG_CALL arGraphicsBounds {
+ public:
+  arGraphicsBounds() : flags(0), generation(-1) {}
+
+  enum { BOX = 1, INHERITS = 2, UNBOUNDED = 4 };
+  // BOX if min and max hold points.  INHERITS if drawables draw
+  // points from above.  UNBOUNDED if anything else draws.
+  int flags;
+  arVector3 min;
+  arVector3 max;
+  // Current while it matches the database's.
+  int generation;
+
+  void add(const arVector3&);
+  void add(const arGraphicsBounds&);
+  // Add b's box after transforming it by m (affine).  Its flags are the
+  // caller's to handle, since INHERITS means points from another frame.
+  void addBox(const arGraphicsBounds& b, const arMatrix4& m);
+  bool finite() const { return flags == BOX; }
+};
+
 // Node in an arGraphicsDatabase.
 
 class SZG_CALL arGraphicsNode: public arDatabaseNode {
  // Needs assignment operator and copy constructor, for pointer members.
  public:
   friend class arGraphicsDatabase;
+  friend class arGraphicsTraversal;
+  friend class arViewportCull;
   arGraphicsNode();
   virtual ~arGraphicsNode();
 
@@ -43,6 +69,13 @@ class SZG_CALL arGraphicsNode: public arDatabaseNode {
   arGraphicsDatabase* _owningDatabase;
   arGraphicsLanguage* _g;
   arLightFloatBuffer _commandBuffer;
+  arGraphicsBounds _bounds;  // Guarded by _owningDatabase->_boundsLock.
+
+  // Unlocked, for traversals after arGraphicsDatabase::_updateBounds():
+  // a sphere around _bounds, if they're current and finite.
+  bool _boundingSphere(arBoundingSphere&) const;
+  // After data changes, stale the bounds here and above.
+  void _invalidateBounds(arDatabaseNode*);
 
   void _accumulateTransform(const arGraphicsNode* g, arMatrix4& m);
   arStructuredData* _getRecord(const bool owned, const int id);
@@ -6,6 +6,8 @@
 #include "arPrecompiled.h"
 #include "arGraphicsPeer.h"
 
+#include <limits.h>
+
 void arGraphicsPeerCullObject::clear() {
   cullOnOff.clear();
 }
@@ -40,6 +42,7 @@ arGraphicsPeerConnection::arGraphicsPeerConnection() {
   // to a feedback peer.  Choose the most permissive send level,
   // because we send updates if node level <= filter level.
   outFilter.insert(arNodePair(0, AR_TRANSIENT_NODE));
+  writes = 0;
 }
 
 string arGraphicsPeerConnection::print() {
@@ -52,7 +55,136 @@ string arGraphicsPeerConnection::print() {
     }
     s += *i;
   }
-  return s + "\n";
+  s += "\n  " + ar_intToString(writes) + " writes\n";
+  s += lanes[AR_INTERACTIVE_LANE].print("interactive") +
+    lanes[AR_BULK_LANE].print("bulk");
+  if (interest.kind != arGraphicsPeerInterest::NONE || interest.recordsDropped > 0)
+    s += interest.print();
+  if (encoder.getEncoding() || encoder.records > 0)
+    s += encoder.print();
+  return s;
+}
+
+arGraphicsPeerInterest::arGraphicsPeerInterest() :
+  kind(NONE),
+  frustum(ar_identityMatrix()),  // Not the default, which reads OpenGL.
+  margin(0.),
+  spheres(0),
+  recordsDropped(0),
+  bytesDropped(0.),
+  catchUps(0),
+  catchUpRecords(0) {
+}
+
+bool arGraphicsPeerInterest::meets(const arBoundingSphere& b, bool wasOutside) const {
+  const arBoundingSphere grown(b.position, b.radius + (wasOutside ? 0. : margin));
+  switch (kind) {
+  case VOLUME:
+    return ++(grown.position - volume.position) <= grown.radius + volume.radius;
+  case FRUSTUM:
+    return grown.classifyViewFrustum(frustum) >= 0;
+  default:
+    return true;
+  }
+}
+
+string arGraphicsPeerInterest::print() const {
+  ostringstream s;
+  s << "  interest: " << (kind == VOLUME ? "volume" : kind == FRUSTUM ? "frustum" : "none") <<
+    ", " << outside.size() << " of " << spheres << " spheres outside, " <<
+    recordsDropped << " records (" << bytesDropped << " bytes) dropped, " <<
+    catchUps << " catch-ups (" << catchUpRecords << " records).\n";
+  return s.str();
+}
+
+arGraphicsPeerLane::arGraphicsPeerLane() :
+  records(0),
+  bytesPerSecond(0),
+  credit(0.),
+  refilled(ar_time()),
+  recordsSent(0),
+  bytesSent(0.),
+  deferrals(0),
+  peakQueued(0) {
+}
+
+bool arGraphicsPeerLane::append(arStructuredData* data, int nodeID, int nodeID2) {
+  const int offset = queued.size();
+  queued.resize(offset + data->size());
+  if (!data->pack(&queued[offset])) {
+    queued.resize(offset);
+    return false;
+  }
+  ++records;
+  recordNodes.push_back(make_pair(nodeID, nodeID2));
+  if (nodeID >= 0)
+    ++nodes[nodeID];
+  if (nodeID2 >= 0)
+    ++nodes[nodeID2];
+  if (int(queued.size()) > peakQueued)
+    peakQueued = queued.size();
+  return true;
+}
+
+int arGraphicsPeerLane::take(vector<ARchar>& out, const ar_timeval& now,
+                             bool drain, int limit) {
+  if (queued.empty())
+    return 0;
+  int budget = drain ? int(queued.size()) : limit;
+  if (!drain && bytesPerSecond > 0) {
+    // Refill the bucket, allowing bursts of 100 msec.
+    credit += bytesPerSecond * ar_difftime(now, refilled) / 1e6;
+    refilled = now;
+    const double burst = bytesPerSecond / 10.;
+    if (credit > burst)
+      credit = burst;
+    if (credit <= 0.) {
+      ++deferrals;
+      return 0;
+    }
+    if (credit < budget)
+      budget = int(credit);
+  }
+
+  // Whole records, at least one (a record bigger than the bucket
+  // leaves it in debt).
+  int n = 0;
+  int count = 0;
+  while (n < int(queued.size())) {
+    const int size = ar_rawDataGetSize(&queued[n]);
+    if (count > 0 && n + size > budget)
+      break;
+    n += size;
+    ++count;
+    const pair<int, int> ids(recordNodes.front());
+    recordNodes.pop_front();
+    if (ids.first >= 0 && --nodes[ids.first] == 0)
+      nodes.erase(ids.first);
+    if (ids.second >= 0 && --nodes[ids.second] == 0)
+      nodes.erase(ids.second);
+  }
+  out.insert(out.end(), queued.begin(), queued.begin() + n);
+  queued.erase(queued.begin(), queued.begin() + n);
+  records -= count;
+  recordsSent += count;
+  bytesSent += n;
+  if (!drain && bytesPerSecond > 0) {
+    credit -= n;
+    if (!queued.empty())
+      ++deferrals;
+  }
+  return n;
+}
+
+string arGraphicsPeerLane::print(const string& name) const {
+  ostringstream s;
+  s << "  " << name << ": " << recordsSent << " records, " <<
+    bytesSent << " bytes sent, " << records << " records (" <<
+    queued.size() << " bytes) queued, peak " << peakQueued << " bytes";
+  if (bytesPerSecond > 0)
+    s << ", cap " << bytesPerSecond << " bytes/s, " << deferrals << " deferrals";
+  s << ".\n";
+  return s.str();
 }
 
 class arGraphicsPeerSerializeInfo{
@@ -182,7 +314,7 @@ void ar_graphicsPeerConsumptionFunction(arStructuredData* data,
           }
         gp->_queueConsumeLock.unlock();
       }
-      gp->_dataServer->sendData(&adminData, socket);
+      gp->_send(&adminData, socket);
     }
 
     else if (action == "ping_reply") {
@@ -199,7 +331,8 @@ void ar_graphicsPeerConsumptionFunction(arStructuredData* data,
       // a result.
       arStructuredData adminData(l->find("graphics admin"));
       adminData.dataInString(l->AR_GRAPHICS_ADMIN_ACTION, "close");
-      gp->_dataServer->sendData(&adminData, socket);
+      gp->_send(&adminData, socket);
+      gp->flush();
       gp->_closeConnection(socket);
     }
 
@@ -253,6 +386,37 @@ void ar_graphicsPeerConsumptionFunction(arStructuredData* data,
       }
     }
 
+    else if (action == "interest") {
+      const int kind = data->getDataInt(l->AR_GRAPHICS_ADMIN_NODE_ID);
+      gp->_lock("ar_graphicsPeerConsumptionFunction interest");
+      map<int, arGraphicsPeerConnection*, less<int> >::iterator i =
+        gp->_connectionContainer.find(socket->getID());
+      if (i == gp->_connectionContainer.end()) {
+        ar_log_error() << "arGraphicsPeer internal error: found no connection object.\n";
+      }
+      else{
+        gp->_setInterest(*i->second, kind,
+          (const float*)data->getDataPtr(l->AR_GRAPHICS_ADMIN_REGION, AR_FLOAT),
+          data->getDataDimension(l->AR_GRAPHICS_ADMIN_REGION));
+      }
+      gp->_unlock();
+    }
+
+    else if (action == "encoding") {
+      const int encoding = data->getDataInt(l->AR_GRAPHICS_ADMIN_NODE_ID);
+      gp->_lock("ar_graphicsPeerConsumptionFunction encoding");
+      map<int, arGraphicsPeerConnection*, less<int> >::iterator i =
+        gp->_connectionContainer.find(socket->getID());
+      if (i == gp->_connectionContainer.end()) {
+        ar_log_error() << "arGraphicsPeer internal error: found no connection object.\n";
+      }
+      else{
+        arGuard _(i->second->queueLock, "ar_graphicsPeerConsumptionFunction encoding");
+        i->second->encoder.setEncoding(encoding);
+      }
+      gp->_unlock();
+    }
+
     else if (action =="set-name") {
       const string socketLabel(data->getDataString(l->AR_GRAPHICS_ADMIN_NAME));
       gp->_dataServer->setSocketLabel(socket, socketLabel);
@@ -274,7 +438,7 @@ void ar_graphicsPeerConsumptionFunction(arStructuredData* data,
       nodeID = gp->getNodeID(nodeName);
       data->dataIn(l->AR_GRAPHICS_ADMIN_NODE_ID, &nodeID, AR_INT, 1);
       data->dataInString(l->AR_GRAPHICS_ADMIN_ACTION, "ID-response");
-      gp->_dataServer->sendData(data, socket);
+      gp->_send(data, socket);
     }
 
     else if (action == "ID-response") {
@@ -419,26 +583,43 @@ void ar_graphicsPeerConnectionTask(void* graphicsPeer) {
     // NOTE: we are guaranteed that this key is unique since
     // IDs are not reused.
     gp->_lock("ar_graphicsPeerConnectionTask");
-    arGraphicsPeerConnection* newConnection = new arGraphicsPeerConnection();
     // we do not know the remote name yet. That will be forwarded to us.
-    newConnection->connectionID = socket->getID();
-    newConnection->socket = socket;
-    newConnection->rootMapNode = &gp->_rootNode;
-    gp->_connectionContainer.insert(
-      map<int, arGraphicsPeerConnection*, less<int> >::value_type(
-        socket->getID(),
-        newConnection));
+    gp->_addConnection(socket, "NULL");
     gp->_unlock();
   }
   cout << "arGraphicsPeer error: connection accept failed.\n";
 }
 
+void ar_graphicsPeerFlushTask(void* graphicsPeer) {
+  ((arGraphicsPeer*)graphicsPeer)->_flushTask();
+}
+
 arGraphicsPeer::arGraphicsPeer() :
   _IDResponseVar("arGraphicsPeer-ID-response"),
   _dumpVar("arGraphicsPeer-dump"),
   _pingVar("arGraphicsPeer-ping"),
-  _queueConsumeVar("arGraphicsPeer-queue-consume")
+  _queueConsumeVar("arGraphicsPeer-queue-consume"),
+  _flushInterval(2),
+  _flushVar("arGraphicsPeer-flush"),
+  _pending(false),
+  _flushRunning(false),
+  _flushExit(false),
+  _fConcurrentAlters(true),
+  _interestInterval(100),
+  _bulkBacklog(65536)
 {
+  _interestUpdated = ar_time();
+  // Records whose nodes' receiveData() only locks the node itself
+  // (and, briefly, the database's bounds).
+  memset(_concurrent, 0, sizeof(_concurrent));
+  const int concurrent[] = { _gfx.AR_TRANSFORM, _gfx.AR_POINTS,
+    _gfx.AR_BOUNDING_SPHERE, _gfx.AR_VISIBILITY, _gfx.AR_BLEND,
+    _gfx.AR_NORMAL3, _gfx.AR_COLOR4, _gfx.AR_TEX2, _gfx.AR_INDEX,
+    _gfx.AR_DRAWABLE, _gfx.AR_MATERIAL, _gfx.AR_PACKED_ARRAY };
+  for (unsigned i=0; i<sizeof(concurrent)/sizeof(concurrent[0]); ++i)
+    _concurrent[concurrent[i]] = true;
+  _laneCap[AR_INTERACTIVE_LANE] = 0;
+  _laneCap[AR_BULK_LANE] = 0;
   // set a few defaults and initialize the mutexes.
   _localDatabase = true;
   _queueingData = false;
@@ -465,6 +646,13 @@ arGraphicsPeer::arGraphicsPeer() :
 }
 
 arGraphicsPeer::~arGraphicsPeer() {
+  _pendingLock.lock("arGraphicsPeer::~arGraphicsPeer");
+  _flushExit = true;
+  _flushVar.signal();
+  _pendingLock.unlock();
+  arSleepBackoff a(5, 20, 1.1);
+  while (_flushRunning)
+    a.sleep();
 }
 
 // The graphics peer uses the "phleet" to offer its services to the
@@ -482,6 +670,7 @@ bool arGraphicsPeer::init(arSZGClient& client) {
     _readWritePath = result;
   }
   _componentID = _client->getProcessID();
+  _initParameters(*_client);
   return true;
 }
 
@@ -498,9 +687,22 @@ bool arGraphicsPeer::init(int& argc, char** argv) {
     _readWritePath = result;
   }
   _componentID = _client->getProcessID();
+  _initParameters(*_client);
   return true;
 }
 
+void arGraphicsPeer::_initParameters(arSZGClient& client) {
+  int x = 0;
+  if (client.getAttributeInts("SZG_PEER", "flush_interval", &x))
+    setFlushInterval(x);
+  if (client.getAttributeInts("SZG_PEER", "interactive_cap", &x))
+    setLaneCap(AR_INTERACTIVE_LANE, x);
+  if (client.getAttributeInts("SZG_PEER", "bulk_cap", &x))
+    setLaneCap(AR_BULK_LANE, x);
+  if (client.getAttributeInts("SZG_PEER", "interest_interval", &x))
+    setInterestInterval(x);
+}
+
 bool arGraphicsPeer::start() {
   if (!_client) {
     cerr << "arGraphicsPeer error: start() called before init().\n";
@@ -522,14 +724,7 @@ bool arGraphicsPeer::start() {
     return false;
   }
 
-  _dataServer->setConsumerCallback(ar_graphicsPeerConsumptionFunction);
-  _dataServer->setConsumerObject(this);
-  _dataServer->setDisconnectCallback(ar_graphicsPeerDisconnectFunction);
-  _dataServer->setDisconnectObject(this);
-  // Definitely want have finer-grained locks then over the processing
-  // of each admin message. This makes message operations that take
-  // a long time to complete practical.
-  _dataServer->atomicReceive(false);
+  _setCallbacks();
   _dataServer->setPort(port);
   _dataServer->setInterface("INADDR_ANY");
   bool success = false;
@@ -560,8 +755,34 @@ bool arGraphicsPeer::start() {
   return true;
 }
 
+bool arGraphicsPeer::startStandalone(int port, const string& networkInterface) {
+  _setCallbacks();
+  // Unique among peers on this host, for loop detection.
+  _componentID = port;
+  if (!_dataServer->setPort(port) ||
+      !_dataServer->setInterface(networkInterface) ||
+      !_dataServer->beginListening(_gfx.getDictionary())) {
+    ar_log_error() << "arGraphicsPeer failed to listen on " <<
+      networkInterface << ":" << port << ".\n";
+    return false;
+  }
+  _connectionThread.beginThread(ar_graphicsPeerConnectionTask, this);
+  return true;
+}
+
+void arGraphicsPeer::_setCallbacks() {
+  _dataServer->setConsumerCallback(ar_graphicsPeerConsumptionFunction);
+  _dataServer->setConsumerObject(this);
+  _dataServer->setDisconnectCallback(ar_graphicsPeerDisconnectFunction);
+  _dataServer->setDisconnectObject(this);
+  // Definitely want have finer-grained locks then over the processing
+  // of each admin message. This makes message operations that take
+  // a long time to complete practical.
+  _dataServer->atomicReceive(false);
+}
+
 void arGraphicsPeer::stop() {
-  closeAllAndReset();
+  closeAllAndReset(); // Flushes.
   _client->closeConnection();
 }
 
@@ -573,6 +794,13 @@ arDatabaseNode* arGraphicsPeer::alter(arStructuredData* data,
   if (data->getID() == _gfx.AR_GRAPHICS_ADMIN) {
     return &_rootNode;
   }
+  if (_fConcurrentAlters && _concurrent[data->getID()] &&
+      _localDatabase && !_bridgeDatabase) {
+    bool fDone = false;
+    arDatabaseNode* result = _alterConcurrent(data, fDone);
+    if (fDone)
+      return result;
+  }
   map<int, arGraphicsPeerConnection*, less<int> >::iterator connectionIter;
   int potentialNewNodeID = -1;
   arDatabaseNode* result = &_rootNode;
@@ -679,8 +907,9 @@ arDatabaseNode* arGraphicsPeer::alter(arStructuredData* data,
     if (potentialNewNodeID > 0 && result) {
       connectionIter->second->inMap.insert(arNodePair(potentialNewNodeID, result->getID()));
       // Put this in the filterIDs.
-      // TWO pairs might be added to the node map, so test for this.
-      filterIDs[filterIDs[1] != -1 ? 1 : 3] = result->getID();
+      // TWO pairs might be added to the node map, so fill in whichever
+      // pair lacks the new node.
+      filterIDs[filterIDs[1] == -1 ? 1 : 3] = result->getID();
       // Activate the outFilter on this node.
       _insertOutFilter(connectionIter->second->outFilter, result->getID(),
                        connectionIter->second->sendLevel);
@@ -746,21 +975,28 @@ arDatabaseNode* arGraphicsPeer::alter(arStructuredData* data,
       // a node level of AR_STRUCTURE_NODE.
       // Also, note how we do not send the message on if
       // arGraphicsDatabase::alter failed locally (i.e. result == NULL).
+      // Updates (not structure) below a bounding sphere outside the
+      // connection's region of interest wait for a catch-up dump.
       if (updateNodeEvenIfTransient &&
           outIter != connectionIter->second->outFilter.end() &&
-          result && result->getNodeLevel() <= outIter->second) {
-        _dataServer->sendData(data, connectionIter->second->socket);
+          result && result->getNodeLevel() <= outIter->second &&
+          (_databaseReceive[dataID] ||
+           !_dropped(connectionIter->second->interest, result, data))) {
+        _queue(*connectionIter->second, data, IDPtr[0]);
       }
     }
     else{
       // The sender's node map needs to be augmented exactly when the
       // filterIDs array has been modified. (see filterIncoming above)
+      // Until the sender has the map, it drops transforms to these nodes,
+      // so they queue behind it.
       if (filterIDs[0] != -1) {
         arStructuredData adminData(_gfx.find("graphics admin"));
         adminData.dataInString(_gfx.AR_GRAPHICS_ADMIN_ACTION, "node_map");
         adminData.dataIn(_gfx.AR_GRAPHICS_ADMIN_NODE_ID, filterIDs, AR_INT,
                          filterIDs[2] == -1 ? 2 : 4);
-        _dataServer->sendData(&adminData, connectionIter->second->socket);
+        _queue(*connectionIter->second, &adminData, filterIDs[1],
+               filterIDs[2] == -1 ? -1 : filterIDs[3]);
       }
     }
   }
@@ -769,6 +1005,61 @@ arDatabaseNode* arGraphicsPeer::alter(arStructuredData* data,
   return result;
 }
 
+// alter() for data records, without _lock().  Sets fDone false for
+// records that alter() should handle instead.
+arDatabaseNode* arGraphicsPeer::_alterConcurrent(arStructuredData* data,
+                                                 bool& fDone) {
+  const int fieldID = _routingField[data->getID()];
+  const int originID = _getOriginSocketID(data, fieldID);
+  arDatabaseNode* result = &_rootNode;
+  fDone = true;
+  map<int, arGraphicsPeerConnection*, less<int> >::iterator i;
+  _lockShared("arGraphicsPeer::_alterConcurrent");
+  if (originID != -1) {
+    i = _connectionContainer.find(originID);
+    if (i == _connectionContainer.end()) {
+      _unlockShared();
+      return result;
+    }
+    // For data records, this only reads inMap.
+    if (!filterIncoming(i->second->rootMapNode, data, i->second->inMap, NULL,
+                        &i->second->outFilter, i->second->sendLevel, false)) {
+      // Unmapped.
+      _unlockShared();
+      fDone = false;
+      return result;
+    }
+  }
+  const int nodeID = *(int*)data->getDataPtr(fieldID, AR_INT);
+  arNodeMap::const_iterator j = _lockContainer.find(nodeID);
+  if (j != _lockContainer.end() && j->second != originID) {
+    _unlockShared();
+    return result;
+  }
+
+  _stripes[unsigned(nodeID) % STRIPES].lock("arGraphicsPeer::_alterConcurrent");
+  result = arGraphicsDatabase::alter(data);
+  if (result) {
+    for (i = _connectionContainer.begin(); i != _connectionContainer.end(); ++i) {
+      arGraphicsPeerConnection& c = *i->second;
+      if (c.connectionID == originID)
+        continue;
+      arGuard _(c.queueLock, "arGraphicsPeer::_alterConcurrent");
+      const bool fUpdate = result->getNodeLevel() != AR_TRANSIENT_NODE ||
+        _updateTransientMap(nodeID, c.transientMap, c.remoteFrameTime);
+      arNodeMap::const_iterator out = c.outFilter.find(nodeID);
+      if (fUpdate && out != c.outFilter.end() &&
+          result->getNodeLevel() <= out->second &&
+          !_dropped(c.interest, result, data)) {
+        _queue(c, data, nodeID);
+      }
+    }
+  }
+  _stripes[unsigned(nodeID) % STRIPES].unlock();
+  _unlockShared();
+  return result;
+}
+
 // The read/write methods are redefined so that we IMPLICITLY use a path
 // as might be specified by the arSZGClient through init unless one is
 // explicitly specified.
@@ -920,8 +1211,16 @@ int arGraphicsPeer::connectToPeer(const string& name) {
     ar_log_error() << "arGraphicsPeer failed to connect to named peer.\n";
     return -1;
   }
+  return connectToPeer(name, result.address, result.portIDs[0]);
+}
 
-  const int socketID = _dataServer->dialUpFallThrough(result.address, result.portIDs[0]);
+int arGraphicsPeer::connectToPeer(const string& name,
+                                  const string& address, int port) {
+  if (_dataServer->getFirstIDWithLabel(name) != -1) {
+    ar_log_remark() << "arGraphicsPeer cannot make duplicate connection.\n";
+    return -1;
+  }
+  const int socketID = _dataServer->dialUpFallThrough(address, port);
   if (socketID < 0) {
     ar_log_error() << "arGraphicsPeer failed to connect to brokered ports.\n";
     return -1;
@@ -936,15 +1235,7 @@ int arGraphicsPeer::connectToPeer(const string& name) {
   // Bug: race condition. a new connection that
   // disappeared *immediately* might not be correctly handled.
   // ANOTHER REASON TO HANDLE DISCONNECT EVENTS DIFFERENTLY
-  // todo: constructor for next 5 lines
-  arGraphicsPeerConnection* newConnection = new arGraphicsPeerConnection();
-  newConnection->remoteName = name;
-  newConnection->connectionID = socket->getID();
-  newConnection->socket = socket;
-  newConnection->rootMapNode = &_rootNode;
-  _connectionContainer.insert(
-    map<int, arGraphicsPeerConnection*, less<int> >::value_type(
-      socket->getID(), newConnection));
+  _addConnection(socket, name);
   _unlock();
   // Give the remote socket our name.
   _setRemoteLabel(socket, _name);
@@ -966,7 +1257,9 @@ bool arGraphicsPeer::closeConnection(const string& name) {
   }
   arStructuredData adminData(_gfx.find("graphics admin"));
   adminData.dataInString(_gfx.AR_GRAPHICS_ADMIN_ACTION, "close");
-  return _dataServer->sendData(&adminData, socket);
+  const bool ok = _send(&adminData, socket);
+  flush();
+  return ok;
 }
 
 // By default, nothing happens when we connect a graphics peer to another.
@@ -996,7 +1289,7 @@ bool arGraphicsPeer::pullSerial(const string& name,
   // We have to wait for the serialization to be completed
   _dumpLock.lock("arGraphicsPeer::pullSerial");
   _dumped = false;
-  _dataServer->sendData(&adminData, socket);
+  _send(&adminData, socket);
   // Block until we are done receiving data (the remote peer signals us that
   // it is finished.)
   while (!_dumped) {
@@ -1030,7 +1323,8 @@ bool arGraphicsPeer::pushSerial(const string& name,
 bool arGraphicsPeer::closeAllAndReset() {
   arStructuredData adminData(_gfx.find("graphics admin"));
   adminData.dataInString(_gfx.AR_GRAPHICS_ADMIN_ACTION, "close");
-  _dataServer->sendData(&adminData);
+  _sendAll(&adminData);
+  flush();
   // wait for everybody to close... THIS IS BAD SINCE IT RELIES ON TRUSTING
   // THE CONNECTED PEERS!
   arSleepBackoff a(30, 120, 1.08);
@@ -1057,7 +1351,7 @@ bool arGraphicsPeer::pingPeer(const string& name) {
   }
   _pingLock.lock("arGraphicsPeer::pingPeer");
   _pinged = false;
-  _dataServer->sendData(&adminData, socket);
+  _send(&adminData, socket);
   while (!_pinged) {
     _pingVar.wait(_pingLock);
   }
@@ -1070,7 +1364,7 @@ bool arGraphicsPeer::broadcastFrameTime(int frameTime) {
   arStructuredData adminData(_gfx.find("graphics admin"));
   adminData.dataInString(_gfx.AR_GRAPHICS_ADMIN_ACTION, "frame_time");
   adminData.dataIn(_gfx.AR_GRAPHICS_ADMIN_NODE_ID, &frameTime, AR_INT, 1);
-  _dataServer->sendData(&adminData);
+  _sendAll(&adminData);
   return true;
 }
 
@@ -1086,7 +1380,7 @@ bool arGraphicsPeer::remoteLockNode(const string& name, int nodeID) {
   if (!socket) {
     return false;
   }
-  _dataServer->sendData(&adminData, socket);
+  _send(&adminData, socket);
   return true;
 }
 
@@ -1104,7 +1398,7 @@ bool arGraphicsPeer::remoteLockNodeBelow(const string& name, int nodeID) {
   if (!socket) {
     return false;
   }
-  _dataServer->sendData(&adminData, socket);
+  _send(&adminData, socket);
   return true;
 }
 
@@ -1120,7 +1414,7 @@ bool arGraphicsPeer::remoteUnlockNode(const string& name, int nodeID) {
   if (!socket) {
     return false;
   }
-  _dataServer->sendData(&adminData, socket);
+  _send(&adminData, socket);
   return true;
 }
 
@@ -1137,7 +1431,7 @@ bool arGraphicsPeer::remoteUnlockNodeBelow(const string& name, int nodeID) {
   if (!socket) {
     return false;
   }
-  _dataServer->sendData(&adminData, socket);
+  _send(&adminData, socket);
   return true;
 }
 
@@ -1179,7 +1473,7 @@ bool arGraphicsPeer::remoteFilterDataBelow(const string& peer,
   if (!socket) {
     return false;
   }
-  _dataServer->sendData(&adminData, socket);
+  _send(&adminData, socket);
   return true;
 }
 
@@ -1194,7 +1488,7 @@ bool arGraphicsPeer::mappedFilterDataBelow(int localNodeID,
   data[1] = level;
   adminData.dataIn(_gfx.AR_GRAPHICS_ADMIN_NODE_ID, data, AR_INT, 2);
   // Gets sent to everybody!
-  _dataServer->sendData(&adminData);
+  _sendAll(&adminData);
   return true;
 }
 
@@ -1228,7 +1522,7 @@ int arGraphicsPeer::remoteNodeID(const string& peer,
   }
   _IDResponseLock.lock("arGraphicsPeer::remoteNodeID");
     _requestedNodeID = -2;
-    _dataServer->sendData(&adminData, socket);
+    _send(&adminData, socket);
     // On error, we'll get back -1, and otherwise nonnegative.
     while (_requestedNodeID == -2) {
       _IDResponseVar.wait(_IDResponseLock);
@@ -1251,6 +1545,268 @@ string arGraphicsPeer::printConnections() {
   return s.str();
 }
 
+void arGraphicsPeer::setFlushInterval(int msec) {
+  _flushInterval = msec < 0 ? 0 : msec;
+}
+
+void arGraphicsPeer::setLaneCap(arPeerLane lane, int bytesPerSecond) {
+  if (lane < 0 || lane >= AR_LANE_COUNT)
+    return;
+  _lock("arGraphicsPeer::setLaneCap");
+  _laneCap[lane] = bytesPerSecond < 0 ? 0 : bytesPerSecond;
+  for (map<int, arGraphicsPeerConnection*, less<int> >::iterator
+         i = _connectionContainer.begin(); i != _connectionContainer.end(); ++i) {
+    i->second->lanes[lane].bytesPerSecond = _laneCap[lane];
+  }
+  _unlock();
+}
+
+void arGraphicsPeer::flush() {
+  (void)_flush(true);
+}
+
+bool arGraphicsPeer::setInterest(const string& peer,
+                                 const arBoundingSphere& volume, float margin) {
+  const float region[5] = { volume.position.v[0], volume.position.v[1],
+    volume.position.v[2], volume.radius, margin };
+  return _sendInterest(peer, arGraphicsPeerInterest::VOLUME, region, 5);
+}
+
+bool arGraphicsPeer::setInterest(const string& peer,
+                                 const arMatrix4& clip, float margin) {
+  float region[17];
+  memcpy(region, clip.v, 16 * sizeof(float));
+  region[16] = margin;
+  return _sendInterest(peer, arGraphicsPeerInterest::FRUSTUM, region, 17);
+}
+
+bool arGraphicsPeer::clearInterest(const string& peer) {
+  return _sendInterest(peer, arGraphicsPeerInterest::NONE, NULL, 0);
+}
+
+void arGraphicsPeer::setInterestInterval(int msec) {
+  _interestInterval = msec < 0 ? 0 : msec;
+}
+
+bool arGraphicsPeer::setEncoding(const string& peer, int encoding) {
+  arStructuredData adminData(_gfx.find("graphics admin"));
+  adminData.dataInString(_gfx.AR_GRAPHICS_ADMIN_ACTION, "encoding");
+  adminData.dataIn(_gfx.AR_GRAPHICS_ADMIN_NODE_ID, &encoding, AR_INT, 1);
+  const int ID = _dataServer->getFirstIDWithLabel(peer);
+  arSocket* socket = _dataServer->getConnectedSocket(ID);
+  if (!socket) {
+    ar_log_error() << "arGraphicsPeer: no peer '" << peer << "' to set encoding.\n";
+    return false;
+  }
+  return _send(&adminData, socket);
+}
+
+double arGraphicsPeer::getBytesSent(const string& peer) {
+  double bytes = -1.;
+  _lock("arGraphicsPeer::getBytesSent");
+  for (map<int, arGraphicsPeerConnection*, less<int> >::const_iterator
+         i = _connectionContainer.begin(); i != _connectionContainer.end(); ++i) {
+    if (i->second->remoteName == peer) {
+      bytes = i->second->lanes[AR_INTERACTIVE_LANE].bytesSent +
+        i->second->lanes[AR_BULK_LANE].bytesSent;
+      break;
+    }
+  }
+  _unlock();
+  return bytes;
+}
+
+bool arGraphicsPeer::_sendInterest(const string& peer, int kind,
+                                   const float* region, int count) {
+  arStructuredData adminData(_gfx.find("graphics admin"));
+  adminData.dataInString(_gfx.AR_GRAPHICS_ADMIN_ACTION, "interest");
+  adminData.dataIn(_gfx.AR_GRAPHICS_ADMIN_NODE_ID, &kind, AR_INT, 1);
+  if (count > 0) {
+    adminData.dataIn(_gfx.AR_GRAPHICS_ADMIN_REGION, region, AR_FLOAT, count);
+  }
+  const int ID = _dataServer->getFirstIDWithLabel(peer);
+  arSocket* socket = _dataServer->getConnectedSocket(ID);
+  if (!socket) {
+    ar_log_error() << "arGraphicsPeer: no peer '" << peer << "' for region of interest.\n";
+    return false;
+  }
+  return _send(&adminData, socket);
+}
+
+void arGraphicsPeer::_setInterest(arGraphicsPeerConnection& c, int kind,
+                                  const float* region, int count) {
+  arGraphicsPeerInterest& interest = c.interest;
+  if (kind == arGraphicsPeerInterest::VOLUME && region && count == 5) {
+    interest.volume = arBoundingSphere(arVector3(region), region[3]);
+    interest.margin = region[4];
+  }
+  else if (kind == arGraphicsPeerInterest::FRUSTUM && region && count == 17) {
+    interest.frustum = arFrustumPlanes(arMatrix4(region));
+    interest.margin = region[16];
+  }
+  else {
+    if (kind != arGraphicsPeerInterest::NONE) {
+      ar_log_error() << "arGraphicsPeer ignoring malformed region of interest from " <<
+        c.remoteName << ".\n";
+    }
+    kind = arGraphicsPeerInterest::NONE;
+  }
+  interest.kind = kind;
+  if (kind != arGraphicsPeerInterest::NONE) {
+    _updateInterest(c);
+    return;
+  }
+
+  // Everything is of interest again.
+  map<int, bool> outside;
+  outside.swap(interest.outside);
+  interest.spheres = 0;
+  for (map<int, bool>::const_iterator i = outside.begin(); i != outside.end(); ++i) {
+    arDatabaseNode* node = i->second ? getNode(i->first, false) : NULL;
+    if (node) {
+      ++interest.catchUps;
+      _catchUp(c, node);
+    }
+  }
+}
+
+void arGraphicsPeer::_updateInterest() {
+  if (ar_difftime(ar_time(), _interestUpdated) < _interestInterval * 1000.)
+    return;
+  _interestUpdated = ar_time();
+  _lock("arGraphicsPeer::_updateInterest");
+  for (map<int, arGraphicsPeerConnection*, less<int> >::iterator
+         i = _connectionContainer.begin(); i != _connectionContainer.end(); ++i) {
+    if (i->second->interest.kind != arGraphicsPeerInterest::NONE)
+      _updateInterest(*i->second);
+  }
+  _unlock();
+}
+
+// Reclassify every bounding sphere, then send what was dropped below
+// the ones that came back.
+void arGraphicsPeer::_updateInterest(arGraphicsPeerConnection& c) {
+  map<int, bool> outside;
+  vector<arDatabaseNode*> entered;
+  c.interest.spheres = 0;
+  _classify(&_rootNode, ar_identityMatrix(), c.interest, outside, entered, false);
+  c.interest.outside.swap(outside);
+  for (vector<arDatabaseNode*>::const_iterator i = entered.begin(); i != entered.end(); ++i) {
+    ++c.interest.catchUps;
+    _catchUp(c, *i);
+  }
+}
+
+// Like arViewportCull::_cull().  Spheres below one that's outside are
+// forgotten, since the outer one covers them.  Spheres below an instance
+// node have many positions, so they're always inside.
+void arGraphicsPeer::_classify(arDatabaseNode* node, const arMatrix4& model,
+                               arGraphicsPeerInterest& interest,
+                               map<int, bool>& outside,
+                               vector<arDatabaseNode*>& entered, bool fEntered) {
+  const int code = node->getTypeCode();
+  const arMatrix4 childModel(code == AR_G_TRANSFORM_NODE ?
+    model * ((arTransformNode*)node)->getTransform() : model);
+  if (code == AR_G_BOUNDING_SPHERE_NODE || code == AR_G_TRANSFORM_NODE) {
+    arBoundingSphere b;
+    bool bounded = true;
+    if (code == AR_G_BOUNDING_SPHERE_NODE) {
+      ++interest.spheres;
+      b = ((arBoundingSphereNode*)node)->getBoundingSphere();
+    }
+    else {
+      // Automatic bounds, in the children's frame.
+      bounded = _fAutoBounds && getBoundingSphere(node, b);
+      if (bounded)
+        ++interest.spheres;
+    }
+    map<int, bool>::const_iterator was = interest.outside.find(node->getID());
+    if (bounded && _classifySphere(interest, node, b, childModel)) {
+      outside.insert(pair<int, bool>(node->getID(),
+        was != interest.outside.end() && was->second));
+      return;
+    }
+    if (was != interest.outside.end() && was->second && !fEntered) {
+      // A catch-up of this sphere covers any that enter below it.
+      entered.push_back(node);
+      fEntered = true;
+    }
+  }
+  else if (code == AR_G_INSTANCE_NODE) {
+    return;
+  }
+
+  const list<arDatabaseNode*> children = node->getChildren();
+  for (list<arDatabaseNode*>::const_iterator i = children.begin(); i != children.end(); ++i)
+    _classify(*i, childModel, interest, outside, entered, fEntered);
+}
+
+// Is node's sphere b outside the region, with model the transform
+// above b?  Newly outside spheres join interest.outside;  returning ones
+// leave at the next _updateInterest(), which catches them up.
+bool arGraphicsPeer::_classifySphere(arGraphicsPeerInterest& interest,
+                                     arDatabaseNode* node, arBoundingSphere b,
+                                     const arMatrix4& model) {
+  b.position = model * b.position;
+  // Largest axis, in case scaling isn't uniform.
+  float scale = 0.;
+  for (int axis=0; axis<3; ++axis) {
+    const float s = ++arVector3(model.v[4*axis], model.v[4*axis+1], model.v[4*axis+2]);
+    if (s > scale)
+      scale = s;
+  }
+  b.radius *= scale;
+  const bool wasOutside = interest.outside.find(node->getID()) != interest.outside.end();
+  if (interest.meets(b, wasOutside))
+    return false;
+  if (!wasOutside)
+    interest.outside.insert(pair<int, bool>(node->getID(), false));
+  return true;
+}
+
+// Should an update to node be dropped, since it's below a sphere outside
+// the region of interest?  If so, remember to catch up that sphere.
+bool arGraphicsPeer::_dropped(arGraphicsPeerInterest& interest,
+                              arDatabaseNode* node, arStructuredData* data) {
+  if (interest.outside.empty())
+    return false;
+  for (arDatabaseNode* p = node->getParent(); p; p = p->getParent()) {
+    map<int, bool>::iterator i = interest.outside.find(p->getID());
+    if (i != interest.outside.end()) {
+      i->second = true;
+      ++interest.recordsDropped;
+      interest.bytesDropped += data->size();
+      return true;
+    }
+  }
+  return false;
+}
+
+// Send the current state of everything below node that passes the
+// connection's filter, except below spheres still outside.
+void arGraphicsPeer::_catchUp(arGraphicsPeerConnection& c, arDatabaseNode* node) {
+  const list<arDatabaseNode*> children = node->getChildren();
+  for (list<arDatabaseNode*>::const_iterator i = children.begin(); i != children.end(); ++i) {
+    arDatabaseNode* child = *i;
+    const int ID = child->getID();
+    map<int, bool>::iterator out = c.interest.outside.find(ID);
+    if (out != c.interest.outside.end()) {
+      out->second = true;
+      continue;
+    }
+    arNodeMap::const_iterator filter = c.outFilter.find(ID);
+    if (filter != c.outFilter.end() && child->getNodeLevel() <= filter->second) {
+      arStructuredData* data = child->dumpData();
+      if (data) {
+        (void)_queue(c, data, ID);
+        ++c.interest.catchUpRecords;
+        delete data;
+      }
+    }
+    _catchUp(c, child);
+  }
+}
+
 // Thread-safe because arDatabase::printStructure() is.
 string arGraphicsPeer::printPeer() {
   stringstream s;
@@ -1261,11 +1817,13 @@ string arGraphicsPeer::printPeer() {
 // THIS IS A TEMPORARY HACK... eventually will do something more general!
 void arGraphicsPeer::motionCull(arGraphicsPeerCullObject* cull,
                                 arCamera* camera) {
-  stack<arMatrix4> transformStack;
-  transformStack.push(camera->getModelviewMatrix());
-  arMatrix4 temp(camera->getProjectionMatrix());
-  _motionCull((arGraphicsNode*)&_rootNode,
-              transformStack, cull, temp);
+  // Ref children, since the graph may change meanwhile.
+  vector<pair<int, int> > visible;
+  _traversal.cull(&_rootNode, camera->getModelviewMatrix(),
+                  camera->getProjectionMatrix(), visible, true);
+  for (vector<pair<int, int> >::const_iterator i = visible.begin();
+       i != visible.end(); ++i)
+    cull->insert(i->first, i->second);
 }
 
 // Returns the ID of the socket upon which this message originated
@@ -1318,48 +1876,13 @@ int arGraphicsPeer::_getWorkingFieldID(int dataID) {
   return -1;
 }
 
-void arGraphicsPeer::_motionCull(arGraphicsNode* node,
-                                 stack<arMatrix4>& transformStack,
-                                 arGraphicsPeerCullObject* cull,
-                                 arMatrix4& projectionMatrix) {
-  arMatrix4 tempMatrix;
-  if (node->getTypeCode() == AR_G_TRANSFORM_NODE) {
-    // Push current onto the matrix stack.
-    glGetFloatv(GL_MODELVIEW_MATRIX, tempMatrix.v);
-    transformStack.push(transformStack.top()
-                        *((arTransformNode*)node)->getTransform());
-  }
-  // Deal with view frustum culling.
-  if (node->getTypeCode() == AR_G_BOUNDING_SPHERE_NODE) {
-    const arBoundingSphere b = ((arBoundingSphereNode*)node)->getBoundingSphere();
-    cull->insert(node->getID(),
-      b.intersectViewFrustum(projectionMatrix*transformStack.top()) ? 1 : 0);
-    // DO NOT DRAW CHILDREN EITHER WAY! THIS IS DEFINITELY A HACK!
-    // BUG BUG BUG BUG BUG BUG BUG BUG BUG BUG
-    return;
-  }
-  // Thread-safety requires we ref all the children in the list.
-  list<arDatabaseNode*> children = node->getChildrenRef();
-  for (list<arDatabaseNode*>::iterator i = children.begin();
-       i != children.end(); i++) {
-    _motionCull((arGraphicsNode*)(*i), transformStack,
-                cull, projectionMatrix);
-  }
-  // Must unref to prevent memory leaks.
-  ar_unrefNodeList(children);
-  if (node->getTypeCode() == AR_G_TRANSFORM_NODE) {
-    // Pop from stack.
-    transformStack.pop();
-  }
-}
-
 // Sets the remote name for this connection (allows the mirroring graphics
 // peer to know who connected to it.
 bool arGraphicsPeer::_setRemoteLabel(arSocket* sock, const string& name) {
   arStructuredData adminData(_gfx.find("graphics admin"));
   adminData.dataInString(_gfx.AR_GRAPHICS_ADMIN_ACTION, "set-name");
   adminData.dataInString(_gfx.AR_GRAPHICS_ADMIN_NAME, name);
-  return _dataServer->sendData(&adminData, sock);
+  return _send(&adminData, sock);
 }
 
 // Serialize the peer and send it out on the given socket. We might also
@@ -1384,7 +1907,7 @@ bool arGraphicsPeer::_serializeAndSend(arSocket* socket,
   flags[0] = remoteRootID;
   flags[1] = remoteSendLevel;
   adminData.dataIn(_gfx.AR_GRAPHICS_ADMIN_NODE_ID, flags, AR_INT, 2);
-  if (!_dataServer->sendData(&adminData, socket)) {
+  if (!_send(&adminData, socket)) {
     return false;
   }
   arStructuredData nodeData(_gfx.find("make node"));
@@ -1403,12 +1926,11 @@ bool arGraphicsPeer::_serializeAndSend(arSocket* socket,
     cout << "arGraphicsPeer error: failed to get local node or connection.\n";
   }
   else{
-    int dataSent = 0;
     // Set the local send level, the default way updates will be sent.
     connectionIter->second->sendLevel = localSendLevel;
     // This actually does the work of sending.
     _recSerialize(pNode, nodeData, socket, connectionIter->second->outFilter,
-                  localSendLevel, sendLevel, dataSent, success);
+                  localSendLevel, sendLevel, success);
   }
   // To prevent a memory leak, must unref the node.
   if (pNode) {
@@ -1417,13 +1939,184 @@ bool arGraphicsPeer::_serializeAndSend(arSocket* socket,
   return success;
 }
 
+// Call only when _lock()'ed.
+arGraphicsPeerConnection* arGraphicsPeer::_addConnection(arSocket* socket,
+                                                         const string& remoteName) {
+  arGraphicsPeerConnection* c = new arGraphicsPeerConnection();
+  c->remoteName = remoteName;
+  c->connectionID = socket->getID();
+  c->socket = socket;
+  c->rootMapNode = &_rootNode;
+  for (int lane = 0; lane < AR_LANE_COUNT; ++lane) {
+    c->lanes[lane].bytesPerSecond = _laneCap[lane];
+  }
+  _connectionContainer.insert(
+    map<int, arGraphicsPeerConnection*, less<int> >::value_type(
+      socket->getID(), c));
+  return c;
+}
+
+bool arGraphicsPeer::_queue(arGraphicsPeerConnection& c,
+                            arStructuredData* data, int nodeID, int nodeID2) {
+  arGuard q(c.queueLock, "arGraphicsPeer::_queue");
+  const bool interactive = data->getID() == _gfx.AR_TRANSFORM &&
+    !c.lanes[AR_BULK_LANE].holds(nodeID);
+  arStructuredData* unpacked = NULL;
+  if (data->getID() == _gfx.AR_PACKED_ARRAY && _localDatabase) {
+    // Relayed.  Its deltas refer to the sender's frames, not this
+    // connection's, so send what it decoded to.
+    arDatabaseNode* node = _getNodeNoLock(nodeID);
+    if (node) {
+      unpacked = node->dumpData();
+      unpacked->dataIn(_routingField[unpacked->getID()],
+        data->getDataPtr(_gfx.AR_PACKED_ARRAY_ID, AR_INT), AR_INT,
+        data->getDataDimension(_gfx.AR_PACKED_ARRAY_ID));
+      data = unpacked;
+    }
+  }
+  arStructuredData* packed = c.encoder.encode(_gfx, data);
+  const bool ok = c.lanes[interactive ? AR_INTERACTIVE_LANE : AR_BULK_LANE].append(
+    packed ? packed : data, nodeID, nodeID2);
+  delete unpacked;
+  if (!ok) {
+    ar_log_error() << "arGraphicsPeer failed to queue record.\n";
+    return false;
+  }
+
+  arGuard _(_pendingLock, "arGraphicsPeer::_queue");
+  if (!_flushRunning && !_flushExit) {
+    _flushRunning = true;
+    if (!_flushThread.beginThread(ar_graphicsPeerFlushTask, this)) {
+      ar_log_error() << "arGraphicsPeer failed to start flush thread.\n";
+      _flushRunning = false;
+    }
+  }
+  _pending = true;
+  _flushVar.signal();
+  return true;
+}
+
+bool arGraphicsPeer::_send(arStructuredData* data, arSocket* socket) {
+  _lock("arGraphicsPeer::_send");
+  map<int, arGraphicsPeerConnection*, less<int> >::iterator
+    i = _connectionContainer.find(socket->getID());
+  if (i != _connectionContainer.end()) {
+    const bool ok = _queue(*i->second, data, -1);
+    _unlock();
+    return ok;
+  }
+  _unlock();
+  return _dataServer->sendData(data, socket);
+}
+
+bool arGraphicsPeer::_sendAll(arStructuredData* data) {
+  bool ok = true;
+  _lock("arGraphicsPeer::_sendAll");
+  for (map<int, arGraphicsPeerConnection*, less<int> >::iterator
+         i = _connectionContainer.begin(); i != _connectionContainer.end(); ++i) {
+    if (!_queue(*i->second, data, -1))
+      ok = false;
+  }
+  _unlock();
+  return ok;
+}
+
+// Writes happen outside _lock(), so alter() needn't wait for the network.
+bool arGraphicsPeer::_flush(bool drain) {
+  // Bulk goes out in pieces, so interactive records queued meanwhile
+  // can slip in between.
+  const int bulkChunk = 65536;
+  arGuard _(_flushLock, "arGraphicsPeer::_flush");
+  bool more = false;
+  vector<int> IDs;
+  _lockShared("arGraphicsPeer::_flush");
+  map<int, arGraphicsPeerConnection*, less<int> >::iterator i;
+  for (i = _connectionContainer.begin(); i != _connectionContainer.end(); ++i) {
+    IDs.push_back(i->first);
+  }
+  _unlockShared();
+
+  for (vector<int>::const_iterator id = IDs.begin(); id != IDs.end(); ++id) {
+    bool left = true;
+    while (left) {
+      _flushBuffer.clear();
+      _lockShared("arGraphicsPeer::_flush connection");
+      i = _connectionContainer.find(*id);
+      if (i == _connectionContainer.end()) {
+        _unlockShared();
+        break;
+      }
+      arGraphicsPeerConnection& c = *i->second;
+      c.queueLock.lock("arGraphicsPeer::_flush");
+      const ar_timeval now = ar_time();
+      c.lanes[AR_INTERACTIVE_LANE].take(_flushBuffer, now, drain, INT_MAX);
+      c.lanes[AR_BULK_LANE].take(_flushBuffer, now, drain, bulkChunk);
+      left = !c.lanes[AR_INTERACTIVE_LANE].empty() || !c.lanes[AR_BULK_LANE].empty();
+      if (!_flushBuffer.empty())
+        ++c.writes;
+      c.queueLock.unlock();
+      _unlockShared();
+
+      if (_flushBuffer.empty()) {
+        // Over a cap.
+        more = more || left;
+        break;
+      }
+      if (!_dataServer->sendPacked(&_flushBuffer[0], _flushBuffer.size(), *id)) {
+        // The disconnect callback removes the connection.
+        break;
+      }
+    }
+  }
+  return more;
+}
+
+void arGraphicsPeer::_flushTask() {
+  while (true) {
+    _pendingLock.lock("arGraphicsPeer::_flushTask");
+    while (!_pending && !_flushExit) {
+      _flushVar.wait(_pendingLock);
+    }
+    const bool fExit = _flushExit;
+    _pending = false;
+    _pendingLock.unlock();
+    if (fExit)
+      break;
+
+    // Let records accumulate, for fewer and bigger writes.
+    ar_usleep(_flushInterval * 1000);
+    _updateInterest();
+    if (_flush(false)) {
+      // Over a cap:  try again next interval.
+      arGuard _(_pendingLock, "arGraphicsPeer::_flushTask");
+      _pending = true;
+    }
+  }
+  _flushRunning = false;
+}
+
+void arGraphicsPeer::_waitForBulk(int connectionID) {
+  arSleepBackoff a(2, 20, 1.1);
+  while (true) {
+    _lock("arGraphicsPeer::_waitForBulk");
+    map<int, arGraphicsPeerConnection*, less<int> >::const_iterator
+      i = _connectionContainer.find(connectionID);
+    const bool full = i != _connectionContainer.end() &&
+      int(i->second->lanes[AR_BULK_LANE].queued.size()) > _bulkBacklog;
+    _unlock();
+    if (!full)
+      return;
+    a.sleep();
+  }
+}
+
 // When a remote peer requests out serialization, we must send a "done"
 // message (because it will block in pullSerial(...) until this is received.
 void arGraphicsPeer::_serializeDoneNotify(arSocket* socket) {
   // Must send serialization-completion-repsonse
   arStructuredData adminData(_gfx.find("graphics admin"));
   adminData.dataInString(_gfx.AR_GRAPHICS_ADMIN_ACTION, "dump-done");
-  if (!_dataServer->sendData(&adminData, socket)) {
+  if (!_send(&adminData, socket)) {
     cout << "szg-rp error: failed to send dump-completion response.\n";
   }
 }
@@ -1592,43 +2285,55 @@ void arGraphicsPeer::_recSerialize(arDatabaseNode* pNode,
                                    arNodeMap& outFilter,
                                    arNodeLevel localSendLevel,
                                    arNodeLevel sendLevel,
-                                   int& dataSent,
                                    bool& success) {
   // This will fail for the root node
-  if (fillNodeData(&nodeData, pNode)) {
-    dataSent += nodeData.size();
-    if (!_dataServer->sendData(&nodeData, socket)) {
-      success = false;
-    }
-    if (sendLevel >= pNode->getNodeLevel()) {
-      arStructuredData* theData = pNode->dumpData();
-      dataSent += theData->size();
-      if (!_dataServer->sendData(theData, socket)) {
-        success = false;
+  const bool fNode = fillNodeData(&nodeData, pNode);
+  arStructuredData* theData =
+    fNode && sendLevel >= pNode->getNodeLevel() ? pNode->dumpData() : NULL;
+  const int connectionID = socket->getID();
+  _lock("arGraphicsPeer::_recSerialize");
+  map<int, arGraphicsPeerConnection*, less<int> >::iterator
+    connectionIter = _connectionContainer.find(connectionID);
+  if (connectionIter == _connectionContainer.end()) {
+    // Disconnected.
+    success = false;
+  }
+  else if (fNode) {
+    arGraphicsPeerConnection& c = *connectionIter->second;
+    if (c.interest.kind != arGraphicsPeerInterest::NONE) {
+      // Classify spheres as they're dumped, instead of at the next update.
+      if (pNode->getTypeCode() == AR_G_BOUNDING_SPHERE_NODE) {
+        (void)_classifySphere(c.interest, pNode,
+          ((arBoundingSphereNode*)pNode)->getBoundingSphere(),
+          accumulateTransform(pNode->getID()));
       }
-      delete theData;
+      if (theData && _dropped(c.interest, pNode, theData)) {
+        delete theData;
+        theData = NULL;
+      }
+    }
+    if (!_queue(c, &nodeData, pNode->getID()) ||
+        (theData && !_queue(c, theData, pNode->getID()))) {
+      success = false;
     }
   }
-  _lock("arGraphicsPeer::_recSerialize");
   _insertOutFilter(outFilter, pNode->getID(), localSendLevel);
   _unlock();
+  delete theData;
+
+  // The bulk lane paces serialization, instead of letting a big dump
+  // queue all at once.
+  _waitForBulk(connectionID);
 
   // Reference the children so they aren't deleted out
   // from under us.  This call _lock()'s.
   list<arDatabaseNode*> children = pNode->getChildrenRef();
 
-  // Cap the serialize rate at about: 100 x (10000x8) = 8 Mbps.
-  // This should allow reasonable connect behavior.
-  if (dataSent > 10000) {
-    ar_usleep(10000);
-    dataSent = 0;
-  }
-
   for (list<arDatabaseNode*>::iterator i=children.begin();
        i!=children.end(); i++) {
     if (success) {
       _recSerialize(*i, nodeData, socket, outFilter, localSendLevel,
-                    sendLevel, dataSent, success);
+                    sendLevel, success);
     }
   }
   ar_unrefNodeList(children);
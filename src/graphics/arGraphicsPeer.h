@@ -9,9 +9,15 @@
 #include "arSZGClient.h"
 #include "arDataServer.h"
 #include "arGraphicsDatabase.h"
+#include "arGraphicsArrayCodec.h"
 #include "arQueuedData.h"
+#include "arRay.h"
 #include "arGraphicsCalling.h"
 
+#include <deque>
+#include <map>
+#include <vector>
+
 // Hack.
 class SZG_CALL arGraphicsPeerCullObject{
  public:
@@ -36,6 +42,82 @@ class SZG_CALL arGraphicsPeerUpdateInfo{
   ar_timeval lastUpdate;
 };
 
+// Outbound records to one connection are queued in two lanes:  transform
+// updates go in the interactive lane, everything else (structure, geometry,
+// serialization, admin messages) in the bulk lane.  A transform also goes
+// in the bulk lane while that lane still holds records for its node,
+// so it can't overtake the node's creation (or the node_map record that
+// tells the receiver the node's ID).
+enum arPeerLane { AR_INTERACTIVE_LANE = 0, AR_BULK_LANE, AR_LANE_COUNT };
+
+// Records packed back to back, as the receiving arDataServer reads them,
+// so many records cross in one write.
+class SZG_CALL arGraphicsPeerLane{
+ public:
+  arGraphicsPeerLane();
+  ~arGraphicsPeerLane() {}
+
+  // nodeID (and nodeID2) are the nodes the record changes or maps, or -1.
+  bool append(arStructuredData*, int nodeID, int nodeID2 = -1);
+  // Move whole records (at least one) into out, up to limit bytes
+  // and the bandwidth cap, unless drain.  Returns bytes moved.
+  int take(vector<ARchar>& out, const ar_timeval& now, bool drain, int limit);
+  bool empty() const { return queued.empty(); }
+  string print(const string& name) const;
+
+  bool holds(int nodeID) const { return nodes.find(nodeID) != nodes.end(); }
+
+  vector<ARchar> queued;
+  int records;
+  // Queued records per node.
+  map<int, int> nodes;
+  deque<pair<int, int> > recordNodes;
+  // Bandwidth cap (bytes per second, 0 for none), as a token bucket.
+  int bytesPerSecond;
+  double credit;
+  ar_timeval refilled;
+
+  // Statistics.
+  long recordsSent;
+  double bytesSent;
+  long deferrals; // flushes that left records queued, over the cap
+  int peakQueued; // bytes
+};
+
+// A connection's region of interest, in this peer's world coordinates.
+// Updates to nodes below a bounding sphere node (or a transform node with
+// automatic bounds, see arGraphicsDatabase::getBounds()) are dropped while
+// the sphere (in world coordinates) misses the region, and sent as a
+// catch-up dump when it returns.  A sphere leaves only when it is margin beyond
+// the region, so one at the edge doesn't flap in and out.
+class SZG_CALL arGraphicsPeerInterest{
+ public:
+  arGraphicsPeerInterest();
+  ~arGraphicsPeerInterest() {}
+
+  enum { NONE = 0, VOLUME, FRUSTUM };
+  int kind;
+  arBoundingSphere volume;
+  arFrustumPlanes frustum;
+  float margin;
+
+  // Whether a sphere in world coordinates meets the region (grown by
+  // margin, if the sphere was inside).
+  bool meets(const arBoundingSphere&, bool wasOutside) const;
+  string print() const;
+
+  // Bounding sphere and transform nodes outside the region, and whether updates below
+  // them were dropped (if so, they need a catch-up dump on returning).
+  map<int, bool> outside;
+  int spheres; // with bounded transforms, at the last update
+
+  // Statistics.
+  long recordsDropped;
+  double bytesDropped;
+  long catchUps;
+  long catchUpRecords;
+};
+
 class SZG_CALL arGraphicsPeerConnection{
  public:
   arGraphicsPeerConnection();
@@ -76,6 +158,18 @@ class SZG_CALL arGraphicsPeerConnection{
   // to transient nodes).
   map<int, arGraphicsPeerUpdateInfo, less<int> > transientMap;
 
+  // Outbound queues.  These and transientMap and interest are guarded by
+  // the peer's _lock(), or by queueLock under the peer's _lockShared().
+  arGraphicsPeerLane lanes[AR_LANE_COUNT];
+  long writes;
+  arLock queueLock;
+
+  arGraphicsPeerInterest interest;
+
+  // Geometry arrays sent packed, as the remote peer asked
+  // (see arGraphicsPeer::setEncoding()).  Guarded like the lanes.
+  arGraphicsArrayEncoder encoder;
+
   string print();
 };
 
@@ -87,6 +181,7 @@ class SZG_CALL arGraphicsPeer: public arGraphicsDatabase{
                                                  arSocket*);
   friend void ar_graphicsPeerDisconnectFunction(void*, arSocket*);
   friend void ar_graphicsPeerConnectionTask(void*);
+  friend void ar_graphicsPeerFlushTask(void*);
  public:
   arGraphicsPeer();
   ~arGraphicsPeer();
@@ -100,6 +195,8 @@ class SZG_CALL arGraphicsPeer: public arGraphicsDatabase{
   bool init(int& argc, char** argv);
   bool start();
   void stop();
+  // Without a szgserver:  listen on a fixed port (see connectToPeer()).
+  bool startStandalone(int port, const string& networkInterface = "INADDR_ANY");
 
   void setBridge(arGraphicsDatabase* database) {
     _bridgeDatabase = database;
@@ -142,6 +239,8 @@ class SZG_CALL arGraphicsPeer: public arGraphicsDatabase{
 
   // These form the most important part of the API.
   int connectToPeer(const string& name);
+  // Connect to a peer by address, e.g. one that called startStandalone().
+  int connectToPeer(const string& name, const string& address, int port);
   bool closeConnection(const string& name);
   bool pullSerial(const string& name, int remoteRootID, int localRootID,
                   arNodeLevel sendLevel,
@@ -167,8 +266,43 @@ class SZG_CALL arGraphicsPeer: public arGraphicsDatabase{
                             int localNodeID, arNodeLevel level);
   int  remoteNodeID(const string& peer, const string& nodeName);
 
+  // Outbound records are written every flushInterval msec, the
+  // interactive lane first.  Caps are per connection, in bytes per
+  // second (0, the default, for none).  Defaults can be set by
+  // SZG_PEER/flush_interval, interactive_cap and bulk_cap.
+  void setFlushInterval(int msec);
+  void setLaneCap(arPeerLane, int bytesPerSecond);
+  // Write everything queued now, ignoring caps.
+  void flush();
+
+  // Updates to existing nodes' data (transforms, geometry, materials;
+  // not structure) are applied and relayed concurrently, whether they
+  // come from different connections or from local threads.  Default true.
+  void setConcurrentAlters(bool f) { _fConcurrentAlters = f; }
+
+  // Region of interest (see arGraphicsPeerInterest):  ask a connected
+  // peer to send updates below its bounding sphere nodes only while they
+  // meet volume, or the view frustum of clip (projection * modelview),
+  // in that peer's world coordinates.
+  bool setInterest(const string& peer, const arBoundingSphere& volume,
+                   float margin = 0.);
+  bool setInterest(const string& peer, const arMatrix4& clip,
+                   float margin = 0.);
+  bool clearInterest(const string& peer);
+  // How often (msec) this peer reevaluates connections' regions of
+  // interest as its scene moves.  Default can be set by
+  // SZG_PEER/interest_interval.
+  void setInterestInterval(int msec);
+  // Ask a connected peer to send this one geometry arrays (points,
+  // normals, colors, texture coordinates) packed:  a combination of
+  // AR_PACK_* (arGraphicsArrayCodec.h), or 0 for plain floats.
+  bool setEncoding(const string& peer, int encoding);
+  // Bytes written to a connected peer, or -1 if none.
+  double getBytesSent(const string& peer);
+
   // Not quite so important.
   //list<arGraphicsPeerConnection> getConnections();
+  // Includes each connection's lane statistics.
   string printConnections();
   string printPeer();
 
@@ -231,14 +365,67 @@ class SZG_CALL arGraphicsPeer: public arGraphicsDatabase{
   // component ID and is determined in the init(...) method;
   int _componentID;
 
+  // Outbound lanes.  _flushLock keeps writes in order;  the flush
+  // thread sleeps on _flushVar until something is queued.
+  int _flushInterval; // msec
+  int _laneCap[AR_LANE_COUNT];
+  arLock _flushLock;
+  arLock _pendingLock; // with _flushVar
+  arConditionVar _flushVar;
+  bool _pending;
+  bool _flushRunning;
+  bool _flushExit;
+  arThread _flushThread;
+  vector<ARchar> _flushBuffer;
+  void _setCallbacks();
+  void _initParameters(arSZGClient&);
+  arGraphicsPeerConnection* _addConnection(arSocket*, const string& remoteName);
+  // Call only when _lock()'ed.
+  bool _queue(arGraphicsPeerConnection&, arStructuredData*, int nodeID,
+              int nodeID2 = -1);
+  // Queue for that socket, or send directly if it has no connection yet.
+  bool _send(arStructuredData*, arSocket*);
+  bool _sendAll(arStructuredData*);
+  // True if records remain queued, over a cap.
+  bool _flush(bool drain);
+  void _flushTask();
+  // Concurrent alters.  The tree and routing tables (_connectionContainer,
+  // each connection's inMap and outFilter, _lockContainer) change only
+  // under _lock(), so updates can read them under _lockShared().  A
+  // striped lock per node keeps each update together with its relay, so
+  // connected peers get a node's updates in the order they're applied.
+  enum { STRIPES = 64 };
+  bool _fConcurrentAlters;
+  bool _concurrent[256]; // by record ID
+  arLock _stripes[STRIPES];
+  arDatabaseNode* _alterConcurrent(arStructuredData*, bool& fDone);
+
+  // Regions of interest.
+  int _interestInterval; // msec
+  ar_timeval _interestUpdated;
+  bool _sendInterest(const string& peer, int kind, const float* region, int count);
+  // Call these only when _lock()'ed.
+  void _setInterest(arGraphicsPeerConnection&, int kind, const float* region, int count);
+  void _updateInterest(arGraphicsPeerConnection&);
+  void _classify(arDatabaseNode*, const arMatrix4&, arGraphicsPeerInterest&,
+                 map<int, bool>& outside, vector<arDatabaseNode*>& entered, bool fEntered);
+  bool _classifySphere(arGraphicsPeerInterest&, arDatabaseNode*, arBoundingSphere,
+                       const arMatrix4&);
+  bool _dropped(arGraphicsPeerInterest&, arDatabaseNode*, arStructuredData*);
+  void _catchUp(arGraphicsPeerConnection&, arDatabaseNode*);
+  // All connections, if _interestInterval has passed.
+  void _updateInterest();
+
+  // Block while the connection's bulk lane holds more than this.
+  int _bulkBacklog;
+  void _waitForBulk(int connectionID);
+
   // Some utility functions for dealing with the message path recording/reading
   // in the graphics peer messages.
   int _getOriginSocketID(arStructuredData* data, int fieldID);
   int _getRoutingFieldID(int dataID);
   int _getWorkingFieldID(int dataID);
 
-  void _motionCull(arGraphicsNode*, stack<arMatrix4>&,
-                   arGraphicsPeerCullObject*, arMatrix4&);
   bool _setRemoteLabel(arSocket* sock, const string& name);
   bool _serializeAndSend(arSocket* socket, int remoteRootID,
                          int localRootID,
@@ -261,7 +448,6 @@ class SZG_CALL arGraphicsPeer: public arGraphicsDatabase{
                      arSocket* socket, arNodeMap& outFilter,
                      arNodeLevel localSendLevel,
                      arNodeLevel sendLevel,
-                     int& dataSent,
                      bool& success);
   void _recDataOnOff(arDatabaseNode* pNode,
                      int value,
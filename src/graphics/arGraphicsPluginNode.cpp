@@ -49,6 +49,8 @@ void arGraphicsPluginNode::draw(arGraphicsContext* context) {
     return;
   }
   _object->draw( *win, *vp );
+  // The plugin may have changed any GL state.
+  context->invalidateState();
 }
 
 bool arGraphicsPluginNode::receiveData(arStructuredData* data) {
@@ -63,6 +63,23 @@ arGraphicsServer::arGraphicsServer() :
   _syncServer.setBondedObject(this);
   _syncServer.setMessageCallback(ar_graphicsServerMessageCallback);
   _syncServer.setConnectionCallback(ar_graphicsServerConnectionCallback);
+
+  // If coalescing is enabled, only the last update of each array or
+  // transform per frame crosses the network.
+  _syncServer.addCoalescedTemplate(_gfx.AR_TRANSFORM, _gfx.AR_TRANSFORM_ID);
+  _syncServer.addCoalescedTemplate(_gfx.AR_POINTS, _gfx.AR_POINTS_ID,
+    _gfx.AR_POINTS_POINT_IDS, _gfx.AR_POINTS_POSITIONS, 3);
+  _syncServer.addCoalescedTemplate(_gfx.AR_COLOR4, _gfx.AR_COLOR4_ID,
+    _gfx.AR_COLOR4_COLOR_IDS, _gfx.AR_COLOR4_COLORS, 4);
+  _syncServer.addCoalescedTemplate(_gfx.AR_NORMAL3, _gfx.AR_NORMAL3_ID,
+    _gfx.AR_NORMAL3_NORMAL_IDS, _gfx.AR_NORMAL3_NORMALS, 3);
+  _syncServer.addCoalescedTemplate(_gfx.AR_TEX2, _gfx.AR_TEX2_ID,
+    _gfx.AR_TEX2_TEX_IDS, _gfx.AR_TEX2_COORDS, 2);
+  _syncServer.addBarrierTemplate(_gfx.AR_MAKE_NODE);
+  _syncServer.addBarrierTemplate(_gfx.AR_INSERT);
+  _syncServer.addBarrierTemplate(_gfx.AR_ERASE);
+  _syncServer.addBarrierTemplate(_gfx.AR_CUT);
+  _syncServer.addBarrierTemplate(_gfx.AR_PERMUTE);
 }
 
 arGraphicsServer::~arGraphicsServer() {
@@ -100,6 +117,16 @@ arDatabaseNode* arGraphicsServer::alter(arStructuredData* theData,
   return result;
 }
 
+bool arGraphicsServer::alterBatch(ARchar* theData) {
+  // Lock order as in alter():  database, then the sync server's queue.
+  _lock("arGraphicsServer::alterBatch");
+  _syncServer.beginBatch();
+  const bool ok = handleDataQueue(theData);
+  _syncServer.endBatch();
+  _unlock();
+  return ok;
+}
+
 void arGraphicsServer::_recSerialize(arDatabaseNode* pNode,
                                      arStructuredData& nodeData) {
   // This will fail for the root node
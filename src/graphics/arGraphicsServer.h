@@ -29,6 +29,8 @@ class SZG_CALL arGraphicsServer: public arGraphicsDatabase {
   // Default should be false (i.e. we do not need an extra reference
   // tacked on to the indicated node in the case of node creation).
   arDatabaseNode* alter(arStructuredData*, bool refNode=false);
+  // Applies and queues the whole batch in one frame.
+  bool alterBatch(ARchar*);
 
   arSyncDataServer _syncServer;
 
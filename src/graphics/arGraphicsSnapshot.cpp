@@ -0,0 +1,181 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arGraphicsSnapshot.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+
+#include <sstream>
+
+arGraphicsSnapshot::arGraphicsSnapshot(arGraphicsDatabase& a, arGraphicsDatabase& b) :
+  _first(&a),
+  _front(&a),
+  _back(&b),
+  _lock("SNAPSHOT"),
+  _wake("arGraphicsSnapshot wake"),
+  _idle("arGraphicsSnapshot idle"),
+  _quit(false),
+  _running(false),
+  _busy(false),
+  _ok(true),
+  _frames(0),
+  _usecApply(0.),
+  _usecCatchUp(0.),
+  _usecWait(0.),
+  _usecCopy(0.) {
+}
+
+arGraphicsSnapshot::~arGraphicsSnapshot() {
+  stop();
+}
+
+bool arGraphicsSnapshot::start() {
+  arGuard _(_lock, "arGraphicsSnapshot::start");
+  if (_running)
+    return true;
+  _quit = false;
+  arThread t;
+  if (!t.beginThread(_applyTask, this)) {
+    ar_log_error() << "arGraphicsSnapshot failed to start its thread.\n";
+    return false;
+  }
+  _running = true;
+  _frames = 0;
+  _usecApply = _usecCatchUp = _usecWait = _usecCopy = 0.;
+  return true;
+}
+
+void arGraphicsSnapshot::stop() {
+  _lock.lock("arGraphicsSnapshot::stop");
+  _quit = true;
+  while (_running) {
+    _wake.signal();
+    _idle.wait(_lock, 100);
+  }
+  _lock.unlock();
+}
+
+bool arGraphicsSnapshot::consume(ARchar* buffer) {
+  const ar_timeval start = ar_time();
+  _lock.lock("arGraphicsSnapshot::consume");
+  _wait();
+  const ar_timeval waited = ar_time();
+  const bool ok = _ok;
+  _ok = true;
+  _swap(buffer);
+  ++_frames;
+  _usecWait += ar_difftimeSafe(waited, start);
+  _usecCopy += ar_difftimeSafe(ar_time(), waited);
+  const bool synchronous = !_running;
+  _lock.unlock();
+  if (synchronous)
+    _applyFrames();
+  return ok;
+}
+
+void arGraphicsSnapshot::flush() {
+  _lock.lock("arGraphicsSnapshot::flush");
+  _wait();
+  if (_pending.empty()) {
+    _lock.unlock();
+    return;
+  }
+  _swap(NULL);
+  const bool synchronous = !_running;
+  _lock.unlock();
+  if (synchronous)
+    _applyFrames();
+}
+
+void arGraphicsSnapshot::clear() {
+  arGuard _(_lock, "arGraphicsSnapshot::clear");
+  _wait();
+  _catchUp.clear();
+  _pending.clear();
+  _ok = true;
+  arGraphicsDatabase* other = _front == _first ? _back : _front;
+  _front = _first;
+  _back = other;
+}
+
+string arGraphicsSnapshot::status() {
+  arGuard _(_lock, "arGraphicsSnapshot::status");
+  const double n = _frames ? _frames : 1;
+  // Drawing waits only for consume(), instead of for applying the new frame.
+  // (On one processor, the thread still competes with drawing.)
+  const double serial = (_usecApply - _usecCatchUp) / n;
+  const double waited = (_usecWait + _usecCopy) / n;
+  ostringstream s;
+  s << "snapshot: " << _frames << " frames;  per frame, the thread applied " <<
+    int(_usecApply / n) << " usec (" << int(_usecCatchUp / n) <<
+    " catching up), consume() waited " << int(_usecWait / n) << " and copied " <<
+    int(_usecCopy / n) << " usec;  " <<
+    int(serial > waited ? 100. * (serial - waited) / serial : 0.) <<
+    "% of applying moved off the drawing thread.\n";
+  return s.str();
+}
+
+void arGraphicsSnapshot::_applyTask(void* snapshot) {
+  ((arGraphicsSnapshot*)snapshot)->_apply();
+}
+
+void arGraphicsSnapshot::_apply() {
+  _lock.lock("arGraphicsSnapshot::_apply");
+  while (!_quit) {
+    if (!_busy) {
+      _wake.wait(_lock, 100);
+      continue;
+    }
+    _lock.unlock();
+    _applyFrames();
+    _lock.lock("arGraphicsSnapshot::_apply");
+  }
+  _running = false;
+  _idle.signal();
+  _lock.unlock();
+}
+
+// While _busy, only this touches _back, _catchUp and _pending.
+void arGraphicsSnapshot::_applyFrames() {
+  const ar_timeval start = ar_time();
+  bool ok = _catchUp.empty() || _back->handleDataQueue(&_catchUp[0]);
+  const ar_timeval caughtUp = ar_time();
+  ok &= _pending.empty() || _back->handleDataQueue(&_pending[0]);
+  const ar_timeval done = ar_time();
+
+  arGuard _(_lock, "arGraphicsSnapshot::_applyFrames");
+  _ok &= ok;
+  _usecCatchUp += ar_difftimeSafe(caughtUp, start);
+  _usecApply += ar_difftimeSafe(done, start);
+  _busy = false;
+  _idle.signal();
+}
+
+// Call with _lock held.
+void arGraphicsSnapshot::_wait() {
+  while (_busy && _running)
+    _idle.wait(_lock);
+}
+
+// Call with _lock held, after _wait().  The new back database lacks
+// _pending, and then buffer.
+void arGraphicsSnapshot::_swap(ARchar* buffer) {
+  arGraphicsDatabase* t = _front;
+  _front = _back;
+  _back = t;
+  _catchUp.swap(_pending);
+  if (buffer) {
+    ARint size = 0;
+    ar_unpackData(buffer, &size, AR_INT, 1);
+    _pending.assign(buffer, buffer + size);
+  }
+  else {
+    _pending.clear();
+  }
+  _busy = !_catchUp.empty() || !_pending.empty();
+  if (_busy)
+    _wake.signal();
+}
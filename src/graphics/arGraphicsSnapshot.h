@@ -0,0 +1,80 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_GRAPHICS_SNAPSHOT_H
+#define AR_GRAPHICS_SNAPSHOT_H
+
+#include "arGraphicsDatabase.h"
+#include "arThread.h"
+#include "arGraphicsCalling.h"
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// Two copies of a scene graph, one frame apart, so applying a frame's
+// records overlaps drawing the previous frame.  consume() waits for the
+// back database to finish, swaps it to the front (just two pointers), and
+// hands the new frame to a thread that applies it to the new back database,
+// after the frame that one missed.  Meanwhile front() is drawn, unchanged.
+// Costs a frame of latency, and twice the memory and the applying,
+// all of it off the drawing thread.
+
+class SZG_CALL arGraphicsSnapshot {
+ public:
+  // Both databases must start empty, or equal.
+  arGraphicsSnapshot(arGraphicsDatabase& a, arGraphicsDatabase& b);
+  ~arGraphicsSnapshot();
+
+  // Without the thread, consume() applies in the caller's.
+  bool start();
+  void stop();
+  bool running() const { return _running; }
+
+  // A frame's data queue (as for arDatabase::handleDataQueue()), copied.
+  // False if the previous frame failed to apply.
+  bool consume(ARchar* buffer);
+  // Swap now, so front() has every consumed frame;  the back one catches up.
+  void flush();
+  // Wait for the thread, and forget frames the back one lacks.
+  // Then the caller can reset() both databases.  The first is in front again.
+  void clear();
+
+  arGraphicsDatabase& front() { return *_front; }
+  arGraphicsDatabase& back() { return *_back; }
+
+  // Since start(), per frame:  how long the thread applied, and how long
+  // consume() waited for it and copied.  The difference left the drawing thread.
+  string status();
+
+ private:
+  arGraphicsDatabase* _first;
+  arGraphicsDatabase* _front;
+  arGraphicsDatabase* _back;
+
+  arLock _lock;            // guards the rest
+  arConditionVar _wake;    // frames to apply, or quitting
+  arConditionVar _idle;    // applied, or the thread exited
+  bool _quit;
+  bool _running;
+  bool _busy;
+  bool _ok;
+  vector<ARchar> _catchUp; // The back one's missing frame, then...
+  vector<ARchar> _pending; // ...the frame the front one lacks.
+
+  long _frames;
+  double _usecApply;       // both frames
+  double _usecCatchUp;     // the first of them
+  double _usecWait;
+  double _usecCopy;
+
+  static void _applyTask(void*);
+  void _apply();
+  void _applyFrames();
+  void _wait();
+  void _swap(ARchar* buffer);
+};
+
+#endif
@@ -0,0 +1,253 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arGraphicsTraversal.h"
+#include "arGraphicsNode.h"
+#include "arTransformNode.h"
+#include "arBoundingSphereNode.h"
+#include "arVisibilityNode.h"
+#include "arInstanceNode.h"
+#include "arDataUtilities.h"
+
+// One subtree.  Subtrees handed to other threads are recorded as
+// splices:  their output belongs at that point in this task's lists.
+class arGraphicsTraversal::Task : public arTask {
+ public:
+  Task(bool draw, const arMatrix4* projection, bool refChildren, bool bounds,
+       arDatabaseNode* node, const arMatrix4& modelView) :
+    _draw(draw),
+    _projection(projection),
+    _refChildren(refChildren),
+    _bounds(bounds),
+    _node(node),
+    _modelView(modelView),
+    _nodes(0) {}
+  ~Task();
+
+  void run(arTaskPool& pool, int thread)
+    { _visit(_node, _modelView, pool, thread); }
+  // Append this subtree's output, in traversal order.
+  void flatten(vector<arGraphicsContext::Deferred>& drawList,
+               vector<pair<int, int> >& visible, int& tasks, int& nodes);
+
+  arGraphicsContext context;  // Attribute stacks only.
+
+ private:
+  struct Splice {
+    size_t drawAt;
+    size_t cullAt;
+    Task* task;
+  };
+  const bool _draw;
+  const arMatrix4* _projection;
+  const bool _refChildren;
+  const bool _bounds;
+  arDatabaseNode* _node;
+  const arMatrix4 _modelView;
+  vector<arGraphicsContext::Deferred> _drawList;
+  vector<pair<int, int> > _visible;
+  vector<Splice> _splices;
+  list< list<arDatabaseNode*> > _refs;
+  int _nodes;
+
+  void _visit(arDatabaseNode* node, const arMatrix4& modelView,
+              arTaskPool& pool, int thread);
+  void _visitChild(arDatabaseNode* child, const arMatrix4& modelView,
+                   arTaskPool& pool, int thread);
+};
+
+arGraphicsTraversal::Task::~Task() {
+  for (vector<Splice>::iterator i = _splices.begin(); i != _splices.end(); ++i)
+    delete i->task;
+  for (list< list<arDatabaseNode*> >::iterator j = _refs.begin(); j != _refs.end(); ++j)
+    ar_unrefNodeList(*j);
+}
+
+void arGraphicsTraversal::Task::_visit(arDatabaseNode* node,
+    const arMatrix4& modelView, arTaskPool& pool, int thread) {
+  ++_nodes;
+  const int code = node->getTypeCode();
+  arMatrix4 childView(modelView);
+
+  if (_draw) {
+    // Like arGraphicsDatabase::_draw().
+    context.pushNode(node);
+    arGraphicsContext::Deferred d;
+    if (context.capture(node, modelView, d))
+      _drawList.push_back(d);
+    int visible = 1;
+    if (_projection && code == AR_G_BOUNDING_SPHERE_NODE) {
+      visible = context.getPrecomputedVisibility(node->getID());
+      if (visible < 0)
+        visible = ((arBoundingSphereNode*)node)->getBoundingSphere().
+          intersectViewFrustum(*_projection * modelView);
+    }
+    if (!visible ||
+        (code == AR_G_VISIBILITY_NODE &&
+         !((arVisibilityNode*)node)->getVisibility())) {
+      context.popNode(node);
+      return;
+    }
+  }
+  else if (code == AR_G_BOUNDING_SPHERE_NODE) {
+    // Like arGraphicsPeer::_motionCull().
+    _visible.push_back(make_pair(node->getID(),
+      ((arBoundingSphereNode*)node)->getBoundingSphere().
+        intersectViewFrustum(*_projection * modelView) ? 1 : 0));
+    return;
+  }
+  else if (code == AR_G_INSTANCE_NODE) {
+    // A sphere below has no one visibility.
+    return;
+  }
+
+  if (code == AR_G_TRANSFORM_NODE) {
+    childView = modelView * ((arTransformNode*)node)->getTransform();
+    arBoundingSphere b;
+    if (_draw && _bounds && _projection &&
+        ((arGraphicsNode*)node)->_boundingSphere(b)) {
+      // Automatic bounds are in the children's frame.
+      int visible = context.getPrecomputedVisibility(node->getID());
+      if (visible < 0)
+        visible = b.intersectViewFrustum(*_projection * childView);
+      if (!visible) {
+        context.popNode(node);
+        return;
+      }
+    }
+  }
+
+  if (_refChildren)
+    _refs.push_back(node->getChildrenRef());
+  const list<arDatabaseNode*>& children =
+    _refChildren ? _refs.back() : arGraphicsTraversal::_children(node);
+  if (_draw && code == AR_G_INSTANCE_NODE) {
+    // Like arGraphicsDatabase::_drawInstances()'s loop.
+    vector<float> instances;
+    ((arInstanceNode*)node)->getInstances(instances);
+    for (size_t j=0; j+20 <= instances.size(); j+=20) {
+      const arMatrix4 instanceView(modelView * arMatrix4(&instances[j]));
+      context.pushInstanceColor(&instances[j+16]);
+      for (list<arDatabaseNode*>::const_iterator i = children.begin();
+           i != children.end(); ++i)
+        _visitChild(*i, instanceView, pool, thread);
+      context.popInstanceColor();
+    }
+    context.popNode(node);
+    return;
+  }
+
+  // Drawing visits only an LOD node's current level.
+  const bool fLOD = _draw && code == AR_G_LOD_NODE;
+  int level = fLOD ? context.selectLOD(node, modelView) : 0;
+  for (list<arDatabaseNode*>::const_iterator i = children.begin(); i != children.end(); ++i) {
+    if (fLOD && level-- != 0)
+      continue;
+    _visitChild(*i, childView, pool, thread);
+  }
+
+  if (_draw)
+    context.popNode(node);
+}
+
+void arGraphicsTraversal::Task::_visitChild(arDatabaseNode* child,
+    const arMatrix4& modelView, arTaskPool& pool, int thread) {
+  // Leaves aren't worth a task.
+  if (pool.getThreads() > 1 && !child->empty() && pool.hungry()) {
+    Splice s;
+    s.drawAt = _drawList.size();
+    s.cullAt = _visible.size();
+    s.task = new Task(_draw, _projection, _refChildren, _bounds, child, modelView);
+    if (_draw)
+      s.task->context.inherit(context);
+    _splices.push_back(s);
+    pool.spawn(s.task, thread);
+  }
+  else {
+    _visit(child, modelView, pool, thread);
+  }
+}
+
+void arGraphicsTraversal::Task::flatten(
+    vector<arGraphicsContext::Deferred>& drawList,
+    vector<pair<int, int> >& visible, int& tasks, int& nodes) {
+  ++tasks;
+  nodes += _nodes;
+  size_t drawn = 0;
+  size_t culled = 0;
+  for (vector<Splice>::const_iterator i = _splices.begin(); i != _splices.end(); ++i) {
+    drawList.insert(drawList.end(), _drawList.begin() + drawn, _drawList.begin() + i->drawAt);
+    visible.insert(visible.end(), _visible.begin() + culled, _visible.begin() + i->cullAt);
+    drawn = i->drawAt;
+    culled = i->cullAt;
+    i->task->flatten(drawList, visible, tasks, nodes);
+  }
+  drawList.insert(drawList.end(), _drawList.begin() + drawn, _drawList.end());
+  visible.insert(visible.end(), _visible.begin() + culled, _visible.end());
+}
+
+arGraphicsTraversal::arGraphicsTraversal(int threads) :
+  _lock("TRAVERSAL"),
+  _threads(0),
+  _pool(NULL),
+  _tasks(0),
+  _nodes(0) {
+  setThreads(threads);
+}
+
+arGraphicsTraversal::~arGraphicsTraversal() {
+  delete _pool;
+}
+
+void arGraphicsTraversal::setThreads(int threads) {
+  if (threads <= 0)
+    threads = ar_numProcessors();
+  arGuard _(_lock, "arGraphicsTraversal::setThreads");
+  if (threads == _threads)
+    return;
+  _threads = threads;
+  // Threads start on first use.
+  delete _pool;
+  _pool = NULL;
+}
+
+const list<arDatabaseNode*>& arGraphicsTraversal::_children(arDatabaseNode* node) {
+  return ((arGraphicsNode*)node)->_children;
+}
+
+void arGraphicsTraversal::_run(Task* root) {
+  if (!_pool)
+    _pool = new arTaskPool(_threads);
+  _pool->run(root);
+}
+
+void arGraphicsTraversal::drawList(arDatabaseNode* root,
+    const arMatrix4& modelView, const arMatrix4* projection,
+    arGraphicsContext& context, bool bounds) {
+  arGuard _(_lock, "arGraphicsTraversal::drawList");
+  Task* t = new Task(true, projection, false, bounds, root, modelView);
+  t->context.inherit(context);
+  _run(t);
+  vector<arGraphicsContext::Deferred> drawList;
+  vector<pair<int, int> > unused;
+  _tasks = _nodes = 0;
+  t->flatten(drawList, unused, _tasks, _nodes);
+  delete t;
+  context.deferDraw(drawList);
+}
+
+void arGraphicsTraversal::cull(arDatabaseNode* root,
+    const arMatrix4& modelView, const arMatrix4& projection,
+    vector<pair<int, int> >& visible, bool refChildren) {
+  arGuard _(_lock, "arGraphicsTraversal::cull");
+  Task* t = new Task(false, &projection, refChildren, false, root, modelView);
+  _run(t);
+  vector<arGraphicsContext::Deferred> unused;
+  visible.clear();
+  _tasks = _nodes = 0;
+  t->flatten(unused, visible, _tasks, _nodes);
+  delete t;
+}
@@ -0,0 +1,70 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_GRAPHICS_TRAVERSAL_H
+#define AR_GRAPHICS_TRAVERSAL_H
+
+#include "arGraphicsContext.h"
+#include "arTaskPool.h"
+#include "arGraphicsCalling.h"
+
+#include <list>
+#include <vector>
+using namespace std;
+
+class arGraphicsNode;
+
+// Scene-graph traversal split across threads.  Each task walks a
+// subtree, accumulating world transforms and frustum visibility,
+// and hands subtrees to idle threads (see arTaskPool).  Each task
+// writes its own list; the lists are then spliced in traversal order,
+// so the result is the same for any number of threads.
+//
+// The traversal makes no GL calls.  drawList() captures what
+// arGraphicsDatabase::_draw() would draw, for
+// arGraphicsContext::drawDeferred();  cull() computes arGraphicsPeer's
+// motion culling.
+
+class SZG_CALL arGraphicsTraversal {
+ public:
+  arGraphicsTraversal(int threads = 1);
+  ~arGraphicsTraversal();
+
+  // 0 means one per processor.
+  void setThreads(int threads);
+  int getThreads() const { return _threads; }
+
+  // Queue root's drawing nodes into context.  projection may be NULL
+  // (no frustum culling).  If bounds, also cull transform nodes by their
+  // current automatic bounds (see arGraphicsDatabase::getBounds()).
+  void drawList(arDatabaseNode* root, const arMatrix4& modelView,
+                const arMatrix4* projection, arGraphicsContext& context,
+                bool bounds = false);
+  // Each bounding sphere's ID, and 1 if it intersects the view frustum
+  // (else 0).  Bounding spheres' children are skipped.
+  // Set refChildren if the graph may change meanwhile (arGraphicsPeer).
+  void cull(arDatabaseNode* root, const arMatrix4& modelView,
+            const arMatrix4& projection, vector<pair<int, int> >& visible,
+            bool refChildren = false);
+
+  // From the most recent traversal.
+  int getTasks() const { return _tasks; }
+  int getNodes() const { return _nodes; }
+
+ private:
+  class Task;
+  friend class Task;
+
+  arLock _lock;  // One traversal at a time.
+  int _threads;
+  arTaskPool* _pool;
+  int _tasks;
+  int _nodes;
+
+  void _run(Task* root);
+  static const list<arDatabaseNode*>& _children(arDatabaseNode* node);
+};
+
+#endif
@@ -6,6 +6,15 @@
 #include "arPrecompiled.h"
 #include "arGraphicsUtilities.h"
 #include "arGraphicsHeader.h"
+#include "arMath.h"
+#include "arLogStream.h"
+#include "arThread.h"
+
+#if defined(AR_USE_LINUX) || defined(AR_USE_SGI)
+  #include <GL/glx.h>
+#endif
+
+#include <map>
 using namespace std;
 
 arNodeLevel ar_convertToNodeLevel(int level) {
@@ -36,9 +45,17 @@ arNodeLevel ar_convertToNodeLevel(int level) {
 #define doColor( i) \
   { const float* c = colors+4*i; glColor4f(c[0], c[1], c[2], c[3]*blendFactor); }
 
+static bool ar_drawInstanced(GLenum mode, int vertices, const int* indices,
+                             int numberPos, const float* positions,
+                             const float* normals, const float* colors,
+                             const float* texCoord, float blendFactor);
+
 inline void ar_draw01DRaw(GLenum drawableType, int number, const int* indices,
                           int numberPos, const float* positions, const float* colors,
                           float blendFactor) {
+  if (ar_drawInstanced(drawableType, number, indices, numberPos, positions,
+                       NULL, colors, NULL, blendFactor))
+    return;
   unsigned int opType = 0;
   if (indices)
     opType |= 1;
@@ -112,6 +129,9 @@ inline void ar_draw2DRaw(GLenum drawableType, int number,
   // boxen (specifically some Win2K w/ Nvidia cards)
 
   // Fails with blending, with the blend factor hack.  So remove that hack?
+  if (ar_drawInstanced(drawableType, number, indices, numberPos, positions,
+                       normals, colors, texCoord, blendFactor))
+    return;
   unsigned int opType = 0;
   if (indices)
     opType |= 1;
@@ -237,3 +257,401 @@ bool ar_openglStereo() {
   glGetBooleanv( GL_STEREO, &glStereoSupported );
   return (bool)glStereoSupported;
 }
+
+
+// Hardware instancing.  Entry points are looked up at runtime, since
+// szg links only against OpenGL 1.1.
+
+#ifndef APIENTRY
+  #define APIENTRY
+#endif
+#ifndef GL_VERTEX_SHADER
+  #define GL_VERTEX_SHADER 0x8B31
+#endif
+#ifndef GL_COMPILE_STATUS
+  #define GL_COMPILE_STATUS 0x8B81
+#endif
+#ifndef GL_LINK_STATUS
+  #define GL_LINK_STATUS 0x8B82
+#endif
+#ifndef GL_VERTEX_PROGRAM_TWO_SIDE
+  #define GL_VERTEX_PROGRAM_TWO_SIDE 0x8643
+#endif
+
+namespace arInstancingNamespace {
+  typedef GLuint (APIENTRY *pfnCreateShader)(GLenum);
+  typedef void (APIENTRY *pfnShaderSource)(GLuint, GLsizei, const char**, const GLint*);
+  typedef void (APIENTRY *pfnCompileShader)(GLuint);
+  typedef void (APIENTRY *pfnGetShaderiv)(GLuint, GLenum, GLint*);
+  typedef void (APIENTRY *pfnGetShaderInfoLog)(GLuint, GLsizei, GLsizei*, char*);
+  typedef GLuint (APIENTRY *pfnCreateProgram)(void);
+  typedef void (APIENTRY *pfnAttachShader)(GLuint, GLuint);
+  typedef void (APIENTRY *pfnBindAttribLocation)(GLuint, GLuint, const char*);
+  typedef void (APIENTRY *pfnLinkProgram)(GLuint);
+  typedef void (APIENTRY *pfnGetProgramiv)(GLuint, GLenum, GLint*);
+  typedef void (APIENTRY *pfnUseProgram)(GLuint);
+  typedef GLint (APIENTRY *pfnGetUniformLocation)(GLuint, const char*);
+  typedef void (APIENTRY *pfnUniform1i)(GLint, GLint);
+  typedef void (APIENTRY *pfnUniform1fv)(GLint, GLsizei, const GLfloat*);
+  typedef void (APIENTRY *pfnUniformMatrixfv)(GLint, GLsizei, GLboolean, const GLfloat*);
+  typedef void (APIENTRY *pfnVertexAttribArray)(GLuint);
+  typedef void (APIENTRY *pfnVertexAttribPointer)(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*);
+  typedef void (APIENTRY *pfnVertexAttribDivisor)(GLuint, GLuint);
+  typedef void (APIENTRY *pfnDrawArraysInstanced)(GLenum, GLint, GLsizei, GLsizei);
+
+  // Attribute locations 9 to 13 alias texture units 1 to 5, which szg doesn't use.
+  const GLuint firstAttrib = 9;
+  const int stride = 20 * sizeof(float);
+
+  // Per GL context, since entry points and programs may differ.
+  struct Context {
+    bool ok;
+    GLuint program;
+    GLint uniforms[6];
+    pfnUseProgram useProgram;
+    pfnUniform1i uniform1i;
+    pfnUniform1fv uniform1fv;
+    pfnUniformMatrixfv uniformMatrix3fv;
+    pfnUniformMatrixfv uniformMatrix4fv;
+    pfnVertexAttribArray enableAttrib;
+    pfnVertexAttribArray disableAttrib;
+    pfnVertexAttribPointer attribPointer;
+    pfnVertexAttribDivisor divisor;
+    pfnDrawArraysInstanced drawInstanced;
+
+    // Between ar_beginInstancing() and ar_endInstancing().
+    const float* instances;
+    int count;
+    arMatrix4 outer;     // modelview at the instance node
+    arMatrix4 outerInverse;
+    float outerNormal[9];
+  };
+  arLock lock;
+  map<const void*, Context> contexts;
+  // Contexts between ar_beginInstancing() and ar_endInstancing(),
+  // so drawing elsewhere skips the lookup.
+  int active = 0;
+
+  enum { LIGHTING, LIGHT_ON, OUTER, INNER, OUTER_NORMAL, INNER_NORMAL };
+  const char* uniformNames[6] = {
+    "lighting", "lightOn", "outer", "inner", "outerNormal", "innerNormal" };
+
+  // Fixed-function transform and lighting, with the instance's matrix
+  // between the instance node's modelview (outer) and the transforms
+  // below it (inner).  As arGraphicsContext sets it up:  GL_COLOR_MATERIAL
+  // tracks the diffuse color, and the viewer is at infinity.
+  const char* vertexShader =
+    "#version 110\n"
+    "attribute vec4 instance0;\n"
+    "attribute vec4 instance1;\n"
+    "attribute vec4 instance2;\n"
+    "attribute vec4 instance3;\n"
+    "attribute vec4 instanceColor;\n"
+    "uniform bool lighting;\n"
+    "uniform float lightOn[8];\n"
+    "uniform mat4 outer;\n"
+    "uniform mat4 inner;\n"
+    "uniform mat3 outerNormal;\n"
+    "uniform mat3 innerNormal;\n"
+    "vec4 shade(vec3 v, vec3 n, vec4 diffuse, vec4 scene,\n"
+    "           vec4 ambient, vec4 specular, float shininess) {\n"
+    "  vec3 c = scene.rgb;\n"
+    "  for (int i=0; i<8; ++i) {\n"
+    "    if (lightOn[i] == 0.)\n"
+    "      continue;\n"
+    "    vec3 l = gl_LightSource[i].position.xyz;\n"
+    "    float a = 1.;\n"
+    "    if (gl_LightSource[i].position.w != 0.) {\n"
+    "      l -= v;\n"
+    "      float d = length(l);\n"
+    "      l /= d;\n"
+    "      a = 1. / (gl_LightSource[i].constantAttenuation +\n"
+    "                gl_LightSource[i].linearAttenuation * d +\n"
+    "                gl_LightSource[i].quadraticAttenuation * d * d);\n"
+    "      if (gl_LightSource[i].spotCutoff <= 90.) {\n"
+    "        float s = max(dot(-l, normalize(gl_LightSource[i].spotDirection)), 0.);\n"
+    "        a *= s < gl_LightSource[i].spotCosCutoff ? 0. :\n"
+    "          pow(s, gl_LightSource[i].spotExponent);\n"
+    "      }\n"
+    "    }\n"
+    "    else\n"
+    "      l = normalize(l);\n"
+    "    float nl = max(dot(n, l), 0.);\n"
+    "    vec3 t = ambient.rgb * gl_LightSource[i].ambient.rgb +\n"
+    "             nl * diffuse.rgb * gl_LightSource[i].diffuse.rgb;\n"
+    "    if (nl > 0.)\n"
+    "      t += pow(max(dot(n, normalize(l + vec3(0., 0., 1.))), 0.), shininess) *\n"
+    "           specular.rgb * gl_LightSource[i].specular.rgb;\n"
+    "    c += a * t;\n"
+    "  }\n"
+    "  return vec4(c, diffuse.a);\n"
+    "}\n"
+    "void main() {\n"
+    "  mat4 instance = mat4(instance0, instance1, instance2, instance3);\n"
+    "  vec4 eye = outer * (instance * (inner * gl_Vertex));\n"
+    "  gl_Position = gl_ProjectionMatrix * eye;\n"
+    "  gl_ClipVertex = eye;\n"
+    "  gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;\n"
+    "  vec4 color = gl_Color * instanceColor;\n"
+    "  if (!lighting) {\n"
+    "    gl_FrontColor = color;\n"
+    "    gl_BackColor = color;\n"
+    "    return;\n"
+    "  }\n"
+    "  vec3 n = normalize(outerNormal * (mat3(instance0.xyz, instance1.xyz,\n"
+    "    instance2.xyz) * (innerNormal * gl_Normal)));\n"
+    "  vec3 v = eye.xyz / eye.w;\n"
+    "  gl_FrontColor = shade(v, n, color, gl_FrontLightModelProduct.sceneColor,\n"
+    "    gl_FrontMaterial.ambient, gl_FrontMaterial.specular, gl_FrontMaterial.shininess);\n"
+    "  gl_BackColor = shade(v, -n, color, gl_BackLightModelProduct.sceneColor,\n"
+    "    gl_BackMaterial.ambient, gl_BackMaterial.specular, gl_BackMaterial.shininess);\n"
+    "}\n";
+
+  void* getProc(const char* name) {
+#ifdef AR_USE_WIN_32
+    return (void*) wglGetProcAddress(name);
+#elif defined(AR_USE_LINUX) || defined(AR_USE_SGI)
+    return (void*) glXGetProcAddressARB((const GLubyte*) name);
+#else
+    (void)name;
+    return NULL;
+#endif
+  }
+
+  const void* currentContext() {
+#ifdef AR_USE_WIN_32
+    return (const void*) wglGetCurrentContext();
+#elif defined(AR_USE_LINUX) || defined(AR_USE_SGI)
+    return (const void*) glXGetCurrentContext();
+#else
+    return NULL;
+#endif
+  }
+
+  bool hasExtension(const char* name) {
+    const char* s = (const char*) glGetString(GL_EXTENSIONS);
+    if (!s)
+      return false;
+    const string extensions(string(" ") + s + " ");
+    return extensions.find(string(" ") + name + " ") != string::npos;
+  }
+
+  // Inverse transpose of the upper 3x3, column-major, for normals.
+  void normalMatrix(const arMatrix4& m, float* n) {
+    const arMatrix4 t((!m).transpose());
+    for (int col=0; col<3; ++col)
+      for (int row=0; row<3; ++row)
+        n[3*col + row] = t.v[4*col + row];
+  }
+
+  // Look up entry points and build the program, for the current context.
+  bool init(Context& c) {
+    c.ok = false;
+    c.instances = NULL;
+    c.count = 0;
+#ifdef AR_USE_DARWIN
+    return false;
+#endif
+    if (!hasExtension("GL_ARB_instanced_arrays") ||
+        !hasExtension("GL_ARB_draw_instanced"))
+      return false;
+
+    pfnCreateShader createShader = (pfnCreateShader) getProc("glCreateShader");
+    pfnShaderSource shaderSource = (pfnShaderSource) getProc("glShaderSource");
+    pfnCompileShader compileShader = (pfnCompileShader) getProc("glCompileShader");
+    pfnGetShaderiv getShaderiv = (pfnGetShaderiv) getProc("glGetShaderiv");
+    pfnGetShaderInfoLog getShaderInfoLog = (pfnGetShaderInfoLog) getProc("glGetShaderInfoLog");
+    pfnCreateProgram createProgram = (pfnCreateProgram) getProc("glCreateProgram");
+    pfnAttachShader attachShader = (pfnAttachShader) getProc("glAttachShader");
+    pfnBindAttribLocation bindAttribLocation = (pfnBindAttribLocation) getProc("glBindAttribLocation");
+    pfnLinkProgram linkProgram = (pfnLinkProgram) getProc("glLinkProgram");
+    pfnGetProgramiv getProgramiv = (pfnGetProgramiv) getProc("glGetProgramiv");
+    pfnGetUniformLocation getUniformLocation = (pfnGetUniformLocation) getProc("glGetUniformLocation");
+    c.useProgram = (pfnUseProgram) getProc("glUseProgram");
+    c.uniform1i = (pfnUniform1i) getProc("glUniform1i");
+    c.uniform1fv = (pfnUniform1fv) getProc("glUniform1fv");
+    c.uniformMatrix3fv = (pfnUniformMatrixfv) getProc("glUniformMatrix3fv");
+    c.uniformMatrix4fv = (pfnUniformMatrixfv) getProc("glUniformMatrix4fv");
+    c.enableAttrib = (pfnVertexAttribArray) getProc("glEnableVertexAttribArray");
+    c.disableAttrib = (pfnVertexAttribArray) getProc("glDisableVertexAttribArray");
+    c.attribPointer = (pfnVertexAttribPointer) getProc("glVertexAttribPointer");
+    c.divisor = (pfnVertexAttribDivisor) getProc("glVertexAttribDivisorARB");
+    c.drawInstanced = (pfnDrawArraysInstanced) getProc("glDrawArraysInstancedARB");
+    if (!createShader || !shaderSource || !compileShader || !getShaderiv ||
+        !getShaderInfoLog || !createProgram || !attachShader ||
+        !bindAttribLocation || !linkProgram || !getProgramiv ||
+        !getUniformLocation || !c.useProgram || !c.uniform1i || !c.uniform1fv ||
+        !c.uniformMatrix3fv || !c.uniformMatrix4fv ||
+        !c.enableAttrib || !c.disableAttrib || !c.attribPointer ||
+        !c.divisor || !c.drawInstanced)
+      return false;
+
+    const GLuint shader = createShader(GL_VERTEX_SHADER);
+    shaderSource(shader, 1, &vertexShader, NULL);
+    compileShader(shader);
+    GLint status = 0;
+    getShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status) {
+      char log[1024] = "";
+      getShaderInfoLog(shader, sizeof(log), NULL, log);
+      ar_log_error() << "instancing vertex shader failed:\n" << log << "\n";
+      return false;
+    }
+    c.program = createProgram();
+    attachShader(c.program, shader);
+    const char* names[5] = {
+      "instance0", "instance1", "instance2", "instance3", "instanceColor" };
+    for (GLuint i=0; i<5; ++i)
+      bindAttribLocation(c.program, firstAttrib+i, names[i]);
+    linkProgram(c.program);
+    getProgramiv(c.program, GL_LINK_STATUS, &status);
+    if (!status) {
+      ar_log_error() << "instancing vertex shader failed to link.\n";
+      return false;
+    }
+    for (int i=0; i<6; ++i)
+      c.uniforms[i] = getUniformLocation(c.program, uniformNames[i]);
+    c.ok = true;
+    ar_log_debug() << "Hardware instancing enabled.\n";
+    return true;
+  }
+
+  // NULL if unsupported.  Call while lock'd.
+  Context* current() {
+    const void* id = currentContext();
+    map<const void*, Context>::iterator i = contexts.find(id);
+    if (i == contexts.end()) {
+      i = contexts.insert(make_pair(id, Context())).first;
+      init(i->second);
+    }
+    return i->second.ok ? &i->second : NULL;
+  }
+};
+
+bool ar_instancingSupported() {
+  arGuard _(arInstancingNamespace::lock, "ar_instancingSupported");
+  return arInstancingNamespace::current() != NULL;
+}
+
+bool ar_beginInstancing(const float* instances, int count) {
+  using namespace arInstancingNamespace;
+  arGuard _(lock, "ar_beginInstancing");
+  Context* c = current();
+  if (!c || c->count > 0 || !instances || count <= 0)
+    return false;
+
+  c->instances = instances;
+  c->count = count;
+  glGetFloatv(GL_MODELVIEW_MATRIX, c->outer.v);
+  c->outerInverse = !c->outer;
+  normalMatrix(c->outer, c->outerNormal);
+  ++active;
+  return true;
+}
+
+void ar_endInstancing() {
+  using namespace arInstancingNamespace;
+  arGuard _(lock, "ar_endInstancing");
+  Context* c = current();
+  if (!c || c->count <= 0)
+    return;
+  c->instances = NULL;
+  c->count = 0;
+  --active;
+}
+
+// Called by ar_draw01DRaw() and ar_draw2DRaw().  False if not instancing,
+// so they draw once as usual.
+static bool ar_drawInstanced(GLenum mode, int vertices, const int* indices,
+                             int numberPos, const float* positions,
+                             const float* normals, const float* colors,
+                             const float* texCoord, float blendFactor) {
+  using namespace arInstancingNamespace;
+  if (active <= 0)
+    return false;
+  Context* c = NULL;
+  {
+    arGuard _(lock, "ar_drawInstanced");
+    c = current();
+  }
+  if (!c || c->count <= 0)
+    return false;
+  if (vertices <= 0)
+    return true;
+
+  // Vertex arrays are sequential, so expand indexed positions.
+  vector<float> expanded;
+  if (indices) {
+    expanded.resize(3*vertices, 0.);
+    for (int i=0; i<vertices; ++i) {
+      if (indices[i] < numberPos)
+        memcpy(&expanded[3*i], positions + 3*indices[i], 3*sizeof(float));
+    }
+    positions = &expanded[0];
+  }
+  vector<float> blended;
+  if (colors && blendFactor != 1.) {
+    blended.assign(colors, colors + 4*vertices);
+    for (int i=0; i<vertices; ++i)
+      blended[4*i+3] *= blendFactor;
+    colors = &blended[0];
+  }
+
+  // Transforms below the instance node.
+  arMatrix4 modelView;
+  glGetFloatv(GL_MODELVIEW_MATRIX, modelView.v);
+  const arMatrix4 inner(c->outerInverse * modelView);
+  float innerNormal[9];
+  normalMatrix(inner, innerNormal);
+
+  c->useProgram(c->program);
+  c->uniform1i(c->uniforms[LIGHTING], glIsEnabled(GL_LIGHTING) ? 1 : 0);
+  float lightOn[8];
+  for (int i=0; i<8; ++i)
+    lightOn[i] = glIsEnabled(GLenum(GL_LIGHT0 + i)) ? 1. : 0.;
+  c->uniform1fv(c->uniforms[LIGHT_ON], 8, lightOn);
+  c->uniformMatrix4fv(c->uniforms[OUTER], 1, GL_FALSE, c->outer.v);
+  c->uniformMatrix4fv(c->uniforms[INNER], 1, GL_FALSE, inner.v);
+  c->uniformMatrix3fv(c->uniforms[OUTER_NORMAL], 1, GL_FALSE, c->outerNormal);
+  c->uniformMatrix3fv(c->uniforms[INNER_NORMAL], 1, GL_FALSE, innerNormal);
+  GLboolean twoSide = GL_FALSE;
+  glGetBooleanv(GL_LIGHT_MODEL_TWO_SIDE, &twoSide);
+  if (twoSide)
+    glEnable(GL_VERTEX_PROGRAM_TWO_SIDE);
+
+  GLuint i;
+  for (i=0; i<5; ++i) {
+    c->enableAttrib(firstAttrib+i);
+    c->attribPointer(firstAttrib+i, 4, GL_FLOAT, GL_FALSE, stride, c->instances + 4*i);
+    c->divisor(firstAttrib+i, 1);
+  }
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glVertexPointer(3, GL_FLOAT, 0, positions);
+  if (normals) {
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glNormalPointer(GL_FLOAT, 0, normals);
+  }
+  if (colors) {
+    glEnableClientState(GL_COLOR_ARRAY);
+    glColorPointer(4, GL_FLOAT, 0, colors);
+  }
+  if (texCoord) {
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glTexCoordPointer(2, GL_FLOAT, 0, texCoord);
+  }
+
+  c->drawInstanced(mode, 0, vertices, c->count);
+
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glDisableClientState(GL_NORMAL_ARRAY);
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  for (i=0; i<5; ++i) {
+    c->divisor(firstAttrib+i, 0);
+    c->disableAttrib(firstAttrib+i);
+  }
+  if (twoSide)
+    glDisable(GL_VERTEX_PROGRAM_TWO_SIDE);
+  c->useProgram(0);
+  return true;
+}
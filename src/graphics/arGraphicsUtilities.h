@@ -55,4 +55,16 @@ void ar_drawPolygon(int number, const int* indices,
 
 bool ar_openglStereo();
 
+// Hardware instancing (GL_ARB_instanced_arrays and GL_ARB_draw_instanced),
+// for arInstanceNode.  Each instance is 20 floats:  a column-major matrix,
+// applied between the current modelview matrix and any transforms after
+// ar_beginInstancing(), then an RGBA multiplying the color.
+// False if the current GL context lacks support (or on OS X).
+bool ar_instancingSupported();
+// Until ar_endInstancing(), ar_drawXXX() draw count copies with one call,
+// through a vertex shader that emulates fixed-function lighting.
+// Instances must stay valid until then.  False if unsupported.
+bool ar_beginInstancing(const float* instances, int count);
+void ar_endInstancing();
+
 #endif
@@ -0,0 +1,611 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arImagePyramid.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+#include "arMath.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+
+// File layout:  8 bytes of magic;  little-endian ints for width, height,
+// bytes per pixel, tile size and level count;  then each level's tiles,
+// finest level first, bottom row first, left to right.  Tiles at the
+// right and top edges are padded with black.
+
+namespace arImagePyramidNamespace {
+  const char magic[8] = { 'S', 'Z', 'G', 'P', 'Y', 'R', '0', '1' };
+  const int cbHeader = 8 + 5*4;
+
+  void putInt(char* p, int x) {
+    for (int i=0; i<4; ++i)
+      p[i] = char((x >> (8*i)) & 0xff);
+  }
+
+  int getInt(const char* p) {
+    int x = 0;
+    for (int i=0; i<4; ++i)
+      x |= int((unsigned char)p[i]) << (8*i);
+    return x;
+  }
+
+  bool seek(FILE* f, ARint64 offset) {
+#ifdef AR_USE_WIN_32
+    return _fseeki64(f, offset, SEEK_SET) == 0;
+#else
+    return fseeko(f, off_t(offset), SEEK_SET) == 0;
+#endif
+  }
+
+  ARint64 threadID() {
+#ifdef AR_USE_WIN_32
+    return GetCurrentThreadId();
+#else
+    return ARint64(pthread_self());
+#endif
+  }
+
+  bool nearer(const pair<double, ARint64>& a, const pair<double, ARint64>& b) {
+    return a.first < b.first;
+  }
+}
+using namespace arImagePyramidNamespace;
+
+arImagePyramid::arImagePyramid(int cacheBytes) :
+  _file(NULL),
+  _width(0),
+  _height(0),
+  _depth(3),
+  _tileSize(0),
+  _tileBytes(0),
+  _lock("PYRAMID"),
+  _wake("arImagePyramid wake"),
+  _idle("arImagePyramid idle"),
+  _quit(false),
+  _running(false),
+  _loading(false),
+  _cacheBytes(cacheBytes),
+  _lookahead(8.),
+  _frame(0),
+  _level(0),
+  _bytes(0),
+  _peakBytes(0),
+  _hits(0),
+  _misses(0),
+  _prefetchHits(0),
+  _loads(0),
+  _evictions(0),
+  _readErrors(0) {
+}
+
+arImagePyramid::~arImagePyramid() {
+  close();
+}
+
+void arImagePyramid::_makeLevels(int width, int height, int tileSize, int tileBytes,
+                                 vector<Level>& levels) {
+  levels.clear();
+  ARint64 offset = cbHeader;
+  for (;;) {
+    Level l;
+    l.width = width;
+    l.height = height;
+    l.cols = (width + tileSize - 1) / tileSize;
+    l.rows = (height + tileSize - 1) / tileSize;
+    l.offset = offset;
+    levels.push_back(l);
+    if (width <= tileSize && height <= tileSize)
+      return;
+    offset += ARint64(l.cols) * l.rows * tileBytes;
+    width = (width + 1) / 2;
+    height = (height + 1) / 2;
+  }
+}
+
+bool arImagePyramid::write(const arTexture& image, const string& fileName,
+                           int tileSize) {
+  if (tileSize <= 0 || !ar_isPowerOfTwo(tileSize)) {
+    ar_log_error() << "arImagePyramid: tile size " << tileSize <<
+      " not a power of two.\n";
+    return false;
+  }
+  if (!image) {
+    ar_log_error() << "arImagePyramid: no image for '" << fileName << "'.\n";
+    return false;
+  }
+
+  const int depth = image.getDepth();
+  const int tileBytes = tileSize * tileSize * depth;
+  vector<Level> levels;
+  _makeLevels(image.getWidth(), image.getHeight(), tileSize, tileBytes, levels);
+
+  FILE* f = fopen(fileName.c_str(), "wb");
+  if (!f) {
+    ar_log_error() << "arImagePyramid failed to create '" << fileName << "'.\n";
+    return false;
+  }
+  char header[cbHeader];
+  memcpy(header, magic, 8);
+  putInt(header + 8, image.getWidth());
+  putInt(header + 12, image.getHeight());
+  putInt(header + 16, depth);
+  putInt(header + 20, tileSize);
+  putInt(header + 24, levels.size());
+  bool ok = fwrite(header, cbHeader, 1, f) == 1;
+
+  // Only the first level is as large as the image.
+  vector<char> tile(tileBytes);
+  vector<char> level;
+  vector<char> next;
+  for (unsigned k=0; ok && k<levels.size(); ++k) {
+    const Level& l = levels[k];
+    const char* pixels = k==0 ? image.getPixels() : &level[0];
+    for (int row=0; row<l.rows; ++row) {
+      for (int col=0; col<l.cols; ++col) {
+        fill(tile.begin(), tile.end(), 0);
+        const int x0 = col * tileSize;
+        const int y0 = row * tileSize;
+        const int w = min(tileSize, l.width - x0);
+        const int h = min(tileSize, l.height - y0);
+        for (int y=0; y<h; ++y)
+          memcpy(&tile[y * tileSize * depth],
+                 pixels + (size_t(y0 + y) * l.width + x0) * depth, w * depth);
+        ok = ok && fwrite(&tile[0], tileBytes, 1, f) == 1;
+      }
+    }
+    if (k+1 == levels.size())
+      break;
+
+    // Average 2x2 blocks, repeating the last row and column if odd.
+    const Level& n = levels[k+1];
+    next.resize(size_t(n.width) * n.height * depth);
+    for (int y=0; y<n.height; ++y) {
+      const unsigned char* a =
+        (const unsigned char*)pixels + size_t(2*y) * l.width * depth;
+      const unsigned char* b =
+        (const unsigned char*)pixels + size_t(min(2*y + 1, l.height - 1)) * l.width * depth;
+      char* out = &next[size_t(y) * n.width * depth];
+      for (int x=0; x<n.width; ++x) {
+        const int x0 = 2*x*depth;
+        const int x1 = min(2*x + 1, l.width - 1) * depth;
+        for (int c=0; c<depth; ++c)
+          *out++ = char((a[x0+c] + a[x1+c] + b[x0+c] + b[x1+c] + 2) / 4);
+      }
+    }
+    level.swap(next);
+  }
+  if (fclose(f) != 0)
+    ok = false;
+  if (!ok) {
+    ar_log_error() << "arImagePyramid failed to write '" << fileName << "'.\n";
+    return false;
+  }
+  ar_log_remark() << "arImagePyramid wrote '" << fileName << "', " <<
+    levels.size() << " levels of " << tileSize << "-pixel tiles.\n";
+  return true;
+}
+
+bool arImagePyramid::open(const string& fileName, const string& path) {
+  close();
+  const string name = path.empty() ? fileName : ar_fileFind(fileName, "", path);
+  FILE* f = name == "NULL" ? NULL : fopen(name.c_str(), "rb");
+  if (!f) {
+    ar_log_error() << "arImagePyramid failed to open '" << fileName << "'.\n";
+    return false;
+  }
+
+  char header[cbHeader];
+  if (fread(header, cbHeader, 1, f) != 1 || memcmp(header, magic, 8)) {
+    ar_log_error() << "arImagePyramid: '" << name << "' is not an image pyramid.\n";
+    fclose(f);
+    return false;
+  }
+  _width = getInt(header + 8);
+  _height = getInt(header + 12);
+  _depth = getInt(header + 16);
+  _tileSize = getInt(header + 20);
+  const int cLevel = getInt(header + 24);
+  if (_width <= 0 || _height <= 0 || (_depth != 3 && _depth != 4) ||
+      _tileSize <= 0 || _tileSize > 8192 || !ar_isPowerOfTwo(_tileSize)) {
+    ar_log_error() << "arImagePyramid: '" << name << "' has a corrupt header.\n";
+    fclose(f);
+    return false;
+  }
+  _tileBytes = _tileSize * _tileSize * _depth;
+  _makeLevels(_width, _height, _tileSize, _tileBytes, _levels);
+  if (int(_levels.size()) != cLevel) {
+    ar_log_error() << "arImagePyramid: '" << name << "' has a corrupt header.\n";
+    fclose(f);
+    return false;
+  }
+
+  _file = f;
+  _frame = 0;
+  _level = _levels.size() - 1;
+  _bytes = _peakBytes = 0;
+  _hits = _misses = _prefetchHits = _loads = _evictions = _readErrors = 0;
+  _quit = false;
+  arThread t;
+  if (!t.beginThread(_loadTask, this)) {
+    ar_log_error() << "arImagePyramid failed to start its loader thread.\n";
+    close();
+    return false;
+  }
+  _running = true;
+  ar_log_remark() << "arImagePyramid opened '" << name << "', " << _width << " x " <<
+    _height << " in " << cLevel << " levels.\n";
+  return true;
+}
+
+void arImagePyramid::close() {
+  _lock.lock("arImagePyramid::close");
+  _quit = true;
+  while (_running) {
+    _wake.signal();
+    _idle.wait(_lock, 100);
+  }
+  _lock.unlock();
+
+  if (_file) {
+    fclose(_file);
+    _file = NULL;
+  }
+  for (map<ARint64, Tile>::iterator i = _tiles.begin(); i != _tiles.end(); ++i)
+    delete [] i->second.pixels;
+  _tiles.clear();
+  _lru.clear();
+  _queue.clear();
+  _visible.clear();
+  _bytes = 0;
+  // Only the threads that drew can delete their textures.
+  _textures.clear();
+}
+
+int arImagePyramid::_levelFor(double u0, double v0, double u1, double v1,
+                              int pixelsWide, int pixelsHigh) const {
+  // Texels of the full-resolution image per screen pixel,
+  // rounded to the nearest power of two.
+  double texels = min(fabs(u1 - u0) * _width / pixelsWide,
+                      fabs(v1 - v0) * _height / pixelsHigh);
+  int level = 0;
+  const int top = _levels.size() - 1;
+  while (level < top && texels >= M_SQRT2) {
+    texels /= 2.;
+    ++level;
+  }
+  return level;
+}
+
+void arImagePyramid::_tilesIn(int level, double u0, double v0, double u1, double v1,
+                              vector<ARint64>& keys) const {
+  const Level& l = _levels[level];
+  // Full-resolution pixels per tile.
+  const double span = double(_tileSize) * (1 << level);
+  const double ulo = max(0., min(u0, u1)) * _width / span;
+  const double uhi = min(1., max(u0, u1)) * _width / span;
+  const double vlo = max(0., min(v0, v1)) * _height / span;
+  const double vhi = min(1., max(v0, v1)) * _height / span;
+  if (ulo >= uhi || vlo >= vhi)
+    return;
+  const int col0 = max(0, int(floor(ulo)));
+  const int col1 = min(l.cols - 1, int(ceil(uhi)) - 1);
+  const int row0 = max(0, int(floor(vlo)));
+  const int row1 = min(l.rows - 1, int(ceil(vhi)) - 1);
+  for (int row=row0; row<=row1; ++row)
+    for (int col=col0; col<=col1; ++col)
+      keys.push_back(_key(level, col, row));
+}
+
+void arImagePyramid::setView(double u0, double v0, double u1, double v1,
+                             int pixelsWide, int pixelsHigh) {
+  if (!_file || pixelsWide <= 0 || pixelsHigh <= 0)
+    return;
+
+  const int top = _levels.size() - 1;
+  const int level = _levelFor(u0, v0, u1, v1, pixelsWide, pixelsHigh);
+  vector<ARint64> visible;
+  _tilesIn(level, u0, v0, u1, v1, visible);
+
+  // Load tiles nearest the center first.
+  const double span = double(_tileSize) * (1 << level);
+  const double cu = (u0 + u1) / 2.;
+  const double cv = (v0 + v1) / 2.;
+  vector<pair<double, ARint64> > order;
+  vector<ARint64>::const_iterator i;
+  for (i = visible.begin(); i != visible.end(); ++i) {
+    const double du = (_keyCol(*i) + .5) * span / _width - cu;
+    const double dv = (_keyRow(*i) + .5) * span / _height - cv;
+    order.push_back(make_pair(du*du + dv*dv, *i));
+  }
+  sort(order.begin(), order.end(), nearer);
+
+  // Predict the view after _lookahead more frames like the last one:
+  // the center moving linearly, the size changing geometrically.
+  vector<ARint64> prefetch;
+  if (_lookahead > 0. && _frame > 0) {
+    const double pu = (_previous[0] + _previous[2]) / 2.;
+    const double pv = (_previous[1] + _previous[3]) / 2.;
+    const double w = u1 - u0;
+    const double pw = _previous[2] - _previous[0];
+    const double scale = (w == 0. || pw == 0.) ? 1. :
+      min(4., max(.25, pow(w / pw, double(_lookahead))));
+    const double hu = w / 2. * scale;
+    const double hv = (v1 - v0) / 2. * scale;
+    const double nu = cu + (cu - pu) * _lookahead;
+    const double nv = cv + (cv - pv) * _lookahead;
+    if (nu != cu || nv != cv || scale != 1.) {
+      _tilesIn(_levelFor(nu-hu, nv-hv, nu+hu, nv+hv, pixelsWide, pixelsHigh),
+               nu-hu, nv-hv, nu+hu, nv+hv, prefetch);
+    }
+  }
+  // The next coarser level, for zooming out, and to draw while tiles load.
+  if (_lookahead > 0. && level < top)
+    _tilesIn(level + 1, u0, v0, u1, v1, prefetch);
+
+  arGuard _(_lock, "arImagePyramid::setView");
+  ++_frame;
+  _level = level;
+  _visible.swap(visible);
+  _queue.clear();
+  map<ARint64, Tile>::iterator t;
+
+  // Most recently used last:  prefetched, then visible, then the top level.
+  vector<ARint64> sorted(_visible);
+  sort(sorted.begin(), sorted.end());
+  for (i = prefetch.begin(); i != prefetch.end(); ++i) {
+    if (binary_search(sorted.begin(), sorted.end(), *i))
+      continue;
+    t = _tiles.find(*i);
+    if (t == _tiles.end()) {
+      Request r = { *i, true };
+      _queue.push_back(r);
+    } else {
+      _lru.splice(_lru.begin(), _lru, t->second.lru);
+    }
+  }
+  // Queue misses in front of prefetches, nearest first.
+  for (vector<pair<double, ARint64> >::reverse_iterator j = order.rbegin();
+       j != order.rend(); ++j) {
+    t = _tiles.find(j->second);
+    if (t == _tiles.end()) {
+      ++_misses;
+      Request r = { j->second, false };
+      _queue.push_front(r);
+      continue;
+    }
+    ++_hits;
+    if (t->second.prefetched) {
+      ++_prefetchHits;
+      t->second.prefetched = false;
+    }
+    t->second.frame = _frame;
+    _lru.splice(_lru.begin(), _lru, t->second.lru);
+  }
+  // The top level is always resident, as a fallback.
+  const ARint64 topKey = _key(top, 0, 0);
+  t = _tiles.find(topKey);
+  if (t == _tiles.end()) {
+    Request r = { topKey, false };
+    _queue.push_front(r);
+  } else {
+    t->second.frame = _frame;
+    _lru.splice(_lru.begin(), _lru, t->second.lru);
+  }
+
+  _previous[0] = u0;
+  _previous[1] = v0;
+  _previous[2] = u1;
+  _previous[3] = v1;
+  if (!_queue.empty())
+    _wake.signal();
+}
+
+bool arImagePyramid::wait(int msecTimeout) {
+  arGuard _(_lock, "arImagePyramid::wait");
+  while (_running && (_loading || !_queue.empty())) {
+    if (!_idle.wait(_lock, msecTimeout))
+      return false;
+  }
+  return true;
+}
+
+// Evict until one more tile fits.  Visible tiles stay:  if only they
+// remain, returns force.
+bool arImagePyramid::_makeRoom(bool force) {
+  list<ARint64>::iterator i = _lru.end();
+  while (_bytes + _tileBytes > _cacheBytes && i != _lru.begin()) {
+    --i;
+    map<ARint64, Tile>::iterator t = _tiles.find(*i);
+    if (t->second.frame == _frame)
+      continue;
+    delete [] t->second.pixels;
+    _tiles.erase(t);
+    i = _lru.erase(i);
+    _bytes -= _tileBytes;
+    ++_evictions;
+  }
+  return force || _bytes + _tileBytes <= _cacheBytes;
+}
+
+void arImagePyramid::_loadTask(void* pyramid) {
+  ((arImagePyramid*)pyramid)->_load();
+}
+
+void arImagePyramid::_load() {
+  _lock.lock("arImagePyramid::_load");
+  while (!_quit) {
+    if (_queue.empty()) {
+      _loading = false;
+      _idle.signal();
+      _wake.wait(_lock, 100);
+      continue;
+    }
+    const Request r = _queue.front();
+    _queue.pop_front();
+    if (_tiles.find(r.key) != _tiles.end() || !_makeRoom(!r.prefetch))
+      continue;
+
+    _loading = true;
+    const Level& l = _levels[_keyLevel(r.key)];
+    const ARint64 offset = l.offset +
+      (ARint64(_keyRow(r.key)) * l.cols + _keyCol(r.key)) * _tileBytes;
+    char* pixels = new char[_tileBytes];
+    _lock.unlock();
+    const bool ok = seek(_file, offset) && fread(pixels, _tileBytes, 1, _file) == 1;
+    _lock.lock("arImagePyramid::_load");
+
+    if (!ok) {
+      if (_readErrors++ == 0)
+        ar_log_error() << "arImagePyramid failed to read a tile;  file truncated?\n";
+      delete [] pixels;
+      continue;
+    }
+    // While unlocked, setView() may have made more tiles visible.
+    _makeRoom(true);
+    Tile& t = _tiles[r.key];
+    t.pixels = pixels;
+    t.frame = r.prefetch ? -1 : _frame;
+    t.prefetched = r.prefetch;
+    _lru.push_front(r.key);
+    t.lru = _lru.begin();
+    _bytes += _tileBytes;
+    if (_bytes > _peakBytes)
+      _peakBytes = _bytes;
+    ++_loads;
+  }
+  _loading = false;
+  _running = false;
+  _idle.signal();
+  _lock.unlock();
+}
+
+void arImagePyramid::draw() {
+  if (!_file)
+    return;
+
+  GLdouble modelView[16];
+  GLdouble projection[16];
+  GLint viewport[4];
+  glGetDoublev(GL_MODELVIEW_MATRIX, modelView);
+  glGetDoublev(GL_PROJECTION_MATRIX, projection);
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  // Where the viewport's corners meet the image's plane.  If one misses
+  // (the image seen edge-on, or behind the eye), all of it might show.
+  double lo[2] = { 1e30, 1e30 };
+  double hi[2] = { -1e30, -1e30 };
+  bool fMissed = false;
+  for (int i=0; i<4 && !fMissed; ++i) {
+    const GLdouble x = viewport[0] + ((i & 1) ? viewport[2] : 0);
+    const GLdouble y = viewport[1] + ((i & 2) ? viewport[3] : 0);
+    GLdouble n[3];
+    GLdouble f[3];
+    if (!gluUnProject(x, y, 0., modelView, projection, viewport, n, n+1, n+2) ||
+        !gluUnProject(x, y, 1., modelView, projection, viewport, f, f+1, f+2)) {
+      fMissed = true;
+      break;
+    }
+    const double dz = f[2] - n[2];
+    const double t = fabs(dz) < 1e-12 ? -1. : -n[2] / dz;
+    if (t < 0. || t > 1.) {
+      fMissed = true;
+      break;
+    }
+    for (int j=0; j<2; ++j) {
+      const double w = n[j] + t * (f[j] - n[j]) + .5;
+      lo[j] = min(lo[j], w);
+      hi[j] = max(hi[j], w);
+    }
+  }
+  if (fMissed) {
+    lo[0] = lo[1] = 0.;
+    hi[0] = hi[1] = 1.;
+  }
+  setView(lo[0], lo[1], hi[0], hi[1], viewport[2], viewport[3]);
+
+  arGuard _(_lock, "arImagePyramid::draw");
+  map<ARint64, GLuint>& textures = _textures[threadID()];
+  for (map<ARint64, GLuint>::iterator i = textures.begin(); i != textures.end(); ) {
+    if (_tiles.find(i->first) == _tiles.end()) {
+      glDeleteTextures(1, &i->second);
+      textures.erase(i++);
+    } else {
+      ++i;
+    }
+  }
+
+  glEnable(GL_TEXTURE_2D);
+  glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_DECAL);
+  for (vector<ARint64>::const_iterator i = _visible.begin(); i != _visible.end(); ++i)
+    _drawTile(*i, textures);
+  glDisable(GL_TEXTURE_2D);
+}
+
+// Draw a visible tile from the finest resident tile that covers it.
+void arImagePyramid::_drawTile(ARint64 key, map<ARint64, GLuint>& textures) {
+  const int level = _keyLevel(key);
+  const int col = _keyCol(key);
+  const int row = _keyRow(key);
+  const int top = _levels.size() - 1;
+  for (int k=0; level+k <= top; ++k) {
+    const ARint64 covering = _key(level+k, col >> k, row >> k);
+    const map<ARint64, Tile>::const_iterator t = _tiles.find(covering);
+    if (t == _tiles.end())
+      continue;
+
+    GLuint& name = textures[covering];
+    if (name == 0) {
+      glGenTextures(1, &name);
+      glBindTexture(GL_TEXTURE_2D, name);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      const GLenum format = _depth == 4 ? GL_RGBA : GL_RGB;
+      glTexImage2D(GL_TEXTURE_2D, 0, format, _tileSize, _tileSize, 0,
+                   format, GL_UNSIGNED_BYTE, t->second.pixels);
+    } else {
+      glBindTexture(GL_TEXTURE_2D, name);
+    }
+
+    // The visible tile's corners, in the image and in the covering tile.
+    const double span = double(_tileSize) * (1 << level);
+    const double spanCovering = span * (1 << k);
+    const double x[2] = { col * span, min(double(_width), (col + 1) * span) };
+    const double y[2] = { row * span, min(double(_height), (row + 1) * span) };
+    const double s0 = (col >> k) * spanCovering;
+    const double t0 = (row >> k) * spanCovering;
+    glBegin(GL_QUADS);
+    for (int c=0; c<4; ++c) {
+      const double px = x[c==1 || c==2];
+      const double py = y[c >= 2];
+      glTexCoord2d((px - s0) / spanCovering, (py - t0) / spanCovering);
+      glVertex2d(px / _width - .5, py / _height - .5);
+    }
+    glEnd();
+    return;
+  }
+}
+
+string arImagePyramid::status() {
+  arGuard _(_lock, "arImagePyramid::status");
+  const long lookups = _hits + _misses;
+  ostringstream s;
+  s << "pyramid: level " << _level << " of " << _levels.size() << ", " <<
+    _visible.size() << " tiles visible;  " << _hits << " hits (" <<
+    (lookups ? 100. * _hits / lookups : 100.) << "%, " << _prefetchHits <<
+    " prefetched), " << _misses << " misses, " << _loads << " loads, " <<
+    _evictions << " evictions;  " << _bytes / 1024 << " KB resident (peak " <<
+    _peakBytes / 1024 << ") of " << _cacheBytes / 1024 << " KB.\n";
+  return s.str();
+}
@@ -0,0 +1,145 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_IMAGE_PYRAMID_H
+#define AR_IMAGE_PYRAMID_H
+
+#include "arTexture.h"
+#include "arThread.h"
+#include "arGraphicsCalling.h"
+
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Image too large to hold in memory on every render node, unlike
+// arLargeImage.  write() converts an image to a pyramid file:  the image
+// at full resolution and at each halving down to one tile, each level cut
+// into square tiles of raw pixels.  Drawing reads only the tiles that
+// are visible, at the level nearest one texel per screen pixel, into a
+// cache of bounded size.  A thread loads them, nearest the center of the
+// view first, and then the tiles that the motion since the previous frame
+// will need next.  Until a tile arrives, its coarser ancestor is drawn.
+
+class SZG_CALL arImagePyramid {
+ public:
+  arImagePyramid(int cacheBytes = 128 << 20);
+  ~arImagePyramid();
+
+  // tileSize must be a power of two.
+  static bool write(const arTexture& image, const string& fileName,
+                    int tileSize = 256);
+
+  bool open(const string& fileName, const string& path = "");
+  void close();
+  bool isOpen() const { return _file != NULL; }
+
+  int getWidth() const { return _width; }
+  int getHeight() const { return _height; }
+  int getTileSize() const { return _tileSize; }
+  int getLevels() const { return _levels.size(); }
+
+  // Tiles not visible are evicted, least recently used first.
+  void setCacheBytes(int bytes) { _cacheBytes = bytes; }
+  // Prefetch where this many frames of the current motion lead;  0 disables.
+  void setLookahead(float frames) { _lookahead = frames; }
+
+  // Of the image from (0,0) at lower left to (1,1) at upper right,
+  // [u0,u1] x [v0,v1] fills pixelsWide x pixelsHigh screen pixels.
+  // Choose the level, and queue the tiles missing from the cache.
+  void setView(double u0, double v0, double u1, double v1,
+               int pixelsWide, int pixelsHigh);
+  // setView() from OpenGL's matrices and viewport, then draw the image
+  // on [-.5,.5] x [-.5,.5] at z=0 like arLargeImage::draw().
+  // Each thread that draws has its own textures.
+  void draw();
+  // Wait until the queued tiles are loaded.  False on timeout.
+  bool wait(int msecTimeout = -1);
+
+  // Since open().
+  int getLevel() const { return _level; }
+  long getHits() const { return _hits; }
+  long getMisses() const { return _misses; }
+  long getPrefetchHits() const { return _prefetchHits; }
+  long getResidentBytes() const { return _bytes; }
+  long getPeakBytes() const { return _peakBytes; }
+  string status();
+
+ private:
+  struct Level {
+    int width;
+    int height;
+    int cols;
+    int rows;
+    ARint64 offset;  // of its first tile, in the file
+  };
+  struct Tile {
+    char* pixels;
+    int frame;        // last visible, or -1
+    bool prefetched;  // and not yet visible
+    list<ARint64>::iterator lru;
+  };
+  struct Request {
+    ARint64 key;
+    bool prefetch;
+  };
+
+  FILE* _file;
+  int _width;
+  int _height;
+  int _depth;
+  int _tileSize;
+  int _tileBytes;
+  vector<Level> _levels;
+
+  arLock _lock;           // guards the rest
+  arConditionVar _wake;   // requests queued, or quitting
+  arConditionVar _idle;   // queue emptied, or the loader exited
+  bool _quit;
+  bool _running;
+  bool _loading;
+  deque<Request> _queue;
+  map<ARint64, Tile> _tiles;
+  list<ARint64> _lru;     // most recent first
+  long _cacheBytes;
+  float _lookahead;
+
+  int _frame;             // setView() calls
+  int _level;
+  vector<ARint64> _visible;
+  double _previous[4];    // view
+  map<ARint64, map<ARint64, GLuint> > _textures;  // per drawing thread
+
+  long _bytes;
+  long _peakBytes;
+  long _hits;
+  long _misses;
+  long _prefetchHits;
+  long _loads;
+  long _evictions;
+  long _readErrors;
+
+  static void _makeLevels(int width, int height, int tileSize, int tileBytes,
+                          vector<Level>& levels);
+  static ARint64 _key(int level, int col, int row)
+    { return (ARint64(level) << 48) | (ARint64(row) << 24) | ARint64(col); }
+  static int _keyLevel(ARint64 key) { return int(key >> 48); }
+  static int _keyRow(ARint64 key) { return int((key >> 24) & 0xffffff); }
+  static int _keyCol(ARint64 key) { return int(key & 0xffffff); }
+  int _levelFor(double u0, double v0, double u1, double v1,
+                int pixelsWide, int pixelsHigh) const;
+  void _tilesIn(int level, double u0, double v0, double u1, double v1,
+                vector<ARint64>& keys) const;
+  void _tileBounds(ARint64 key, double* bounds) const;
+  bool _makeRoom(bool force);
+  void _drawTile(ARint64 key, map<ARint64, GLuint>& textures);
+  static void _loadTask(void*);
+  void _load();
+};
+
+#endif
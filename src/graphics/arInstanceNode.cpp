@@ -0,0 +1,153 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arInstanceNode.h"
+#include "arGraphicsDatabase.h"
+
+arInstanceNode::arInstanceNode() : arGraphicsArrayNode(AR_FLOAT, 20)
+{
+  _name = "instance_node";
+  _typeCode = AR_G_INSTANCE_NODE;
+  _typeString = "instance";
+  _commandBuffer.grow(1);
+}
+
+void arInstanceNode::initialize(arDatabase* database) {
+  arGraphicsNode::initialize(database);
+  arGraphicsArrayNode::initialize(
+    _g->AR_INSTANCE,
+    _g->AR_INSTANCE_ID,
+    _g->AR_INSTANCE_IDS,
+    _g->AR_INSTANCE_INSTANCES,
+    _g->AR_INSTANCE);
+}
+
+bool arInstanceNode::receiveData(arStructuredData* inData) {
+  if (!_g->checkNodeID(_g->AR_INSTANCE, inData->getID(), "arInstanceNode"))
+    return false;
+
+  const int count = inData->getDataInt(_g->AR_INSTANCE_COUNT);
+  const ARint len = inData->getDataDimension(_g->AR_INSTANCE_INSTANCES) / _arrayStride;
+  const ARint numberIDs = inData->getDataDimension(_g->AR_INSTANCE_IDS);
+  ARint* IDs = (ARint*)inData->getDataPtr(_g->AR_INSTANCE_IDS, AR_INT);
+  float* instances = (float*)inData->getDataPtr(_g->AR_INSTANCE_INSTANCES, AR_FLOAT);
+
+  {
+    arGuard _(_nodeLock, "arInstanceNode::receiveData");
+    if (count >= 0) {
+      // Shrink, or grow with zeros.  A 1-float buffer holds no instances.
+      const int size = count * _arrayStride;
+      if (size != int(_commandBuffer.size()))
+        _commandBuffer.resize(size > 0 ? size : 1);
+    }
+    if (len > 0 && numberIDs > 0)
+      _mergeElements(len, instances, IDs[0] == -1 ? NULL : IDs);
+    _commandBuffer.setType(_recordType);
+  }
+  _invalidateBounds(this);
+  return true;
+}
+
+arStructuredData* arInstanceNode::dumpData() {
+  arGuard _(_nodeLock, "arInstanceNode::dumpData");
+  const int number = _numElements();
+  return _dumpData(number, _commandBuffer.v, NULL, number, false);
+}
+
+arStructuredData* arInstanceNode::_dumpData(int number, float* instances,
+    int* IDs, int count, bool owned) {
+  arStructuredData* r = arGraphicsArrayNode::_dumpData(number, instances, IDs, owned);
+  if (r && !r->dataIn(_g->AR_INSTANCE_COUNT, &count, AR_INT, 1)) {
+    delete r;
+    return NULL;
+  }
+  return r;
+}
+
+const float* arInstanceNode::getInstances(int& number) {
+  number = _numElements();
+  return _commandBuffer.v;
+}
+
+void arInstanceNode::getInstances(vector<float>& instances) {
+  arGuard _(_nodeLock, "arInstanceNode::getInstances");
+  instances.assign(_commandBuffer.v, _commandBuffer.v + _numElements()*_arrayStride);
+}
+
+int arInstanceNode::getNumber() {
+  arGuard _(_nodeLock, "arInstanceNode::getNumber");
+  return _numElements();
+}
+
+void arInstanceNode::setInstances(int number, float* instances, int* IDs) {
+  if (number < 0)
+    return;
+  if (active()) {
+    _nodeLock.lock("arInstanceNode::setInstances active");
+      arStructuredData* r = _dumpData(number, instances, IDs, IDs ? -1 : number, true);
+    _nodeLock.unlock();
+    _owningDatabase->alter(r);
+    recycle(r);
+  }
+  else{
+    arGuard _(_nodeLock, "arInstanceNode::setInstances inactive");
+    if (!IDs)
+      _commandBuffer.resize(number > 0 ? number*_arrayStride : 1);
+    _mergeElements(number, instances, IDs);
+  }
+}
+
+void arInstanceNode::setInstances(int number, float* instances) {
+  setInstances(number, instances, NULL);
+}
+
+void arInstanceNode::setInstances(int number, const float* matrices, const float* colors) {
+  if (number < 0)
+    return;
+  vector<float> packed(number*_arrayStride + 1);
+  for (int i=0; i<number; ++i) {
+    float* p = &packed[i*_arrayStride];
+    memcpy(p, matrices + 16*i, 16*sizeof(float));
+    if (colors)
+      memcpy(p+16, colors + 4*i, 4*sizeof(float));
+    else
+      p[16] = p[17] = p[18] = p[19] = 1.;
+  }
+  setInstances(number, &packed[0], NULL);
+}
+
+vector<arMatrix4> arInstanceNode::getMatrices() {
+  arGuard _(_nodeLock, "arInstanceNode::getMatrices");
+  const unsigned num = _numElements();
+  vector<arMatrix4> r(num);
+  for (unsigned i = 0; i < num; i++) {
+    r[i] = arMatrix4(_commandBuffer.v + _arrayStride * i);
+  }
+  return r;
+}
+
+vector<arVector4> arInstanceNode::getColors() {
+  arGuard _(_nodeLock, "arInstanceNode::getColors");
+  const unsigned num = _numElements();
+  vector<arVector4> r(num);
+  for (unsigned i = 0; i < num; i++) {
+    r[i].set(_commandBuffer.v + _arrayStride * i + 16);
+  }
+  return r;
+}
+
+// Slow, Python-compatible.  Missing colors are white.
+void arInstanceNode::setInstances(vector<arMatrix4>& matrices, vector<arVector4>& colors) {
+  const unsigned num = matrices.size();
+  vector<float> packed(num*_arrayStride + 1);
+  for (unsigned i = 0; i < num; i++) {
+    float* p = &packed[i*_arrayStride];
+    memcpy(p, matrices[i].v, 16*sizeof(float));
+    const arVector4 c(i < colors.size() ? colors[i] : arVector4(1, 1, 1, 1));
+    memcpy(p+16, c.v, 4*sizeof(float));
+  }
+  setInstances(num, &packed[0], NULL);
+}
@@ -0,0 +1,56 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_INSTANCE_NODE_H
+#define AR_INSTANCE_NODE_H
+
+#include "arGraphicsArrayNode.h"
+#include "arGraphicsCalling.h"
+
+#include <vector>
+
+// Draw the subtree below once per instance.  Each instance is 20 floats:
+// a column-major matrix (applied like an arTransformNode above the
+// subtree), then an RGBA multiplying the subtree's colors.
+//
+// One array record carries every instance, instead of a transform and
+// material subtree per copy.  arGraphicsDatabase draws the copies with
+// hardware instancing where available (see ar_beginInstancing()),
+// and otherwise loops over them.
+
+class SZG_CALL arInstanceNode: public arGraphicsArrayNode{
+ public:
+  arInstanceNode();
+  ~arInstanceNode() {}
+
+  virtual void initialize(arDatabase* database);
+  arStructuredData* dumpData();
+  bool receiveData(arStructuredData*);
+
+  // Speedy accessor.  Not thread-safe, so call while _nodeLock'd.
+  const float* getInstances(int& number);
+  // Thread-safe copy.
+  void getInstances(vector<float>& instances);
+  int getNumber();
+
+  // Replace all instances.  NULL colors are white.
+  void setInstances(int number, const float* matrices, const float* colors = NULL);
+  // Replace all instances, packed 20 floats each.
+  void setInstances(int number, float* instances);
+  // Change or add some instances, packed 20 floats each.
+  void setInstances(int number, float* instances, int* IDs);
+
+  // Slow, Python-compatible.
+  vector<arMatrix4> getMatrices();
+  vector<arVector4> getColors();
+  void setInstances(vector<arMatrix4>& matrices, vector<arVector4>& colors);
+
+ protected:
+  // count:  instances after the update, or -1 to keep any past the IDs.
+  arStructuredData* _dumpData(int number, float* instances, int* IDs,
+                              int count, bool owned);
+};
+
+#endif
@@ -0,0 +1,120 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arGraphicsDatabase.h"
+
+arLODNode::arLODNode():
+  _mode(AR_LOD_DISTANCE),
+  _center(0, 0, 0),
+  _radius(0) {
+  _name = "lod_node";
+  _typeCode = AR_G_LOD_NODE;
+  _typeString = "lod";
+}
+
+bool arLODNode::receiveData(arStructuredData* inData) {
+  if (!_g->checkNodeID(_g->AR_LOD, inData->getID(), "arLODNode"))
+    return false;
+
+  const int mode = inData->getDataInt(_g->AR_LOD_MODE);
+  if (mode != AR_LOD_DISTANCE && mode != AR_LOD_ANGLE) {
+    ar_log_error() << "arLODNode ignoring unknown mode " << mode << ".\n";
+    return false;
+  }
+  vector<float> ranges(inData->getDataDimension(_g->AR_LOD_RANGES));
+  if (!ranges.empty())
+    inData->dataOut(_g->AR_LOD_RANGES, &ranges[0], AR_FLOAT, ranges.size());
+
+  arGuard _(_nodeLock, "arLODNode::receiveData");
+  _mode = mode;
+  _ranges.swap(ranges);
+  inData->dataOut(_g->AR_LOD_CENTER, _center.v, AR_FLOAT, 3);
+  inData->dataOut(_g->AR_LOD_RADIUS, &_radius, AR_FLOAT, 1);
+  return true;
+}
+
+int arLODNode::select(const arMatrix4& world, const arVector3& viewpoint) {
+  arGuard _(_nodeLock, "arLODNode::select");
+  const float d = (world * _center - viewpoint).magnitude();
+  int level = 0;
+  if (_mode == AR_LOD_DISTANCE) {
+    while (level < int(_ranges.size()) && _ranges[level] <= d)
+      ++level;
+    return level;
+  }
+
+  // The radius scales with world's largest axis.
+  float scale = 0.;
+  for (int i=0; i<3; ++i) {
+    const float s = arVector3(world.v + 4*i).magnitude();
+    if (s > scale)
+      scale = s;
+  }
+  const float r = _radius * scale;
+  const float angle = r >= d ? 180. : 2. * asin(r / d) * 180. / M_PI;
+  while (level < int(_ranges.size()) && _ranges[level] > angle)
+    ++level;
+  return level;
+}
+
+void arLODNode::setLOD(int mode, const vector<float>& ranges,
+                       const arVector3& center, float radius) {
+  if (active()) {
+    _nodeLock.lock("arLODNode::setLOD active");
+      arStructuredData* r = _dumpData(mode, ranges, center, radius, true);
+    _nodeLock.unlock();
+    _owningDatabase->alter(r);
+    recycle(r);
+  }
+  else{
+    arGuard _(_nodeLock, "arLODNode::setLOD inactive");
+    _mode = mode;
+    _ranges = ranges;
+    _center = center;
+    _radius = radius;
+  }
+}
+
+int arLODNode::getMode() {
+  arGuard _(_nodeLock, "arLODNode::getMode");
+  return _mode;
+}
+
+vector<float> arLODNode::getRanges() {
+  arGuard _(_nodeLock, "arLODNode::getRanges");
+  return _ranges;
+}
+
+arVector3 arLODNode::getCenter() {
+  arGuard _(_nodeLock, "arLODNode::getCenter");
+  return _center;
+}
+
+float arLODNode::getRadius() {
+  arGuard _(_nodeLock, "arLODNode::getRadius");
+  return _radius;
+}
+
+arStructuredData* arLODNode::dumpData() {
+  arGuard _(_nodeLock, "arLODNode::dumpData");
+  return _dumpData(_mode, _ranges, _center, _radius, false);
+}
+
+arStructuredData* arLODNode::_dumpData(int mode, const vector<float>& ranges,
+    const arVector3& center, float radius, bool owned) {
+  arStructuredData* r = _getRecord(owned, _g->AR_LOD);
+  _dumpGenericNode(r, _g->AR_LOD_ID);
+  const float none = 0.;  // dataIn rejects NULL even for no ranges
+  if (!r->dataIn(_g->AR_LOD_MODE, &mode, AR_INT, 1) ||
+      !r->dataIn(_g->AR_LOD_RANGES, ranges.empty() ? &none : &ranges[0],
+                 AR_FLOAT, ranges.size()) ||
+      !r->dataIn(_g->AR_LOD_CENTER, center.v, AR_FLOAT, 3) ||
+      !r->dataIn(_g->AR_LOD_RADIUS, &radius, AR_FLOAT, 1)) {
+    delete r;
+    return NULL;
+  }
+  return r;
+}
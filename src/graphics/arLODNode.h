@@ -0,0 +1,56 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_LOD_NODE_H
+#define AR_LOD_NODE_H
+
+#include "arGraphicsNode.h"
+#include "arGraphicsCalling.h"
+
+#include <vector>
+
+// Level-of-detail switch:  draw only the child for the current level,
+// child 0 being the most detailed.  Levels past the last child draw nothing.
+//
+// AR_LOD_DISTANCE:  level is how many ranges (ascending) are at most the
+//   distance from the viewpoint to center.
+// AR_LOD_ANGLE:  level is how many ranges (descending, in degrees) exceed
+//   the angle the sphere (center, radius) subtends at the viewpoint.
+//   This is the projected size, independent of any one wall's resolution.
+//
+// Every render node selects from the same head position,
+// so the walls of a cluster switch together.
+
+enum { AR_LOD_DISTANCE = 0, AR_LOD_ANGLE = 1 };
+
+class SZG_CALL arLODNode: public arGraphicsNode{
+ public:
+  arLODNode();
+  virtual ~arLODNode() {}
+
+  void draw(arGraphicsContext*) {}
+  arStructuredData* dumpData();
+  bool receiveData(arStructuredData*);
+
+  // world maps this node's coordinates to the viewpoint's.
+  int select(const arMatrix4& world, const arVector3& viewpoint);
+
+  void setLOD(int mode, const vector<float>& ranges,
+              const arVector3& center, float radius);
+  int getMode();
+  vector<float> getRanges();
+  arVector3 getCenter();
+  float getRadius();
+
+ protected:
+  int _mode;
+  vector<float> _ranges;
+  arVector3 _center;
+  float _radius;
+  arStructuredData* _dumpData(int mode, const vector<float>& ranges,
+                              const arVector3& center, float radius, bool owned);
+};
+
+#endif
@@ -6,6 +6,9 @@
 
 #include <vector>
 
+// Whole image in memory, as tiles.  For images too large for that,
+// see arImagePyramid.
+
 class SZG_CALL arLargeImage {
 public:
   arLargeImage( unsigned int tileWidth=256, unsigned int tileHeight=0 );
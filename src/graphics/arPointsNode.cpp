@@ -12,6 +12,7 @@ arPointsNode::arPointsNode() : arGraphicsArrayNode(AR_FLOAT, 3) {
   _typeCode = AR_G_POINTS_NODE;
   _typeString = "points";
   _commandBuffer.grow(1);
+  _fPointsBounds = false;
 }
 
 void arPointsNode::initialize(arDatabase* database) {
@@ -24,6 +25,29 @@ void arPointsNode::initialize(arDatabase* database) {
     _g->AR_POINTS);
 }
 
+bool arPointsNode::receiveData(arStructuredData* inData) {
+  if (!arGraphicsArrayNode::receiveData(inData))
+    return false;
+  _nodeLock.lock("arPointsNode::receiveData");
+    _fPointsBounds = false;
+  _nodeLock.unlock();
+  _invalidateBounds(this);
+  return true;
+}
+
+arGraphicsBounds arPointsNode::getPointsBounds() {
+  arGuard _(_nodeLock, "arPointsNode::getPointsBounds");
+  if (!_fPointsBounds) {
+    _pointsBounds = arGraphicsBounds();
+    const unsigned num = _numElements();
+    for (unsigned i = 0; i < num; ++i) {
+      _pointsBounds.add(arVector3(_commandBuffer.v + _arrayStride * i));
+    }
+    _fPointsBounds = true;
+  }
+  return _pointsBounds;
+}
+
 // Speedy accessor.  Not thread-safe, so call while _nodeLock'd.
 const float* arPointsNode::getPoints(int& number) {
   number = _numElements();
@@ -52,6 +76,7 @@ void arPointsNode::setPoints(int number, float* points, int* IDs) {
   else{
     arGuard _(_nodeLock, "arPointsNode::setPoints inactive");
     _mergeElements(number, points, IDs);
+    _fPointsBounds = false;
   }
 }
 
@@ -18,6 +18,7 @@ class SZG_CALL arPointsNode:public arGraphicsArrayNode{
   virtual ~arPointsNode() {}
 
   virtual void initialize(arDatabase* database);
+  bool receiveData(arStructuredData*);
 
   const float* getPoints(int& number);
   void setPoints(int number, float* points, int* IDs = NULL);
@@ -25,6 +26,13 @@ class SZG_CALL arPointsNode:public arGraphicsArrayNode{
   void setPoints(vector<arVector3>& points);
   void setPoints(vector<arVector3>& points,
                  vector<int>& IDs);
+
+  // Thread-safe.  The box around the points, kept until they change.
+  arGraphicsBounds getPointsBounds();
+
+ private:
+  bool _fPointsBounds;
+  arGraphicsBounds _pointsBounds;
 };
 
 #endif
@@ -105,6 +105,18 @@ bool arBoundingSphere::intersectViewFrustum(const arFrustumPlanes& planes) const
 }
 
 
+int arBoundingSphere::classifyViewFrustum(const arFrustumPlanes& planes) const {
+  int result = 1;
+  for (unsigned i=0; i<6; ++i) {
+    const float distance = planes.D[i] + planes.normals[i].dot( position );
+    if (distance < -radius)
+      return -1;
+    if (distance < radius)
+      result = 0;
+  }
+  return result;
+}
+
 // Given a camera viewing matrix, does this bounding sphere intersect?
 bool arBoundingSphere::intersectViewFrustum(const arMatrix4& mArg) const {
   // hack: cast away constness, since arMatrix4.operator[] can't be const
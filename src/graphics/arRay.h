@@ -56,6 +56,8 @@ class SZG_CALL arBoundingSphere {
 
   bool intersectViewFrustum(const arMatrix4&) const;
   bool intersectViewFrustum(const arFrustumPlanes&) const;
+  // -1 if outside the planes, 1 if inside all of them, else 0.
+  int classifyViewFrustum(const arFrustumPlanes&) const;
 
   float     radius;
   bool      visibility;
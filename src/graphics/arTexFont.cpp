@@ -6,6 +6,7 @@
 
 #include "arPrecompiled.h"
 #include "arTexFont.h"
+#include "arDataUtilities.h"
 
 #include <assert.h>
 #include <ctype.h>
@@ -40,10 +41,13 @@ list<string> ar_parseLineBreaks(const string& text) {
   return result;
 }
 
-arTexFont::arTexFont() {
+arTexFont::arTexFont() :
+  _texture(&_fontTexture),
+  _asset(NULL) {
 }
 
 arTexFont::~arTexFont() {
+  _release();
 }
 
 float arTexFont::characterWidth() {
@@ -59,19 +63,40 @@ float arTexFont::characterHeight() {
   return _charHeight;
 }
 
+// The decoded font is shared with other arTexFonts through ar_assetCache().
 bool arTexFont::load( const string& fontFilePath, int transparentColor ) {
-  const bool ok =_fontTexture.readImage( fontFilePath, transparentColor );
-  if (ok) {
-    _fontTexture.setTextureFunc(GL_MODULATE);
-    _fontTexture.mipmap(true);
+  const string kind("font/" + ar_intToString(transparentColor));
+  arAssetCache& cache = ar_assetCache();
+  arAsset* a = cache.acquire(kind, fontFilePath);
+  if (!a) {
+    arTexture* t = new arTexture;
+    if (!t->readImage( fontFilePath, transparentColor )) {
+      t->unref();
+      return false;
+    }
+    t->setTextureFunc(GL_MODULATE);
+    t->mipmap(true);
+    a = cache.insert(kind, fontFilePath, new arTextureAsset(t));
   }
-  return ok;
+  _release();
+  _asset = a;
+  _texture = static_cast<arTextureAsset*>(a)->texture();
+  return true;
 }
 
 void arTexFont::setFontTexture( const arTexture& newFont ) {
+  _release();
   _fontTexture = newFont;
 }
 
+void arTexFont::_release() {
+  if (_asset) {
+    ar_assetCache().release(_asset);
+    _asset = NULL;
+  }
+  _texture = &_fontTexture;
+}
+
 void arTexFont::lineFeed(int& currentColumn, int& currentRow, arTextBox& format) {
   glTranslatef( -currentColumn*characterWidth(), -lineHeight(format), 0);
   currentColumn = 0;
@@ -189,7 +214,7 @@ void arTexFont::renderText(list<string>& parse, arTextBox& format ) {
   // These parameters seem to give the best text minimization.
   glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST );
   glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-  _fontTexture.activate();
+  _texture->activate();
   // The character width and height are in the character coordinate system.
   _charHeight = 1;  // This is fixed by convention.
   _charWidth = 0.6; // This actually depends on the font's texture.
@@ -222,7 +247,7 @@ void arTexFont::renderText(list<string>& parse, arTextBox& format ) {
     }
   }
   glPopMatrix();
-  _fontTexture.deactivate();
+  _texture->deactivate();
   glDisable(GL_BLEND);
   glPopAttrib();
 }
@@ -70,7 +70,13 @@ class SZG_CALL arTexFont
     bool renderFile(const string& filename, arTextBox& format);
 
   private:
+    arTexFont( const arTexFont& );
+    arTexFont& operator=( const arTexFont& );
+
     arTexture _fontTexture;
+    arTexture* _texture;  // _fontTexture, or the shared one from load()
+    arAsset* _asset;
+    void _release();
     float _charWidth;
     float _charHeight;
 };
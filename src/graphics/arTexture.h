@@ -9,6 +9,7 @@
 #include "arGraphicsHeader.h"
 #include "arDataType.h"
 #include "arThread.h" // for arLock
+#include "arAssetCache.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <iostream>
@@ -51,6 +52,8 @@ class SZG_CALL arTexture {
 
   bool activate(bool forceReload = false);
   void deactivate() const;
+  // New pixels await activate().
+  bool dirty() const { return _fDirty; }
 
   int getWidth()  const { return _width; }
   int getHeight() const { return _height; }
@@ -152,4 +155,17 @@ class SZG_CALL arTexture {
 
 extern void arTexture_setThreaded(bool f = false);
 
+// arTexture decoded once per process, shared through ar_assetCache().
+// Holds one reference to the texture.
+
+class SZG_CALL arTextureAsset : public arAsset {
+ public:
+  arTextureAsset(arTexture* t) : _texture(t) {}
+  ~arTextureAsset() { _texture->unref(); }
+  int bytes() const { return _texture->numbytes(); }
+  arTexture* texture() const { return _texture; }
+ private:
+  arTexture* _texture;
+};
+
 #endif
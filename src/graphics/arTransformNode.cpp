@@ -24,8 +24,11 @@ bool arTransformNode::receiveData(arStructuredData* inData) {
   if (!_g->checkNodeID(_g->AR_TRANSFORM, inData->getID(), "arTransformNode"))
     return false;
 
-  arGuard _(_nodeLock, "arTransformNode::receiveData");
-  inData->dataOut(_g->AR_TRANSFORM_MATRIX, _transform.v, AR_FLOAT, 16);
+  _nodeLock.lock("arTransformNode::receiveData");
+    inData->dataOut(_g->AR_TRANSFORM_MATRIX, _transform.v, AR_FLOAT, 16);
+  _nodeLock.unlock();
+  // Bounds here are in the children's frame, so only those above move.
+  _invalidateBounds(getParent());
   return true;
 }
 
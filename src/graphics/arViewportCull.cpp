@@ -0,0 +1,175 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arViewportCull.h"
+#include "arGraphicsNode.h"
+#include "arTransformNode.h"
+#include "arBoundingSphereNode.h"
+#include "arVisibilityNode.h"
+#include "arDataUtilities.h"
+
+arViewportCull::arViewportCull() :
+  _union(ar_identityMatrix()),  // Not the default, which reads OpenGL.
+  _fBounds(false),
+  _usec(0.),
+  _spheres(0),
+  _bounds(0),
+  _tests(0) {
+}
+
+void arViewportCull::cull(arDatabaseNode* root, const vector<arMatrix4>& clip,
+                          bool bounds) {
+  const ar_timeval start = ar_time();
+  _fBounds = bounds;
+  _planes.clear();
+  const int cViewport = min(int(clip.size()), int(MAX_VIEWPORTS));
+  for (int i=0; i<cViewport; ++i)
+    _planes.push_back(arFrustumPlanes(clip[i]));
+  fill(_masks.begin(), _masks.end(), 0);
+  _spheres = 0;
+  _bounds = 0;
+  _tests = 0;
+  if (cViewport > 0) {
+    _makeUnion(clip);
+    _cull(root, ar_identityMatrix(), (1u << cViewport) - 1, 0);
+  }
+  _usec = ar_difftime(ar_time(), start);
+}
+
+// Push each plane of the first frustum out past every frustum's corners.
+// Each frustum is the convex hull of its corners, so the union of the
+// frusta is inside the result.
+void arViewportCull::_makeUnion(const vector<arMatrix4>& clip) {
+  _union = _planes[0];
+  for (unsigned k=0; k<_planes.size(); ++k) {
+    const arMatrix4 inverse(clip[k].inverse());
+    for (int corner=0; corner<8; ++corner) {
+      const arVector3 c(inverse * arVector3(
+        corner&1 ? 1 : -1, corner&2 ? 1 : -1, corner&4 ? 1 : -1));
+      for (int i=0; i<6; ++i) {
+        const float d = -_union.normals[i].dot(c);
+        if (d > _union.D[i])
+          _union.D[i] = d;
+      }
+    }
+  }
+}
+
+void arViewportCull::_cull(arDatabaseNode* node, const arMatrix4& model,
+                           unsigned candidates, unsigned inside) {
+  const int code = node->getTypeCode();
+  const arMatrix4 childModel(code == AR_G_TRANSFORM_NODE ?
+    model * ((arTransformNode*)node)->getTransform() : model);
+  arBoundingSphere b;
+  bool bounded = false;
+  if (code == AR_G_BOUNDING_SPHERE_NODE) {
+    ++_spheres;
+    b = ((arBoundingSphereNode*)node)->getBoundingSphere();
+    bounded = true;
+  }
+  else if (code == AR_G_TRANSFORM_NODE && _fBounds &&
+           ((arGraphicsNode*)node)->_boundingSphere(b)) {
+    // In the children's frame.
+    ++_bounds;
+    bounded = true;
+  }
+  if (bounded) {
+    b.position = childModel * b.position;
+    // Largest axis, in case scaling isn't uniform.
+    float scale = 0.;
+    for (int axis=0; axis<3; ++axis) {
+      const float s = ++arVector3(childModel.v[4*axis], childModel.v[4*axis+1],
+                                  childModel.v[4*axis+2]);
+      if (s > scale)
+        scale = s;
+    }
+    b.radius *= scale;
+
+    unsigned mask = inside;
+    const unsigned test = candidates & ~inside;
+    if (test) {
+      ++_tests;
+      if (b.classifyViewFrustum(_union) >= 0) {
+        for (unsigned k=0; k<_planes.size(); ++k) {
+          const unsigned bit = 1u << k;
+          if (!(test & bit))
+            continue;
+          ++_tests;
+          const int c = b.classifyViewFrustum(_planes[k]);
+          if (c >= 0)
+            mask |= bit;
+          if (c > 0)
+            inside |= bit;
+        }
+      }
+    }
+    const unsigned id = unsigned(node->getID());
+    if (id >= _masks.size())
+      _masks.resize(id + 1 + id/2, 0);
+    _masks[id] = mask | KNOWN;
+    // Viewports that culled this sphere won't reach its children.
+    candidates = mask;
+    if (!candidates)
+      return;
+    if (inside == candidates) {
+      // Nothing below needs testing.
+      _mark(node, mask);
+      return;
+    }
+  }
+  else if ((code == AR_G_VISIBILITY_NODE &&
+            !((arVisibilityNode*)node)->getVisibility()) ||
+           code == AR_G_INSTANCE_NODE) {
+    // Spheres below instances stay unknown, for drawing to test.
+    return;
+  }
+
+  const list<arDatabaseNode*>& children = ((arGraphicsNode*)node)->_children;
+  for (list<arDatabaseNode*>::const_iterator i = children.begin(); i != children.end(); ++i)
+    _cull(*i, childModel, candidates, inside);
+}
+
+void arViewportCull::_mark(arDatabaseNode* node, unsigned mask) {
+  const list<arDatabaseNode*>& children = ((arGraphicsNode*)node)->_children;
+  for (list<arDatabaseNode*>::const_iterator i = children.begin(); i != children.end(); ++i) {
+    arDatabaseNode* child = *i;
+    const int code = child->getTypeCode();
+    if (code == AR_G_BOUNDING_SPHERE_NODE || code == AR_G_TRANSFORM_NODE) {
+      if (code == AR_G_BOUNDING_SPHERE_NODE)
+        ++_spheres;
+      const unsigned id = unsigned(child->getID());
+      if (id >= _masks.size())
+        _masks.resize(id + 1 + id/2, 0);
+      _masks[id] = mask | KNOWN;
+    }
+    else if ((code == AR_G_VISIBILITY_NODE &&
+              !((arVisibilityNode*)child)->getVisibility()) ||
+             code == AR_G_INSTANCE_NODE) {
+      continue;
+    }
+    _mark(child, mask);
+  }
+}
+
+int arViewportCull::visible(int nodeID, int viewport) const {
+  if (nodeID < 0 || unsigned(nodeID) >= _masks.size() ||
+      viewport < 0 || viewport >= int(_planes.size()))
+    return -1;
+  const unsigned mask = _masks[nodeID];
+  if (!(mask & KNOWN))
+    return -1;
+  return (mask >> viewport) & 1;
+}
+
+string arViewportCull::status() const {
+  const int cNaive = _spheres * int(_planes.size());
+  return "Viewport cull: " + ar_intToString(int(_planes.size())) + " viewports, " +
+    ar_intToString(_spheres) + " bounding spheres, " +
+    ar_intToString(_bounds) + " bounded transforms, " +
+    ar_intToString(_tests) + " frustum tests (" +
+    ar_intToString(cNaive) + " one viewport at a time), " +
+    ar_intToString(int(_usec)) + " usec.\n";
+}
@@ -0,0 +1,65 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_VIEWPORT_CULL_H
+#define AR_VIEWPORT_CULL_H
+
+#include "arDatabaseNode.h"
+#include "arRay.h"
+#include "arGraphicsCalling.h"
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// View-frustum culling for all of a window's viewports (and eyes) at
+// once, so each viewport's draw looks up visibility instead of testing.
+//
+// A bounding sphere is first tested against the union of the frusta
+// (each plane of the first frustum, pushed out to contain every frustum's
+// corners).  Only spheres inside the union are tested per viewport.
+// A sphere entirely inside a viewport's frustum skips that viewport's
+// tests for the spheres below it.  Spheres are tested in world space,
+// with radius scaled by the largest axis of their transform.
+// Transform nodes with automatic bounds (see arGraphicsDatabase::getBounds())
+// are tested like spheres around those bounds.
+
+class SZG_CALL arViewportCull {
+ public:
+  arViewportCull();
+
+  // One projection*modelview matrix per viewport (at most 32).
+  // If bounds, also test transform nodes' current automatic bounds.
+  void cull(arDatabaseNode* root, const vector<arMatrix4>& clip, bool bounds = false);
+  // For bounding sphere (or transform) nodeID in viewport i, 1 if visible,
+  // 0 if culled, -1 if unknown (e.g., made after the cull).
+  int visible(int nodeID, int viewport) const;
+  int getViewports() const { return int(_planes.size()); }
+
+  // From the most recent cull().
+  double getUsec() const { return _usec; }
+  int getSpheres() const { return _spheres; }
+  int getBounds() const { return _bounds; }
+  int getTests() const { return _tests; }
+  string status() const;
+
+ private:
+  enum { KNOWN = 0x80000000, MAX_VIEWPORTS = 31 };
+  vector<arFrustumPlanes> _planes;
+  arFrustumPlanes _union;
+  vector<unsigned> _masks;  // By node ID:  KNOWN, and which viewports see it.
+  bool _fBounds;
+  double _usec;
+  int _spheres;
+  int _bounds;
+  int _tests;
+
+  void _makeUnion(const vector<arMatrix4>& clip);
+  void _cull(arDatabaseNode* node, const arMatrix4& model,
+             unsigned candidates, unsigned inside);
+  void _mark(arDatabaseNode* node, unsigned mask);
+};
+
+#endif
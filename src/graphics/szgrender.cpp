@@ -84,6 +84,50 @@ void messageTask(void* pClient) {
       }
     }
 
+    else if (messageType=="state_sort") {
+      graphicsClient.setStateSorting(messageBody == "on");
+    }
+
+    else if (messageType=="instancing") {
+      graphicsClient.setInstancing(messageBody == "on");
+    }
+
+    else if (messageType=="viewport_cull") {
+      graphicsClient.setViewportCulling(messageBody == "on");
+    }
+
+    else if (messageType=="cull_stats") {
+      cli->messageResponse( messageID, graphicsClient.getCullStats() );
+    }
+
+    else if (messageType=="traversal_threads") {
+      graphicsClient.setTraversalThreads(atoi(messageBody.c_str()));
+    }
+
+    else if (messageType=="state_cache") {
+      graphicsClient.setStateCaching(messageBody != "off");
+    }
+
+    else if (messageType=="state_stats") {
+      cli->messageResponse( messageID, graphicsClient.getStateStats() );
+    }
+
+    else if (messageType=="snapshot_stats") {
+      cli->messageResponse( messageID, graphicsClient.getSnapshotStats() );
+    }
+
+    else if (messageType=="draw_times") {
+      cli->messageResponse( messageID, graphicsClient.getDrawTimes() );
+    }
+
+    else if (messageType=="asset_stats") {
+      cli->messageResponse( messageID, ar_assetCache().status() );
+    }
+
+    else if (messageType=="asset_flush") {
+      ar_assetCache().flush();
+    }
+
     else if (messageType=="delay") {
       framerateThrottle = messageBody=="on";
     }
@@ -0,0 +1,127 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+// Test data queue compression (arCompress.h) without a szgserver.
+// A mesh-like buffer must survive a round trip, and truncated input
+// must fail.  Then the same queue goes over loopback raw and
+// compressed, and a server-to-server link must stay raw.
+//
+// Usage: CompressTest
+
+#include "arPrecompiled.h"
+#define SZG_DO_NOT_EXPORT
+
+#include "arDataTemplate.h"
+#include "arTemplateDictionary.h"
+#include "arStructuredData.h"
+#include "arDataServer.h"
+#include "arDataClient.h"
+#include "arQueuedData.h"
+#include "arCompress.h"
+#include "arLogStream.h"
+
+#include <string.h>
+
+static arDataServer* server = NULL;
+
+static void acceptClient(void*) {
+  (void)server->acceptConnection();
+}
+
+int main() {
+  // Something like a mesh that's streamed each frame:  runs of
+  // repeated values, with some noise.
+  const int n = 1000000;
+  vector<ARchar> raw(n);
+  int i;
+  for (i=0; i<n; ++i)
+    raw[i] = ARchar((i/64) % 7 + (i % 13 == 0 ? i : 0));
+  vector<ARchar> z(ar_compressBound(n));
+  vector<ARchar> back(n);
+  ar_timeval time1 = ar_time();
+  const int zSize = ar_compress(&raw[0], n, &z[0], int(z.size()));
+  const double usecCompress = ar_difftime(ar_time(), time1);
+  time1 = ar_time();
+  const int backSize = ar_uncompress(&z[0], zSize, &back[0], n);
+  const double usecUncompress = ar_difftime(ar_time(), time1);
+  if (zSize <= 0 || backSize != n || memcmp(&raw[0], &back[0], n)) {
+    ar_log_error() << "CompressTest: round trip failed.\n";
+    return 1;
+  }
+  cout << "CompressTest: compressed " << n << " bytes to " << zSize << " at "
+       << n/usecCompress << " MB/s, uncompressed at "
+       << n/usecUncompress << " MB/s.\n";
+  if (ar_uncompress(&z[0], zSize-1, &back[0], n) == n ||
+      ar_uncompress(&z[0], zSize, &back[0], n-1) >= 0) {
+    ar_log_error() << "CompressTest: truncated data uncompressed.\n";
+    return 1;
+  }
+
+  // Send the same queue raw and compressed over loopback.
+  arTemplateDictionary dictionary;
+  arDataTemplate meshTemplate("mesh");
+  const int MESH_ID = meshTemplate.add("positions", AR_CHAR);
+  dictionary.add(&meshTemplate);
+  arStructuredData mesh(&meshTemplate);
+  arQueuedData queue;
+  for (i=0; i<8; ++i) {
+    (void)mesh.dataIn(MESH_ID, &raw[i*(n/8)], AR_CHAR, n/8);
+    queue.forceQueueData(&mesh);
+  }
+  queue.swapBuffers();
+
+  server = new arDataServer(1000);
+  if (!server->setPort(4620) || !server->beginListening(&dictionary)) {
+    ar_log_error() << "CompressTest: no loopback server on port 4620.\n";
+    return 1;
+  }
+  arThread acceptThread(acceptClient);
+  arDataClient client("CompressTest");
+  if (!client.dialUp("127.0.0.1", 4620)) {
+    ar_log_error() << "CompressTest: no loopback connection.\n";
+    return 1;
+  }
+  while (server->getNumberConnected() < 1)
+    ar_usleep(10000);
+
+  int destSize = 1000;
+  ARchar* dest = new ARchar[destSize];
+  for (int threshold=0; threshold<=1000; threshold+=1000) {
+    server->setCompressThreshold(threshold);
+    time1 = ar_time();
+    for (int s=0; s<20; s++) {
+      if (!server->sendDataQueue(&queue) ||
+          !client.getDataQueue(dest, destSize) ||
+          memcmp(dest, queue.getFrontBufferRaw(), queue.getFrontBufferSize())) {
+        ar_log_error() << "CompressTest: loopback queue " << s << " failed.\n";
+        return 1;
+      }
+    }
+    cout << "CompressTest: " << ar_difftime(ar_time(), time1)/20000.0
+         << " msec per " << queue.getFrontBufferSize() << "-byte queue, "
+         << (threshold ? "compressed" : "uncompressed") << ".\n";
+  }
+  cout << server->compressionStatus() << client.compressionStatus();
+
+  // arDataServer's read threads parse records, not compressed queues,
+  // so a server-to-server link (as arGraphicsPeer makes) must stay raw.
+  arDataServer relay(1000);
+  arThread acceptRelayThread(acceptClient);
+  if (relay.dialUpFallThrough("127.0.0.1", 4620) < 0) {
+    ar_log_error() << "CompressTest: no loopback server-to-server connection.\n";
+    return 1;
+  }
+  while (server->getNumberConnected() < 2)
+    ar_usleep(10000);
+  if (server->getNumberUncompressing() != 1 ||
+      relay.getNumberUncompressing() != 0) {
+    ar_log_error() << "CompressTest: arDataServer advertised compression.\n";
+    return 1;
+  }
+  client.closeConnection();
+  delete [] dest;
+  cout << "CompressTest passed.\n";
+  return 0;
+}
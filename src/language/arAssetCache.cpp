@@ -0,0 +1,218 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arAssetCache.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+
+#include <sys/stat.h>
+#include <stdio.h>
+#include <sstream>
+
+arAssetCache::arAssetCache(int maxBytes) :
+  _lock("ASSETCACHE"),
+  _bytes(0),
+  _maxBytes(maxBytes),
+  _hits(0),
+  _misses(0),
+  _evictions(0) {
+}
+
+arAssetCache::~arAssetCache() {
+  // Don't delete the assets:  at exit, their graphics contexts
+  // or sound system may already be gone.
+  for (list<Entry*>::iterator i = _lru.begin(); i != _lru.end(); ++i)
+    delete *i;
+}
+
+bool arAssetCache::_stat(const string& path, long& mtime, long& size) {
+  struct stat s;
+  if (stat(path.c_str(), &s) != 0)
+    return false;
+  mtime = long(s.st_mtime);
+  size = long(s.st_size);
+  return true;
+}
+
+arAsset* arAssetCache::acquire(const string& kind, const string& path) {
+  long mtime, size;
+  if (!_stat(path, mtime, size))
+    return NULL;
+
+  arGuard _(_lock, "arAssetCache::acquire");
+  const map<string, Entry*>::iterator i = _entries.find(kind + "|" + path);
+  if (i == _entries.end()) {
+    ++_misses;
+    return NULL;
+  }
+  Entry* e = i->second;
+  if (e->mtime != mtime || e->size != size) {
+    // Changed on disk.  Whoever holds the old one keeps it until release().
+    _entries.erase(i);
+    e->stale = true;
+    if (e->users == 0)
+      _delete(e);
+    ++_misses;
+    return NULL;
+  }
+  ++e->users;
+  _lru.splice(_lru.begin(), _lru, e->lru);
+  ++_hits;
+  return e->asset;
+}
+
+arAsset* arAssetCache::insert(const string& kind, const string& path, arAsset* asset) {
+  if (!asset)
+    return NULL;
+
+  long mtime = 0, size = 0;
+  (void)_stat(path, mtime, size);
+  const string key(kind + "|" + path);
+
+  arGuard _(_lock, "arAssetCache::insert");
+  map<string, Entry*>::iterator i = _entries.find(key);
+  if (i != _entries.end()) {
+    Entry* e = i->second;
+    if (e->mtime == mtime && e->size == size) {
+      // Another thread decoded it meanwhile.
+      delete asset;
+      ++e->users;
+      _lru.splice(_lru.begin(), _lru, e->lru);
+      return e->asset;
+    }
+    _entries.erase(i);
+    e->stale = true;
+    if (e->users == 0)
+      _delete(e);
+  }
+
+  Entry* e = new Entry;
+  e->key = key;
+  e->asset = asset;
+  e->mtime = mtime;
+  e->size = size;
+  const int bytes = asset->bytes();
+  e->bytes = bytes < 0 ? size : bytes;
+  e->users = 1;
+  e->stale = false;
+  _lru.push_front(e);
+  e->lru = _lru.begin();
+  _entries[key] = e;
+  _assets[asset] = e;
+  _bytes += e->bytes;
+  _evict();
+  return asset;
+}
+
+void arAssetCache::release(arAsset* asset) {
+  if (!asset)
+    return;
+
+  arGuard _(_lock, "arAssetCache::release");
+  const map<const arAsset*, Entry*>::iterator i = _assets.find(asset);
+  if (i == _assets.end()) {
+    ar_log_error() << "arAssetCache ignoring release of uncached asset.\n";
+    return;
+  }
+  Entry* e = i->second;
+  if (--e->users > 0)
+    return;
+  if (e->stale)
+    _delete(e);
+  else
+    _evict();
+}
+
+// Caller holds _lock.
+void arAssetCache::_delete(Entry* e) {
+  _lru.erase(e->lru);
+  _assets.erase(e->asset);
+  _bytes -= e->bytes;
+  delete e->asset;
+  delete e;
+}
+
+// Caller holds _lock.
+void arAssetCache::_evict() {
+  list<Entry*>::iterator i = _lru.end();
+  while (_bytes > _maxBytes && i != _lru.begin()) {
+    Entry* e = *--i;
+    if (e->users > 0)
+      continue;
+    // _delete() invalidates i, so step past e first.
+    ++i;
+    _entries.erase(e->key);
+    _delete(e);
+    ++_evictions;
+  }
+}
+
+void arAssetCache::setMaxBytes(int maxBytes) {
+  arGuard _(_lock, "arAssetCache::setMaxBytes");
+  _maxBytes = maxBytes;
+  _evict();
+}
+
+void arAssetCache::flush() {
+  arGuard _(_lock, "arAssetCache::flush");
+  const int maxBytes = _maxBytes;
+  _maxBytes = -1;
+  _evict();
+  _maxBytes = maxBytes;
+}
+
+string arAssetCache::status() {
+  arGuard _(_lock, "arAssetCache::status");
+  int inUse = 0;
+  for (list<Entry*>::const_iterator i = _lru.begin(); i != _lru.end(); ++i) {
+    if ((*i)->users > 0)
+      ++inUse;
+  }
+  ostringstream s;
+  s << "assets: " << _entries.size() << " cached (" << inUse << " in use), " <<
+    _bytes / 1024 << " of " << _maxBytes / 1024 << " KB;  " <<
+    _hits << " hits, " << _misses << " misses, " << _evictions << " evictions.\n";
+  return s.str();
+}
+
+int arAssetCache::prewarm(const string& files, const string& dir) {
+  const ar_timeval start = ar_time();
+  arSemicolonString names(files);
+  int cFile = 0;
+  long cByte = 0;
+  char buf[65536];
+  for (int i=0; i<names.size(); ++i) {
+    string name(names[i]);
+    if (name.empty() || name == "NULL")
+      continue;
+    if (!dir.empty() && name[0] != '/' && name[0] != '\\' &&
+        !(name.size() > 1 && name[1] == ':')) {
+      string d(dir);
+      name = ar_pathAddSlash(d) + name;
+    }
+    ar_fixPathDelimiter(name);
+    FILE* f = fopen(name.c_str(), "rb");
+    if (!f) {
+      ar_log_warning() << "arAssetCache: no file '" << name << "' to prewarm.\n";
+      continue;
+    }
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+      cByte += long(n);
+    fclose(f);
+    ++cFile;
+  }
+  if (cFile > 0) {
+    ar_log_remark() << "arAssetCache prewarmed " << cFile << " files, " <<
+      cByte / 1024 << " KB in " << ar_difftime(ar_time(), start) / 1000. << " msec.\n";
+  }
+  return cFile;
+}
+
+arAssetCache& ar_assetCache() {
+  static arAssetCache cache;
+  return cache;
+}
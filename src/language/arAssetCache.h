@@ -0,0 +1,93 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_ASSET_CACHE_H
+#define AR_ASSET_CACHE_H
+
+#include "arThread.h"
+#include "arLanguageCalling.h"
+
+#include <list>
+#include <map>
+#include <string>
+using namespace std;
+
+// Something decoded from a file (texture, font, sound), shared
+// through arAssetCache instead of decoded once per database.
+
+class SZG_CALL arAsset {
+ public:
+  virtual ~arAsset() {}
+  // Memory held, or -1 for the file's size.
+  virtual int bytes() const { return -1; }
+};
+
+// Process-wide cache of decoded files, keyed by kind (how the file was
+// decoded, e.g. "texture/alpha=-1") and resolved path.  A file whose
+// mtime or size changes is decoded afresh.
+//
+// Each acquire() or insert() must be matched by a release().  Released
+// assets stay cached until the cache exceeds its budget, and then the
+// least recently used are deleted first.  Assets in use are never deleted.
+
+class SZG_CALL arAssetCache {
+ public:
+  arAssetCache(int maxBytes = 256 << 20);
+  ~arAssetCache();
+
+  // NULL if not cached, or stale.
+  arAsset* acquire(const string& kind, const string& path);
+  // Takes ownership of asset.  If another thread cached the same file
+  // meanwhile, deletes asset and returns that one instead.
+  arAsset* insert(const string& kind, const string& path, arAsset* asset);
+  void release(arAsset* asset);
+
+  void setMaxBytes(int maxBytes);
+  int getMaxBytes() const { return _maxBytes; }
+  // Delete every unused asset.
+  void flush();
+
+  long getHits() const { return _hits; }
+  long getMisses() const { return _misses; }
+  long getEvictions() const { return _evictions; }
+  long getBytes() const { return _bytes; }
+  string status();
+
+  // Read files (semicolon-separated, relative ones in dir) so the
+  // OS has them cached, e.g. szgd before launching an app.
+  // Returns how many were read.
+  static int prewarm(const string& files, const string& dir = "");
+
+ private:
+  struct Entry {
+    string key;
+    arAsset* asset;
+    long mtime;
+    long size;
+    long bytes;
+    int users;
+    bool stale;           // replaced by a newer decoding
+    list<Entry*>::iterator lru;
+  };
+
+  arLock _lock;
+  map<string, Entry*> _entries;
+  map<const arAsset*, Entry*> _assets;
+  list<Entry*> _lru;      // most recently used first
+  long _bytes;
+  int _maxBytes;
+  long _hits;
+  long _misses;
+  long _evictions;
+
+  static bool _stat(const string& path, long& mtime, long& size);
+  void _delete(Entry*);
+  void _evict();
+};
+
+// The one cache shared by every database in this process.
+SZG_CALL arAssetCache& ar_assetCache();
+
+#endif
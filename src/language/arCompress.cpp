@@ -0,0 +1,184 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arCompress.h"
+
+#include <string.h>
+#include <vector>
+using namespace std;
+
+// Each sequence is a token byte (4 bits of literal count, 4 bits of
+// match length minus 4), more count bytes if a nibble is 15,
+// the literals, a 2-byte little-endian match offset, and more match
+// length bytes.  The last sequence has only literals.
+
+namespace {
+
+typedef unsigned char byte;
+
+const int MIN_MATCH = 4;
+const int LAST_LITERALS = 5;  // The last bytes are always literals,
+const int MATCH_LIMIT = 12;   // and no match starts this near the end.
+const int MAX_OFFSET = 65535;
+const int HASH_BITS = 14;
+
+inline unsigned read32(const byte* p) {
+  unsigned v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+inline unsigned hash4(const byte* p) {
+  return (read32(p) * 2654435761U) >> (32 - HASH_BITS);
+}
+
+inline byte* putCount(byte* out, int n) {
+  for (; n >= 255; n -= 255)
+    *out++ = 255;
+  *out++ = byte(n);
+  return out;
+}
+
+byte* putSequence(byte* out, const byte* literals, int numLiterals,
+                  int offset, int matchLength) {
+  byte* token = out++;
+  *token = byte((numLiterals >= 15 ? 15 : numLiterals) << 4);
+  if (numLiterals >= 15)
+    out = putCount(out, numLiterals - 15);
+  memcpy(out, literals, numLiterals);
+  out += numLiterals;
+  if (matchLength < MIN_MATCH)
+    return out;
+
+  *out++ = byte(offset & 0xff);
+  *out++ = byte(offset >> 8);
+  const int m = matchLength - MIN_MATCH;
+  *token |= byte(m >= 15 ? 15 : m);
+  if (m >= 15)
+    out = putCount(out, m - 15);
+  return out;
+}
+
+// Read an extended count.  False if it runs off the input or past limit.
+inline bool getCount(const byte*& in, const byte* inEnd, int& n, int limit) {
+  byte b;
+  do {
+    if (in >= inEnd)
+      return false;
+    b = *in++;
+    n += b;
+    if (n > limit)
+      return false;
+  } while (b == 255);
+  return true;
+}
+
+}
+
+int ar_compressBound(int srcSize) {
+  return srcSize + srcSize/255 + 16;
+}
+
+int ar_compress(const ARchar* src, int srcSize, ARchar* dst, int dstSize) {
+  if (srcSize < 0 || dstSize < ar_compressBound(srcSize))
+    return 0;
+
+  const byte* const in = (const byte*)src;
+  const byte* const inEnd = in + srcSize;
+  byte* out = (byte*)dst;
+  const byte* anchor = in;
+
+  if (srcSize > MATCH_LIMIT) {
+    const byte* const matchEnd = inEnd - LAST_LITERALS;
+    const byte* const startLimit = inEnd - MATCH_LIMIT;
+    vector<int> table(1 << HASH_BITS, -1);
+    const byte* ip = in;
+    while (ip < startLimit) {
+      const unsigned h = hash4(ip);
+      const int prev = table[h];
+      table[h] = int(ip - in);
+      if (prev < 0 || ip - (in + prev) > MAX_OFFSET ||
+          read32(in + prev) != read32(ip)) {
+        // Skip faster through incompressible stretches.
+        ip += 1 + ((ip - anchor) >> 6);
+        continue;
+      }
+
+      const byte* ref = in + prev;
+      while (ip > anchor && ref > in && ip[-1] == ref[-1]) {
+        --ip;
+        --ref;
+      }
+      const byte* end = ip + MIN_MATCH;
+      const byte* refEnd = ref + MIN_MATCH;
+      while (end < matchEnd && *end == *refEnd) {
+        ++end;
+        ++refEnd;
+      }
+
+      out = putSequence(out, anchor, int(ip - anchor),
+                        int(ip - ref), int(end - ip));
+      ip = anchor = end;
+      if (ip < startLimit)
+        table[hash4(ip - 2)] = int(ip - 2 - in);
+    }
+  }
+
+  out = putSequence(out, anchor, int(inEnd - anchor), 0, 0);
+  return int((ARchar*)out - dst);
+}
+
+int ar_uncompress(const ARchar* src, int srcSize, ARchar* dst, int dstSize) {
+  if (srcSize <= 0 || dstSize < 0)
+    return -1;
+
+  const byte* in = (const byte*)src;
+  const byte* const inEnd = in + srcSize;
+  byte* const outStart = (byte*)dst;
+  byte* out = outStart;
+  byte* const outEnd = out + dstSize;
+
+  while (true) {
+    const byte token = *in++;
+    int numLiterals = token >> 4;
+    if (numLiterals == 15 && !getCount(in, inEnd, numLiterals, dstSize))
+      return -1;
+    if (numLiterals > inEnd - in || numLiterals > outEnd - out)
+      return -1;
+    memcpy(out, in, numLiterals);
+    in += numLiterals;
+    out += numLiterals;
+    if (in == inEnd)
+      break;
+
+    if (inEnd - in < 2)
+      return -1;
+    const int offset = in[0] | (in[1] << 8);
+    in += 2;
+    if (offset == 0 || offset > out - outStart)
+      return -1;
+    int matchLength = token & 15;
+    if (matchLength == 15 && !getCount(in, inEnd, matchLength, dstSize))
+      return -1;
+    matchLength += MIN_MATCH;
+    if (matchLength > outEnd - out)
+      return -1;
+
+    const byte* ref = out - offset;
+    if (offset >= matchLength) {
+      memcpy(out, ref, matchLength);
+      out += matchLength;
+    }
+    else {
+      // Overlapping copy repeats the last offset bytes.
+      while (matchLength-- > 0)
+        *out++ = *ref++;
+    }
+    if (in >= inEnd)
+      return -1; // Every stream ends with literals.
+  }
+  return int(out - outStart);
+}
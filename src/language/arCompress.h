@@ -0,0 +1,35 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_COMPRESS_H
+#define AR_COMPRESS_H
+
+#include "arDataType.h"
+#include "arLanguageCalling.h"
+
+// Fast byte-oriented LZ77 compression (in the style of LZ4),
+// for large arQueuedData buffers and initial database dumps.
+// Trades ratio for speed:  it should outrun a gigabit link.
+
+// Codecs a data point may advertise in its arStreamConfig.
+SZG_CALL enum {
+  AR_COMPRESS_NONE = 0,
+  AR_COMPRESS_LZ
+};
+
+// Largest possible output of ar_compress() for srcSize bytes.
+SZG_CALL int ar_compressBound(int srcSize);
+
+// Return the compressed size, or 0 if dst is smaller than
+// ar_compressBound(srcSize).
+SZG_CALL int ar_compress(const ARchar* src, int srcSize,
+                         ARchar* dst, int dstSize);
+
+// Return the uncompressed size, or -1 if src is corrupt or
+// would overflow dst.
+SZG_CALL int ar_uncompress(const ARchar* src, int srcSize,
+                           ARchar* dst, int dstSize);
+
+#endif
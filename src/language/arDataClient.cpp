@@ -14,7 +14,11 @@ arDataClient::arDataClient(const string& exeName) :
   _theDictionary(NULL),
   _socket(NULL),
   _activeConnection(false), // disable closeConnection if there is no active connection
-  _lockSend("DCLIENT_SEND")
+  _lockSend("DCLIENT_SEND"),
+  _uncompressBuffer(NULL),
+  _uncompressBufferSize(0),
+  _queuesUncompressed(0),
+  _usecUncompressing(0.)
 {
   setLabel(exeName);
 }
@@ -26,6 +30,7 @@ arDataClient::~arDataClient() {
   if (_socket) {
     delete _socket;
   }
+  delete [] _uncompressBuffer;
 }
 
 void arDataClient::setLabel(const string& exeName) {
@@ -73,11 +78,20 @@ bool arDataClient::getData(ARchar*& dest, int& availableSize) {
 // @param availableSize Size of "dest"
 bool arDataClient::getDataQueue(ARchar*& dest, int& availableSize) {
   bool fEndianMode = false;
-  if (!getDataCore(dest, availableSize, fEndianMode,
+  ARint size = -1;
+  if (!getDataCore(dest, availableSize, size, fEndianMode,
                    _socket, _remoteStreamConfig)) {
     return false;
   }
 
+  ARchar*& raw = fEndianMode ? dest : _translationBuffer;
+  if (ar_translateInt(raw + AR_INT_SIZE, _remoteStreamConfig) == AR_COMPRESSED_QUEUE) {
+    if (!_uncompressQueue(raw, fEndianMode ? availableSize : _translationBufferSize, size))
+      return false;
+    if (!fEndianMode && !ar_growBuffer(dest, availableSize, size))
+      return false;
+  }
+
   if (fEndianMode)
     return true;
 
@@ -100,6 +114,40 @@ bool arDataClient::getDataQueue(ARchar*& dest, int& availableSize) {
   return true;
 }
 
+// Replace a compressed queue in buf (and its size) with the original,
+// still in the remote data point's binary format.
+bool arDataClient::_uncompressQueue(ARchar*& buf, int& bufSize, ARint& size) {
+  const int header = 3 * AR_INT_SIZE;
+  const ARint rawSize = ar_translateInt(buf + 2*AR_INT_SIZE, _remoteStreamConfig);
+  if (size < header || rawSize < 2*AR_INT_SIZE ||
+      !ar_growBuffer(_uncompressBuffer, _uncompressBufferSize, rawSize))
+    return false;
+
+  const ar_timeval start = ar_time();
+  if (ar_uncompress(buf + header, size - header,
+                    _uncompressBuffer, rawSize) != rawSize) {
+    ar_log_error() << _exeName << ": corrupt compressed data queue.\n";
+    return false;
+  }
+  _usecUncompressing += ar_difftime(ar_time(), start);
+  ++_queuesUncompressed;
+  size = rawSize;
+
+  // Swap buffers instead of copying.
+  ARchar* temp = buf;
+  buf = _uncompressBuffer;
+  _uncompressBuffer = temp;
+  const int tempSize = bufSize;
+  bufSize = _uncompressBufferSize;
+  _uncompressBufferSize = tempSize;
+  return true;
+}
+
+string arDataClient::compressionStatus() const {
+  return "uncompressed " + ar_intToString(_queuesUncompressed) + " queues in " +
+    ar_intToString(int(_usecUncompressing / 1000.)) + " msec.\n";
+}
+
 // When two peers connect, they exchange configuration information,
 // so that each can translate the other's binary data format.
 bool arDataClient::_dialUpActivate() {
@@ -110,6 +158,7 @@ bool arDataClient::_dialUpActivate() {
 
   // Only one socket in this data point.
   localConfig.ID = 0;
+  localConfig.compression = AR_COMPRESS_LZ;
 
   // Now, the handshaking looks like so:
   //   a. server sends config, waits for remote config.
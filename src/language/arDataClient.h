@@ -28,6 +28,7 @@ class SZG_CALL arDataClient : public arDataPoint {
    void closeConnection();
    bool getData(ARchar*&, int&); // 1st arg will be grown to fit, if needed.
    bool getDataQueue(ARchar*&, int&); // 1st arg grown to fit, if needed.
+   string compressionStatus() const; // Uncompressed queues and time.
    arTemplateDictionary* getDictionary();
 
    bool sendData(arStructuredData*);
@@ -57,6 +58,12 @@ class SZG_CALL arDataClient : public arDataPoint {
    bool _dialUpConnect(const char*, int);
    bool _dialUpActivate();
    bool _translateID(ARchar* buf, ARchar* dest, int& size);
+
+   ARchar* _uncompressBuffer;
+   int _uncompressBufferSize;
+   long _queuesUncompressed;
+   double _usecUncompressing;
+   bool _uncompressQueue(ARchar*& buf, int& bufSize, ARint& size);
 };
 
 #endif
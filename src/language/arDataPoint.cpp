@@ -134,6 +134,7 @@ bool arDataPoint::setReceiveBufferSize(arSocket* socket) {
 }
 
 arStreamConfig& arDataPoint::_handshakeReceive(arStreamConfig& config, arSocket* fd) {
+  config.compression = AR_COMPRESS_NONE;
   // Receive stuff from the other side.
   const string keys = _remoteConfigString(fd);
   if (keys == "NULL") {
@@ -216,6 +217,7 @@ string arDataPoint::_constructConfigString(const arStreamConfig& config) {
     string(config.endian == AR_LITTLE_ENDIAN ? "little" : "big") +
     " version=" + ar_intToString(SZG_VERSION_NUMBER) +
     " ID=" + ar_intToString(config.ID) +
+    " compress=" + ar_intToString(config.compression) +
     "</keys> </config>";
 }
 
@@ -297,5 +299,13 @@ void arDataPoint::_fillConfig(arStreamConfig& config, const string& text) {
     return;
   }
 
+  // Which codec the remote connection can uncompress.
+  // Older peers omit this key, so they get only uncompressed data.
+  iter = table.find("compress");
+  if (iter != table.end() &&
+      !ar_stringToIntValid(iter->second, config.compression)) {
+    config.compression = AR_COMPRESS_NONE;
+  }
+
   config.valid = true;
 }
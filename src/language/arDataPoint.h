@@ -7,6 +7,7 @@
 #define AR_DATA_POINT
 
 #include "arDataUtilities.h"
+#include "arCompress.h"
 #include "arLanguageCalling.h"
 #include <map>
 using namespace std;
@@ -16,6 +17,11 @@ using namespace std;
 // Block connections to incompatible protocols.
 enum {SZG_VERSION_NUMBER = 2};
 
+// A compressed data queue is its total size, AR_COMPRESSED_QUEUE where
+// the record count would be, the uncompressed size, then ar_compress()'s
+// output.  Only sent to data points whose arStreamConfig allows it.
+enum {AR_COMPRESSED_QUEUE = -1};
+
 class SZG_CALL arDataPoint {
  private:
   int _bufferSize;
@@ -7,6 +7,8 @@
 #include "arDataServer.h"
 #include "arLogStream.h"
 
+#include <sstream>
+
 // Allocating the listening socket in the constructor may prevent
 // arDataServer from being declared as a global in win32.  Sigh.
 arDataServer::arDataServer(int dataBufferSize) :
@@ -25,7 +27,15 @@ arDataServer::arDataServer(int dataBufferSize) :
   _consumerObject(NULL),
   _disconnectCallback(NULL),
   _disconnectObject(NULL),
-  _atomicReceive(true)
+  _atomicReceive(true),
+  _compressThreshold(0),
+  _compressBuffer(NULL),
+  _compressBufferSize(0),
+  _compressedSize(0),
+  _queuesCompressed(0),
+  _bytesUncompressed(0.),
+  _bytesCompressed(0.),
+  _usecCompressing(0.)
 {
 }
 
@@ -44,6 +54,7 @@ arDataServer::~arDataServer() {
   if (_numberConnected > 0)
     ar_log_error() << "arDataServer destructor confused.\n";
   delete _listeningSocket;
+  delete [] _compressBuffer;
 }
 
 void ar_readDataThread(void* dataServer) {
@@ -238,6 +249,7 @@ arSocket* arDataServer::_acceptConnection(bool addToActive) {
 
   arGuard _(_lockTransfer, "arDataServer::_acceptConnection");
   _addSocketToDatabase(sockNew);
+  _connectionAddresses[sockNew->getID()] = addr.getRepresentation();
   if (!sockNew->smallPacketOptimize(_smallPacketOptimize)) {
     ar_log_error() << "arDataServer failed to smallPacketOptimize.\n";
 LAbort:
@@ -258,6 +270,8 @@ LAbort:
   arStreamConfig localConfig;
   localConfig.endian = AR_ENDIAN_MODE; // todo: do this line in arStreamConfig's constructor.
   localConfig.ID = sockNew->getID();
+  // _readDataTask() reads records, not (compressed) queues.
+  localConfig.compression = AR_COMPRESS_NONE;
   arStreamConfig remoteStreamConfig = handshakeConnectTo(sockNew, localConfig);
   if (!remoteStreamConfig.valid) {
     string sSymptom;
@@ -396,7 +410,100 @@ bool arDataServer::sendData(arStructuredData* pData) {
 
 bool arDataServer::sendDataQueue(arQueuedData* pData) {
   arGuard _(_lockTransfer, "arDataServer::sendDataQueue");
-  return _sendDataCore(pData->getFrontBufferRaw(), pData->getFrontBufferSize());
+  const ARchar* theBuffer = pData->getFrontBufferRaw();
+  const int theSize = pData->getFrontBufferSize();
+  _compressQueue(theBuffer, theSize);
+  if (_compressedSize == 0)
+    return _sendDataCore(theBuffer, theSize);
+
+  bool ok = false;
+  list<arSocket*> removalList;
+  list<arSocket*>::iterator iter;
+  for (iter = _connectionSockets.begin(); iter != _connectionSockets.end(); ++iter) {
+    if (_sendQueueCore(theBuffer, theSize, *iter))
+      ok = true;
+    else
+      removalList.push_back(*iter);
+  }
+  for (iter = removalList.begin(); iter != removalList.end(); ++iter)
+    _deleteSocketFromDatabase(*iter);
+  return ok;
+}
+
+// Call this only inside _lockTransfer.
+// Compress a queue into _compressBuffer, if it's worth it.
+void arDataServer::_compressQueue(const ARchar* theBuffer, const int theSize) {
+  _compressedSize = 0;
+  if (_compressThreshold <= 0 || theSize < _compressThreshold)
+    return;
+
+  const int header = 3 * AR_INT_SIZE;
+  if (!ar_growBuffer(_compressBuffer, _compressBufferSize,
+                     header + ar_compressBound(theSize)))
+    return;
+
+  const ar_timeval start = ar_time();
+  const int n = ar_compress(theBuffer, theSize, _compressBuffer + header,
+                            _compressBufferSize - header);
+  _usecCompressing += ar_difftime(ar_time(), start);
+  if (n <= 0 || header + n >= theSize) {
+    // Incompressible.
+    return;
+  }
+
+  _compressedSize = header + n;
+  const ARint marker = AR_COMPRESSED_QUEUE;
+  ar_packData(_compressBuffer, &_compressedSize, AR_INT, 1);
+  ar_packData(_compressBuffer + AR_INT_SIZE, &marker, AR_INT, 1);
+  ar_packData(_compressBuffer + 2*AR_INT_SIZE, &theSize, AR_INT, 1);
+  ++_queuesCompressed;
+  _bytesUncompressed += theSize;
+  _bytesCompressed += _compressedSize;
+}
+
+// Call this only inside _lockTransfer, after _compressQueue().
+bool arDataServer::_sendQueueCore(const ARchar* theBuffer, const int theSize, arSocket* fd) {
+  if (_compressedSize > 0) {
+    const map<int, arStreamConfig, less<int> >::const_iterator
+      iter(_connectionConfigs.find(fd->getID()));
+    if (iter != _connectionConfigs.end() &&
+        iter->second.compression == AR_COMPRESS_LZ)
+      return fd->ar_safeWrite(_compressBuffer, _compressedSize);
+  }
+  return fd->ar_safeWrite(theBuffer, theSize);
+}
+
+string arDataServer::compressionStatus() {
+  arGuard _(_lockTransfer, "arDataServer::compressionStatus");
+  if (_compressThreshold <= 0)
+    return "compression: off.\n";
+
+  ostringstream s;
+  s << "compression: " << _queuesCompressed << " queues of "
+    << _compressThreshold << "+ bytes";
+  if (_queuesCompressed > 0) {
+    s << ", ratio " << _bytesUncompressed / _bytesCompressed
+      << ", " << _bytesUncompressed / _usecCompressing << " MB/s";
+  }
+  s << ", to " << _numberUncompressingNoLock() << " of "
+    << _connectionConfigs.size() << " connections.\n";
+  return s.str();
+}
+
+int arDataServer::getNumberUncompressing() {
+  arGuard _(_lockTransfer, "arDataServer::getNumberUncompressing");
+  return _numberUncompressingNoLock();
+}
+
+// Call this only inside _lockTransfer.
+int arDataServer::_numberUncompressingNoLock() const {
+  int n = 0;
+  for (map<int, arStreamConfig, less<int> >::const_iterator
+       iter(_connectionConfigs.begin()); iter != _connectionConfigs.end(); ++iter) {
+    if (iter->second.compression == AR_COMPRESS_LZ)
+      ++n;
+  }
+  return n;
 }
 
 // Send data in a different thread from where we accept connections.
@@ -448,7 +555,20 @@ bool arDataServer::sendDataQueue(arQueuedData* p, arSocket* fd) {
     return false;
   }
   arGuard _(_lockTransfer, "arDataServer::sendDataQueue fd");
-  return _sendDataCore(p->getFrontBufferRaw(), p->getFrontBufferSize(), fd);
+  const ARchar* theBuffer = p->getFrontBufferRaw();
+  const int theSize = p->getFrontBufferSize();
+  _compressQueue(theBuffer, theSize);
+  if (_sendQueueCore(theBuffer, theSize, fd))
+    return true;
+  ar_log_error() << "arDataServer failed to send data to specific socket.\n";
+  _deleteSocketFromDatabase(fd);
+  return false;
+}
+
+bool arDataServer::sendPacked(const ARchar* theBuffer, int theSize, int socketID) {
+  arGuard _(_lockTransfer, "arDataServer::sendPacked");
+  arSocket* fd = getConnectedSocketNoLock(socketID);
+  return fd && _sendDataCore(theBuffer, theSize, fd);
 }
 
 // Call this only inside _lockTransfer.
@@ -468,8 +588,9 @@ bool arDataServer::sendDataQueue(arQueuedData* theData, list<arSocket*>* socketL
   ARchar* theBuffer = theData->getFrontBufferRaw();
   list<arSocket*>::iterator i;
   arGuard _(_lockTransfer, "arDataServer::sendDataQueue socketList");
+  _compressQueue(theBuffer, theSize);
   for (i = socketList->begin(); i != socketList->end(); ++i) {
-    if ((*i)->ar_safeWrite(theBuffer, theSize)) {
+    if (_sendQueueCore(theBuffer, theSize, *i)) {
       ok = true;
     }
     else{
@@ -551,6 +672,12 @@ string arDataServer::getSocketLabel(int theSocketID) {
   return i==_connectionLabels.end() ? string("NULL") : i->second;
 }
 
+string arDataServer::getSocketAddress(int theSocketID) {
+  arGuard _(_lockTransfer, "arDataServer::getSocketAddress");
+  map<int, string, less<int> >::const_iterator i(_connectionAddresses.find(theSocketID));
+  return i==_connectionAddresses.end() ? string("NULL") : i->second;
+}
+
 int arDataServer::getFirstIDWithLabel(const string& theSocketLabel) {
   arGuard _(_lockTransfer, "arDataServer::getFirstIDWithLabel");
   for (map<int, string, less<int> >::const_iterator i = _connectionLabels.begin();
@@ -627,6 +754,7 @@ void arDataServer::_deleteSocketFromDatabase(arSocket* theSocket) {
   // Delete the socket from the label table.
   if (!_delSocketLabel(theSocket))
     ar_log_error() << "arDataServer: inconsistent internal socket databases.\n";
+  _connectionAddresses.erase(theSocket->getID());
 
   // Remove the socket*.
   for (list<arSocket*>::iterator removalIterator(_connectionSockets.begin());
@@ -695,6 +823,7 @@ int arDataServer::dialUpFallThrough(const string& s, int port) {
   // BUG: localConfig.ID here is NOT the socket ID... but the arDataServer doesn't
   // use it yet.  This breaks symmetry, but no code depends on it yet.
   localConfig.ID = 0;
+  localConfig.compression = AR_COMPRESS_NONE;
   arStreamConfig remoteStreamConfig = handshakeReceiveConnection(socket, localConfig);
   if (!remoteStreamConfig.valid) {
     if (remoteStreamConfig.refused) {
@@ -64,10 +64,24 @@ class SZG_CALL arDataServer : public arDataPoint {
    bool sendData(arStructuredData*, arSocket*);
    bool sendDataNoLock(arStructuredData*, arSocket*);
    bool sendDataQueue(arQueuedData*, arSocket*);
+   // Records already packed back to back, in one write.
+   // The socket is named by ID, since it may have gone away.
+   bool sendPacked(const ARchar*, int size, int socketID);
 
    // Send data to a group of someone's in particular.
    bool sendDataQueue(arQueuedData*, list<arSocket*>*);
 
+   // Compress queues of at least this many bytes, for connections
+   // that can uncompress them.  0 (the default) never compresses.
+   void setCompressThreshold(int bytes)
+     { _compressThreshold = bytes; }
+   int getCompressThreshold() const
+     { return _compressThreshold; }
+   // Compression ratio and time so far.
+   string compressionStatus();
+   // Connections that get compressed queues (arDataClients, not arDataServers).
+   int getNumberUncompressing();
+
    // NOTE: setConsumerCallback calls setConsume(true)
    // subclasses that override onConsume() will need to
    // explicitly call this.
@@ -93,6 +107,8 @@ class SZG_CALL arDataServer : public arDataPoint {
    arSocket* getConnectedSocketNoLock(int theSocketID);
    void setSocketLabel(arSocket* theSocket, const string& theLabel);
    string getSocketLabel(int theSocketID);
+   // Remote IP:port of a connection, as seen when it was accepted.
+   string getSocketAddress(int theSocketID);
    int getFirstIDWithLabel(const string& theSocketLabel);
 
    // Accept connections.
@@ -114,6 +130,7 @@ class SZG_CALL arDataServer : public arDataPoint {
    int _nextID;  // The next socket will get this ID.
    map<int, string, less<int> >         _connectionLabels;  // all communications points have
                                                           // a text label.
+   map<int, string, less<int> >         _connectionAddresses; // remote IP:port
    map<int, arSocket*, less<int> >      _connectionIDs;     // map from ID to comm point
    map<int, arStreamConfig, less<int> > _connectionConfigs; // remote stream's binary data format
 
@@ -151,6 +168,19 @@ class SZG_CALL arDataServer : public arDataPoint {
 
    list<string>    _acceptMask;
 
+   // Compressing queues, guarded by _lockTransfer.
+   int _compressThreshold;
+   ARchar* _compressBuffer;
+   int _compressBufferSize;
+   int _compressedSize; // of the queue being sent, or 0 if sent raw
+   long _queuesCompressed;
+   double _bytesUncompressed;
+   double _bytesCompressed;
+   double _usecCompressing;
+   void _compressQueue(const ARchar* theBuffer, const int theSize);
+   int _numberUncompressingNoLock() const;
+   bool _sendQueueCore(const ARchar* theBuffer, const int theSize, arSocket* fd);
+
    void _readDataTask();
    // To a specific socket.
    bool _sendDataCore(const ARchar* theBuffer, const int theSize, arSocket* fd);
@@ -6,6 +6,7 @@
 #include "arPrecompiled.h"
 #include "arDataUtilities.h"
 #include "arDatabaseNode.h" // for ar_refNodeList, etc.
+#include "arCompress.h"
 #include "arLogStream.h"
 
 #include <string>
@@ -323,6 +324,7 @@ ARint ar_rawDataGetFields(ARchar* data) {
 arStreamConfig ar_getLocalStreamConfig() {
   arStreamConfig config;
   config.endian = AR_ENDIAN_MODE;
+  config.compression = AR_COMPRESS_LZ;
   // Bug: the other fields are uninitialized garbage. Should arStreamConfig be a class not a struct, with a proper constructor?
   return config;
 }
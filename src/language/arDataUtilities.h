@@ -114,6 +114,7 @@ struct SZG_CALL arStreamConfig{
   int  ID;
   bool valid; // For a success/failure return value.
   bool refused; // If true, the other end rejected our connection attempt.
+  int  compression; // Codec the data point can uncompress (arCompress.h).
 };
 
 #if defined(AR_BIG_ENDIAN)
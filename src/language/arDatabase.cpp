@@ -11,6 +11,10 @@
 arDatabase::arDatabase() :
   _lang(NULL),
   _dbLock("DATABASE"),
+  _dbDepth(0),
+  _readerLock("DATABASE-readers"),
+  _readersVar("DATABASE-readers"),
+  _readers(0),
   _typeCode(AR_GENERIC_DATABASE),
   _typeString("generic"),
   _server(false),
@@ -456,6 +460,46 @@ bool arDatabase::handleDataQueue(ARchar* theData) {
   return true;
 }
 
+void arDatabase::_lock(const char* name) {
+  _dbLock.lock(name);
+  if (++_dbDepth > 1)
+    return;
+  // Readers can leave, but none can enter, while we hold _dbLock.
+  arGuard _(_readerLock, "arDatabase::_lock");
+  while (_readers > 0)
+    _readersVar.wait(_readerLock);
+}
+
+void arDatabase::_unlock() {
+  --_dbDepth;
+  _dbLock.unlock();
+}
+
+void arDatabase::_lockShared(const char* name) {
+  arGuard _(_dbLock, name);
+  arGuard __(_readerLock, "arDatabase::_lockShared");
+  ++_readers;
+}
+
+void arDatabase::_unlockShared() {
+  arGuard _(_readerLock, "arDatabase::_unlockShared");
+  if (--_readers == 0)
+    _readersVar.signal();
+}
+
+bool arDatabase::alterBatch(ARchar* theData) {
+  arGuard _(_dbLock, "arDatabase::alterBatch");
+  return handleDataQueue(theData);
+}
+
+int arDatabase::reserveNodeIDs(int count) {
+  arGuard _(_dbLock, "arDatabase::reserveNodeIDs");
+  const int first = _nextAssignedID;
+  if (count > 0)
+    _nextAssignedID += count;
+  return first;
+}
+
 // Reads in the database in binary format.
 bool arDatabase::readDatabase(const string& fileName, const string& path) {
   FILE* sourceFile = ar_fileOpen(fileName, path, "rb", "arDatabase");
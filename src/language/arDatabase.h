@@ -93,6 +93,14 @@ class SZG_CALL arDatabase{
   virtual arDatabaseNode* alter(arStructuredData* data, bool refNode = false);
   arDatabaseNode* alterRaw(ARchar*);
   bool handleDataQueue(ARchar*);
+  // A handleDataQueue() buffer applied atomically:  other threads'
+  // alter() calls see all of it or none of it.
+  virtual bool alterBatch(ARchar*);
+
+  // Reserve count consecutive node IDs, for "make node" records that
+  // name their own IDs (e.g. from arGraphicsCommandBuffer).
+  // Returns the first ID.
+  int reserveNodeIDs(int count);
 
   virtual bool readDatabase(const string& fileName, const string& path="");
   virtual bool readDatabaseXML(const string& fileName, const string& path="");
@@ -153,12 +161,24 @@ class SZG_CALL arDatabase{
 
  private:
   arLock _dbLock;
+  int _dbDepth; // of _lock(), guarded by _dbLock
+  // Holders of _lockShared(), with _readersVar.
+  arLock _readerLock;
+  arConditionVar _readersVar;
+  int _readers;
   arDatabaseNode* _ref(arDatabaseNode*, const bool);
 
  protected:
   // Used by arGraphicsPeer, arGraphicsDatabase, etc.
-  void _lock(const char* name = NULL) { _dbLock.lock(name); }
-  void _unlock() { _dbLock.unlock(); }
+  // Exclusive (and recursive):  waits for _lockShared() holders to finish.
+  // Structure changes must be made under _lock().
+  void _lock(const char* name = NULL);
+  void _unlock();
+  // Shared, among threads that only read the tree and other state changed
+  // under _lock(), e.g. to alter the data of existing nodes (which lock
+  // themselves).  Don't nest it, and don't call _lock() while holding it.
+  void _lockShared(const char* name = NULL);
+  void _unlockShared();
 
   bool _check(arDatabaseNode* n) const
     { return n && n->active() && n->getOwner()==this; }
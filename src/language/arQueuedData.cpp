@@ -101,3 +101,23 @@ void arQueuedData::forceQueueData(arStructuredData* theData) {
   _bufferLocation += recordSize;
   _numberBufferRecords++;
 }
+
+bool arQueuedData::replaceQueuedData(int offset, arStructuredData* theData) {
+  ARchar* bufferPtr = (ARchar*) _backBuffer->getDataPtr(BUFFER, AR_CHAR);
+  if (offset < 2*AR_INT_SIZE || offset >= _bufferLocation ||
+      ar_rawDataGetSize(bufferPtr + offset) != theData->size())
+    return false;
+  theData->pack(bufferPtr + offset);
+  return true;
+}
+
+bool arQueuedData::eraseQueuedData(int offset, int size) {
+  if (offset < 2*AR_INT_SIZE || size <= 0 || offset + size > _bufferLocation)
+    return false;
+  ARchar* bufferPtr = (ARchar*) _backBuffer->getDataPtr(BUFFER, AR_CHAR);
+  memmove(bufferPtr + offset, bufferPtr + offset + size,
+          _bufferLocation - (offset + size));
+  _bufferLocation -= size;
+  _numberBufferRecords--;
+  return true;
+}
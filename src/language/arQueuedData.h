@@ -26,6 +26,13 @@ class SZG_CALL arQueuedData{
   void swapBuffers();
   void forceQueueData(arStructuredData*);
 
+  // Rewrite the back buffer, e.g. to coalesce redundant records.
+  // Offsets are as returned by getBackBufferSize() just before queueing.
+  // Overwrite a queued record with one of the same size.
+  bool replaceQueuedData(int offset, arStructuredData*);
+  // Remove a queued record, shifting later records down by its size.
+  bool eraseQueuedData(int offset, int size);
+
  private:
   arDataTemplate* _bufferTemplate;
   int BUFFER;
@@ -15,6 +15,8 @@
 #include <sys/time.h>
 #include <fcntl.h>
 #include <sys/signal.h>
+#include <sys/epoll.h>
+#include <errno.h>
 #endif
 
 #ifdef AR_USE_WIN_32
@@ -128,7 +130,18 @@ static bool nyi() {
 
 arRS232Port::arRS232Port() :
   _isOpen(false),
-  _readTimeoutTenths(10)
+  _readTimeoutTenths(10),
+  _decoder(NULL),
+  _reading(false),
+  _stopReading(false),
+  _readThreadRunning(false),
+  _ring(NULL),
+  _ringSize(0),
+  _ringStart(0),
+  _ringCount(0),
+  _bytesReceived(0),
+  _wakeups(0),
+  _bytesDropped(0)
 {
 #ifdef AR_USE_WIN_32
   _timeoutStruct.ReadIntervalTimeout = 0;
@@ -142,6 +155,7 @@ arRS232Port::arRS232Port() :
 arRS232Port::~arRS232Port() {
   if (_isOpen)
     ar_close();
+  delete [] _ring;
 }
 
 static inline bool fltcomp(float a, float b) {
@@ -153,18 +167,29 @@ bool arRS232Port::ar_open( const unsigned port, const unsigned long baud,
                       const std::string& par ) {
 #if defined( AR_USE_WIN_32 )
   const unsigned portMin = 1;
-#elif defined( AR_USE_LINUX )
-  //unused const unsigned portMin = 0;
-#else
-  return nyi();
-#endif
-
-#if defined( AR_USE_WIN_32 )
   // This check is meaningful only when portMin>0, since portMin is unsigned.
   if (port < portMin) {
     ar_log_error() << "arRS232Port: port numbers are 1-based.\n";
     return false;
   }
+  char portString[16] = "COM";
+  // Windows port #s are 1-based..
+  sprintf( portString+3, "%d", port );
+#elif defined( AR_USE_LINUX )
+  char portString[64];
+  sprintf( portString, "/dev/ttyS%d", port-1 ); // port numbers are 0-based
+#else
+  const char* portString = "";
+  (void)port;
+#endif
+  return ar_open( string(portString), baud, dBits, stBits, par );
+}
+
+bool arRS232Port::ar_open( const std::string& portString, const unsigned long baud,
+                      const unsigned dBits, const float stBits,
+                      const std::string& par ) {
+#if !defined( AR_USE_WIN_32 ) && !defined( AR_USE_LINUX )
+  return nyi();
 #endif
 
   if (_isOpen) {
@@ -255,11 +280,7 @@ bool arRS232Port::ar_open( const unsigned port, const unsigned long baud,
     return false;
   }
 
-  char portString[8] = "COM";
-  // Windows port #s are 1-based..
-  sprintf( portString+3, "%d", port );
-
-  _portHandle = CreateFile( portString, GENERIC_READ | GENERIC_WRITE,
+  _portHandle = CreateFile( portString.c_str(), GENERIC_READ | GENERIC_WRITE,
                             0, // exclusive access
                             0, // no security attributes.
                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
@@ -346,11 +367,8 @@ bool arRS232Port::ar_open( const unsigned port, const unsigned long baud,
       ar_log_error() << "arRS232Port: baud rate must be one of 9600, 19200, 38400, 57600, 115200.\n";
       return false;
   }
-  char portString[64];
-  sprintf( portString, "/dev/ttyS%d", port-1 ); // port numbers are 0-based
-
   // Open the port.
-  _fileDescriptor = open( portString, O_RDWR | O_NOCTTY );
+  _fileDescriptor = open( portString.c_str(), O_RDWR | O_NOCTTY );
   if (_fileDescriptor < 0) {
     ar_log_error() << "arRS232Port failed to open " << portString << ".\n"
          << "     (Did you give non-root users write permission?)\n";
@@ -497,6 +515,7 @@ bool arRS232Port::ar_close() {
   if (!_isOpen)
     return true;
 
+  stopReading();
   if (!flushInput())
     ar_log_error() << "arRS232Port: flushInput() failed.\n";
   if (!flushOutput())
@@ -522,6 +541,10 @@ int arRS232Port::ar_read(char* buf, const unsigned numBytes, const unsigned maxB
     ar_log_error() << "arRS232Port can't read from a closed port.\n";
     return -1;
   }
+  if (_reading) {
+    ar_log_error() << "arRS232Port can't ar_read() after startReading().\n";
+    return -1;
+  }
 #ifdef AR_USE_WIN_32
   DWORD bytesThisTime = 0; // unsigned
   unsigned numBytesAvailable = getNumberBytes();
@@ -789,3 +812,202 @@ unsigned arRS232Port::getNumberBytes() {
   nyi();
   return 0;
 }
+
+void ar_RS232PortReadTask(void* port) {
+  ((arRS232Port*)port)->_readLoop();
+}
+
+bool arRS232Port::startReading( arSerialFrameDecoder* decoder,
+                                const unsigned bufferBytes ) {
+#if !defined( AR_USE_WIN_32 ) && !defined( AR_USE_LINUX )
+  return nyi();
+#endif
+  if (!_isOpen) {
+    ar_log_error() << "arRS232Port: can't start reading a closed port.\n";
+    return false;
+  }
+  if (_reading) {
+    ar_log_error() << "arRS232Port: already reading.\n";
+    return false;
+  }
+  if (!decoder || bufferBytes == 0) {
+    ar_log_error() << "arRS232Port: startReading() needs a decoder and a buffer.\n";
+    return false;
+  }
+
+  delete [] _ring;
+  _ring = new unsigned char[2*bufferBytes];
+  _ringSize = bufferBytes;
+  _ringStart = _ringCount = 0;
+  _bytesReceived = _wakeups = _bytesDropped = 0;
+  _decoder = decoder;
+  _stopReading = false;
+
+#ifdef AR_USE_LINUX
+  if (pipe( _wakePipe ) < 0) {
+    ar_log_error() << "arRS232Port: pipe() failed.\n";
+    return false;
+  }
+#endif
+#ifdef AR_USE_WIN_32
+  // ReadFile() returns what has arrived, or else waits for the
+  // first byte until the read timeout (see MSDN's remarks, above).
+  COMMTIMEOUTS t = _timeoutStruct;
+  t.ReadIntervalTimeout = MAXDWORD;
+  t.ReadTotalTimeoutMultiplier = MAXDWORD;
+  t.ReadTotalTimeoutConstant = 100 * (_readTimeoutTenths > 0 ? _readTimeoutTenths : 1);
+  if (!SetCommTimeouts( _portHandle, &t )) {
+    ar_log_error() << "arRS232Port: SetCommTimeouts() failed.\n";
+    return false;
+  }
+#endif
+
+  _readThreadRunning = true;
+  if (!_readThread.beginThread( ar_RS232PortReadTask, this )) {
+    ar_log_error() << "arRS232Port failed to start reading thread.\n";
+    _readThreadRunning = false;
+#ifdef AR_USE_LINUX
+    close(_wakePipe[0]);
+    close(_wakePipe[1]);
+#endif
+    return false;
+  }
+  _reading = true;
+  return true;
+}
+
+void arRS232Port::stopReading() {
+  if (!_reading)
+    return;
+
+  _stopReading = true;
+#ifdef AR_USE_LINUX
+  const char wake = 0;
+  if (write( _wakePipe[1], &wake, 1 ) != 1)
+    ar_log_error() << "arRS232Port: failed to wake reading thread.\n";
+#endif
+  arSleepBackoff a(5, 20, 1.1);
+  while (_readThreadRunning)
+    a.sleep();
+#ifdef AR_USE_LINUX
+  close(_wakePipe[0]);
+  close(_wakePipe[1]);
+#endif
+#ifdef AR_USE_WIN_32
+  SetCommTimeouts( _portHandle, &_timeoutStruct );
+#endif
+  _reading = false;
+}
+
+void arRS232Port::_readLoop() {
+#ifdef AR_USE_LINUX
+  const int epfd = epoll_create(2);
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = _fileDescriptor;
+  bool ok = epfd >= 0 && epoll_ctl( epfd, EPOLL_CTL_ADD, _fileDescriptor, &ev ) == 0;
+  ev.data.fd = _wakePipe[0];
+  ok = ok && epoll_ctl( epfd, EPOLL_CTL_ADD, _wakePipe[0], &ev ) == 0;
+  if (!ok)
+    ar_log_error() << "arRS232Port: epoll setup failed.\n";
+
+  const int msecTimeout = _readTimeoutTenths > 0 ? 100*_readTimeoutTenths : -1;
+  while (ok && !_stopReading) {
+    struct epoll_event events[2];
+    const int n = epoll_wait( epfd, events, 2, msecTimeout );
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      ar_log_error() << "arRS232Port: epoll_wait() failed.\n";
+      break;
+    }
+    if (n == 0) {
+      _decoder->onTimeout();
+      continue;
+    }
+    // Timestamp before read(), as near as possible to the bytes' arrival.
+    const ar_timeval arrival = ar_time();
+    for (int i=0; i<n; ++i) {
+      if (events[i].data.fd != _fileDescriptor)
+        continue;
+      ++_wakeups;
+      const int got = _receive();
+      if (got < 0 || (got == 0 && (events[i].events & (EPOLLHUP | EPOLLERR)))) {
+        ar_log_error() << "arRS232Port: read() failed;  device gone?\n";
+        ok = false;
+        break;
+      }
+      _decode(arrival);
+    }
+  }
+  if (epfd >= 0)
+    close(epfd);
+#endif
+
+#ifdef AR_USE_WIN_32
+  while (!_stopReading) {
+    const int got = _receive();
+    if (got < 0)
+      break;
+    if (got == 0) {
+      _decoder->onTimeout();
+      continue;
+    }
+    ++_wakeups;
+    _decode(ar_time());
+  }
+#endif
+  _readThreadRunning = false;
+}
+
+// Read what fits in the ring buffer without wrapping, and mirror it.
+int arRS232Port::_receive() {
+  const unsigned end = (_ringStart + _ringCount) % _ringSize;
+  unsigned room = _ringSize - _ringCount;
+  if (room > _ringSize - end)
+    room = _ringSize - end;
+  if (room == 0)
+    return 0;
+
+  int got = -1;
+#ifdef AR_USE_LINUX
+  got = read( _fileDescriptor, _ring + end, room );
+  if (got < 0 && (errno == EAGAIN || errno == EINTR))
+    got = 0;
+#endif
+#ifdef AR_USE_WIN_32
+  DWORD cb = 0;
+  if (ReadFile( _portHandle, _ring + end, room, &cb, NULL ))
+    got = int(cb);
+  else
+    ar_log_error() << "arRS232Port: ReadFile() failed:\n  "
+                   << ar_getLastWin32ErrorString() << ar_endl;
+#endif
+  if (got <= 0)
+    return got;
+
+  memcpy( _ring + _ringSize + end, _ring + end, got );
+  _ringCount += got;
+  _bytesReceived += got;
+  return got;
+}
+
+void arRS232Port::_decode( const ar_timeval& arrival ) {
+  for (;;) {
+    const int used = _ringCount == 0 ? 0 :
+      _decoder->decode( _ring + _ringStart, int(_ringCount), arrival );
+    unsigned n = used > 0 ? unsigned(used) : 0;
+    if (n > _ringCount)
+      n = _ringCount;
+    if (n == 0) {
+      if (_ringCount < _ringSize)
+        return;
+      // Full, yet no frame:  drop the oldest byte.
+      n = 1;
+      ++_bytesDropped;
+    }
+    _ringStart = (_ringStart + n) % _ringSize;
+    _ringCount -= n;
+  }
+}
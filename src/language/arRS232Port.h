@@ -15,8 +15,27 @@
 #include <string>
 using namespace std;
 
+#include "arThread.h"
+#include "arDataUtilities.h"
 #include "arLanguageCalling.h"
 
+// Parses a device's byte stream, for arRS232Port::startReading().
+
+class SZG_CALL arSerialFrameDecoder {
+  public:
+    virtual ~arSerialFrameDecoder() {}
+
+    // bytes[0..count) arrived and are not yet consumed, oldest first.
+    // The newest arrived at time arrival.  Handle at most one frame, and
+    // return how many bytes it used, or how many bytes of garbage precede
+    // the next plausible frame.  Return 0 to wait for more bytes.
+    virtual int decode( const unsigned char* bytes, int count,
+                        const ar_timeval& arrival ) = 0;
+
+    // Nothing arrived during the port's read timeout.
+    virtual void onTimeout() {}
+};
+
 // An RS-232 port.
 
 class SZG_CALL arRS232Port {
@@ -31,6 +50,11 @@ class SZG_CALL arRS232Port {
                   const unsigned long baudRate,
                   const unsigned int dataBits, const float stopBits,
                   const std::string& parity );
+    // By device name, e.g. /dev/ttyUSB0, a pty, or \\.\COM12.
+    bool ar_open( const std::string& device,
+                  const unsigned long baudRate,
+                  const unsigned int dataBits, const float stopBits,
+                  const std::string& parity );
     bool ar_close();
 
     // These three return a signed int that is the number of bytes
@@ -83,9 +107,40 @@ class SZG_CALL arRS232Port {
     // Get the number of bytes available to be read (yahoo!).
     unsigned int getNumberBytes();
 
+    // Event-driven input instead of ar_read() and readAll().  A thread
+    // waits for bytes (with epoll on Linux), timestamps them as they
+    // arrive into a ring buffer of bufferBytes, and hands them to decoder
+    // in place, so each frame is handled as soon as it completes.
+    // Bytes the decoder hasn't consumed when the buffer fills are dropped.
+    bool startReading( arSerialFrameDecoder* decoder,
+                       const unsigned int bufferBytes=4096 );
+    void stopReading();
+    bool isReading() const { return _reading; }
+    // Since startReading().
+    long getBytesReceived() const { return _bytesReceived; }
+    long getWakeups() const { return _wakeups; }
+    long getBytesDropped() const { return _bytesDropped; }
+
   private:
+    friend void ar_RS232PortReadTask(void*);
     bool _isOpen;
     unsigned int _readTimeoutTenths;
+
+    arSerialFrameDecoder* _decoder;
+    arThread _readThread;
+    bool _reading;
+    bool _stopReading;
+    bool _readThreadRunning;
+    unsigned char* _ring;     // twice _ringSize, each byte stored twice,
+    unsigned int _ringSize;   // so any run of bytes is contiguous
+    unsigned int _ringStart;
+    unsigned int _ringCount;
+    long _bytesReceived;
+    long _wakeups;
+    long _bytesDropped;
+    void _readLoop();
+    int _receive();
+    void _decode(const ar_timeval& arrival);
 #ifdef AR_USE_WIN_32
     HANDLE _portHandle;
     COMMTIMEOUTS _timeoutStruct;
@@ -93,6 +148,7 @@ class SZG_CALL arRS232Port {
 #ifdef AR_USE_LINUX
     int _fileDescriptor;
     struct termios _oldConfig, _newConfig;
+    int _wakePipe[2];   // interrupts epoll_wait() for stopReading()
 #endif
 };
 
@@ -0,0 +1,194 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arTaskPool.h"
+#include "arLogStream.h"
+
+#ifndef AR_USE_WIN_32
+#include <unistd.h>
+#endif
+
+int ar_numProcessors() {
+#ifdef AR_USE_WIN_32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  const int n = int(info.dwNumberOfProcessors);
+#else
+  const int n = int(sysconf(_SC_NPROCESSORS_ONLN));
+#endif
+  return n < 1 ? 1 : n;
+}
+
+namespace {
+struct arTaskPoolStart {
+  arTaskPool* pool;
+  int thread;
+};
+}
+
+arTaskPool::arTaskPool(int threads) :
+  _threads(threads > 0 ? threads : ar_numProcessors()),
+  _lock("TASKPOOL"),
+  _wake("arTaskPool wake"),
+  _done("arTaskPool done"),
+  _queued(0),
+  _pending(0),
+  _running(0),
+  _joining(false),
+  _quit(false),
+  _tasksRun(0),
+  _steals(0) {
+  int i;
+  for (i=0; i<_threads; ++i)
+    _workers.push_back(new Worker);
+
+  // Thread 0 is whoever calls run().
+  for (i=1; i<_threads; ++i) {
+    arTaskPoolStart* s = new arTaskPoolStart;
+    s->pool = this;
+    s->thread = i;
+    arThread t;
+    arGuard _(_lock, "arTaskPool start");
+    if (t.beginThread(_workTask, s)) {
+      ++_running;
+    } else {
+      ar_log_error() << "arTaskPool failed to start thread " << i << ".\n";
+      delete s;
+    }
+  }
+}
+
+arTaskPool::~arTaskPool() {
+  _lock.lock("arTaskPool::~arTaskPool");
+  _quit = true;
+  // Each exiting thread signals _done.
+  while (_running > 0) {
+    _wake.signal();
+    (void)_done.wait(_lock);
+  }
+  _lock.unlock();
+  for (vector<Worker*>::iterator i = _workers.begin(); i != _workers.end(); ++i)
+    delete *i;
+}
+
+void arTaskPool::_workTask(void* arg) {
+  arTaskPoolStart* s = (arTaskPoolStart*)arg;
+  arTaskPool* pool = s->pool;
+  const int thread = s->thread;
+  delete s;
+  pool->_work(thread);
+}
+
+void arTaskPool::_work(int thread) {
+  for (;;) {
+    arTask* t = _next(thread);
+    if (t) {
+      t->run(*this, thread);
+      _finish();
+      continue;
+    }
+    arGuard _(_lock, "arTaskPool::_work");
+    if (_quit)
+      break;
+    if (_queued == 0)
+      (void)_wake.wait(_lock);
+  }
+  arGuard _(_lock, "arTaskPool::_work exit");
+  --_running;
+  _done.signal();
+}
+
+// Newest of our own, else oldest of someone else's.
+arTask* arTaskPool::_next(int thread) {
+  arTask* t = NULL;
+  {
+    Worker& w = *_workers[thread];
+    arGuard _(w.lock, "arTaskPool::_next");
+    if (!w.tasks.empty()) {
+      t = w.tasks.back();
+      w.tasks.pop_back();
+    }
+  }
+  bool stolen = false;
+  for (int i=1; !t && i<_threads; ++i) {
+    Worker& w = *_workers[(thread + i) % _threads];
+    arGuard _(w.lock, "arTaskPool::_next steal");
+    if (!w.tasks.empty()) {
+      t = w.tasks.front();
+      w.tasks.pop_front();
+      stolen = true;
+    }
+  }
+  if (t) {
+    arGuard _(_lock, "arTaskPool::_next count");
+    --_queued;
+    if (stolen)
+      ++_steals;
+    // Pass the wakeup on, in case one signal woke one thread for several tasks.
+    if (_queued > 0)
+      _wake.signal();
+  }
+  return t;
+}
+
+void arTaskPool::spawn(arTask* task, int thread) {
+  if (!task)
+    return;
+  // Count it and queue it under _lock, so it can't be taken (or finish)
+  // before it's counted, and a thread about to wait can't miss it.
+  arGuard _(_lock, "arTaskPool::spawn");
+  ++_pending;
+  ++_tasksRun;
+  {
+    Worker& w = *_workers[thread];
+    arGuard q(w.lock, "arTaskPool::spawn queue");
+    w.tasks.push_back(task);
+  }
+  ++_queued;
+  _wake.signal();
+  if (_joining)
+    _done.signal();
+}
+
+void arTaskPool::_finish() {
+  arGuard _(_lock, "arTaskPool::_finish");
+  if (--_pending == 0)
+    _done.signal();
+}
+
+void arTaskPool::run(arTask* task) {
+  if (!task)
+    return;
+  if (_threads == 1) {
+    // Everything in this thread.
+    spawn(task, 0);
+    arTask* t;
+    while ((t = _next(0)) != NULL) {
+      t->run(*this, 0);
+      _finish();
+    }
+    return;
+  }
+
+  spawn(task, 0);
+  for (;;) {
+    arTask* t = _next(0);
+    if (t) {
+      t->run(*this, 0);
+      _finish();
+      continue;
+    }
+    arGuard _(_lock, "arTaskPool::run");
+    if (_pending == 0)
+      break;
+    if (_queued == 0) {
+      // Until the last task finishes, or one spawns another.
+      _joining = true;
+      (void)_done.wait(_lock);
+      _joining = false;
+    }
+  }
+}
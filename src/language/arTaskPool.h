@@ -0,0 +1,80 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_TASK_POOL_H
+#define AR_TASK_POOL_H
+
+#include "arThread.h"
+#include "arLanguageCalling.h"
+
+#include <deque>
+#include <vector>
+using namespace std;
+
+class arTaskPool;
+
+// Unit of work for an arTaskPool.  The pool doesn't delete tasks.
+class SZG_CALL arTask {
+ public:
+  virtual ~arTask() {}
+  // thread is the index of the pool thread running this task,
+  // to pass to arTaskPool::spawn().
+  virtual void run(arTaskPool& pool, int thread) = 0;
+};
+
+// Fork-join thread pool.  run() starts one task, which may spawn()
+// more, and returns when they've all finished.  The calling thread
+// works too, so a pool of N threads starts N-1.
+//
+// Work-stealing:  each thread takes the newest task from its own queue,
+// and when that's empty steals the oldest from another's.  For recursive
+// work like tree traversal, the oldest tasks are the biggest.
+
+class SZG_CALL arTaskPool {
+ public:
+  // 0 threads means one per processor.
+  arTaskPool(int threads = 0);
+  ~arTaskPool();
+
+  int getThreads() const { return _threads; }
+  void run(arTask* task);
+  // Only from within a task's run().
+  void spawn(arTask* task, int thread);
+  // True if spawning more tasks would keep idle threads busy.
+  bool hungry() const { return _queued < _threads; }
+
+  long getTasksRun() const { return _tasksRun; }
+  long getSteals() const { return _steals; }
+
+ private:
+  struct Worker {
+    arLock lock;
+    deque<arTask*> tasks;
+  };
+  const int _threads;
+  vector<Worker*> _workers;
+
+  arLock _lock;           // guards the rest
+  arConditionVar _wake;   // work arrived, or quitting
+  arConditionVar _done;   // _pending reached 0, a thread exited, or
+                          // work arrived while _joining
+  int _queued;            // spawned, not yet started
+  int _pending;           // spawned, not yet finished
+  int _running;           // threads started, not yet exited
+  bool _joining;          // run() is waiting on _done
+  bool _quit;
+  long _tasksRun;
+  long _steals;
+
+  arTask* _next(int thread);
+  void _finish();
+  void _work(int thread);
+  static void _workTask(void*);
+};
+
+// Number of processors, at least 1.
+SZG_CALL int ar_numProcessors();
+
+#endif
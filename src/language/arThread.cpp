@@ -496,6 +496,41 @@ bool arThread::beginThread(void (*threadFunction)(void*), void* parameter) {
   return true;
 }
 
+arThreadLocal::arThreadLocal() {
+#ifdef AR_USE_WIN_32
+  _key = TlsAlloc();
+  if (_key == TLS_OUT_OF_INDEXES)
+    cerr << "arThreadLocal error: TlsAlloc failed.\n";
+#else
+  if (pthread_key_create(&_key, NULL) != 0)
+    cerr << "arThreadLocal error: pthread_key_create failed.\n";
+#endif
+}
+
+arThreadLocal::~arThreadLocal() {
+#ifdef AR_USE_WIN_32
+  TlsFree(_key);
+#else
+  pthread_key_delete(_key);
+#endif
+}
+
+void* arThreadLocal::get() const {
+#ifdef AR_USE_WIN_32
+  return TlsGetValue(_key);
+#else
+  return pthread_getspecific(_key);
+#endif
+}
+
+void arThreadLocal::set(void* p) {
+#ifdef AR_USE_WIN_32
+  TlsSetValue(_key, p);
+#else
+  pthread_setspecific(_key, p);
+#endif
+}
+
 arSignalObject::arSignalObject() {
 #ifdef AR_USE_WIN_32
   // Create an auto-reset event object, which resets to
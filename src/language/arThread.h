@@ -199,6 +199,22 @@ class SZG_CALL arThreadEvent {
   typedef void* arWrapperType;
 #endif
 
+// One pointer per thread, NULL until that thread set()s it.
+
+class SZG_CALL arThreadLocal {
+ public:
+  arThreadLocal();
+  ~arThreadLocal();
+  void* get() const;
+  void set(void*);
+ private:
+#ifdef AR_USE_WIN_32
+  DWORD _key;
+#else
+  pthread_key_t _key;
+#endif
+};
+
 // Thread.
 
 class SZG_CALL arThread {
@@ -0,0 +1,274 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+// Test arHTR without a szgserver, on synthetic .htr files.
+// For each Euler rotation order, the batched pose must match HTRTransform(),
+// and a half frame must interpolate.  Then for a large take, compares
+// parsing the text with loading the cache, and playback with one
+// setTransform() per node (as arHTR did) against setFrame()'s one batch.
+//
+// Usage: HTRPlaybackTest [segments [frames]]
+
+#include "arPrecompiled.h"
+#define SZG_DO_NOT_EXPORT
+
+#include "arHTR.h"
+#include "arGraphicsDatabase.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char* fileName = "HTRPlaybackTest.htr";
+
+// Exposes HTRTransform(), the unbatched reference.
+class TestHTR : public arHTR {
+ public:
+  arMatrix4 reference(int segment, int frame) { return HTRTransform(segment, frame); }
+};
+
+// Counts alters from outside alterBatch(), and batches.
+class CountingDatabase : public arGraphicsDatabase {
+ public:
+  CountingDatabase() : alters(0), batches(0), _batching(false) {}
+  virtual arDatabaseNode* alter(arStructuredData* data, bool refNode=false) {
+    if (!_batching)
+      ++alters;
+    return arGraphicsDatabase::alter(data, refNode);
+  }
+  virtual bool alterBatch(ARchar* data) {
+    ++batches;
+    _batching = true;
+    const bool ok = arGraphicsDatabase::alterBatch(data);
+    _batching = false;
+    return ok;
+  }
+  int alters;
+  int batches;
+ private:
+  bool _batching;
+};
+
+static bool writeHTR(const char* order, int cSegment, int cFrame) {
+  FILE* f = fopen(fileName, "w");
+  if (!f)
+    return false;
+  fprintf(f, "# HTRPlaybackTest\n[Header]\nFileType htr\nDataType HTRS\nFileVersion 1\n");
+  fprintf(f, "NumSegments %d\nNumFrames %d\nDataFrameRate 60\n", cSegment, cFrame);
+  fprintf(f, "EulerRotationOrder %s\nCalibrationUnits mm\nRotationUnits Degrees\n", order);
+  fprintf(f, "GlobalAxisofGravity Y\nBoneLengthAxis Y\nScaleFactor 1.0\n");
+  fprintf(f, "\n[SegmentNames&Hierarchy]\n");
+  int i;
+  for (i=0; i<cSegment; ++i) {
+    if (i == 0)
+      fprintf(f, "seg0\tGLOBAL\n");
+    else
+      fprintf(f, "seg%d\tseg%d\n", i, (i-1)/2);
+  }
+  fprintf(f, "\n[BasePosition]\n");
+  for (i=0; i<cSegment; ++i)
+    fprintf(f, "seg%d\t%f\t%f\t%f\t%f\t%f\t%f\t%f\n", i,
+            i*1.5, 10.+i, -i*.5, 10.*sin(i*1.), 20.*cos(i*.7), i*7., 10.+i%5);
+  for (i=0; i<cSegment; ++i) {
+    fprintf(f, "[seg%d]\n", i);
+    for (int j=0; j<cFrame; ++j) {
+      const double t = j / 60.;
+      fprintf(f, "%d\t%f\t%f\t%f\t%f\t%f\t%f\t%f\n", j+1,
+              sin(t+i), cos(2.*t), t*.1,
+              170.*sin(t*1.3+i), 80.*cos(t*.9+i*.3), 120.*sin(t*2.1-i),
+              1. + .1*sin(t));
+    }
+  }
+  fprintf(f, "[EndOfFile]\n");
+  fclose(f);
+  return true;
+}
+
+static float difference(const arMatrix4& a, const arMatrix4& b) {
+  float d = 0.;
+  for (int i=0; i<16; ++i) {
+    const float e = fabs(a.v[i] - b.v[i]) / (1.f + fabs(b.v[i]));
+    if (e > d)
+      d = e;
+  }
+  return d;
+}
+
+// The angle between the rotation parts of a and b.
+static float angle(const arMatrix4& a, const arMatrix4& b) {
+  float trace = 0.;
+  for (int i=0; i<3; ++i)
+    for (int k=0; k<3; ++k)
+      trace += a.v[4*i+k] * b.v[4*i+k];
+  const float c = (trace - 1.f) / 2.f;
+  return acos(c > 1.f ? 1.f : c < -1.f ? -1.f : c);
+}
+
+static bool testOrder(const char* order) {
+  const int cSegment = 11;
+  const int cFrame = 30;
+  TestHTR htr;
+  htr.setCaching(false);
+  if (!writeHTR(order, cSegment, cFrame) || !htr.readHTR(fileName)) {
+    ar_log_error() << "HTRPlaybackTest: failed to read " << order << " file.\n";
+    return false;
+  }
+  float worst = 0.;
+  int i, j;
+  for (j=0; j<cFrame; ++j) {
+    htr.setFrame(j);
+    for (i=0; i<cSegment; ++i) {
+      const float d = difference(htr.poseTransform(i), htr.reference(i, j));
+      if (d > worst)
+        worst = d;
+    }
+  }
+
+  // Halfway between frames:  halfway translation, and rotation
+  // equally far from both frames' rotations.
+  float worstHalf = 0.;
+  for (j=0; j+1<cFrame; ++j) {
+    htr.setPose(j + .5);
+    for (i=0; i<cSegment; ++i) {
+      const arMatrix4 a(htr.reference(i, j));
+      const arMatrix4 b(htr.reference(i, j+1));
+      const arMatrix4& m = htr.poseTransform(i);
+      for (int k=12; k<15; ++k) {
+        const float d = fabs(m.v[k] - (a.v[k] + b.v[k]) / 2.f);
+        if (d > worstHalf)
+          worstHalf = d;
+      }
+      const float d = fabs(angle(m, a) - angle(m, b));
+      if (d > worstHalf)
+        worstHalf = d;
+    }
+  }
+  htr.setInterpolation(false);
+  htr.setPose(3.7);
+  const float rounded = difference(htr.poseTransform(cSegment-1), htr.reference(cSegment-1, 3));
+
+  printf("  %s: batched pose within %.2g of HTRTransform, interpolation within %.2g\n",
+         order, worst, worstHalf);
+  if (worst > 1e-4 || worstHalf > 1e-3 || rounded > 1e-4) {
+    ar_log_error() << "HTRPlaybackTest: wrong " << order << " pose.\n";
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  const int cSegment = argc > 1 ? atoi(argv[1]) : 60;
+  const int cFrame = argc > 2 ? atoi(argv[2]) : 3000;
+  if (cSegment < 1 || cFrame < 2) {
+    ar_log_error() << "usage: HTRPlaybackTest [segments [frames]]\n";
+    return 1;
+  }
+  bool ok = true;
+  const char* orders[6] = { "XYZ", "XZY", "YXZ", "YZX", "ZXY", "ZYX" };
+  for (int o=0; o<6; ++o)
+    ok &= testOrder(orders[o]);
+
+  // Loading.
+  const string cacheName(string(fileName) + ".cache");
+  remove(cacheName.c_str());
+  writeHTR("ZYX", cSegment, cFrame);
+  ar_timeval start = ar_time();
+  TestHTR parsed;
+  parsed.setCaching(false);
+  ok &= parsed.readHTR(fileName);
+  const double msecParse = ar_difftime(ar_time(), start) / 1000.;
+  start = ar_time();
+  {
+    TestHTR first;
+    ok &= first.readHTR(fileName) && !first.readFromCache();
+  }
+  const double msecFirst = ar_difftime(ar_time(), start) / 1000.;
+  start = ar_time();
+  TestHTR htr;
+  const bool cached = htr.readHTR(fileName) && htr.readFromCache();
+  const double msecCache = ar_difftime(ar_time(), start) / 1000.;
+  if (!cached) {
+    ar_log_error() << "HTRPlaybackTest: didn't read the cache.\n";
+    ok = false;
+  } else {
+    for (int j=0; j<cFrame; j+=97) {
+      parsed.setFrame(j);
+      htr.setFrame(j);
+      for (int i=0; i<cSegment; ++i) {
+        if (!(parsed.poseTransform(i) == htr.poseTransform(i)) ||
+            parsed.poseScale(i) != htr.poseScale(i)) {
+          ar_log_error() << "HTRPlaybackTest: cache differs from file.\n";
+          ok = false;
+          j = cFrame;
+          break;
+        }
+      }
+    }
+  }
+  printf("%d segments, %d frames:\n", cSegment, cFrame);
+  printf("  parse %.1f msec, parse and write cache %.1f msec, read cache %.1f msec\n",
+         msecParse, msecFirst, msecCache);
+
+  // Playback.
+  start = ar_time();
+  for (int j=0; j<cFrame; ++j)
+    parsed.setFrame(j);
+  const double msecPose = ar_difftime(ar_time(), start) / 1000.;
+  CountingDatabase database;
+  arGraphicsNode* parent = (arGraphicsNode*)
+    database.newNode(database.getRoot(), "transform", "HTRPlaybackTest");
+  ok &= parent && htr.attachMesh(parent, "htr", true);
+
+  // As arHTR did:  precomputed matrices, one alter per node.
+  vector<arMatrix4> transforms(cFrame * cSegment);
+  vector<float> scales(cFrame * cSegment);
+  int i, j;
+  for (j=0; j<cFrame; ++j) {
+    htr.setPose(j);
+    for (i=0; i<cSegment; ++i) {
+      transforms[j*cSegment + i] = htr.poseTransform(i);
+      scales[j*cSegment + i] = htr.poseScale(i);
+    }
+  }
+  database.alters = database.batches = 0;
+  start = ar_time();
+  for (j=0; j<cFrame; ++j) {
+    for (i=0; i<cSegment; ++i) {
+      htr.transformForSegment(i)->setTransform(transforms[j*cSegment + i]);
+      htr.scaleForSegment(i)->setTransform(ar_scaleMatrix(scales[j*cSegment + i]));
+    }
+  }
+  const double msecNodes = ar_difftime(ar_time(), start) / 1000.;
+  const int altersNodes = database.alters;
+
+  database.alters = database.batches = 0;
+  start = ar_time();
+  for (j=0; j<cFrame; ++j)
+    htr.setFrame(j);
+  const double msecBatched = ar_difftime(ar_time(), start) / 1000.;
+  for (i=0; i<cSegment; ++i) {
+    if (!(htr.transformForSegment(i)->getTransform() == htr.poseTransform(i))) {
+      ar_log_error() << "HTRPlaybackTest: wrong transform for segment " << i << ".\n";
+      ok = false;
+      break;
+    }
+  }
+  printf("  poses alone: %.1f msec\n", msecPose);
+  printf("  per node: %.1f msec, %.1f alters/frame\n",
+         msecNodes, double(altersNodes) / cFrame);
+  printf("  setFrame: %.1f msec, %.1f alters/frame, %.1f batches/frame\n",
+         msecBatched, double(database.alters) / cFrame, double(database.batches) / cFrame);
+  if (database.alters != 0 || database.batches != cFrame) {
+    ar_log_error() << "HTRPlaybackTest: setFrame() didn't batch.\n";
+    ok = false;
+  }
+
+  remove(fileName);
+  remove(cacheName.c_str());
+  printf(ok ? "HTRPlaybackTest passed.\n" : "HTRPlaybackTest FAILED.\n");
+  return ok ? 0 : 1;
+}
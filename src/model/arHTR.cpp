@@ -8,10 +8,19 @@
 #include "arPrecompiled.h"
 #include "arHTR.h"
 #include "arGraphicsAPI.h"
+#include "arGraphicsCommandBuffer.h"
+
+#include <math.h>
+#include <string.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 #define MAXLINE 500
 #define MAXTOKENS 50
 
+static arGraphicsLanguage __gfx;
+
 // converts degrees to radians
 // @param angle degrees
 inline double deg2rad(const double &angle) {
@@ -64,14 +73,237 @@ arMatrix4 arHTR::HTRRotation(double Rx, double Ry, double Rz) {
 
 // returns a special HTR matrix, of the form
 // (BaseTranslation+FrameTranslation)*(BaseRotation*FrameRotation)
-// @param theBP baseposition to use for calculation
-// @param theFrame frame to use for calculation
-arMatrix4 arHTR::HTRTransform(htrBasePosition *theBP,
-                              htrFrame *theFrame) {
-  return (theFrame == NULL) ? theBP->trans * theBP->rot :
+// @param segment index of the segment
+// @param frame frame to use for calculation, or -1 for the base position
+arMatrix4 arHTR::HTRTransform(int segment, int frame) {
+  const htrBasePosition* theBP = segmentData[segment]->basePosition;
+  return (frame < 0) ? theBP->trans * theBP->rot :
     theBP->trans *
-    ar_translationMatrix(theFrame->Tx, theFrame->Ty, theFrame->Tz) *
-    theBP->rot * HTRRotation(theFrame->Rx, theFrame->Ry, theFrame->Rz);
+    ar_translationMatrix(channel(HTR_TX, segment, frame),
+                         channel(HTR_TY, segment, frame),
+                         channel(HTR_TZ, segment, frame)) *
+    theBP->rot * HTRRotation(channel(HTR_RX, segment, frame),
+                             channel(HTR_RY, segment, frame),
+                             channel(HTR_RZ, segment, frame));
+}
+
+// The batched version of HTRTransform, for computePose().  Arrays hold
+// one value per segment;  a quaternion is 4 arrays (w, x, y, z) and
+// a 3x3 matrix 9 arrays (row-major), each n long.
+
+// q = q * r
+static void htrQuatMultiply(float* q, const float* r, int n) {
+  float* qw = q;     float* qx = q+n;       float* qy = q+2*n;     float* qz = q+3*n;
+  const float* rw = r; const float* rx = r+n; const float* ry = r+2*n; const float* rz = r+3*n;
+  int i = 0;
+#ifdef __SSE__
+  for (; i+4 <= n; i += 4) {
+    const __m128 aw = _mm_loadu_ps(qw+i);
+    const __m128 ax = _mm_loadu_ps(qx+i);
+    const __m128 ay = _mm_loadu_ps(qy+i);
+    const __m128 az = _mm_loadu_ps(qz+i);
+    const __m128 bw = _mm_loadu_ps(rw+i);
+    const __m128 bx = _mm_loadu_ps(rx+i);
+    const __m128 by = _mm_loadu_ps(ry+i);
+    const __m128 bz = _mm_loadu_ps(rz+i);
+    _mm_storeu_ps(qw+i, _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(aw, bw), _mm_mul_ps(ax, bx)),
+                                   _mm_add_ps(_mm_mul_ps(ay, by), _mm_mul_ps(az, bz))));
+    _mm_storeu_ps(qx+i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(aw, bx), _mm_mul_ps(ax, bw)),
+                                   _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by))));
+    _mm_storeu_ps(qy+i, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(aw, by), _mm_mul_ps(ax, bz)),
+                                   _mm_add_ps(_mm_mul_ps(ay, bw), _mm_mul_ps(az, bx))));
+    _mm_storeu_ps(qz+i, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(aw, bz), _mm_mul_ps(ay, bx)),
+                                   _mm_add_ps(_mm_mul_ps(ax, by), _mm_mul_ps(az, bw))));
+  }
+#endif
+  for (; i<n; ++i) {
+    const float aw = qw[i], ax = qx[i], ay = qy[i], az = qz[i];
+    qw[i] = aw*rw[i] - ax*rx[i] - ay*ry[i] - az*rz[i];
+    qx[i] = aw*rx[i] + ax*rw[i] + ay*rz[i] - az*ry[i];
+    qy[i] = aw*ry[i] - ax*rz[i] + ay*rw[i] + az*rx[i];
+    qz[i] = aw*rz[i] + ax*ry[i] - ay*rx[i] + az*rw[i];
+  }
+}
+
+// a = (1-w)*a + w*b, for n values.
+static void htrLerp(float* a, const float* b, float w, int n) {
+  int i = 0;
+#ifdef __SSE__
+  const __m128 ww = _mm_set1_ps(w);
+  for (; i+4 <= n; i += 4) {
+    const __m128 aa = _mm_loadu_ps(a+i);
+    _mm_storeu_ps(a+i, _mm_add_ps(aa, _mm_mul_ps(ww, _mm_sub_ps(_mm_loadu_ps(b+i), aa))));
+  }
+#endif
+  for (; i<n; ++i)
+    a[i] += w * (b[i] - a[i]);
+}
+
+// Lerp quaternions q toward r, through the shorter arc:  r and -r are
+// the same rotation.  computePose() normalizes.
+static void htrQuatBlend(float* q, float* r, float w, int n) {
+  int i = 0;
+#ifdef __SSE__
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 sign = _mm_set1_ps(-0.f);
+  for (; i+4 <= n; i += 4) {
+    const __m128 dot = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(q+i), _mm_loadu_ps(r+i)),
+                 _mm_mul_ps(_mm_loadu_ps(q+n+i), _mm_loadu_ps(r+n+i))),
+      _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(q+2*n+i), _mm_loadu_ps(r+2*n+i)),
+                 _mm_mul_ps(_mm_loadu_ps(q+3*n+i), _mm_loadu_ps(r+3*n+i))));
+    const __m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, zero), sign);
+    for (int k=0; k<4; ++k)
+      _mm_storeu_ps(r+k*n+i, _mm_xor_ps(_mm_loadu_ps(r+k*n+i), flip));
+  }
+#endif
+  for (; i<n; ++i) {
+    if (q[i]*r[i] + q[n+i]*r[n+i] + q[2*n+i]*r[2*n+i] + q[3*n+i]*r[3*n+i] < 0) {
+      for (int k=0; k<4; ++k)
+        r[k*n+i] = -r[k*n+i];
+    }
+  }
+  for (int k=0; k<4; ++k)
+    htrLerp(q+k*n, r+k*n, w, n);
+}
+
+// m = base * (rotation of q).  q needn't be unit length.
+static void htrQuatRotate(const float* q, const float* base, float* m, int n) {
+  const float* qw = q; const float* qx = q+n; const float* qy = q+2*n; const float* qz = q+3*n;
+  int i = 0;
+#ifdef __SSE__
+  const __m128 one = _mm_set1_ps(1.f);
+  const __m128 two = _mm_set1_ps(2.f);
+  for (; i+4 <= n; i += 4) {
+    const __m128 w = _mm_loadu_ps(qw+i);
+    const __m128 x = _mm_loadu_ps(qx+i);
+    const __m128 y = _mm_loadu_ps(qy+i);
+    const __m128 z = _mm_loadu_ps(qz+i);
+    const __m128 s = _mm_div_ps(two, _mm_add_ps(_mm_add_ps(_mm_mul_ps(w, w), _mm_mul_ps(x, x)),
+                                                _mm_add_ps(_mm_mul_ps(y, y), _mm_mul_ps(z, z))));
+    const __m128 xs = _mm_mul_ps(x, s), ys = _mm_mul_ps(y, s), zs = _mm_mul_ps(z, s);
+    const __m128 wx = _mm_mul_ps(w, xs), wy = _mm_mul_ps(w, ys), wz = _mm_mul_ps(w, zs);
+    const __m128 xx = _mm_mul_ps(x, xs), xy = _mm_mul_ps(x, ys), xz = _mm_mul_ps(x, zs);
+    const __m128 yy = _mm_mul_ps(y, ys), yz = _mm_mul_ps(y, zs), zz = _mm_mul_ps(z, zs);
+    const __m128 r[9] = {
+      _mm_sub_ps(one, _mm_add_ps(yy, zz)), _mm_sub_ps(xy, wz), _mm_add_ps(xz, wy),
+      _mm_add_ps(xy, wz), _mm_sub_ps(one, _mm_add_ps(xx, zz)), _mm_sub_ps(yz, wx),
+      _mm_sub_ps(xz, wy), _mm_add_ps(yz, wx), _mm_sub_ps(one, _mm_add_ps(xx, yy)) };
+    for (int row=0; row<3; ++row) {
+      const __m128 b0 = _mm_loadu_ps(base+(3*row)*n+i);
+      const __m128 b1 = _mm_loadu_ps(base+(3*row+1)*n+i);
+      const __m128 b2 = _mm_loadu_ps(base+(3*row+2)*n+i);
+      for (int col=0; col<3; ++col) {
+        _mm_storeu_ps(m+(3*row+col)*n+i,
+          _mm_add_ps(_mm_add_ps(_mm_mul_ps(b0, r[col]), _mm_mul_ps(b1, r[3+col])),
+                     _mm_mul_ps(b2, r[6+col])));
+      }
+    }
+  }
+#endif
+  for (; i<n; ++i) {
+    const float w = qw[i], x = qx[i], y = qy[i], z = qz[i];
+    const float s = 2.f / (w*w + x*x + y*y + z*z);
+    const float xs = x*s, ys = y*s, zs = z*s;
+    const float wx = w*xs, wy = w*ys, wz = w*zs;
+    const float xx = x*xs, xy = x*ys, xz = x*zs;
+    const float yy = y*ys, yz = y*zs, zz = z*zs;
+    const float r[9] = {
+      1.f - (yy+zz), xy - wz, xz + wy,
+      xy + wz, 1.f - (xx+zz), yz - wx,
+      xz - wy, yz + wx, 1.f - (xx+yy) };
+    for (int row=0; row<3; ++row) {
+      for (int col=0; col<3; ++col) {
+        m[(3*row+col)*n+i] = base[(3*row)*n+i] * r[col] +
+          base[(3*row+1)*n+i] * r[3+col] + base[(3*row+2)*n+i] * r[6+col];
+      }
+    }
+  }
+}
+
+// Each segment's frame rotation, as a quaternion, multiplied in the
+// order specified within the HTR file like HTRRotation().
+void arHTR::poseRotations(int frame, float* q) {
+  const int n = numSegments;
+  float* q2 = &_poseWork[8*n];
+  float* q3 = &_poseWork[12*n];
+  int axes[3] = {0, 1, 2};
+  switch (eulerRotationOrder) {
+    case AR_XYZ: break;
+    case AR_XZY: axes[1] = 2; axes[2] = 1; break;
+    case AR_YXZ: axes[0] = 1; axes[1] = 0; break;
+    case AR_YZX: axes[0] = 1; axes[1] = 2; axes[2] = 0; break;
+    case AR_ZXY: axes[0] = 2; axes[1] = 0; axes[2] = 1; break;
+    case AR_ZYX: axes[0] = 2; axes[2] = 0; break;
+    default:
+      axes[0] = axes[1] = axes[2] = -1;
+      break;
+  }
+  float* factor[3] = { q, q2, q3 };
+  memset(q, 0, 4*n*sizeof(float));
+  memset(q2, 0, 8*n*sizeof(float));
+  for (int k=0; k<3; ++k) {
+    float* f = factor[k];
+    if (axes[k] < 0) {
+      for (int i=0; i<n; ++i)
+        f[i] = 1.;
+      continue;
+    }
+    const float* angle = &_channels[HTR_RX + axes[k]][frame*n];
+    float* axis = f + (axes[k]+1)*n;
+    for (int i=0; i<n; ++i) {
+      // Half the angle, in radians.
+      const float a = angle[i] * float(M_PI/360.);
+      f[i] = cosf(a);
+      axis[i] = sinf(a);
+    }
+  }
+  htrQuatMultiply(q, q2, n);
+  htrQuatMultiply(q, q3, n);
+}
+
+void arHTR::computePose(double frame) {
+  const int n = numSegments;
+  if (frame > numFrames-1)
+    frame = numFrames-1;
+  if (frame < 0.)
+    frame = 0.;
+  const int f0 = int(frame);
+  const int f1 = f0+1 < numFrames ? f0+1 : f0;
+  const float w = _interpolate ? float(frame - f0) : 0.f;
+
+  _poseWork.resize(33*n);
+  float* q0 = &_poseWork[0];
+  float* q1 = &_poseWork[4*n];
+  float* t0 = &_poseWork[16*n];   // translation and scale
+  float* t1 = &_poseWork[20*n];
+  float* r = &_poseWork[24*n];
+  int c;
+  poseRotations(f0, q0);
+  for (c=0; c<4; ++c)
+    memcpy(t0 + c*n, &_channels[HTR_TX + (c<3 ? c : HTR_SF-HTR_TX)][f0*n], n*sizeof(float));
+  if (w > 0.f && f1 != f0) {
+    poseRotations(f1, q1);
+    for (c=0; c<4; ++c)
+      memcpy(t1 + c*n, &_channels[HTR_TX + (c<3 ? c : HTR_SF-HTR_TX)][f1*n], n*sizeof(float));
+    htrQuatBlend(q0, q1, w, n);
+    htrLerp(t0, t1, w, 4*n);
+  }
+  htrQuatRotate(q0, &_poseBase[0], r, n);
+
+  const float* baseTranslation = &_poseBase[9*n];
+  const float* boneLength = &_poseBase[12*n];
+  for (int i=0; i<n; ++i) {
+    float* v = _poseTransforms[i].v;
+    for (int row=0; row<3; ++row) {
+      for (int col=0; col<3; ++col)
+        v[4*col+row] = r[(3*row+col)*n+i];
+      v[12+row] = baseTranslation[row*n+i] + t0[row*n+i];
+    }
+    v[3] = v[7] = v[11] = 0.;
+    v[15] = 1.;
+    _poseScales[i] = boneLength[i] * t0[3*n+i];
+  }
 }
 
 bool arHTR::attachMesh(const string& objectName,
@@ -150,7 +382,7 @@ void arHTR::attachChildNode(arGraphicsNode* parent,
   }
 
   const string tempName = "." + string(node->name);
-  arMatrix4 tempTransform = HTRTransform(node, NULL);
+  arMatrix4 tempTransform = HTRTransform(node->segment->index, -1);
 
   node->segment->postTransformNode = (arTransformNode*)
     parent->newNode("transform", objectName + tempName + ".postTransform");
@@ -244,7 +476,7 @@ void arHTR::subNormalizeModelSize(arVector3 thePoint, arVector3& minVec,
                                   arVector3& maxVec, htrBasePosition* theBP) {
   unsigned int i = 0;
   for (int j=0; j<numFrames; j++) {
-    arVector3 newPoint = HTRTransform(theBP, theBP->segment->frame[j])*thePoint;
+    arVector3 newPoint = HTRTransform(theBP->segment->index, j)*thePoint;
     // Throw out bogus data (the MotionAnalysis system tags problematic points
     // with 9999999.
     if (++newPoint < 1000000) {
@@ -260,100 +492,99 @@ void arHTR::subNormalizeModelSize(arVector3 thePoint, arVector3& minVec,
 }
 
 arMatrix4 arHTR::segmentBaseTransformRelative(int segmentID) {
-  return HTRTransform(basePosition[segmentID], NULL);
+  return basePosition[segmentID]->trans * basePosition[segmentID]->rot;
 }
 
 // MotionAnalysis represent bogus values as 9999999 (infinity).
-bool arHTR::frameValid(htrFrame* f) {
+bool arHTR::frameValid(int segment, int frame) const {
   const float big = 9000000;
-  return
-    fabs(f->Tx) < big && fabs(f->Ty) < big && fabs(f->Tz) < big &&
-    fabs(f->Rx) < big && fabs(f->Ry) < big && fabs(f->Rz) < big &&
-    fabs(f->scale) < big;
+  for (int c=0; c<HTR_CHANNELS; ++c) {
+    if (fabs(channel(c, segment, frame)) >= big)
+      return false;
+  }
+  return true;
 }
 
 #define lerp(w, a, b) ((w) * (a) + (1.0-(w)) * (b));
-#define lerpField(w, dst, src1, src2, field) dst->field = lerp(w, src1->field, src2->field)
+#define lerpChannel(w, c, dst, src1, src2) channel(c, segment, dst) = \
+  lerp(w, channel(c, segment, src1), channel(c, segment, src2))
 
-void arHTR::frameInterpolate(htrFrame* dst,
-                             const htrFrame* src1,
-                             const htrFrame* src2) {
-  if (!src1 || !src2)
+void arHTR::frameInterpolate(int segment, int dst, int src1, int src2) {
+  if (src1 < 0 || src2 < 0)
     return;
 
-  const arQuaternion q1(HTRRotation(src1->Rx, src1->Ry, src1->Rz));
-  arQuaternion q2(HTRRotation(src2->Rx, src2->Ry, src2->Rz));
+  const arQuaternion q1(HTRRotation(channel(HTR_RX, segment, src1),
+                                    channel(HTR_RY, segment, src1),
+                                    channel(HTR_RZ, segment, src1)));
+  arQuaternion q2(HTRRotation(channel(HTR_RX, segment, src2),
+                              channel(HTR_RY, segment, src2),
+                              channel(HTR_RZ, segment, src2)));
   // Don't lerp between a quarternion and its negative (which is the same rotation).
   if (q1.dot(q2) < 0) {
     q2 = -q2;
   }
   const float weight = 1. -
-    float(dst->frameNum - src1->frameNum) / float(src2->frameNum - src1->frameNum);
+    float(_frameNumbers[dst] - _frameNumbers[src1]) /
+    float(_frameNumbers[src2] - _frameNumbers[src1]);
 
-  lerpField(weight, dst, src1, src2, Tx);
-  lerpField(weight, dst, src1, src2, Ty);
-  lerpField(weight, dst, src1, src2, Tz);
-  lerpField(weight, dst, src1, src2, scale);
+  lerpChannel(weight, HTR_TX, dst, src1, src2);
+  lerpChannel(weight, HTR_TY, dst, src1, src2);
+  lerpChannel(weight, HTR_TZ, dst, src1, src2);
+  lerpChannel(weight, HTR_SF, dst, src1, src2);
 
   const arQuaternion q = lerp(weight, q1, q2);
   arVector3 euler(ar_convertToDeg(ar_extractEulerAngles(q.normalize(), eulerRotationOrder)));
+  float& Rx = channel(HTR_RX, segment, dst);
+  float& Ry = channel(HTR_RY, segment, dst);
+  float& Rz = channel(HTR_RZ, segment, dst);
   switch(eulerRotationOrder) {
   case AR_XYZ:
-    dst->Rx = euler[2];
-    dst->Ry = euler[1];
-    dst->Rz = euler[0];
+    Rx = euler[2];
+    Ry = euler[1];
+    Rz = euler[0];
     break;
   case AR_XZY:
-    dst->Rx = euler[2];
-    dst->Ry = euler[0];
-    dst->Rz = euler[1];
+    Rx = euler[2];
+    Ry = euler[0];
+    Rz = euler[1];
     break;
   case AR_YXZ:
-    dst->Rx = euler[1];
-    dst->Ry = euler[2];
-    dst->Rz = euler[0];
+    Rx = euler[1];
+    Ry = euler[2];
+    Rz = euler[0];
     break;
   case AR_YZX:
-    dst->Rx = euler[0];
-    dst->Ry = euler[2];
-    dst->Rz = euler[1];
+    Rx = euler[0];
+    Ry = euler[2];
+    Rz = euler[1];
     break;
   case AR_ZXY:
-    dst->Rx = euler[1];
-    dst->Ry = euler[0];
-    dst->Rz = euler[2];
+    Rx = euler[1];
+    Ry = euler[0];
+    Rz = euler[2];
     break;
   case AR_ZYX:
-    dst->Rx = euler[0];
-    dst->Ry = euler[1];
-    dst->Rz = euler[2];
+    Rx = euler[0];
+    Ry = euler[1];
+    Rz = euler[2];
     break;
   }
 }
 
 // Lerp between gaps in data found by frameValid().
 void arHTR::basicDataSmoothing() {
-  for (unsigned i=0; i<segmentData.size(); i++) {
-    for (unsigned j=0; j<segmentData[i]->frame.size(); j++) {
-      htrFrame* f = segmentData[i]->frame[j];
-      if (!frameValid(f)) {
+  for (int i=0; i<numSegments; i++) {
+    for (int j=0; j<numFrames; j++) {
+      if (!frameValid(i, j)) {
         // Find the latest previous valid frame, if any.
         int prev = j; // could go negative
-        while (prev >= 0 && !frameValid(segmentData[i]->frame[prev]))
+        while (prev >= 0 && !frameValid(i, prev))
           --prev;
-        unsigned next = j;
+        int next = j;
         // Find the next valid frame, if any.
-        while (next < segmentData[i]->frame.size()
-               && !frameValid(segmentData[i]->frame[next]))
+        while (next < numFrames && !frameValid(i, next))
           ++next;
-        htrFrame* interp1 = (prev >= 0) ?
-          segmentData[i]->frame[prev] : NULL;
-        htrFrame* interp2 = (next < segmentData[i]->frame.size()) ?
-          segmentData[i]->frame[next] : NULL;
-        frameInterpolate(f, interp1, interp2);
-        // Update the matrices.
-        f->trans = HTRTransform(segmentData[i]->basePosition, f);
-        f->totalScale = segmentData[i]->basePosition->boneLength * f->scale;
+        frameInterpolate(i, j, prev, next < numFrames ? next : -1);
       }
     }
   }
@@ -372,10 +603,10 @@ int arHTR::numberOfSegment(const string& segmentName) {
 // @param i HTR internal index number of segment
 arMatrix4 arHTR::inverseTransformForSegment(int i) {
   htrSegmentData* theSegment = segmentData[i];
-  arMatrix4 theTransform = HTRTransform(theSegment->basePosition, NULL);
+  arMatrix4 theTransform = HTRTransform(theSegment->index, -1);
   while (theSegment->parent != NULL) {
     theSegment = theSegment->parent;
-    theTransform = HTRTransform(theSegment->basePosition, NULL)*theTransform;
+    theTransform = HTRTransform(theSegment->index, -1)*theTransform;
   }
   return !theTransform * !ar_scaleMatrix(scaleFactor, scaleFactor, scaleFactor);
 }
@@ -388,21 +619,66 @@ arMatrix4 arHTR::inverseTransformForSegment(int i) {
 bool arHTR::setFrame(int newFrame) {
   if (newFrame >= numFrames || newFrame < 0)
     return false;
+  return setPose(newFrame);
+}
+
+// sets the .htr animation to a possibly fractional frame
+// @param frame the frame to go to
+bool arHTR::setPose(double frame) {
+  if (_invalidFile || frame > numFrames-1 || frame < 0.)
+    return false;
 
+  computePose(frame);
+
+  // Alter all the segments' nodes at once.
+  arGraphicsDatabase* database = NULL;
+  for (unsigned int i=0; i<segmentData.size() && !database; i++) {
+    arTransformNode* node = segmentData[i]->transformNode;
+    if (node && node->active())
+      database = (arGraphicsDatabase*)node->getOwner();
+  }
+  if (database && database != _commandsDatabase) {
+    delete _commands;
+    _commands = new arGraphicsCommandBuffer(database);
+    _commandsDatabase = database;
+  }
   for(unsigned int i=0; i<segmentData.size(); i++) {
     if (segmentData[i]->transformNode) {
-      segmentData[i]->transformNode->setTransform(segmentData[i]->frame[newFrame]->trans);
+      updateTransform(segmentData[i]->transformNode, _poseTransforms[i]);
     }
     // There is a scale matrix for the bone.
     if (segmentData[i]->scaleNode) {
-      segmentData[i]->scaleNode->setTransform(ar_scaleMatrix(segmentData[i]->frame[newFrame]->totalScale));
+      updateTransform(segmentData[i]->scaleNode, ar_scaleMatrix(_poseScales[i]));
     }
   }
+  if (database && !_commands->submit()) {
+    ar_log_error() << "arHTR failed to update segments.\n";
+  }
 
-  _currentFrame = newFrame;
+  _currentFrame = int(frame);
   return true;
 }
 
+// @param seconds time since the first frame, at the file's frame rate
+bool arHTR::setTime(double seconds) {
+  return dataFrameRate > 0 && setPose(seconds * dataFrameRate);
+}
+
+// Adds a node's new transform to setPose()'s batch.
+void arHTR::updateTransform(arTransformNode* node, const arMatrix4& transform) {
+  if (!node->active() || node->getOwner() != _commandsDatabase) {
+    node->setTransform(transform);
+    return;
+  }
+  arStructuredData* data = _commands->scratch(_commandsDatabase->transformData);
+  int ID = node->getID();
+  if (!data->dataIn(__gfx.AR_TRANSFORM_ID, &ID, AR_INT, 1) ||
+      !data->dataIn(__gfx.AR_TRANSFORM_MATRIX, transform.v, AR_FLOAT, AR_FLOATS_PER_MATRIX) ||
+      !_commands->record(data)) {
+    node->setTransform(transform);
+  }
+}
+
 // goes to next frame, or returns false if at last frame
 bool arHTR::nextFrame() {
   return setFrame(_currentFrame+1);
@@ -417,7 +693,7 @@ bool arHTR::prevFrame() {
 bool arHTR::setBasePosition() {
   for(unsigned int i=0; i<segmentData.size(); i++) {
     if (segmentData[i]->transformNode) {
-      segmentData[i]->transformNode->setTransform(HTRTransform(segmentData[i]->basePosition, NULL));
+      segmentData[i]->transformNode->setTransform(HTRTransform(i, -1));
     }
   }
   return true;
@@ -30,6 +30,8 @@
 #include <string>
 #include <vector>
 
+class arGraphicsCommandBuffer;
+
 // Rotation orders (there are many possibilities for Euler angles).
 //enum { XYZ = 1, XZY, YXZ, YZX, ZXY, ZYX };
 
@@ -47,16 +49,17 @@ class SZG_CALL htrSegmentHierarchy {
 };
 
 class htrBasePosition;
-class htrFrame;
 
 // Segment data
 class SZG_CALL htrSegmentData{
  public:
-  htrSegmentData(): transformNode(NULL), scaleNode(NULL), preTransformNode(NULL), postTransformNode(NULL),
-    localTransformNode(NULL), invTransformNode(NULL), boundingSphereNode(NULL), parent(NULL) {}
+  htrSegmentData(): index(-1), transformNode(NULL), scaleNode(NULL), preTransformNode(NULL), postTransformNode(NULL),
+    localTransformNode(NULL), invTransformNode(NULL), boundingSphereNode(NULL), parent(NULL), basePosition(NULL) {}
   ~htrSegmentData() {}
 
   string segmentName;
+  // Index into arHTR's segments and frame channels.
+  int index;
   // Transform node associated with this segment
   arTransformNode* transformNode;
   // The scale node associated with this segment
@@ -82,7 +85,6 @@ class SZG_CALL htrSegmentData{
   htrSegmentData* parent;
   htrBasePosition* basePosition;
   vector<htrSegmentData*> children;
-  vector<htrFrame*> frame;
 };
 
 // Base position Structure
@@ -101,20 +103,13 @@ class SZG_CALL htrBasePosition {
   double boneLength;
 };
 
-// Frame data
-class SZG_CALL htrFrame{
- public:
-  htrFrame() {}
-  ~htrFrame() {}
-  int frameNum;
-  arMatrix4 trans;
-  double Tx, Ty, Tz;
-  double Rx, Ry, Rz;
-  double scale;
-  double totalScale;
-};
+// Frame data, struct-of-arrays:  channel c of segment s in frame f
+// is _channels[c][f*numSegments + s].
+enum { HTR_TX, HTR_TY, HTR_TZ, HTR_RX, HTR_RY, HTR_RZ, HTR_SF, HTR_CHANNELS };
 
-// Wrapper for .htr format
+// Wrapper for .htr format.
+// readHTR(fileName) keeps a binary copy of what it parsed in fileName.cache,
+// which later reads load instead, until the .htr file changes.
 class SZG_CALL arHTR : public arObject {
   public:
     arHTR();
@@ -123,6 +118,9 @@ class SZG_CALL arHTR : public arObject {
     bool readHTR(const string& fileName, const string& subdirectory, const string& path);
     bool readHTR(FILE* htrFileHandle);
     bool writeToFile(const string& fileName);
+    void setCaching(bool on) { _caching = on; }
+    // Whether the last readHTR() loaded the cache.
+    bool readFromCache() const { return _readFromCache; }
 
     // DEPRECATED! Use the arGraphicsNode* parent version instead!
     bool attachMesh(const string& objectName, const string& parent);
@@ -144,6 +142,16 @@ class SZG_CALL arHTR : public arObject {
     bool nextFrame();
     bool prevFrame();
     bool setBasePosition();
+    // A fractional frame interpolates between its neighbors,
+    // unless setInterpolation(false), which rounds down.
+    bool setPose(double frame);
+    // At the file's DataFrameRate.
+    bool setTime(double seconds);
+    void setInterpolation(bool on) { _interpolate = on; }
+    inline int frameRate() const { return dataFrameRate; }
+    // A segment's transform and bone scale, as of the last setPose().
+    const arMatrix4& poseTransform(int i) const { return _poseTransforms[i]; }
+    float poseScale(int i) const { return _poseScales[i]; }
 
     // Stats.
     inline int numberOfFrames() const { return numFrames; }
@@ -152,6 +160,7 @@ class SZG_CALL arHTR : public arObject {
     inline int version() const { return fileVersion; }
     inline string nameOfSegment(const int i) const { return segmentData[i]->segmentName; }
     inline arTransformNode* transformForSegment(int i) { return segmentData[i]->transformNode; }
+    inline arTransformNode* scaleForSegment(int i) { return segmentData[i]->scaleNode; }
     inline arTransformNode* preTransformForSegment(int i) { return segmentData[i]->preTransformNode; }
     inline arTransformNode* postTransformForSegment(int i) { return segmentData[i]->postTransformNode; }
     inline arTransformNode* localTransformForSegment(int i) { return segmentData[i]->localTransformNode; }
@@ -177,12 +186,24 @@ class SZG_CALL arHTR : public arObject {
     bool parseSegmentData(FILE* htrFileHandle);
     bool precomputeData(void);
     bool setInvalid();
+    bool readCache(const string& cacheName, long sourceTime, long sourceSize);
+    bool writeCache(const string& cacheName, long sourceTime, long sourceSize);
     void subNormalizeModelSize(arVector3 thePoint, arVector3 &minVec,
                                    arVector3 &maxVec, htrBasePosition *theBP);
-    bool frameValid(htrFrame* f);
-    void frameInterpolate(htrFrame*, const htrFrame*, const htrFrame*);
-    arMatrix4 HTRTransform(htrBasePosition* theBP, htrFrame* theFrame);
+    bool frameValid(int segment, int frame) const;
+    void frameInterpolate(int segment, int dst, int src1, int src2);
+    // Segment's transform in frame, or in its base position if frame < 0.
+    arMatrix4 HTRTransform(int segment, int frame);
     arMatrix4 HTRRotation(double Rx, double Ry, double Rz);
+    // Every segment's transform and bone scale, into _poseTransforms and
+    // _poseScales, in one pass over the frame's channels.
+    void computePose(double frame);
+    void poseRotations(int frame, float* quaternion);
+    void updateTransform(arTransformNode* node, const arMatrix4& transform);
+    inline float channel(int c, int segment, int frame) const
+      { return _channels[c][frame*numSegments + segment]; }
+    inline float& channel(int c, int segment, int frame)
+      { return _channels[c][frame*numSegments + segment]; }
 
     void attachChildNode(arGraphicsNode* parent,
                          const string& baseName,
@@ -205,6 +226,21 @@ class SZG_CALL arHTR : public arObject {
     vector<htrSegmentHierarchy*> childParent;
     vector<htrBasePosition*> basePosition;
     vector<htrSegmentData*> segmentData;
+    vector<int> _frameNumbers;
+    vector<float> _channels[HTR_CHANNELS];
+
+    // computePose()'s per-segment arrays, numSegments long:  base
+    // rotation (9, row-major), base translation (3), bone length (1).
+    vector<float> _poseBase;
+    vector<float> _poseWork;
+    vector<arMatrix4> _poseTransforms;
+    vector<float> _poseScales;
+    bool _interpolate;
+    bool _caching;
+    bool _readFromCache;
+    // Batches setPose()'s updates into one alter.
+    arGraphicsCommandBuffer* _commands;
+    arGraphicsDatabase* _commandsDatabase;
 
     int _currentFrame;
     arVector3 _normCenter;        // middle of the model
@@ -5,7 +5,9 @@
 
 #include "arPrecompiled.h"
 #include "arHTR.h"
+#include "arGraphicsCommandBuffer.h"
 #include "arLogStream.h"
+#include <sys/stat.h>
 #include <string>
 using namespace std;
 
@@ -13,10 +15,18 @@ const int MAXLINE  = 600;
 const int MAXTOKENS  = 50;
 
 arHTR::arHTR() :
+  numSegments(0),
+  numFrames(0),
+  dataFrameRate(0),
   fileType(NULL),
   dataType(NULL),
   calibrationUnits(NULL),
   rotationUnits(NULL),
+  _interpolate(true),
+  _caching(true),
+  _readFromCache(false),
+  _commands(NULL),
+  _commandsDatabase(NULL),
   _currentFrame(0),
   _normCenter(arVector3(0, 0, 0)),
   _normScaleAmount(1) {
@@ -31,6 +41,7 @@ arHTR::~arHTR() {
     free(calibrationUnits);
   if (rotationUnits)
     free(rotationUnits);
+  delete _commands;
 }
 
 // marks this HTR file as invalid
@@ -47,10 +58,25 @@ bool arHTR::readHTR(const string& fileName, const string& path) {
 // Reads HTR file specified
 // @param fileName name of the HTR file, including extension
 // @param path for some reason, a path string
-// Actually checks that it exists and calls readHTR(FILE*)
+// Loads fileName.cache if it's as new as the file, or else
+// calls readHTR(FILE*) and writes fileName.cache.
 bool arHTR::readHTR(const string& fileName, const string& subdirectory, const string& path) {
+  _readFromCache = false;
+  const string found(ar_fileFind(fileName, subdirectory, path));
+  struct stat s;
+  const bool caching = _caching && found != "NULL" && stat(found.c_str(), &s) == 0;
+  const string cacheName(found + ".cache");
+  if (caching && readCache(cacheName, long(s.st_mtime), long(s.st_size))) {
+    _readFromCache = true;
+    return precomputeData() || setInvalid();
+  }
+
   FILE* htrFileHandle = ar_fileOpen(fileName, subdirectory, path, "r", "arHTR");
-  return htrFileHandle ? readHTR(htrFileHandle) : setInvalid();
+  if (!htrFileHandle || !readHTR(htrFileHandle))
+    return setInvalid();
+  if (caching)
+    (void)writeCache(cacheName, long(s.st_mtime), long(s.st_size));
+  return true;
 }
 
 // reads HTR file specified
@@ -273,9 +299,9 @@ bool arHTR::parseSegmentData1(FILE* htrFileHandle) {
   char textLine[MAXLINE] = {0};
   char *token[MAXTOKENS] = {0};
   htrSegmentData *newSegmentData = NULL;
-  htrFrame *newFrame = NULL;
   for (int i=0; i<numSegments; ++i) {
     newSegmentData = new htrSegmentData;
+    newSegmentData->index = i;
     // todo: test for out of memory
     bool found = false;
     value = (char *)1;
@@ -301,16 +327,9 @@ bool arHTR::parseSegmentData1(FILE* htrFileHandle) {
       if (!parseLine(htrFileHandle, token, textLine, 8, "SegmentData"))
         return false;
 
-      newFrame = new htrFrame;
-      newFrame->frameNum = atoi(token[0]);
-      newFrame->Tx = atof(token[1]);
-      newFrame->Ty = atof(token[2]);
-      newFrame->Tz = atof(token[3]);
-      newFrame->Rx = atof(token[4]);
-      newFrame->Ry = atof(token[5]);
-      newFrame->Rz = atof(token[6]);
-      newFrame->scale = atof(token[7]);
-      newSegmentData->frame.push_back(newFrame);
+      _frameNumbers[j] = atoi(token[0]);
+      for (int c=0; c<HTR_CHANNELS; ++c)
+        channel(c, i, j) = atof(token[c+1]);
     }
     segmentData.push_back(newSegmentData);
   }
@@ -327,17 +346,15 @@ bool arHTR::parseSegmentData2(FILE* htrFileHandle) {
   char textLine[MAXLINE] = {0};
   char *token[MAXTOKENS] = {0};
   htrSegmentData *newSegmentData = NULL;
-  htrFrame *newFrame = NULL;
   // Create storage for each segment's data.
-  // Store values for all frames in an htrSegmentData object.
   for (int j=0; j<numSegments; j++) {
     newSegmentData = new htrSegmentData();
     htrSegmentHierarchy* segment = childParent[j];
     newSegmentData->segmentName = string(segment->child);
+    newSegmentData->index = j;
     segmentData.push_back(newSegmentData);
   }
   for (int i=0; i<numFrames; i++) {
-    newSegmentData = new htrSegmentData;
     bool found = false;
     value = (char *)1;
     while (!found && value) {
@@ -365,17 +382,10 @@ bool arHTR::parseSegmentData2(FILE* htrFileHandle) {
       if (!parseLine(htrFileHandle, token, textLine, 8, "SegmentData"))
         return false;
 
-      newFrame = new htrFrame;
-      newFrame->frameNum = i;
-      newFrame->Tx = atof(token[1]);
-      newFrame->Ty = atof(token[2]);
-      newFrame->Tz = atof(token[3]);
-      newFrame->Rx = atof(token[4]);
-      newFrame->Ry = atof(token[5]);
-      newFrame->Rz = atof(token[6]);
-      newFrame->scale = atof(token[7]);
-      segmentData[k]->frame.push_back(newFrame);
+      for (int c=0; c<HTR_CHANNELS; ++c)
+        channel(c, k, i) = atof(token[c+1]);
     }
+    _frameNumbers[i] = i;
   }
 
   return true;
@@ -384,6 +394,14 @@ bool arHTR::parseSegmentData2(FILE* htrFileHandle) {
 // Parse the frame data of .htr file
 // @param htrFileHandle the HTR file
 bool arHTR::parseSegmentData(FILE* htrFileHandle) {
+  if (numSegments < 0 || numFrames < 0) {
+    ar_log_error() << "arHTR: invalid NumSegments or NumFrames.\n";
+    return false;
+  }
+  _frameNumbers.assign(numFrames, 0);
+  for (int c=0; c<HTR_CHANNELS; ++c)
+    _channels[c].assign(numFrames*numSegments, 0.);
+
   if (fileVersion == 1) {
     return parseSegmentData1(htrFileHandle);
   }
@@ -423,14 +441,230 @@ bool arHTR::precomputeData(void) {
     b->trans = ar_translationMatrix(b->Tx, b->Ty, b->Tz);
     b->rot   = HTRRotation(b->Rx, b->Ry, b->Rz);
   }
-  // precompute matrices for frames
-  htrFrame *h;
-  for (k=0; k<segmentData.size(); k++)
-    for (l=0; l<segmentData[k]->frame.size(); l++) {
-      h = segmentData[k]->frame[l];
-      h->trans = HTRTransform(segmentData[k]->basePosition, h);
-      h->totalScale = segmentData[k]->basePosition->boneLength * h->scale;
+  // base positions as arrays, for computePose()
+  const int n = numSegments;
+  _poseBase.assign(13*n, 0.);
+  for (j=0; j<n; j++) {
+    b = segmentData[j]->basePosition;
+    if (!b) {
+      ar_log_error() << "arHTR: no base position for segment '" <<
+        segmentData[j]->segmentName << "'.\n";
+      return false;
+    }
+    for (i=0; i<9; i++)
+      _poseBase[i*n + j] = b->rot.v[4*(i%3) + i/3];
+    _poseBase[9*n + j] = b->Tx;
+    _poseBase[10*n + j] = b->Ty;
+    _poseBase[11*n + j] = b->Tz;
+    _poseBase[12*n + j] = b->boneLength;
+  }
+  _poseTransforms.assign(n, arMatrix4());
+  _poseScales.assign(n, 1.);
+  return true;
+}
+
+// The cache is what the parser read, in binary:  this machine's ints,
+// floats and doubles, and length-prefixed strings.
+static const char htrCacheMagic[] = "SZGHTRC1";
+
+static bool htrWrite(FILE* f, const void* p, size_t bytes) {
+  return bytes == 0 || fwrite(p, bytes, 1, f) == 1;
+}
+
+static bool htrWriteInt(FILE* f, ARint x) {
+  return htrWrite(f, &x, sizeof(x));
+}
+
+static bool htrWriteString(FILE* f, const char* s) {
+  const ARint length = s ? ARint(strlen(s)) : 0;
+  return htrWriteInt(f, length) && htrWrite(f, s, length);
+}
+
+static bool htrRead(FILE* f, void* p, size_t bytes) {
+  return bytes == 0 || fread(p, bytes, 1, f) == 1;
+}
+
+static bool htrReadInt(FILE* f, ARint& x) {
+  return htrRead(f, &x, sizeof(x));
+}
+
+// Returns a malloc'ed string, like the parser's, or NULL.
+static char* htrReadString(FILE* f) {
+  ARint length = -1;
+  if (!htrReadInt(f, length) || length < 0 || length >= MAXLINE)
+    return NULL;
+  char* s = (char *)malloc(length+1);
+  if (!htrRead(f, s, length)) {
+    free(s);
+    return NULL;
+  }
+  s[length] = '\0';
+  return s;
+}
+
+// Reads the cache if it matches the .htr file's time and size.
+bool arHTR::readCache(const string& cacheName, long sourceTime, long sourceSize) {
+  FILE* f = fopen(cacheName.c_str(), "rb");
+  if (!f)
+    return false;
+
+  char magic[8];
+  ARint byteOrder = 0;
+  ARint64 key[2] = {0, 0};
+  ARint header[5];
+  double scale = 0.;
+  char axes[2];
+  bool ok = htrRead(f, magic, 8) && !memcmp(magic, htrCacheMagic, 8) &&
+    htrReadInt(f, byteOrder) && byteOrder == 0x01020304 &&
+    htrRead(f, key, sizeof(key)) && key[0] == sourceTime && key[1] == sourceSize &&
+    htrRead(f, header, sizeof(header)) && header[1] >= 0 && header[2] >= 0 &&
+    htrRead(f, &scale, sizeof(scale)) && htrRead(f, axes, 2);
+  if (!ok) {
+    fclose(f);
+    ar_log_remark() << "arHTR: stale cache '" << cacheName << "'.\n";
+    return false;
+  }
+
+  const int segments = header[1];
+  const int frames = header[2];
+  char* strings[4];
+  int i;
+  for (i=0; i<4; ++i)
+    strings[i] = htrReadString(f);
+  ok = strings[0] && strings[1] && strings[2] && strings[3];
+
+  vector<htrSegmentHierarchy*> hierarchy;
+  vector<htrBasePosition*> bases;
+  vector<htrSegmentData*> data;
+  for (i=0; ok && i<segments; ++i) {
+    htrSegmentHierarchy* h = new htrSegmentHierarchy;
+    h->child = htrReadString(f);
+    h->parent = htrReadString(f);
+    hierarchy.push_back(h);
+    ok = h->child && h->parent;
+  }
+  for (i=0; ok && i<segments; ++i) {
+    htrBasePosition* b = new htrBasePosition;
+    double v[7];
+    b->name = htrReadString(f);
+    bases.push_back(b);
+    ok = b->name && htrRead(f, v, sizeof(v));
+    if (ok) {
+      b->Tx = v[0]; b->Ty = v[1]; b->Tz = v[2];
+      b->Rx = v[3]; b->Ry = v[4]; b->Rz = v[5];
+      b->boneLength = v[6];
+    }
+  }
+  for (i=0; ok && i<segments; ++i) {
+    char* name = htrReadString(f);
+    ok = name != NULL;
+    if (ok) {
+      htrSegmentData* d = new htrSegmentData;
+      d->segmentName = name;
+      d->index = i;
+      data.push_back(d);
+      free(name);
     }
+  }
+  vector<int> frameNumbers(frames);
+  vector<float> channels[HTR_CHANNELS];
+  ok = ok && htrRead(f, frames ? &frameNumbers[0] : NULL, frames*sizeof(int));
+  for (i=0; ok && i<HTR_CHANNELS; ++i) {
+    channels[i].resize(frames*segments);
+    ok = htrRead(f, channels[i].empty() ? NULL : &channels[i][0],
+                 frames*segments*sizeof(float));
+  }
+  ok = ok && htrRead(f, magic, 8) && !memcmp(magic, htrCacheMagic, 8);
+  fclose(f);
+
+  if (!ok) {
+    for (i=0; i<4; ++i)
+      if (strings[i])
+        free(strings[i]);
+    for (i=0; i<int(hierarchy.size()); ++i)
+      delete hierarchy[i];
+    for (i=0; i<int(bases.size()); ++i)
+      delete bases[i];
+    for (i=0; i<int(data.size()); ++i)
+      delete data[i];
+    ar_log_error() << "arHTR: corrupt cache '" << cacheName << "'.\n";
+    return false;
+  }
+
+  fileVersion = header[0];
+  numSegments = segments;
+  numFrames = frames;
+  dataFrameRate = header[3];
+  eulerRotationOrder = arAxisOrder(header[4]);
+  scaleFactor = scale;
+  globalAxisOfGravity = axes[0];
+  boneLengthAxis = axes[1];
+  fileType = strings[0];
+  dataType = strings[1];
+  calibrationUnits = strings[2];
+  rotationUnits = strings[3];
+  childParent.swap(hierarchy);
+  basePosition.swap(bases);
+  segmentData.swap(data);
+  _frameNumbers.swap(frameNumbers);
+  for (i=0; i<HTR_CHANNELS; ++i)
+    _channels[i].swap(channels[i]);
+  return true;
+}
+
+// Writes the cache, first to a temporary file so no reader sees half of it.
+bool arHTR::writeCache(const string& cacheName, long sourceTime, long sourceSize) {
+  const string tempName(cacheName + ".tmp");
+  FILE* f = fopen(tempName.c_str(), "wb");
+  if (!f) {
+    ar_log_debug() << "arHTR: can't write cache '" << cacheName << "'.\n";
+    return false;
+  }
+
+  const ARint64 key[2] = { sourceTime, sourceSize };
+  const ARint header[5] = { fileVersion, numSegments, numFrames, dataFrameRate, eulerRotationOrder };
+  const char axes[2] = { globalAxisOfGravity, boneLengthAxis };
+  bool ok = htrWrite(f, htrCacheMagic, 8) &&
+    htrWriteInt(f, 0x01020304) &&
+    htrWrite(f, key, sizeof(key)) &&
+    htrWrite(f, header, sizeof(header)) &&
+    htrWrite(f, &scaleFactor, sizeof(scaleFactor)) &&
+    htrWrite(f, axes, 2) &&
+    htrWriteString(f, fileType) &&
+    htrWriteString(f, dataType) &&
+    htrWriteString(f, calibrationUnits) &&
+    htrWriteString(f, rotationUnits);
+  int i;
+  for (i=0; ok && i<numSegments; ++i) {
+    ok = htrWriteString(f, childParent[i]->child) &&
+      htrWriteString(f, childParent[i]->parent);
+  }
+  for (i=0; ok && i<numSegments; ++i) {
+    const htrBasePosition* b = basePosition[i];
+    const double v[7] = { b->Tx, b->Ty, b->Tz, b->Rx, b->Ry, b->Rz, b->boneLength };
+    ok = htrWriteString(f, b->name) && htrWrite(f, v, sizeof(v));
+  }
+  for (i=0; ok && i<numSegments; ++i) {
+    ok = htrWriteString(f, segmentData[i]->segmentName.c_str());
+  }
+  ok = ok && htrWrite(f, numFrames ? &_frameNumbers[0] : NULL, numFrames*sizeof(int));
+  for (i=0; ok && i<HTR_CHANNELS; ++i) {
+    ok = htrWrite(f, _channels[i].empty() ? NULL : &_channels[i][0],
+                  _channels[i].size()*sizeof(float));
+  }
+  ok = ok && htrWrite(f, htrCacheMagic, 8);
+  ok = (fclose(f) == 0) && ok;
+
+#ifdef AR_USE_WIN_32
+  // Windows won't rename onto an existing file.
+  if (ok)
+    remove(cacheName.c_str());
+#endif
+  if (!ok || rename(tempName.c_str(), cacheName.c_str()) != 0) {
+    remove(tempName.c_str());
+    ar_log_debug() << "arHTR: can't write cache '" << cacheName << "'.\n";
+    return false;
+  }
   return true;
 }
 
@@ -476,12 +710,12 @@ bool arHTR::writeToFile(const string& fileName) {
   for (int j=0; j<numSegments; j++) {
     fprintf(htrFile, "[%s]\n", segmentData[j]->segmentName.c_str());
     fprintf(htrFile, "#Fr\tTx\tTy\tTz\tRx\tRy\tRz\tSF\n");
-    for (i=0; i<segmentData[j]->frame.size(); i++) {
+    for (int k=0; k<numFrames; k++) {
       fprintf(htrFile, "%i\t%f\t%f\t%f\t%f\t%f\t%f\t%f\n",
-              segmentData[j]->frame[i]->frameNum, segmentData[j]->frame[i]->Tx,
-              segmentData[j]->frame[i]->Ty, segmentData[j]->frame[i]->Tz,
-              segmentData[j]->frame[i]->Rx, segmentData[j]->frame[i]->Ry,
-              segmentData[j]->frame[i]->Rz, segmentData[j]->frame[i]->scale);
+              _frameNumbers[k], channel(HTR_TX, j, k),
+              channel(HTR_TY, j, k), channel(HTR_TZ, j, k),
+              channel(HTR_RX, j, k), channel(HTR_RY, j, k),
+              channel(HTR_RZ, j, k), channel(HTR_SF, j, k));
     }
   }
 
@@ -0,0 +1,262 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arMeshSimplifier.h"
+
+#include <algorithm>
+#include <map>
+
+// Boundary edges get a plane perpendicular to their face,
+// weighted so the silhouette of an open mesh survives.
+static const double BOUNDARY_WEIGHT = 1000.;
+
+// Upper triangle of the symmetric 4x4 matrix (n,d)(n,d)^T.
+void arMeshSimplifier::Quadric::addPlane(const arVector3& n, double d,
+                                         double weight) {
+  const double p[4] = { n.v[0], n.v[1], n.v[2], d };
+  int k = 0;
+  for (int i=0; i<4; ++i)
+    for (int j=i; j<4; ++j)
+      a[k++] += weight * p[i] * p[j];
+}
+
+arMeshSimplifier::Quadric& arMeshSimplifier::Quadric::operator+=(
+    const Quadric& rhs) {
+  for (int i=0; i<10; ++i)
+    a[i] += rhs.a[i];
+  return *this;
+}
+
+double arMeshSimplifier::Quadric::error(const arVector3& v) const {
+  const double x = v.v[0], y = v.v[1], z = v.v[2];
+  return a[0]*x*x + 2*a[1]*x*y + 2*a[2]*x*z + 2*a[3]*x
+       + a[4]*y*y + 2*a[5]*y*z + 2*a[6]*y
+       + a[7]*z*z + 2*a[8]*z
+       + a[9];
+}
+
+arMeshSimplifier::arMeshSimplifier(const vector<arVector3>& vertices,
+                                   const vector<int>& triangles) :
+  _cTriangle(0),
+  _error(0.) {
+  // Work only on the vertices the triangles use.
+  map<int, int> local;
+  _triangle.reserve(triangles.size());
+  unsigned i;
+  for (i=0; i+2<triangles.size(); i+=3) {
+    int t[3];
+    bool ok = true;
+    for (int k=0; k<3; ++k) {
+      const int v = triangles[i+k];
+      if (v < 0 || v >= int(vertices.size())) {
+        ok = false;
+        break;
+      }
+      map<int, int>::const_iterator j = local.find(v);
+      if (j == local.end()) {
+        t[k] = _original.size();
+        local[v] = t[k];
+        _original.push_back(v);
+        _position.push_back(vertices[v]);
+      }
+      else {
+        t[k] = j->second;
+      }
+    }
+    // Triangles with bad indices are dropped.
+    _triangle.push_back(ok ? t[0] : -1);
+    _triangle.push_back(ok ? t[1] : -1);
+    _triangle.push_back(ok ? t[2] : -1);
+    _alive.push_back(ok);
+    if (ok)
+      ++_cTriangle;
+  }
+
+  const int cVertex = _original.size();
+  _quadric.resize(cVertex);
+  _stamp.assign(cVertex, 0);
+  _faces.resize(cVertex);
+
+  // Count each undirected edge's faces, to find the boundary.
+  map<pair<int, int>, int> edges;
+  for (i=0; i<_alive.size(); ++i) {
+    if (!_alive[i])
+      continue;
+    const int* t = &_triangle[3*i];
+    const arVector3 e1(_position[t[1]] - _position[t[0]]);
+    const arVector3 e2(_position[t[2]] - _position[t[0]]);
+    arVector3 n(e1 * e2);
+    const float area = n.magnitude();
+    if (area > 0.)
+      n /= area;
+    const double d = -(n % _position[t[0]]);
+    for (int k=0; k<3; ++k) {
+      _quadric[t[k]].addPlane(n, d, area);
+      _faces[t[k]].push_back(i);
+      const int a = t[k], b = t[(k+1)%3];
+      ++edges[make_pair(min(a, b), max(a, b))];
+    }
+  }
+  for (i=0; i<_alive.size(); ++i) {
+    if (!_alive[i])
+      continue;
+    const int* t = &_triangle[3*i];
+    const arVector3 faceNormal(
+      (_position[t[1]] - _position[t[0]]) * (_position[t[2]] - _position[t[0]]));
+    for (int k=0; k<3; ++k) {
+      const int a = t[k], b = t[(k+1)%3];
+      if (edges[make_pair(min(a, b), max(a, b))] != 1)
+        continue;
+      arVector3 n((_position[b] - _position[a]) * faceNormal);
+      const float length = n.magnitude();
+      if (length <= 0.)
+        continue;
+      n /= length;
+      const double d = -(n % _position[a]);
+      const double w = BOUNDARY_WEIGHT * (_position[b] - _position[a]).magnitude2();
+      _quadric[a].addPlane(n, d, w);
+      _quadric[b].addPlane(n, d, w);
+    }
+  }
+
+  for (map<pair<int, int>, int>::const_iterator e = edges.begin();
+       e != edges.end(); ++e) {
+    _push(e->first.first, e->first.second);
+    _push(e->first.second, e->first.first);
+  }
+}
+
+void arMeshSimplifier::_push(int from, int to) {
+  Quadric q(_quadric[from]);
+  q += _quadric[to];
+  Collapse c;
+  c.cost = q.error(_position[to]);
+  c.from = from;
+  c.to = to;
+  c.stampFrom = _stamp[from];
+  c.stampTo = _stamp[to];
+  _heap.push_back(c);
+  push_heap(_heap.begin(), _heap.end());
+}
+
+void arMeshSimplifier::_neighbors(int v, vector<int>& out) const {
+  out.clear();
+  const vector<int>& faces = _faces[v];
+  for (vector<int>::const_iterator f = faces.begin(); f != faces.end(); ++f) {
+    if (!_alive[*f])
+      continue;
+    for (int k=0; k<3; ++k) {
+      const int w = _triangle[3 * *f + k];
+      if (w != v)
+        out.push_back(w);
+    }
+  }
+  sort(out.begin(), out.end());
+  out.erase(unique(out.begin(), out.end()), out.end());
+}
+
+bool arMeshSimplifier::_valid(int from, int to) const {
+  vector<int> a, b;
+  _neighbors(from, a);
+  if (!binary_search(a.begin(), a.end(), to))
+    return false;  // No longer an edge.
+
+  // Link condition:  the endpoints may share only the two vertices
+  // opposite the edge, else the collapse pinches the surface.
+  _neighbors(to, b);
+  vector<int> common;
+  set_intersection(a.begin(), a.end(), b.begin(), b.end(),
+                   back_inserter(common));
+  if (common.size() > 2)
+    return false;
+
+  // Moving from onto to mustn't flip or flatten its other triangles.
+  const vector<int>& faces = _faces[from];
+  for (vector<int>::const_iterator f = faces.begin(); f != faces.end(); ++f) {
+    if (!_alive[*f])
+      continue;
+    const int* t = &_triangle[3 * *f];
+    if (t[0] == to || t[1] == to || t[2] == to)
+      continue;  // Removed by the collapse.
+    arVector3 p[3];
+    arVector3 q[3];
+    for (int k=0; k<3; ++k) {
+      p[k] = _position[t[k]];
+      q[k] = t[k] == from ? _position[to] : p[k];
+    }
+    const arVector3 before((p[1] - p[0]) * (p[2] - p[0]));
+    const arVector3 after((q[1] - q[0]) * (q[2] - q[0]));
+    const float lb = before.magnitude(), la = after.magnitude();
+    if (la <= 0. || (lb > 0. && (before % after) < .2 * la * lb))
+      return false;
+  }
+  return true;
+}
+
+void arMeshSimplifier::_collapse(int from, int to) {
+  vector<int>& faces = _faces[from];
+  vector<int>& kept = _faces[to];
+  for (vector<int>::const_iterator f = faces.begin(); f != faces.end(); ++f) {
+    if (!_alive[*f])
+      continue;
+    int* t = &_triangle[3 * *f];
+    if (t[0] == to || t[1] == to || t[2] == to) {
+      _alive[*f] = false;
+      --_cTriangle;
+      continue;
+    }
+    for (int k=0; k<3; ++k)
+      if (t[k] == from)
+        t[k] = to;
+    kept.push_back(*f);
+  }
+  faces.clear();
+  _quadric[to] += _quadric[from];
+  _stamp[from] = -1;
+  ++_stamp[to];
+
+  // Drop dead triangles, and requeue the edges around to.
+  vector<int> live;
+  for (vector<int>::const_iterator g = kept.begin(); g != kept.end(); ++g)
+    if (_alive[*g])
+      live.push_back(*g);
+  kept.swap(live);
+  vector<int> n;
+  _neighbors(to, n);
+  for (vector<int>::const_iterator w = n.begin(); w != n.end(); ++w) {
+    _push(to, *w);
+    _push(*w, to);
+  }
+}
+
+int arMeshSimplifier::simplify(int targetTriangles) {
+  while (_cTriangle > targetTriangles && !_heap.empty()) {
+    pop_heap(_heap.begin(), _heap.end());
+    const Collapse c = _heap.back();
+    _heap.pop_back();
+    if (_stamp[c.from] != c.stampFrom || _stamp[c.to] != c.stampTo)
+      continue;  // Stale.
+    if (!_valid(c.from, c.to))
+      continue;
+    _collapse(c.from, c.to);
+    if (c.cost > _error)
+      _error = c.cost;
+  }
+  return _cTriangle;
+}
+
+void arMeshSimplifier::getTriangles(vector<int>& triangles,
+                                    vector<int>& sources) const {
+  triangles.clear();
+  sources.clear();
+  for (unsigned i=0; i<_alive.size(); ++i) {
+    if (!_alive[i])
+      continue;
+    for (int k=0; k<3; ++k)
+      triangles.push_back(_original[_triangle[3*i+k]]);
+    sources.push_back(i);
+  }
+}
@@ -0,0 +1,76 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_MESH_SIMPLIFIER_H
+#define AR_MESH_SIMPLIFIER_H
+
+#include "arMath.h"
+#include "arObjCalling.h"
+
+#include <vector>
+using namespace std;
+
+// Quadric-error mesh decimation (Garland and Heckbert).
+//
+// Collapses edges by moving one endpoint onto the other, cheapest first,
+// so surviving triangles still index the original vertices (and can share
+// the original points node).  Collapses that would flip a triangle or make
+// the mesh non-manifold are skipped;  boundary edges are expensive to move.
+//
+// Call simplify() with decreasing targets to make a chain of levels.
+
+class SZG_CALL arMeshSimplifier {
+ public:
+  // triangles holds 3 indices into vertices per triangle.
+  arMeshSimplifier(const vector<arVector3>& vertices,
+                   const vector<int>& triangles);
+
+  // Collapse until at most targetTriangles remain, or no collapse is valid.
+  // Returns how many remain.
+  int simplify(int targetTriangles);
+  int getTriangleCount() const { return _cTriangle; }
+  // Squared distance error of the most expensive collapse so far.
+  double getError() const { return _error; }
+
+  // The remaining triangles, as indices into the original vertices,
+  // and which original triangle each came from (for its normals,
+  // texture coordinates and material).
+  void getTriangles(vector<int>& triangles, vector<int>& sources) const;
+
+ private:
+  struct Quadric {
+    double a[10];
+    Quadric() { for (int i=0; i<10; ++i) a[i] = 0.; }
+    void addPlane(const arVector3& n, double d, double weight);
+    Quadric& operator+=(const Quadric&);
+    double error(const arVector3& p) const;
+  };
+  struct Collapse {
+    double cost;
+    int from;      // removed
+    int to;        // kept
+    int stampFrom;
+    int stampTo;
+    bool operator<(const Collapse& rhs) const { return cost > rhs.cost; }
+  };
+
+  vector<int> _original;       // local vertex -> original index
+  vector<arVector3> _position;
+  vector<Quadric> _quadric;
+  vector<int> _stamp;          // -1 once removed
+  vector<vector<int> > _faces; // per vertex, possibly dead triangles
+  vector<int> _triangle;       // 3 local vertices each
+  vector<bool> _alive;
+  int _cTriangle;
+  double _error;
+  vector<Collapse> _heap;
+
+  void _neighbors(int v, vector<int>& out) const;
+  void _push(int from, int to);
+  bool _valid(int from, int to) const;
+  void _collapse(int from, int to);
+};
+
+#endif
@@ -165,23 +165,38 @@ bool arOBJ::attachGroup(arGraphicsNode* where, int groupID, const string& base)
     ar_log_error() << "arOBJ cannot attach group: no parent.\n";
     return false;
   }
-  const string trianglesModifier(".triangles");
+  const string baseName((base=="" ? "myOBJ." : base+".") + _groupName[groupID]);
+
+  const vector<int>& thisGroup = _group[groupID];
+  vector<arOBJTriangle> triangles;
+  triangles.reserve(thisGroup.size());
+  for (unsigned i=0; i<thisGroup.size(); ++i) {
+    triangles.push_back(_triangle[thisGroup[i]]);
+  }
+  _attachTriangles(where, triangles, baseName);
+  return true;
+}
+
+// @param where The parent node to which we will attach everything.
+// @param triangles The triangles, indexing the points node above where.
+// @param baseName The base name of the nodes.
+// Attaches index, normal, material, texture and drawable nodes, per material.
+void arOBJ::_attachTriangles(arGraphicsNode* where,
+                             const vector<arOBJTriangle>& triangles,
+                             const string& baseName) {
   const string normalsModifier  (".normals");
   const string colorsModifier   (".colors");
   const string texCoordModifier (".texCoords");
   const string textureModifier  (".texture:");
-  const string baseName((base=="" ? "myOBJ." : base+".") + _groupName[groupID]);
-
-  vector<int>& thisGroup = _group[groupID];
 
   // Attach triangles (faces)
-  const int numberTriangles = thisGroup.size();
+  const int numberTriangles = triangles.size();
 
   // Attach colors and textures.
   // Sort triangles by material.
   vector<int>* triangleMaterialIDs = new vector<int>[_material.size()];
   for (unsigned tri=0; tri<unsigned(numberTriangles); ++tri) {
-    triangleMaterialIDs[_triangle[thisGroup[tri]].material].push_back(tri);
+    triangleMaterialIDs[triangles[tri].material].push_back(tri);
   }
 
   for (unsigned matID=0; matID<_material.size(); ++matID) {
@@ -199,7 +214,7 @@ bool arOBJ::attachGroup(arGraphicsNode* where, int groupID, const string& base)
     const bool useTexture = thisMaterial.map_Kd != "none";
 
     for (unsigned i=0; i<numTriUsingMaterial; ++i) {
-      const arOBJTriangle currentTriangle = _triangle[thisGroup[thisMatTriangleIDs[i]]];
+      const arOBJTriangle& currentTriangle = triangles[thisMatTriangleIDs[i]];
       indices[3*i  ] = currentTriangle.vertices[0];
       indices[3*i+1] = currentTriangle.vertices[1];
       indices[3*i+2] = currentTriangle.vertices[2];
@@ -266,6 +281,81 @@ bool arOBJ::attachGroup(arGraphicsNode* where, int groupID, const string& base)
   }
 
   delete [] triangleMaterialIDs;
+}
+
+// @param where The scenegraph node to which we attach the OBJ.
+// @param baseName The name of the entire object.
+// @param distances Where each group switches to its next coarser level.
+// @param ratio How many triangles each level keeps from the previous one.
+// Like attachMesh(), but each group gets an LOD node choosing among
+// distances.size()+1 levels, decimated by arMeshSimplifier.  Past the last
+// distance, the coarsest level is drawn.  All levels share one points node.
+bool arOBJ::attachMeshLOD(arGraphicsNode* where, const string& baseName,
+                          const vector<float>& distances, float ratio) {
+  if (_invalidFile) {
+    // already complained
+    return false;
+  }
+  if (ratio <= 0. || ratio >= 1.) {
+    ar_log_error() << "arOBJ: LOD ratio " << ratio << " not in (0,1).\n";
+    return false;
+  }
+  arGraphicsNode* pointsNode = attachPoints(where, baseName+".points");
+  if (!pointsNode) {
+    return false;
+  }
+
+  const string base(baseName=="" ? "myOBJ." : baseName+".");
+  for (unsigned groupID=0; groupID<_group.size(); ++groupID) {
+    const vector<int>& thisGroup = _group[groupID];
+    if (thisGroup.empty()) {
+      continue;
+    }
+    const string groupName(base + _groupName[groupID]);
+    const arBoundingSphere sphere(getGroupBoundingSphere(groupID));
+    arLODNode* lodNode = (arLODNode*)
+      pointsNode->newNode("lod", groupName + ".lod");
+    if (!lodNode) {
+      return false;
+    }
+    lodNode->setLOD(AR_LOD_DISTANCE, distances, sphere.position, sphere.radius);
+
+    vector<int> indices;
+    unsigned i;
+    for (i=0; i<thisGroup.size(); ++i) {
+      for (int k=0; k<3; ++k) {
+        indices.push_back(_triangle[thisGroup[i]].vertices[k]);
+      }
+    }
+    arMeshSimplifier simplifier(_vertex, indices);
+    float target = thisGroup.size();
+    for (unsigned level=0; level<=distances.size(); ++level) {
+      // Decimated triangles keep the normals, texture coordinates
+      // and material of the triangle they came from.
+      vector<int> sources;
+      if (level > 0) {
+        target *= ratio;
+        simplifier.simplify(int(target));
+      }
+      simplifier.getTriangles(indices, sources);
+      vector<arOBJTriangle> triangles(sources.size());
+      for (i=0; i<sources.size(); ++i) {
+        triangles[i] = _triangle[thisGroup[sources[i]]];
+        for (int k=0; k<3; ++k) {
+          triangles[i].vertices[k] = indices[3*i+k];
+        }
+      }
+      const string levelName(groupName + ".lod" + ar_intToString(level));
+      arGraphicsNode* levelNode = (arGraphicsNode*)
+        lodNode->newNode("name", levelName);
+      if (!levelNode) {
+        return false;
+      }
+      _attachTriangles(levelNode, triangles, levelName);
+    }
+    ar_log_remark() << "arOBJ: group " << _groupName[groupID] << " decimated from " <<
+      thisGroup.size() << " to " << simplifier.getTriangleCount() << " triangles.\n";
+  }
   return true;
 }
 
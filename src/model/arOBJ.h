@@ -13,6 +13,7 @@
 #include "arOBJSmoothingGroup.h"
 #include "arRay.h"
 #include "arAxisAlignedBoundingBox.h"
+#include "arMeshSimplifier.h"
 #include "arObjCalling.h"
 
 #include <stdio.h>
@@ -91,6 +92,9 @@ class SZG_CALL arOBJ : public arObject {
     bool attachMesh(arGraphicsNode* where, const string& baseName="");
     arGraphicsNode* attachPoints(arGraphicsNode* where, const string& nodeName);
     bool attachGroup(arGraphicsNode* where, int group, const string& base);
+    // Level-of-detail chain per group.  See arLODNode.h.
+    bool attachMeshLOD(arGraphicsNode* where, const string& baseName,
+                       const vector<float>& distances, float ratio=.5);
 
     arBoundingSphere getGroupBoundingSphere(int groupID);
     arAxisAlignedBoundingBox getAxisAlignedBoundingBox(int groupID);
@@ -102,6 +106,9 @@ class SZG_CALL arOBJ : public arObject {
     void _parseFace(int numTokens, char *token[]);
     bool _parseOneLine(FILE* inputFile);
     void _generateNormals();
+    void _attachTriangles(arGraphicsNode* where,
+                          const vector<arOBJTriangle>& triangles,
+                          const string& baseName);
 
   private:
     // status/condition variables
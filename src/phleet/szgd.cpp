@@ -8,6 +8,7 @@
 
 #include "arSZGClient.h"
 #include "arDataUtilities.h"
+#include "arAssetCache.h"
 
 #ifdef AR_USE_WIN_32
   #include <windows.h>
@@ -689,6 +690,13 @@ LDone:
   const string szgExecPath = SZGClient->getAttribute(userName, "NULL", "SZG_EXEC", "path", "");
   const string nativeLibPath = SZGClient->getAttribute(userName, "NULL", "SZG_NATIVELIB", "path", "");
 
+  // Read the app's big files (textures, sounds) now, so the OS
+  // has them cached by the time the app loads them.
+  const string prewarm = SZGClient->getAttribute(userName, "NULL", "SZG_ASSETS", "prewarm", "");
+  if (prewarm != "NULL") {
+    (void)arAssetCache::prewarm(prewarm, execInfo->appDirPath);
+  }
+
   // Construct the new dynamic library path.
 #ifdef AR_USE_WIN_32
   // guard around ar_getenv/ar_setenv/ar_setenv(DLLPathPrev),
@@ -0,0 +1,131 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+// Test arSpatialMixer without fmod or a szgserver.  First, a still
+// source must match direct time-domain convolution with its response,
+// also when the response spans several blocks.  Then a benchmark:
+// sources circle the listener, and the binaural mix goes to a .wav.
+//
+// Usage: HRTFTest [sources [seconds [out.wav [hrtf dataset]]]]
+
+#include "arPrecompiled.h"
+#define SZG_DO_NOT_EXPORT
+
+#include "arSpatialMixer.h"
+#include "arWAVFile.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// Largest difference between the mixer's output and direct convolution
+// with the spherical head's response, for noise from a still source.
+static float convolutionError(int blockSize) {
+  arSpatialMixer mixer(blockSize);
+  arHRTF hrtf;
+  hrtf.makeSphericalHead(mixer.getSampleRate());
+  const arVector3 point(1., .2, -.5); // nearer than the reference distance
+  const int direction = hrtf.nearest(point);
+
+  // The source's gain ramps up during its first block, so start it silent.
+  vector<float> x(blockSize, 0.);
+  srand(1);
+  for (int i=0; i<1000; ++i)
+    x.push_back(2. * rand() / RAND_MAX - 1.);
+  const int id = mixer.addSource(&x);
+  mixer.setSource(id, point, 1.);
+  mixer.playSource(id, false);
+
+  const int frames = int(x.size()) + hrtf.taps() + blockSize;
+  vector<float> y(2*frames);
+  mixer.render(&y[0], frames);
+
+  float error = 0.;
+  for (int ear=0; ear<2; ++ear) {
+    const float* h = ear ? hrtf.right(direction) : hrtf.left(direction);
+    for (int n=0; n<frames; ++n) {
+      double sum = 0.;
+      for (int k=0; k<hrtf.taps() && k<=n; ++k)
+        if (n-k < int(x.size()))
+          sum += h[k] * x[n-k];
+      const float e = fabs(y[2*n + ear] - sum);
+      if (e > error)
+        error = e;
+    }
+  }
+  return error;
+}
+
+int main(int argc, char** argv) {
+  // 32-sample blocks split the 128-tap response into 4 partitions.
+  const int blockSizes[] = { 32, 256 };
+  for (int b=0; b<2; ++b) {
+    const float error = convolutionError(blockSizes[b]);
+    if (error > 1e-6) {
+      ar_log_error() << "HRTFTest: " << blockSizes[b] <<
+        "-sample blocks differ from direct convolution by " << error << ".\n";
+      return 1;
+    }
+  }
+  cout << "HRTFTest: matches direct convolution.\n";
+
+  const int cSource = argc > 1 ? atoi(argv[1]) : 64;
+  const float seconds = argc > 2 ? atof(argv[2]) : 10.;
+  const string wavName(argc > 3 ? argv[3] : "HRTFTest.wav");
+  const string hrtfName(argc > 4 ? argv[4] : "");
+
+  arSpatialMixer mixer;
+  if (!mixer.setHRTF(hrtfName)) {
+    ar_log_error() << "HRTFTest: bad HRTF dataset '" << hrtfName << "'.\n";
+    return 1;
+  }
+  const float rate = mixer.getSampleRate();
+
+  // Each source is a one-second tone with a decaying envelope, so
+  // they're easy to tell apart by ear.
+  vector< vector<float> > clips(cSource);
+  int i;
+  for (i=0; i<cSource; ++i) {
+    const float hz = 220. * pow(2., (i % 24) / 12.);
+    clips[i].resize(int(rate));
+    for (int t=0; t<int(rate); ++t)
+      clips[i][t] = sin(2*M_PI*hz*t/rate) * exp(-4.*t/rate);
+    const int id = mixer.addSource(&clips[i]);
+    mixer.playSource(id, true);
+  }
+
+  arWAVWriter w;
+  if (!w.open(wavName, int(rate), 2))
+    return 1;
+
+  // Move the sources 50 times a second, like SoundRender.
+  const int framesPerUpdate = int(rate / 50);
+  vector<float> buf(2*framesPerUpdate);
+  const int cUpdate = int(seconds * 50);
+  double usec = 0.;
+  for (int update=0; update<cUpdate; ++update) {
+    const float t = update / 50.;
+    for (i=0; i<cSource; ++i) {
+      const float a = 2*M_PI * (t * (.1 + .02*i) + float(i) / cSource);
+      const float r = 1. + 3.*(i%4);
+      mixer.setSource(i, arVector3(r*sin(a), .5*sin(a*.7), -r*cos(a)),
+                      1. / cSource);
+    }
+    const ar_timeval start = ar_time();
+    mixer.render(&buf[0], framesPerUpdate);
+    usec += ar_difftime(ar_time(), start);
+    if (!w.write(&buf[0], framesPerUpdate))
+      return 1;
+  }
+  if (!w.close())
+    return 1;
+
+  const double realtime = seconds * 1e6 / usec;
+  cout << "HRTFTest: " << cSource << " sources, " << seconds << " seconds in " <<
+    usec / 1000. << " msec, " << realtime << "x realtime.\n" <<
+    mixer.status() << "Wrote " << wavName << ".\n";
+  return 0;
+}
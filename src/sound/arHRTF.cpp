@@ -0,0 +1,136 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arHRTF.h"
+#include "arLogStream.h"
+
+#include <stdio.h>
+#include <math.h>
+
+arHRTF::arHRTF() :
+  _taps(0),
+  _sampleRate(44100.) {
+}
+
+void arHRTF::_addDirection(float azimuth, float elevation) {
+  const float a = ar_convertToRad(azimuth);
+  const float e = ar_convertToRad(elevation);
+  _directions.push_back(arVector3(cos(e)*sin(a), sin(e), -cos(e)*cos(a)));
+}
+
+bool arHRTF::read(const string& filename) {
+  FILE* f = fopen(filename.c_str(), "r");
+  if (!f) {
+    ar_log_error() << "arHRTF: no dataset '" << filename << "'.\n";
+    return false;
+  }
+
+  int cAzi = 0, cEle = 0;
+  if (fscanf(f, "%d %d %d %f", &cAzi, &cEle, &_taps, &_sampleRate) != 4 ||
+      cAzi <= 0 || cEle <= 0 || _taps <= 0 || _sampleRate <= 0.) {
+    ar_log_error() << "arHRTF: bad header in '" << filename << "'.\n";
+    fclose(f);
+    _taps = 0;
+    return false;
+  }
+
+  vector<float> azimuths(cAzi);
+  vector<float> elevations(cEle);
+  const int n = cAzi * cEle * _taps;
+  _left.resize(n);
+  _right.resize(n);
+  bool ok = true;
+  int i;
+  for (i=0; i<cAzi && ok; ++i)
+    ok = fscanf(f, "%f", &azimuths[i]) == 1;
+  for (i=0; i<cEle && ok; ++i)
+    ok = fscanf(f, "%f", &elevations[i]) == 1;
+  for (i=0; i<n && ok; ++i)
+    ok = fscanf(f, "%f", &_left[i]) == 1;
+  for (i=0; i<n && ok; ++i)
+    ok = fscanf(f, "%f", &_right[i]) == 1;
+  fclose(f);
+  if (!ok) {
+    ar_log_error() << "arHRTF: truncated dataset '" << filename << "'.\n";
+    _left.clear();
+    _right.clear();
+    _taps = 0;
+    return false;
+  }
+
+  _directions.clear();
+  for (int a=0; a<cAzi; ++a)
+    for (int e=0; e<cEle; ++e)
+      _addDirection(azimuths[a], elevations[e]);
+  ar_log_remark() << "arHRTF read " << directions() << " directions of " <<
+    _taps << " taps from '" << filename << "'.\n";
+  return true;
+}
+
+void arHRTF::makeSphericalHead(float sampleRate, int taps) {
+  const double headRadius = .0875; // meters
+  const double speedOfSound = 343.;
+  const double w0 = speedOfSound / headRadius;
+  const double T = 1. / sampleRate;
+
+  _sampleRate = sampleRate;
+  _taps = taps;
+  _directions.clear();
+  _left.clear();
+  _right.clear();
+  for (int elevation = -45; elevation <= 90; elevation += 15) {
+    const int step = elevation == 90 ? 360 : 15;
+    for (int azimuth = -180; azimuth < 180; azimuth += step) {
+      _addDirection(float(azimuth), float(elevation));
+      const arVector3& d = _directions.back();
+      for (int ear = 0; ear < 2; ++ear) {
+        // Angle between the source and this ear's axis.
+        const double x = ear == 0 ? -d.v[0] : d.v[0];
+        const double incidence = acos(x < -1. ? -1. : x > 1. ? 1. : x);
+
+        // Woodworth:  the far ear hears the wavefront later.
+        const double lateral = M_PI/2. - incidence;
+        const double delay = lateral >= 0. ? 0. :
+          (headRadius / speedOfSound) * (-lateral + sin(-lateral));
+
+        // Brown and Duda's one-pole one-zero head shadow,
+        // via the bilinear transform.
+        const double alpha = 1.05 + .95 * cos(incidence * 180./150.);
+        const double a0 = w0*T + 2.;
+        const double b0 = (w0*T + 2.*alpha) / a0;
+        const double b1 = (w0*T - 2.*alpha) / a0;
+        const double a1 = (w0*T - 2.) / a0;
+
+        vector<float>& h = ear == 0 ? _left : _right;
+        const int start = int(h.size());
+        h.resize(start + taps, 0.f);
+        const int lag = int(delay * sampleRate + .5);
+        double y = 0., xPrev = 0.;
+        for (int t = lag; t < taps; ++t) {
+          const double in = t == lag ? 1. : 0.;
+          y = b0*in + b1*xPrev - a1*y;
+          xPrev = in;
+          h[start + t] = float(y);
+        }
+      }
+    }
+  }
+}
+
+int arHRTF::nearest(const arVector3& p) const {
+  const float m = p.magnitude();
+  const arVector3 d(m > 0. ? p/m : arVector3(0, 0, -1));
+  int best = 0;
+  float bestDot = -2.;
+  for (int i = 0; i < directions(); ++i) {
+    const float dot = d.dot(_directions[i]);
+    if (dot > bestDot) {
+      bestDot = dot;
+      best = i;
+    }
+  }
+  return best;
+}
@@ -0,0 +1,57 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_HRTF_H
+#define AR_HRTF_H
+
+#include "arMath.h"
+#include "arSoundCalling.h"
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// Head-related impulse responses, one pair per measured direction.
+
+// Directions are head-relative:  azimuth in degrees clockwise
+// from straight ahead (-z), elevation in degrees up from the horizon.
+
+class SZG_CALL arHRTF {
+ public:
+  arHRTF();
+
+  // ASCII dataset:  azimuth count, elevation count, taps, sample rate;
+  // the azimuths; the elevations; then all left-ear responses and all
+  // right-ear responses, each ordered [azimuth][elevation][tap].
+  // A CIPIC subject converts to this with a short script.
+  bool read(const string& filename);
+
+  // Spherical head model (Woodworth's interaural delay and Brown and
+  // Duda's head shadow), for when no measured dataset is at hand.
+  void makeSphericalHead(float sampleRate = 44100., int taps = 128);
+
+  bool empty() const { return _directions.empty(); }
+  int taps() const { return _taps; }
+  float sampleRate() const { return _sampleRate; }
+  int directions() const { return int(_directions.size()); }
+
+  // Index of the measured direction nearest a head-relative point.
+  int nearest(const arVector3&) const;
+  const float* left(int direction) const
+    { return &_left[direction * _taps]; }
+  const float* right(int direction) const
+    { return &_right[direction * _taps]; }
+
+ private:
+  int _taps;
+  float _sampleRate;
+  vector<arVector3> _directions; // unit vectors
+  vector<float> _left;           // [direction][tap]
+  vector<float> _right;
+
+  void _addDirection(float azimuth, float elevation);
+};
+
+#endif
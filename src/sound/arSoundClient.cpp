@@ -75,31 +75,6 @@ bool ar_fmodcheck3(const FMOD_RESULT r, const char* file, const int line) {
 
 #ifdef EnableSound
 
-const unsigned iFIRMac = 200; // Tidemann's fir_length
-const unsigned iFIRMax = 256; // max interaural time delay
-const unsigned cEle = 50; // todo: read from datafile
-const unsigned cAzi = 25; // todo: read from datafile
-
-class dspHRTFCIPIC_state
-{
- public:
-  int azumuth;
-  int elevation;
-  int distance;
-
-  // circular buffer
-  float rgxFIR[iFIRMax];        // Tidemann's fir_state
-  int iFIR;                            // Tidemann's fir_state_index
-  float xL;                        // left channel of input
-
-  dspHRTFCIPIC_state() :
-    iFIR(0),
-    xL(0.)
-    {}
-};
-dspHRTFCIPIC_state dspHRTF;
-// todo: member of arSoundClient? of g?  &dspHRTF passed in, a la hrtfFilter_CIPIC::firFilter?
-
 FMOD_RESULT SZG_CALLBACK ar_soundClientDSPCallback(
     FMOD_DSP_STATE* /*pState*/,
     float *  bufSrc,
@@ -115,70 +90,23 @@ FMOD_RESULT SZG_CALLBACK ar_soundClientDSPCallback(
   default:
     break;
 
-  case mode_fmodplugins: {
-    // One filter for *all* sounds, not one filter per sound.
-    // Bogusly localize multiple simultaneous sounds to one location.
-
-    if (inchannels != 2 || outchannels != 2) {
-      ar_log_error() << "fmodplugin internal error: wrong number of channels.\n";
+  case mode_hrtf:
+    // fmod plays nothing itself.  Replace its output with the mixer's.
+    if (outchannels != 2) {
+      ar_log_error() << "hrtf internal error: wrong number of channels.\n";
       return FMOD_OK;
     }
-
-    if (iFIRMac > iFIRMax) {
-      ar_log_error() << "fmodplugin: recompile with larger FIR buffer.\n";
+    if (g->_wavWriter.isOpen()) {
+      // SZG_SOUND/wav_out consumes the mix instead.
+      memset(bufDst, 0, cSamp * outchannels * sizeof(float));
       return FMOD_OK;
     }
-
-    unsigned iAzi = 12; // Tidemann's azumuth_index
-    unsigned iEle = 25; // Tidemann's elevation_index
-    // derive from cEle cAzi?
-
-    // todo: attenuate inversely with distance; that's accurate enough when distance >1 m.
-
-    dspHRTF.xL = 0.;
-    int& iFIR = dspHRTF.iFIR;
-    for (iSamp=0; iSamp<cSamp; ++iSamp) {
-      ++iFIR %= iFIRMax;
-      int jFIR = iFIR;
-      dspHRTF.rgxFIR[iFIR] = dspHRTF.xL;
-
-      // Monophonic input.  Discard right channel.
-      dspHRTF.xL = *bufSrc++;
-      bufSrc++;
-
-      // Convolute to get output.
-      double yL = 0;
-      double yR = 0;
-
-      // Head-Related Impulse Response
-      // const float subject_015_hrir_left[] and ...right[], from e.g. subject_015.c
-      // todo: read from datafile
-      static const float hrirPlaceholder[1] = {0.0};
-      const float* hrirL = hrirPlaceholder;
-      const float* hrirR = hrirPlaceholder;
-      // todo: hrirL and hrirR = new float[250000], read from datafile.
-      // humansubject ascii datafile format: iAziMax iEleMax iFIRMax, then linearized 3d array of float coeffs.
-
-      // Initial index of HRTF filter for both ears.  Linearized 3D array.
-      const unsigned iFIRMic = cEle*iFIRMac*iAzi + iFIRMac*iEle;
-      // todo: verify by looping iAzi here, and listening on headphones.
-
-#if 0
-      // disabled until datafile reading implemented (see todo's in arSoundClient.cpp)
-      for (unsigned m = iFIRMic; m < iFIRMic + iFIRMac; ++m) {
-        yL += dspHRTF.rgxFIR[jFIR] * hrirL[m];
-        yR += dspHRTF.rgxFIR[jFIR] * hrirR[m];
-        --jFIR %= iFIRMax;
-      }
-#else
-      yL = yR = dspHRTF.rgxFIR[jFIR];
-#endif
-
-      *bufDst++ = float(yL);
-      *bufDst++ = float(yR);
-    }
-    break;
+    g->_soundDatabase.getMixer().render(bufDst, cSamp);
+    for (iSamp=0; iSamp<cSamp && iSamp<1024; ++iSamp) {
+      g->_waveDataPtr[iSamp] = 14000*(bufDst[2*iSamp] + bufDst[2*iSamp + 1]);
     }
+    g->relayWaveform();
+    return FMOD_OK;
 
   case mode_fmod:
     // About 35 fps.
@@ -230,6 +158,7 @@ arSoundClient::arSoundClient():
   _recordChannel(NULL),
 #endif
   _microphoneVolume(0),
+  _framesMixed(-1),
   _rolloff(.08)  // .8 is faint, 70 feet away.  .008 is much more gradual.
 {
   // Set up the language.
@@ -255,6 +184,7 @@ arSoundClient::arSoundClient():
 }
 
 void arSoundClient::terminateSound() {
+  (void)_wavWriter.close();
 #ifdef EnableSound
   if (!_fSilent) {
     FMOD_System_Release( ar_fmod() );
@@ -271,22 +201,46 @@ bool arSoundClient::configure(arSZGClient* cli) {
   setPath(cli->getAttribute("SZG_SOUND", "path"));
 
   string renderMode(cli->getAttribute("SZG_SOUND", "render",
-    "|fmod|fmod_plugins|vss|mmio|"));
+    "|fmod|hrtf|fmod_plugins|vss|mmio|"));
   ar_log_debug() << "mode SZG_SOUND/render '" << renderMode << "'.\n";
   if (renderMode == "fmod_plugins") {
-    ar_log_warning() << "ignoring incompletely implemented mode SZG_SOUND/render " <<
-      renderMode << ".\n";
-    renderMode = "fmod";
+    ar_log_warning() << "SZG_SOUND/render fmod_plugins is now 'hrtf'.\n";
+    renderMode = "hrtf";
   }
   _setMode(
-    renderMode == "fmod_plugins" ?
-      mode_fmodplugins :
+    renderMode == "hrtf" ?
+      mode_hrtf :
     renderMode == "vss" ?
       mode_vss :
     renderMode == "mmio" ?
       mode_mmio :
       mode_fmod);
 
+  const int assetMB = cli->getAttributeInt("SZG_ASSETS", "cache_mb");
+  if (assetMB > 0)
+    ar_assetCache().setMaxBytes(assetMB << 20);
+
+  if (_getMode() == mode_hrtf) {
+    const string hrtf(cli->getAttribute("SZG_SOUND", "hrtf"));
+    if (hrtf != "NULL" && !_soundDatabase.getMixer().setHRTF(hrtf)) {
+      ar_log_warning() << "using a spherical head instead of SZG_SOUND/hrtf '" <<
+        hrtf << "'.\n";
+    }
+
+    const string wavOut(cli->getAttribute("SZG_SOUND", "wav_out"));
+    if (wavOut != "NULL") {
+      if (!_wavWriter.open(wavOut,
+             int(_soundDatabase.getMixer().getSampleRate()), 2))
+        return false;
+      ar_log_remark() << "writing mix to '" << wavOut << "'.\n";
+    }
+#ifndef EnableSound
+    else {
+      ar_log_warning() << "hrtf without fmod is silent unless SZG_SOUND/wav_out is set.\n";
+    }
+#endif
+  }
+
   float rolloff;
   if (cli->getAttributeFloats( "SZG_SOUND", "fmod_rolloff", &rolloff )) {
     _rolloff = rolloff;
@@ -306,11 +260,38 @@ bool ar_soundClientActionCallback(void* client) {
   return ((arSoundClient*)client)->_render();
 }
 
-bool ar_soundClientPostSyncCallback(void*) {
+bool ar_soundClientPostSyncCallback(void* client) {
+  arSoundClient* c = (arSoundClient*) client;
+  if (c->_getMode() == mode_hrtf && !c->_mixToFile())
+    return false;
+
   // todo: with a local timer, call it no more than every 20 msec.
   return ar_fmodcheck( FMOD_System_Update( ar_fmod() ) );
 }
 
+// Keep SZG_SOUND/wav_out abreast of the wall clock.
+bool arSoundClient::_mixToFile() {
+  if (!_wavWriter.isOpen())
+    return true;
+
+  const ar_timeval now = ar_time();
+  if (_framesMixed < 0) {
+    _mixStart = now;
+    _framesMixed = 0;
+  }
+  arSpatialMixer& mixer = _soundDatabase.getMixer();
+  const int due = int(ar_difftime(now, _mixStart) * 1e-6 * mixer.getSampleRate());
+  float buf[2*1024];
+  while (_framesMixed < due) {
+    const int n = min(due - _framesMixed, 1024);
+    mixer.render(buf, n);
+    if (!_wavWriter.write(buf, n))
+      return false;
+    _framesMixed += n;
+  }
+  return true;
+}
+
 bool ar_soundClientNullCallback(void*) {
   return true;
 }
@@ -388,8 +369,6 @@ bool arSoundClient::startDSP() {
     return true;
   _dspStarted = true;
 
-  // Always called.  Clone this for HRTF?
-
 #ifndef EnableSound
   return true;
 #else
@@ -431,16 +410,17 @@ bool arSoundClient::startDSP() {
     return false;
   }
 
-#ifdef Busted_on_zx81
-  // Start the DSP, which taps into the sample stream to e.g. compute its FFT.
+  // Start the DSP, which taps into the sample stream to e.g. compute its FFT,
+  // and which plays arSpatialMixer's output in mode_hrtf.
+#ifndef Busted_on_zx81
+  if (_getMode() != mode_hrtf)
+    return true;
+#endif
   FMOD_DSP_DESCRIPTION d = {0};
   d.read = ar_soundClientDSPCallback;
   return ar_fmodcheck( FMOD_System_CreateDSP( ar_fmod(), &d, &_DSPunit )) &&
          ar_fmodcheck( FMOD_System_AddDSP( ar_fmod(), _DSPunit )) &&
          ar_fmodcheck( FMOD_DSP_SetActive( _DSPunit, true ));
-#else
-  return true;
-#endif
 #endif
 }
 
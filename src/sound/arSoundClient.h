@@ -10,6 +10,7 @@
 #include "arDataClient.h"
 #include "arDataType.h"
 #include "arSyncDataClient.h"
+#include "arWAVFile.h"
 #include <string>
 #include "arSoundCalling.h"
 
@@ -121,6 +122,13 @@ class SZG_CALL arSoundClient{
   FMOD_CHANNEL* _recordChannel;
 #endif
   int             _microphoneVolume;
+
+  // SZG_SOUND/wav_out, for mode_hrtf.
+  arWAVWriter _wavWriter;
+  ar_timeval _mixStart;
+  int _framesMixed;
+  bool _mixToFile();
+
   float _rolloff;
 
   bool _fSilent; // True iff sound subsystem failed to initialize at runtime.
@@ -7,6 +7,16 @@
 #include "arSoundDatabase.h"
 #include "arStreamNode.h"
 
+// arSoundFile decoded once per process, shared through ar_assetCache().
+class arSoundFileAsset : public arAsset {
+ public:
+  arSoundFileAsset(arSoundFile* f) : _file(f) {}
+  ~arSoundFileAsset() { delete _file; }
+  arSoundFile* file() const { return _file; }
+ private:
+  arSoundFile* _file;
+};
+
 arSoundDatabase::arSoundDatabase() :
   _renderMode(mode_fmod),
   _path(new list<string>(1, "") /* local dir */ )
@@ -51,6 +61,10 @@ arSoundDatabase::~arSoundDatabase() {
     delete speechData;
   if (streamData)
     delete streamData;
+  for (map<arSoundFile*, arAsset*>::iterator i(_fileAssets.begin());
+       i != _fileAssets.end(); ++i) {
+    ar_assetCache().release(i->second);
+  }
 }
 
 arDatabaseNode* arSoundDatabase::alter(arStructuredData* inData, bool refNode) {
@@ -60,14 +74,21 @@ arDatabaseNode* arSoundDatabase::alter(arStructuredData* inData, bool refNode) {
 void arSoundDatabase::reset() {
   arDatabase::reset();
 
-  // Delete wavfiles.
+  // Delete wavfiles, or return them to the cache.
   for (map<string, arSoundFile*, less<string> >::iterator
         i(_filewavNameContainer.begin());
        i != _filewavNameContainer.end();
        ++i) {
-    delete i->second;
+    const map<arSoundFile*, arAsset*>::iterator j(_fileAssets.find(i->second));
+    if (j == _fileAssets.end()) {
+      delete i->second;
+    } else {
+      ar_assetCache().release(j->second);
+    }
   }
   _filewavNameContainer.clear();
+  _fileAssets.clear();
+  _mixer.reset();
 }
 
 string arSoundDatabase::getPath() const {
@@ -111,6 +132,24 @@ void arSoundDatabase::setPath(const string& thePath) {
 // Only clients, not the server, load soundfiles or even check that they exist.
 // Client and server may be different machines, mounting different disks).
 
+// Return the soundfile at a path, or NULL.
+arSoundFile* arSoundDatabase::_loadFile(const string& fileName, bool fLoop) {
+  const string kind("sound/" + ar_intToString(fLoop) + "/" + ar_intToString(_renderMode));
+  arAssetCache& cache = ar_assetCache();
+  arAsset* a = cache.acquire(kind, fileName);
+  if (!a) {
+    arSoundFile* f = new arSoundFile;
+    if (!f->read(fileName.c_str(), fLoop, _renderMode)) {
+      delete f;
+      return NULL;
+    }
+    a = cache.insert(kind, fileName, new arSoundFileAsset(f));
+  }
+  arSoundFile* f = static_cast<arSoundFileAsset*>(a)->file();
+  _fileAssets[f] = a;
+  return f;
+}
+
 // Only arSoundClient, not arSoundServer, should ever call addFile().
 arSoundFile* arSoundDatabase::addFile(const string& name, bool fLoop) {
   if (_server) {
@@ -124,7 +163,7 @@ arSoundFile* arSoundDatabase::addFile(const string& name, bool fLoop) {
     return iFind->second;
   }
 
-  arSoundFile* theFile = new arSoundFile;
+  arSoundFile* theFile = NULL;
   bool fDone = false;
   string s; // potential filename
   vector<string> triedPaths;
@@ -140,7 +179,8 @@ arSoundFile* arSoundDatabase::addFile(const string& name, bool fLoop) {
       s += name;
       ar_fixPathDelimiter(s);
       triedPaths.push_back( s );
-      fDone = theFile->read(s.c_str(), fLoop, _renderMode);
+      theFile = _loadFile(s, fLoop);
+      fDone = theFile != NULL;
     }
   }
 
@@ -150,11 +190,13 @@ arSoundFile* arSoundDatabase::addFile(const string& name, bool fLoop) {
     s = *i + name;
     ar_fixPathDelimiter(s);
     triedPaths.push_back( s );
-    fDone = theFile->read(s.c_str(), fLoop, _renderMode);
+    theFile = _loadFile(s, fLoop);
+    fDone = theFile != NULL;
   }
   _pathLock.unlock();
   static bool fComplained = false;
   if (!fDone) {
+    theFile = new arSoundFile;
     if (!theFile->dummy()) {
       ar_log_error() << "arSoundDatabase failed to create dummy sound.\n";
     }
@@ -15,14 +15,17 @@
 #include "arSpeakerObject.h"
 #include "arPlayerNode.h"
 #include "arSpeechNode.h"
+#include "arSpatialMixer.h"
+#include "arAssetCache.h"
 
 #include "arSoundCalling.h"
 
 // Scene graph for sound.
 
-enum { mode_fmod, mode_fmodplugins, mode_vss, mode_mmio };
+enum { mode_fmod, mode_hrtf, mode_vss, mode_mmio };
   // fmod:        thin wrapper around 'gamer' 2-speaker style.
-  // fmodplugins: transform sources to compensate for stationary listener
+  // hrtf:        transform sources to compensate for stationary listener,
+  //              then arSpatialMixer convolves them for headphones.
   // vss:         todo, as library, not separate exe
   // mmio:        todo, windows legacy code (fallback if fmod's missing).
 
@@ -44,6 +47,7 @@ class SZG_CALL arSoundDatabase: public arDatabase {
 
   int getMode() const { return _renderMode; };
   void setMode(const int m) { _renderMode = m; };
+  arSpatialMixer& getMixer() { return _mixer; }
 
   // Deliberately public, for external data input.
   arStructuredData* transformData;
@@ -59,7 +63,10 @@ class SZG_CALL arSoundDatabase: public arDatabase {
   mutable arLock _pathLock; // Guard _path.
   list<string>*  _path;
   map<string, arSoundFile*, less<string> > _filewavNameContainer;
+  map<arSoundFile*, arAsset*> _fileAssets;  // shared through ar_assetCache()
+  arSpatialMixer _mixer;
 
+  arSoundFile* _loadFile(const string& fileName, bool fLoop);
   bool _render(arSoundNode*);
   virtual arDatabaseNode* _makeNode(const string& type);
   arDatabaseNode* _processAdmin(arStructuredData* data);
@@ -35,7 +35,7 @@ bool arSoundFile::read(const char* filename, bool fLoop, const int renderMode) {
 #endif
 
 #ifdef EnableSound
-  if (renderMode == mode_fmodplugins) {
+  if (renderMode == mode_hrtf) {
     // copypaste from FMOD_3D case
     if (!ar_fmodcheck( FMOD_System_CreateSound( ar_fmod(), filename,
         FMOD_SOFTWARE, // FMOD_2D | (fLoop ? FMOD_LOOP_NORMAL : FMOD_LOOP_OFF),
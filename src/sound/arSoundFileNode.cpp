@@ -14,6 +14,7 @@ arSoundFileNode::arSoundFileNode() :
   _channel(NULL),
 #endif
   _fLoop(0),
+  _mixerSource(-1),
   _fileName("NULL"),
   _oldFileName("NULL"),
   _action("none"),
@@ -29,6 +30,8 @@ arSoundFileNode::arSoundFileNode() :
 }
 
 arSoundFileNode::~arSoundFileNode() {
+  if (_mixerSource >= 0 && isClient())
+    _owningDatabase->getMixer().removeSource(_mixerSource);
 #ifdef EnableSound
   if (_channel && isClient()) {
     const FMOD_RESULT ok = FMOD_Channel_Stop( _channel );
@@ -43,8 +46,6 @@ arSoundFileNode::~arSoundFileNode() {
 
 extern arMatrix4 __globalSoundListener;
 
-static inline float sq(float _) { return _*_; }
-
 // Ugly.
 #include "arSoundClient.h"
 extern arSoundClient* __globalSoundClient;
@@ -78,29 +79,12 @@ bool arSoundFileNode::_adjust(bool useTrigger) {
   if (m & FMOD_2D) {
     const float r = 1.5;
     const float& x = point.v[0];
-    const float& y = point.v[1];
-    const float& z = point.v[2];
-
-    const double azi = atan2(x, -z);
-    const double ele = atan2(y, sqrt(sq(x) + sq(z)));
     const float dist = point.magnitude() / r;
 
     switch (__globalSoundClient->_getMode()) {
     default:
       return false;
 
-    case mode_fmodplugins:
-#undef YAKYAKYAK
-#ifdef YAKYAKYAK
-      ar_log_critical() << "2D sound, azi " << azi*180./M_PI <<
-        ", ele " << ele*180./M_PI <<
-        ", dist " << dist << ".\n";
-#endif
-
-      // todo: pass azi, ele, dist to HRTF FIR filter.
-      // Through yet another global like __globalSoundListener?
-      return true;
-
     case mode_fmod:
       const float pan = x<-r ? -1. : x>r ? 1. : x/r;
       const float aDist = dist<1. ? 1. : 1. / dist; // hack: inverse not inverse square
@@ -126,7 +110,50 @@ bool arSoundFileNode::_adjust(bool useTrigger) {
 #endif
 }
 
+// No fmod:  arSpatialMixer plays the sound, positioned relative to
+// the listener, so triggered sounds also follow head motion.
+bool arSoundFileNode::_renderHRTF() {
+  if (!isClient())
+    return true;
+
+  arSpatialMixer& mixer = _owningDatabase->getMixer();
+  if (_oldFileName != _fileName && !_fInit) {
+    // Like the fmod path, load only once in the lifetime of the node.
+    _fInit = true;
+    _oldFileName = _fileName;
+    const string fullName(ar_fileFind(_fileName, "", _owningDatabase->getPath()));
+    _mixerSource = mixer.addSource(
+      fullName == "NULL" ? NULL : mixer.loadSamples(fullName));
+    if (_mixerSource < 0) {
+      ar_log_error() << "arSoundFileNode: no soundfile '" << _fileName << "'.\n";
+      return false;
+    }
+  }
+  if (_mixerSource < 0)
+    return true;
+
+  const bool looped = _fLoop == 1;
+  const arMatrix4 mat(ar_transformStack.empty() ? arMatrix4() : ar_transformStack.top());
+  const arVector3 point((__globalSoundListener * mat) * (looped ? _point : _triggerPoint));
+  mixer.setSource(_mixerSource, point, looped ? _amplitude : _triggerAmplitude);
+
+  if (_action == "play") {
+    mixer.playSource(_mixerSource, true);
+  }
+  else if (_action == "pause") {
+    mixer.pauseSource(_mixerSource);
+  }
+  else if (_action == "trigger") {
+    mixer.triggerSource(_mixerSource);
+  }
+  _action = "none";
+  return true;
+}
+
 bool arSoundFileNode::render() {
+  if (_owningDatabase->getMode() == mode_hrtf)
+    return _renderHRTF();
+
 #ifdef EnableSound
   if (_amplitude < 0.) {
     if (!_fComplained[0]) {
@@ -35,6 +35,7 @@ class SZG_CALL arSoundFileNode : public arSoundNode{
   //  "prepare to retrigger the sound".
   int _fLoop;
   bool _fComplained[4];
+  int _mixerSource; // mode_hrtf's arSpatialMixer source, or -1
   string _fileName;
   string _oldFileName;
   string _action;
@@ -42,6 +43,7 @@ class SZG_CALL arSoundFileNode : public arSoundNode{
   arVector3 _triggerPoint;
 
   bool _adjust(bool useTriggered = false);
+  bool _renderHRTF();
 };
 
 #endif
@@ -0,0 +1,482 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arSpatialMixer.h"
+#include "arWAVFile.h"
+#include "arDataUtilities.h"
+#include "arLogStream.h"
+
+#include <math.h>
+#include <string.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+// acc += a * b, complex, over n bins.
+static void ar_complexMultiplyAdd(float* accRe, float* accIm,
+                                  const float* aRe, const float* aIm,
+                                  const float* bRe, const float* bIm, int n) {
+  int i = 0;
+#ifdef __SSE__
+  for (; i+4 <= n; i += 4) {
+    const __m128 ar = _mm_loadu_ps(aRe+i);
+    const __m128 ai = _mm_loadu_ps(aIm+i);
+    const __m128 br = _mm_loadu_ps(bRe+i);
+    const __m128 bi = _mm_loadu_ps(bIm+i);
+    _mm_storeu_ps(accRe+i, _mm_add_ps(_mm_loadu_ps(accRe+i),
+      _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi))));
+    _mm_storeu_ps(accIm+i, _mm_add_ps(_mm_loadu_ps(accIm+i),
+      _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br))));
+  }
+#endif
+  for (; i<n; ++i) {
+    accRe[i] += aRe[i]*bRe[i] - aIm[i]*bIm[i];
+    accIm[i] += aRe[i]*bIm[i] + aIm[i]*bRe[i];
+  }
+}
+
+arSpatialMixer::arSpatialMixer(int blockSize, float sampleRate) :
+  _B(blockSize),
+  _N(2*blockSize),
+  _bins(blockSize+1),
+  _sampleRate(sampleRate),
+  _referenceDistance(1.5),
+  _partitions(1),
+  _lock("SPATIAL_MIXER"),
+  _nextID(0),
+  _fftRe(2*blockSize),
+  _fftIm(2*blockSize),
+  _acc(12*(blockSize+1)),
+  _input(blockSize),
+  _direct(2*blockSize),
+  _out(2*blockSize, 0.),
+  _outPos(blockSize),
+  _blocks(0),
+  _usecRendering(0.) {
+  // Twiddles and bit reversal for the radix-2 FFT.  blockSize must be a power of 2.
+  int bits = 0;
+  while ((1 << bits) < _N)
+    ++bits;
+  _bitReverse.resize(_N);
+  for (int i=0; i<_N; ++i) {
+    int r = 0;
+    for (int b=0; b<bits; ++b)
+      if (i & (1 << b))
+        r |= 1 << (bits-1-b);
+    _bitReverse[i] = r;
+  }
+  _cos.resize(_N/2);
+  _sin.resize(_N/2);
+  for (int k=0; k<_N/2; ++k) {
+    _cos[k] = cos(2.*M_PI*k/_N);
+    _sin[k] = -sin(2.*M_PI*k/_N);
+  }
+  (void)setHRTF("");
+}
+
+// Samples decoded by ar_readWAV().
+class arSamplesAsset : public arAsset {
+ public:
+  int bytes() const { return int(samples.size() * sizeof(float)); }
+  vector<float> samples;
+};
+
+arSpatialMixer::~arSpatialMixer() {
+  reset();
+  for (map<string, arAsset*>::iterator i = _samples.begin();
+       i != _samples.end(); ++i)
+    ar_assetCache().release(i->second);
+}
+
+bool arSpatialMixer::setHRTF(const string& filename) {
+  arHRTF h;
+  bool ok = true;
+  if (filename.empty() || !h.read(filename)) {
+    ok = filename.empty();
+    h.makeSphericalHead(_sampleRate);
+  }
+  if (fabs(h.sampleRate() - _sampleRate) > 1.) {
+    ar_log_warning() << "arSpatialMixer: HRTF sample rate " << h.sampleRate() <<
+      " differs from mixer's " << _sampleRate << ".\n";
+  }
+
+  arGuard _(_lock, "arSpatialMixer::setHRTF");
+  _hrtf = h;
+  _partitions = (_hrtf.taps() + _B - 1) / _B;
+  if (_partitions < 1)
+    _partitions = 1;
+  _filters.clear();
+  _filters.resize(_hrtf.directions());
+  for (map<int, Source*>::iterator i = _sources.begin(); i != _sources.end(); ++i)
+    _resize(*i->second);
+  return ok;
+}
+
+void arSpatialMixer::_resize(Source& s) {
+  s.previous.assign(_B, 0.);
+  s.re.assign(_partitions * _bins, 0.);
+  s.im.assign(_partitions * _bins, 0.);
+  s.head = 0;
+  s.direction = -1;
+}
+
+const vector<float>* arSpatialMixer::loadSamples(const string& filename) {
+  {
+    arGuard _(_lock, "arSpatialMixer::loadSamples cached");
+    map<string, arAsset*>::const_iterator i = _samples.find(filename);
+    if (i != _samples.end())
+      return &static_cast<arSamplesAsset*>(i->second)->samples;
+  }
+
+  // Decode without the lock, so render() isn't starved.
+  arAssetCache& cache = ar_assetCache();
+  const string kind("wav/" + ar_intToString(int(_sampleRate)));
+  arAsset* a = cache.acquire(kind, filename);
+  if (!a) {
+    arSamplesAsset* s = new arSamplesAsset;
+    if (!ar_readWAV(filename, s->samples, _sampleRate)) {
+      delete s;
+      return NULL;
+    }
+    a = cache.insert(kind, filename, s);
+  }
+
+  arGuard _(_lock, "arSpatialMixer::loadSamples");
+  map<string, arAsset*>::const_iterator i = _samples.find(filename);
+  if (i != _samples.end()) {
+    // Another thread loaded it meanwhile.
+    cache.release(a);
+    a = i->second;
+  } else {
+    _samples[filename] = a;
+  }
+  return &static_cast<arSamplesAsset*>(a)->samples;
+}
+
+int arSpatialMixer::addSource(const vector<float>* samples, bool spatial) {
+  if (!samples)
+    return -1;
+
+  Source* s = new Source;
+  s->samples = samples;
+  s->spatial = spatial;
+  s->playing = false;
+  s->loop = false;
+  s->position = 0;
+  s->tail = 0;
+  s->point = arVector3(0, 0, -1);
+  s->amplitude = 0.;
+  s->gain = 0.;
+  arGuard _(_lock, "arSpatialMixer::addSource");
+  _resize(*s);
+  _sources[_nextID] = s;
+  return _nextID++;
+}
+
+void arSpatialMixer::removeSource(int id) {
+  arGuard _(_lock, "arSpatialMixer::removeSource");
+  map<int, Source*>::iterator i = _sources.find(id);
+  if (i != _sources.end()) {
+    delete i->second;
+    _sources.erase(i);
+  }
+}
+
+void arSpatialMixer::setSource(int id, const arVector3& position, float amplitude) {
+  arGuard _(_lock, "arSpatialMixer::setSource");
+  map<int, Source*>::iterator i = _sources.find(id);
+  if (i != _sources.end()) {
+    i->second->point = position;
+    i->second->amplitude = amplitude;
+  }
+}
+
+void arSpatialMixer::playSource(int id, bool loop) {
+  arGuard _(_lock, "arSpatialMixer::playSource");
+  map<int, Source*>::iterator i = _sources.find(id);
+  if (i != _sources.end()) {
+    i->second->playing = true;
+    i->second->loop = loop;
+  }
+}
+
+void arSpatialMixer::triggerSource(int id) {
+  arGuard _(_lock, "arSpatialMixer::triggerSource");
+  map<int, Source*>::iterator i = _sources.find(id);
+  if (i != _sources.end()) {
+    i->second->playing = true;
+    i->second->loop = false;
+    i->second->position = 0;
+  }
+}
+
+void arSpatialMixer::pauseSource(int id) {
+  arGuard _(_lock, "arSpatialMixer::pauseSource");
+  map<int, Source*>::iterator i = _sources.find(id);
+  if (i != _sources.end())
+    i->second->playing = false;
+}
+
+void arSpatialMixer::seekSource(int id, int msec) {
+  arGuard _(_lock, "arSpatialMixer::seekSource");
+  map<int, Source*>::iterator i = _sources.find(id);
+  if (i != _sources.end()) {
+    const int length = int(i->second->samples->size());
+    const int position = int(msec * .001 * _sampleRate);
+    i->second->position = position < 0 ? 0 : position > length ? length : position;
+  }
+}
+
+int arSpatialMixer::getSourceTime(int id) {
+  arGuard _(_lock, "arSpatialMixer::getSourceTime");
+  map<int, Source*>::const_iterator i = _sources.find(id);
+  return i == _sources.end() ? 0 : int(i->second->position * 1000. / _sampleRate);
+}
+
+int arSpatialMixer::getSourceLength(int id) {
+  arGuard _(_lock, "arSpatialMixer::getSourceLength");
+  map<int, Source*>::const_iterator i = _sources.find(id);
+  return i == _sources.end() ? 0 :
+    int(i->second->samples->size() * 1000. / _sampleRate);
+}
+
+void arSpatialMixer::reset() {
+  arGuard _(_lock, "arSpatialMixer::reset");
+  for (map<int, Source*>::iterator i = _sources.begin(); i != _sources.end(); ++i)
+    delete i->second;
+  _sources.clear();
+}
+
+// In place, unnormalized.
+void arSpatialMixer::_fft(float* re, float* im, bool inverse) {
+  int i;
+  for (i=0; i<_N; ++i) {
+    const int j = _bitReverse[i];
+    if (j > i) {
+      float t = re[i]; re[i] = re[j]; re[j] = t;
+      t = im[i]; im[i] = im[j]; im[j] = t;
+    }
+  }
+  const float sign = inverse ? -1. : 1.;
+  for (int len=2; len<=_N; len<<=1) {
+    const int half = len >> 1;
+    const int step = _N / len;
+    for (i=0; i<_N; i+=len) {
+      for (int k=0; k<half; ++k) {
+        const float wr = _cos[k*step];
+        const float wi = sign * _sin[k*step];
+        float* aRe = re + i + k;
+        float* aIm = im + i + k;
+        const float xr = aRe[half]*wr - aIm[half]*wi;
+        const float xi = aRe[half]*wi + aIm[half]*wr;
+        aRe[half] = *aRe - xr;
+        aIm[half] = *aIm - xi;
+        *aRe += xr;
+        *aIm += xi;
+      }
+    }
+  }
+}
+
+const vector<float>& arSpatialMixer::_filter(int direction) {
+  vector<float>& f = _filters[direction];
+  if (!f.empty())
+    return f;
+
+  f.resize(2 * _partitions * 2 * _bins);
+  for (int ear=0; ear<2; ++ear) {
+    const float* h = ear ? _hrtf.right(direction) : _hrtf.left(direction);
+    for (int p=0; p<_partitions; ++p) {
+      fill(_fftRe.begin(), _fftRe.end(), 0.);
+      fill(_fftIm.begin(), _fftIm.end(), 0.);
+      for (int t=0; t<_B && p*_B+t < _hrtf.taps(); ++t)
+        _fftRe[t] = h[p*_B + t];
+      _fft(&_fftRe[0], &_fftIm[0], false);
+      float* dst = &f[(ear*_partitions + p) * 2 * _bins];
+      memcpy(dst, &_fftRe[0], _bins * sizeof(float));
+      memcpy(dst + _bins, &_fftIm[0], _bins * sizeof(float));
+    }
+  }
+  return f;
+}
+
+void arSpatialMixer::_addFiltered(int which, const Source& s, const vector<float>& filter) {
+  for (int ear=0; ear<2; ++ear) {
+    float* accRe = _accumulator(which, ear, false);
+    float* accIm = _accumulator(which, ear, true);
+    for (int p=0; p<_partitions; ++p) {
+      // Partition p meets the input from p blocks ago.
+      const int slot = ((s.head - p + _partitions) % _partitions) * _bins;
+      const float* h = &filter[(ear*_partitions + p) * 2 * _bins];
+      ar_complexMultiplyAdd(accRe, accIm, &s.re[slot], &s.im[slot],
+                            h, h + _bins, _bins);
+    }
+  }
+}
+
+// Accumulated spectra back to the last _B samples of the overlap-save frame.
+void arSpatialMixer::_inverse(int which, float* left, float* right) {
+  for (int ear=0; ear<2; ++ear) {
+    const float* accRe = _accumulator(which, ear, false);
+    const float* accIm = _accumulator(which, ear, true);
+    for (int k=0; k<_bins; ++k) {
+      _fftRe[k] = accRe[k];
+      _fftIm[k] = accIm[k];
+    }
+    // Real signal:  the upper half mirrors the lower.
+    for (int k=1; k<_B; ++k) {
+      _fftRe[_N-k] = accRe[k];
+      _fftIm[_N-k] = -accIm[k];
+    }
+    _fft(&_fftRe[0], &_fftIm[0], true);
+    float* dst = ear ? right : left;
+    const float scale = 1. / _N;
+    for (int t=0; t<_B; ++t)
+      dst[t] = _fftRe[_B + t] * scale;
+  }
+}
+
+void arSpatialMixer::_renderBlock() {
+  const ar_timeval start = ar_time();
+  arGuard _(_lock, "arSpatialMixer::_renderBlock");
+
+  fill(_acc.begin(), _acc.end(), 0.);
+  fill(_direct.begin(), _direct.end(), 0.);
+  bool fading = false;
+  bool filtered = false;
+
+  for (map<int, Source*>::iterator iSource = _sources.begin();
+       iSource != _sources.end(); ++iSource) {
+    Source& s = *iSource->second;
+    if (!s.playing && s.tail <= 0)
+      continue;
+
+    // Gain ramps across the block, to avoid zipper noise.
+    float target = s.playing ? s.amplitude : 0.;
+    if (s.spatial) {
+      const float d = s.point.magnitude() / _referenceDistance;
+      if (d > 1.)
+        target /= d;
+    }
+    // Flush the delay line for _partitions blocks after the last one
+    // that had input, including one where the source stops midway.
+    s.tail = s.playing ? _partitions : s.tail-1;
+
+    const vector<float>& samples = *s.samples;
+    const int length = int(samples.size());
+    for (int t=0; t<_B; ++t) {
+      float x = 0.;
+      if (s.playing && length > 0) {
+        if (s.position >= length) {
+          // Unlooped sources stay at the end until triggered again.
+          if (s.loop)
+            s.position = 0;
+          else
+            s.playing = false;
+        }
+        if (s.playing)
+          x = samples[s.position++];
+      }
+      _input[t] = x * (s.gain + (target - s.gain) * (t+1) / _B);
+    }
+    s.gain = target;
+
+    if (!s.spatial) {
+      for (int t=0; t<_B; ++t) {
+        _direct[2*t] += _input[t];
+        _direct[2*t+1] += _input[t];
+      }
+      s.tail = 0;
+      continue;
+    }
+
+    // Overlap-save frame:  previous block, then this one.
+    memcpy(&_fftRe[0], &s.previous[0], _B * sizeof(float));
+    memcpy(&_fftRe[_B], &_input[0], _B * sizeof(float));
+    fill(_fftIm.begin(), _fftIm.end(), 0.);
+    _fft(&_fftRe[0], &_fftIm[0], false);
+    s.previous.assign(_input.begin(), _input.end());
+    s.head = (s.head + 1) % _partitions;
+    memcpy(&s.re[s.head * _bins], &_fftRe[0], _bins * sizeof(float));
+    memcpy(&s.im[s.head * _bins], &_fftIm[0], _bins * sizeof(float));
+
+    const int direction = _hrtf.nearest(s.point);
+    if (s.direction >= 0 && s.direction != direction) {
+      _addFiltered(1, s, _filter(s.direction));
+      _addFiltered(2, s, _filter(direction));
+      fading = true;
+    }
+    else {
+      _addFiltered(0, s, _filter(direction));
+    }
+    s.direction = direction;
+    filtered = true;
+  }
+
+  vector<float> l(_B, 0.);
+  vector<float> r(_B, 0.);
+  if (filtered)
+    _inverse(0, &l[0], &r[0]);
+  if (fading) {
+    vector<float> lOld(_B), rOld(_B), lNew(_B), rNew(_B);
+    _inverse(1, &lOld[0], &rOld[0]);
+    _inverse(2, &lNew[0], &rNew[0]);
+    for (int t=0; t<_B; ++t) {
+      const float w = float(t+1) / _B;
+      l[t] += lOld[t] + w * (lNew[t] - lOld[t]);
+      r[t] += rOld[t] + w * (rNew[t] - rOld[t]);
+    }
+  }
+  for (int t=0; t<_B; ++t) {
+    _out[2*t] = l[t] + _direct[2*t];
+    _out[2*t+1] = r[t] + _direct[2*t+1];
+  }
+  _outPos = 0;
+
+  ++_blocks;
+  _usecRendering += ar_difftime(ar_time(), start);
+}
+
+void arSpatialMixer::render(float* stereo, int frames) {
+  while (frames > 0) {
+    if (_outPos >= _B)
+      _renderBlock();
+    const int n = min(frames, _B - _outPos);
+    memcpy(stereo, &_out[2*_outPos], 2 * n * sizeof(float));
+    stereo += 2*n;
+    frames -= n;
+    _outPos += n;
+  }
+}
+
+bool arSpatialMixer::renderToWAV(const string& filename, float seconds) {
+  arWAVWriter w;
+  if (!w.open(filename, int(_sampleRate), 2))
+    return false;
+  vector<float> buf(2*_B);
+  for (int frames = int(seconds * _sampleRate); frames > 0; frames -= _B) {
+    const int n = min(frames, _B);
+    render(&buf[0], n);
+    if (!w.write(&buf[0], n))
+      return false;
+  }
+  return w.close();
+}
+
+string arSpatialMixer::status() {
+  arGuard _(_lock, "arSpatialMixer::status");
+  int playing = 0;
+  for (map<int, Source*>::const_iterator i = _sources.begin(); i != _sources.end(); ++i)
+    if (i->second->playing)
+      ++playing;
+  const double usecPerBlock = _blocks ? _usecRendering / _blocks : 0.;
+  return "arSpatialMixer: " + ar_intToString(playing) + " of " +
+    ar_intToString(_sources.size()) + " sources playing, " +
+    ar_intToString(int(usecPerBlock)) + " usec per " + ar_intToString(_B) +
+    "-sample block, " +
+    ar_intToString(int(100. * usecPerBlock * _sampleRate / (1e6 * _B))) +
+    "% of realtime.\n";
+}
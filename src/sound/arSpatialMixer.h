@@ -0,0 +1,123 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_SPATIAL_MIXER_H
+#define AR_SPATIAL_MIXER_H
+
+#include "arMath.h"
+#include "arThread.h"
+#include "arHRTF.h"
+#include "arAssetCache.h"
+#include "arSoundCalling.h"
+
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Binaural software mixer:  each spatial source is convolved with
+// the head-related impulse response of its direction, so no fmod
+// plugin is needed for headphone rendering.
+//
+// Convolution is uniformly partitioned overlap-save:  every block of
+// each source is transformed once, and all sources accumulate into one
+// output spectrum per ear, so each block costs one inverse FFT per ear
+// regardless of source count.  A source that changes direction is
+// crossfaded between the old and new responses over one block.
+
+class SZG_CALL arSpatialMixer {
+ public:
+  arSpatialMixer(int blockSize = 256, float sampleRate = 44100.);
+  ~arSpatialMixer();
+
+  // Measured dataset (see arHRTF::read), or "" for the spherical head.
+  bool setHRTF(const string& filename);
+  float getSampleRate() const { return _sampleRate; }
+  int getBlockSize() const { return _B; }
+
+  // Decoded .wav, shared through ar_assetCache().  NULL if unreadable.
+  const vector<float>* loadSamples(const string& filename);
+
+  // Spatial sources are convolved;  others (streamed music) play
+  // unfiltered to both ears.  Returns -1 if samples is NULL.
+  int addSource(const vector<float>* samples, bool spatial = true);
+  void removeSource(int id);
+  // Head-relative position, in the listener's units.
+  void setSource(int id, const arVector3& position, float amplitude);
+  void playSource(int id, bool loop);
+  void triggerSource(int id);
+  void pauseSource(int id);
+  // Milliseconds, for arStreamNode.
+  void seekSource(int id, int msec);
+  int getSourceTime(int id);
+  int getSourceLength(int id);
+  void reset();
+
+  // Interleaved stereo.
+  void render(float* stereo, int frames);
+  bool renderToWAV(const string& filename, float seconds);
+  string status();
+
+ private:
+  struct Source {
+    const vector<float>* samples;
+    bool spatial;
+    bool playing;
+    bool loop;
+    int position;
+    int tail;         // silent blocks left to flush the delay line
+    arVector3 point;
+    float amplitude;
+    float gain;       // at the end of the previous block
+    int direction;    // -1 until first rendered
+    vector<float> previous;  // last block's input, for overlap-save
+    vector<float> re;        // frequency-domain delay line,
+    vector<float> im;        //   [partition][bin]
+    int head;
+  };
+
+  const int _B;       // block size
+  const int _N;       // FFT size
+  const int _bins;
+  float _sampleRate;
+  float _referenceDistance;
+  int _partitions;
+
+  arLock _lock;
+  arHRTF _hrtf;
+  map<int, Source*> _sources;
+  int _nextID;
+  map<string, arAsset*> _samples;
+
+  // Response spectra per direction, made on first use:
+  // [ear][partition][bin], real then imaginary.
+  vector< vector<float> > _filters;
+
+  vector<float> _cos;
+  vector<float> _sin;
+  vector<int> _bitReverse;
+
+  vector<float> _fftRe;
+  vector<float> _fftIm;
+  vector<float> _acc;        // 3 accumulators x 2 ears x (re, im)
+  vector<float> _input;
+  vector<float> _direct;     // unfiltered sources, stereo
+  vector<float> _out;        // the current block, stereo
+  int _outPos;
+
+  long _blocks;
+  double _usecRendering;
+
+  void _fft(float* re, float* im, bool inverse);
+  const vector<float>& _filter(int direction);
+  float* _accumulator(int which, int ear, bool imaginary)
+    { return &_acc[((which*2 + ear)*2 + (imaginary ? 1 : 0)) * _bins]; }
+  void _addFiltered(int which, const Source&, const vector<float>& filter);
+  void _inverse(int which, float* left, float* right);
+  void _renderBlock();
+  void _resize(Source&);
+};
+
+#endif
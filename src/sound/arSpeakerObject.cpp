@@ -61,8 +61,8 @@ bool arSpeakerObject::loadMatrices(const arMatrix4& mHead, const int mode) {
 
   switch (mode) {
 
-  case mode_fmodplugins:
-    // Hide listener motion from the FMOD plugins:
+  case mode_hrtf:
+    // Hide listener motion from arSpatialMixer:
     // transform listener and sources so listener is
     // pos (0, 0, 0) fwd (0, 0, -1) up (0, 1, 0).
     __globalSoundListener = head.inverse();
@@ -16,7 +16,8 @@ arStreamNode::arStreamNode():
   _msecRequested(0),
   _msecNow(0),
   _msecDuration(0),
-  _complained(false) {
+  _complained(false),
+  _mixerSource(-1) {
 
   // RedHat 8.0's gcc fails if these are initializers, like graphics/ar*Node.cpp.
   _typeCode = AR_S_STREAM_NODE;
@@ -26,6 +27,8 @@ arStreamNode::arStreamNode():
 arStreamNode::~arStreamNode() {
   if (_owningDatabase->isServer())
     return;
+  if (_mixerSource >= 0)
+    _owningDatabase->getMixer().removeSource(_mixerSource);
 #ifdef EnableSound
   if (_stream) {
     (void)ar_fmodcheck( FMOD_Sound_Release( _stream ));
@@ -38,6 +41,8 @@ bool arStreamNode::render() {
     _fileNamePrev = _fileName; // This has no effect?
     return true;
   }
+  if (_owningDatabase->getMode() == mode_hrtf)
+    return _renderHRTF();
 
 #ifdef EnableSound
   if (_fileName != _fileNamePrev) {
@@ -107,6 +112,45 @@ bool arStreamNode::render() {
   return true;
 }
 
+// Unfiltered to both ears, through arSpatialMixer.  Only .wav files.
+bool arStreamNode::_renderHRTF() {
+  arSpatialMixer& mixer = _owningDatabase->getMixer();
+  if (_fileName != _fileNamePrev) {
+    _complained = false;
+    if (_mixerSource >= 0) {
+      mixer.removeSource(_mixerSource);
+      _mixerSource = -1;
+    }
+    const string fullName(ar_fileFind(_fileName, "", _owningDatabase->getPath()));
+    if (fullName != "NULL") {
+      _mixerSource = mixer.addSource(mixer.loadSamples(fullName), false);
+      _msecDuration = mixer.getSourceLength(_mixerSource);
+      mixer.playSource(_mixerSource, false);
+    }
+    _fileNamePrev = _fileName;
+  }
+
+  if (_mixerSource < 0) {
+    if (!_complained) {
+      ar_log_error() << "arStreamNode failed to create stream '" << _fileName << "'\n";
+      _complained = true;
+    }
+    return true;
+  }
+
+  mixer.setSource(_mixerSource, arVector3(0, 0, -1), _amplitude);
+  if (_msecRequested >= 0 && !_paused) {
+    mixer.seekSource(_mixerSource, _msecRequested);
+    _msecRequested = -1;
+  }
+  if (_paused)
+    mixer.pauseSource(_mixerSource);
+  else
+    mixer.playSource(_mixerSource, false);
+  _msecNow = mixer.getSourceTime(_mixerSource);
+  return true;
+}
+
 arStructuredData* arStreamNode::dumpData() {
   arStructuredData* data = _l.makeDataRecord(_l.AR_STREAM);
   _dumpGenericNode(data, _l.AR_STREAM_ID);
@@ -50,6 +50,9 @@ class SZG_CALL arStreamNode: public arSoundNode {
   unsigned _msecNow;
   unsigned _msecDuration;
   bool _complained;
+  int _mixerSource; // mode_hrtf's arSpatialMixer source, or -1
+
+  bool _renderHRTF();
 };
 
 #endif
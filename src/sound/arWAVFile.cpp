@@ -0,0 +1,187 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#include "arPrecompiled.h"
+#include "arWAVFile.h"
+#include "arLogStream.h"
+
+#include <string.h>
+
+// .wav is little-endian.
+static unsigned readLE(const unsigned char* p, int bytes) {
+  unsigned v = 0;
+  for (int i = bytes-1; i >= 0; --i)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+static void writeLE(unsigned char* p, unsigned v, int bytes) {
+  for (int i = 0; i < bytes; ++i, v >>= 8)
+    p[i] = (unsigned char)(v & 0xff);
+}
+
+static float sampleFromBytes(const unsigned char* p, int bytes, bool isFloat) {
+  if (isFloat) {
+    const unsigned u = readLE(p, 4);
+    float f;
+    memcpy(&f, &u, 4);
+    return f;
+  }
+  switch (bytes) {
+  case 1:
+    return (p[0] - 128) / 128.f;
+  case 2:
+    return short(readLE(p, 2)) / 32768.f;
+  case 3:
+    return (int(readLE(p, 3) << 8) >> 8) / 8388608.f;
+  default:
+    return int(readLE(p, 4)) / 2147483648.f;
+  }
+}
+
+bool ar_readWAV(const string& filename, vector<float>& samples, float sampleRate) {
+  FILE* f = fopen(filename.c_str(), "rb");
+  if (!f)
+    return false;
+
+  unsigned char header[12];
+  if (fread(header, 1, 12, f) != 12 || memcmp(header, "RIFF", 4) || memcmp(header+8, "WAVE", 4)) {
+    ar_log_error() << "ar_readWAV: '" << filename << "' isn't a .wav file.\n";
+    fclose(f);
+    return false;
+  }
+
+  int format = 0, channels = 0, rate = 0, bits = 0;
+  vector<unsigned char> data;
+  unsigned char chunk[8];
+  while (fread(chunk, 1, 8, f) == 8) {
+    const unsigned size = readLE(chunk+4, 4);
+    if (!memcmp(chunk, "fmt ", 4)) {
+      unsigned char fmt[40] = {0};
+      const unsigned n = size < sizeof(fmt) ? size : sizeof(fmt);
+      if (fread(fmt, 1, n, f) != n)
+        break;
+      format = readLE(fmt, 2);
+      channels = readLE(fmt+2, 2);
+      rate = readLE(fmt+4, 4);
+      bits = readLE(fmt+14, 2);
+      if (format == 0xfffe && n >= 26)
+        format = readLE(fmt+24, 2); // WAVE_FORMAT_EXTENSIBLE's subformat
+      fseek(f, size - n + (size & 1), SEEK_CUR);
+    }
+    else if (!memcmp(chunk, "data", 4)) {
+      data.resize(size);
+      data.resize(fread(&data[0], 1, size, f));
+      break;
+    }
+    else {
+      fseek(f, size + (size & 1), SEEK_CUR);
+    }
+  }
+  fclose(f);
+
+  const bool isFloat = format == 3 && bits == 32;
+  if ((format != 1 && !isFloat) || channels <= 0 || rate <= 0 ||
+      bits < 8 || bits > 32 || bits % 8 || data.empty()) {
+    ar_log_error() << "ar_readWAV: unsupported format in '" << filename << "'.\n";
+    return false;
+  }
+
+  // Mix down to mono.
+  const int bytes = bits / 8;
+  const int frames = int(data.size() / (bytes * channels));
+  vector<float> mono(frames);
+  const unsigned char* p = &data[0];
+  for (int i = 0; i < frames; ++i) {
+    float sum = 0.;
+    for (int c = 0; c < channels; ++c, p += bytes)
+      sum += sampleFromBytes(p, bytes, isFloat);
+    mono[i] = sum / channels;
+  }
+
+  if (int(sampleRate) == rate) {
+    samples.swap(mono);
+    return true;
+  }
+
+  // Linear interpolation is crude, but cheap and done only once.
+  const double step = double(rate) / sampleRate;
+  const int n = int(frames / step);
+  samples.resize(n);
+  for (int i = 0; i < n; ++i) {
+    const double t = i * step;
+    const int j = int(t);
+    const float a = float(t - j);
+    samples[i] = j+1 < frames ? mono[j]*(1.f-a) + mono[j+1]*a : mono[j];
+  }
+  return true;
+}
+
+arWAVWriter::arWAVWriter() :
+  _file(NULL),
+  _channels(0),
+  _dataBytes(0) {
+}
+
+arWAVWriter::~arWAVWriter() {
+  (void)close();
+}
+
+bool arWAVWriter::_writeHeader(int sampleRate) {
+  unsigned char h[44];
+  memcpy(h, "RIFF", 4);
+  writeLE(h+4, 36 + _dataBytes, 4);
+  memcpy(h+8, "WAVEfmt ", 8);
+  writeLE(h+16, 16, 4);
+  writeLE(h+20, 1, 2); // PCM
+  writeLE(h+22, _channels, 2);
+  writeLE(h+24, sampleRate, 4);
+  writeLE(h+28, sampleRate * _channels * 2, 4);
+  writeLE(h+32, _channels * 2, 2);
+  writeLE(h+34, 16, 2);
+  memcpy(h+36, "data", 4);
+  writeLE(h+40, _dataBytes, 4);
+  return fwrite(h, 1, 44, _file) == 44;
+}
+
+bool arWAVWriter::open(const string& filename, int sampleRate, int channels) {
+  (void)close();
+  _file = fopen(filename.c_str(), "wb");
+  if (!_file) {
+    ar_log_error() << "arWAVWriter failed to open '" << filename << "'.\n";
+    return false;
+  }
+  _channels = channels;
+  _dataBytes = 0;
+  return _writeHeader(sampleRate);
+}
+
+bool arWAVWriter::write(const float* samples, int frames) {
+  if (!_file)
+    return false;
+  const int n = frames * _channels;
+  vector<unsigned char> buf(2 * n);
+  for (int i = 0; i < n; ++i) {
+    const float s = samples[i] < -1.f ? -1.f : samples[i] > 1.f ? 1.f : samples[i];
+    writeLE(&buf[2*i], unsigned(short(s * 32767.f)), 2);
+  }
+  _dataBytes += 2 * n;
+  return n == 0 || fwrite(&buf[0], 1, 2 * n, _file) == size_t(2 * n);
+}
+
+bool arWAVWriter::close() {
+  if (!_file)
+    return true;
+
+  // Patch the header's sizes.
+  unsigned char size[4];
+  writeLE(size, 36 + _dataBytes, 4);
+  bool ok = fseek(_file, 4, SEEK_SET) == 0 && fwrite(size, 1, 4, _file) == 4;
+  writeLE(size, _dataBytes, 4);
+  ok = ok && fseek(_file, 40, SEEK_SET) == 0 && fwrite(size, 1, 4, _file) == 4;
+  ok = fclose(_file) == 0 && ok;
+  _file = NULL;
+  return ok;
+}
@@ -0,0 +1,43 @@
+//********************************************************
+// Syzygy is licensed under the BSD license v2
+// see the file SZG_CREDITS for details
+//********************************************************
+
+#ifndef AR_WAV_FILE_H
+#define AR_WAV_FILE_H
+
+#include "arSoundCalling.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Read and write .wav files without fmod, for arSpatialMixer.
+
+// Read PCM (8, 16, 24 or 32 bit) or float .wav, mixed down to mono
+// and resampled to sampleRate.
+SZG_CALL bool ar_readWAV(const string& filename, vector<float>& samples,
+                         float sampleRate);
+
+// Write 16-bit PCM .wav.
+class SZG_CALL arWAVWriter {
+ // Needs assignment operator and copy constructor, for pointer member.
+ public:
+  arWAVWriter();
+  ~arWAVWriter();
+
+  bool open(const string& filename, int sampleRate, int channels);
+  // Interleaved samples in [-1, 1], clipped.
+  bool write(const float* samples, int frames);
+  bool close();
+  bool isOpen() const { return _file != NULL; }
+
+ private:
+  FILE* _file;
+  int _channels;
+  unsigned _dataBytes;
+  bool _writeHeader(int sampleRate);
+};
+
+#endif
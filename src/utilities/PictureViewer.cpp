@@ -12,6 +12,7 @@
 #include "arMasterSlaveFramework.h"
 #include "arGlutRenderFuncs.h"
 #include "arLargeImage.h"
+#include "arImagePyramid.h"
 #include "arTexture.h"
 
 const float FLIP_SECONDS = 2;
@@ -45,6 +46,7 @@ class PictureApp: public arMasterSlaveFramework {
   private:
     arTexture _texture;
     arLargeImage _largeImage;
+    arImagePyramid _pyramid;
     int _screenWidth;
     int _screenHeight;
     int _flipped;
@@ -67,13 +69,23 @@ PictureApp::PictureApp() :
 //
 bool PictureApp::onStart( arSZGClient& szgClient ) {
   const string dataPath = szgClient.getDataPath();
-  if (!_texture.readPPM( pictureFilename, dataPath )) {
-    ar_log_error() << "PictureViewer failed to read picture file '"
-                 << pictureFilename << "' from path '" << dataPath << "'.\n";
-    return false;
+  // Pyramids (see PyramidTest) are read as needed, not all at once.
+  const string::size_type dot = pictureFilename.rfind('.');
+  if (dot != string::npos && pictureFilename.substr(dot) == ".pyr") {
+    if (!_pyramid.open( pictureFilename, dataPath )) {
+      ar_log_error() << "PictureViewer failed to read pyramid file '"
+                   << pictureFilename << "' from path '" << dataPath << "'.\n";
+      return false;
+    }
+  } else {
+    if (!_texture.readPPM( pictureFilename, dataPath )) {
+      ar_log_error() << "PictureViewer failed to read picture file '"
+                   << pictureFilename << "' from path '" << dataPath << "'.\n";
+      return false;
+    }
+    // NOTE: we _do_ need to keep the arTexture.
+    _largeImage.setImage(_texture);
   }
-  // NOTE: we _do_ need to keep the arTexture.
-  _largeImage.setImage(_texture);
 
   // Register shared memory.
   //  framework.addTransferField( char* name, void* address, arDataType type, int numElements ); e.g.
@@ -140,7 +152,11 @@ void PictureApp::showCenteredImage() {
   glMatrixMode(GL_MODELVIEW);
   glLoadIdentity();
   gluLookAt(0,0,2, 0,0,0, 0,1,0);
-  _largeImage.draw();
+  if (_pyramid.isOpen()) {
+    _pyramid.draw();
+  } else {
+    _largeImage.draw();
+  }
 }
 
 void PictureApp::drawSyncTest() {